@@ -0,0 +1,72 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "Allocations.hpp"
+#include "lilxml.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<unsigned long> allocations{0};
+
+static inline void counted()
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void * countedMalloc(size_t size)
+{
+    counted();
+    return malloc(size);
+}
+
+static void * countedRealloc(void * ptr, size_t size)
+{
+    counted();
+    return realloc(ptr, size);
+}
+
+void Allocations::setup()
+{
+    indi_xmlMalloc(countedMalloc, countedRealloc, free);
+}
+
+unsigned long Allocations::count()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+void * operator new(size_t size)
+{
+    counted();
+    void * p = malloc(size ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void * p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void * p, size_t) noexcept
+{
+    free(p);
+}
@@ -0,0 +1,49 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+
+/* Count of the heap allocations of the server: operator new, and the
+ * malloc/realloc of lilxml. Published as a metric, so the allocations
+ * made for each routed message can be followed.
+ *
+ * Counting replaces the global operator new: it is only built with the
+ * INDISERVER_COUNT_ALLOCATIONS CMake option. Without it, nothing is counted.
+ */
+class Allocations
+{
+    public:
+#ifdef INDISERVER_COUNT_ALLOCATIONS
+        static constexpr bool enabled = true;
+
+        /* Start counting the allocations of lilxml */
+        static void setup();
+
+        static unsigned long count();
+#else
+        static constexpr bool enabled = false;
+
+        static void setup() {}
+
+        static unsigned long count()
+        {
+            return 0;
+        }
+#endif
+};
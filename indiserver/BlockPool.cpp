@@ -0,0 +1,116 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "BlockPool.hpp"
+
+#include <mutex>
+
+namespace
+{
+
+constexpr size_t smallStep = 16;
+constexpr size_t smallClasses = 64;                 /* up to 1 kB */
+constexpr size_t largeClasses = 12;                 /* 2 kB to 4 MB */
+constexpr size_t smallMax = smallStep * smallClasses;
+constexpr size_t largeMax = smallMax << largeClasses;
+
+/* released blocks kept by a class, at most this many bytes */
+constexpr size_t keptBytes = 2 * 1024 * 1024;
+
+struct FreeBlock
+{
+    FreeBlock * next;
+};
+
+struct SizeClass
+{
+    std::mutex lock;
+    FreeBlock * free = nullptr;
+    size_t count = 0;
+};
+
+SizeClass classes[smallClasses + largeClasses];
+
+/* index in classes and size of the blocks for size, which must be <= largeMax */
+size_t classOf(size_t size, size_t &blockSize)
+{
+    if (size <= smallMax)
+    {
+        size_t id = size == 0 ? 0 : (size - 1) / smallStep;
+        blockSize = (id + 1) * smallStep;
+        return id;
+    }
+
+    size_t id = smallClasses;
+    blockSize = smallMax * 2;
+    while (blockSize < size)
+    {
+        blockSize *= 2;
+        id++;
+    }
+    return id;
+}
+
+}
+
+void * BlockPool::allocate(size_t size)
+{
+    if (size > largeMax)
+        return ::operator new(size);
+
+    size_t blockSize;
+    SizeClass &sizeClass = classes[classOf(size, blockSize)];
+    {
+        std::lock_guard<std::mutex> guard(sizeClass.lock);
+        FreeBlock * block = sizeClass.free;
+        if (block != nullptr)
+        {
+            sizeClass.free = block->next;
+            sizeClass.count--;
+            return block;
+        }
+    }
+    return ::operator new(blockSize);
+}
+
+void BlockPool::release(void * block, size_t size)
+{
+    if (block == nullptr)
+        return;
+
+    if (size > largeMax)
+    {
+        ::operator delete(block);
+        return;
+    }
+
+    size_t blockSize;
+    SizeClass &sizeClass = classes[classOf(size, blockSize)];
+    {
+        std::lock_guard<std::mutex> guard(sizeClass.lock);
+        if ((sizeClass.count + 1) * blockSize <= keptBytes || sizeClass.count == 0)
+        {
+            FreeBlock * freeBlock = static_cast<FreeBlock *>(block);
+            freeBlock->next = sizeClass.free;
+            sizeClass.free = freeBlock;
+            sizeClass.count++;
+            return;
+        }
+    }
+    ::operator delete(block);
+}
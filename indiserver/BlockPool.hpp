@@ -0,0 +1,92 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+/* Recycled memory blocks for what is allocated for every routed message:
+ * Msg and SerializedMsg objects, their containers and output buffers.
+ *
+ * Blocks are grouped by size class: multiples of 16 bytes for small objects,
+ * powers of two for buffers. Each class keeps a bounded number of released
+ * blocks for reuse, so a steady flow of messages stops reaching the heap.
+ * Blocks larger than the biggest class are plain heap allocations.
+ *
+ * Safe to use from any thread: buffers are filled by conversion threads.
+ */
+class BlockPool
+{
+    public:
+        static void * allocate(size_t size);
+
+        /* size must be the one given to allocate */
+        static void release(void * block, size_t size);
+};
+
+/* Base of classes whose instances come from the BlockPool */
+class PoolAllocated
+{
+    public:
+        static void * operator new(size_t size)
+        {
+            return BlockPool::allocate(size);
+        }
+
+        static void operator delete(void * block, size_t size)
+        {
+            BlockPool::release(block, size);
+        }
+};
+
+/* Allocator of standard containers, for their nodes and arrays */
+template <class T>
+class PoolAllocator
+{
+    public:
+        using value_type = T;
+
+        PoolAllocator() = default;
+
+        template <class U>
+        PoolAllocator(const PoolAllocator<U> &) {}
+
+        T * allocate(size_t n)
+        {
+            return static_cast<T *>(BlockPool::allocate(n * sizeof(T)));
+        }
+
+        void deallocate(T * p, size_t n)
+        {
+            BlockPool::release(p, n * sizeof(T));
+        }
+
+        template <class U>
+        bool operator==(const PoolAllocator<U> &) const
+        {
+            return true;
+        }
+
+        template <class U>
+        bool operator!=(const PoolAllocator<U> &) const
+        {
+            return false;
+        }
+};
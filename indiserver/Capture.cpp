@@ -0,0 +1,292 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "Capture.hpp"
+#include "Msg.hpp"
+#include "MsgQueue.hpp"
+#include "CommandLineArgs.hpp"
+#include "Utils.hpp"
+
+#include "base64.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <unordered_map>
+#include <vector>
+
+Capture * Capture::instance = nullptr;
+
+namespace
+{
+
+/* Capture ids of the open connections. 0 is the server itself */
+std::unordered_map<const MsgQueue *, uint32_t> connectionIds;
+uint32_t lastConnectionId = 0;
+
+uint32_t connectionId(const MsgQueue * queue)
+{
+    if (queue == nullptr)
+        return 0;
+
+    auto it = connectionIds.find(queue);
+    if (it != connectionIds.end())
+        return it->second;
+
+    return connectionIds[queue] = ++lastConnectionId;
+}
+
+uint64_t fnv1a(const char * data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/* Byte count of base64 text, without decoding it */
+size_t decodedSize(const char * text, size_t len)
+{
+    size_t chars = 0;
+    size_t padding = 0;
+    for (size_t i = 0; i < len; ++i)
+    {
+        char c = text[i];
+        if (c == '=')
+            padding++;
+        else if (!isspace((unsigned char)c))
+            chars++;
+    }
+    return (chars + padding) / 4 * 3 - std::min<size_t>(padding, 2);
+}
+
+}
+
+Capture::Capture(FILE * file): file(file)
+{
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    flushTimer.set<Capture, &Capture::onFlushTimer>(this);
+    flushTimer.start(flushPeriod, flushPeriod);
+}
+
+void Capture::setup(const std::string &path, const std::string &blobs)
+{
+    if (path.empty())
+        return;
+
+    FILE * file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        log(fmt("capture %s: %s\n", path.c_str(), strerror(errno)));
+        Bye();
+    }
+    /* the stream is flushed by the timer and at exit */
+    setvbuf(file, nullptr, _IOFBF, 1 << 20);
+
+    instance = new Capture(file);
+    if (blobs == "hash")
+        instance->hashBlobs = true;
+    else if (!blobs.empty())
+        instance->keptBlobBytes = strtoul(blobs.c_str(), nullptr, 10);
+
+    instance->write(CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE);
+
+    if (userConfigurableArguments->verbosity > 0)
+        log(fmt("capturing traffic to %s\n", path.c_str()));
+}
+
+void Capture::onFlushTimer(ev::timer &, int)
+{
+    fflush(file);
+}
+
+void Capture::write(const void * data, size_t size)
+{
+    if (fwrite(data, 1, size, file) != size)
+    {
+        log(fmt("capture write: %s\n", strerror(errno)));
+        Bye();
+    }
+}
+
+void Capture::writeU8(uint8_t value)
+{
+    write(&value, 1);
+}
+
+void Capture::writeU16(uint16_t value)
+{
+    uint8_t bytes[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+    write(bytes, sizeof(bytes));
+}
+
+void Capture::writeU32(uint32_t value)
+{
+    uint8_t bytes[4];
+    for (int i = 0; i < 4; ++i)
+        bytes[i] = (uint8_t)(value >> (8 * i));
+    write(bytes, sizeof(bytes));
+}
+
+void Capture::writeU64(uint64_t value)
+{
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; ++i)
+        bytes[i] = (uint8_t)(value >> (8 * i));
+    write(bytes, sizeof(bytes));
+}
+
+void Capture::header(CaptureRecord type, const MsgQueue * queue)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    writeU8(type);
+    writeU64((uint64_t)(now.tv_sec - start.tv_sec) * 1000000000ull + now.tv_nsec - start.tv_nsec);
+    writeU32(connectionId(queue));
+}
+
+uint32_t Capture::writeIn(const MsgQueue * from, const std::string &xml)
+{
+    uint32_t id = ++lastMsgId;
+    header(CaptureIn, from);
+    writeU32(id);
+    writeU32(xml.size());
+    write(xml.data(), xml.size());
+    return id;
+}
+
+void Capture::opened(CaptureRole role, const MsgQueue * queue, const std::string &name)
+{
+    if (!instance)
+        return;
+
+    instance->header(CaptureOpen, queue);
+    instance->writeU8(role);
+    instance->writeU16(std::min<size_t>(name.size(), UINT16_MAX));
+    instance->write(name.data(), std::min<size_t>(name.size(), UINT16_MAX));
+}
+
+void Capture::closed(const MsgQueue * queue)
+{
+    if (!instance || connectionIds.find(queue) == connectionIds.end())
+        return;
+
+    instance->header(CaptureClose, queue);
+    connectionIds.erase(queue);
+}
+
+uint32_t Capture::received(const MsgQueue * from, XMLEle * root, const std::string &raw,
+                           const std::list<int> &sharedBuffers)
+{
+    if (!instance)
+        return 0;
+
+    /* scanned messages never hold BLOBs */
+    return instance->writeIn(from, raw.empty() ? instance->elide(root, sharedBuffers) : raw);
+}
+
+void Capture::queued(const MsgQueue * to, Msg * mp)
+{
+    if (!instance)
+        return;
+
+    if (mp->captureId == 0)
+    {
+        std::string xml = mp->xmlContent && mp->rawContent.empty()
+                          ? instance->elide(mp->xmlContent, std::list<int>())
+                          : mp->rawContent;
+        mp->captureId = instance->writeIn(nullptr, xml);
+    }
+
+    instance->header(CaptureOut, to);
+    instance->writeU32(mp->captureId);
+}
+
+std::string Capture::elide(XMLEle * root, const std::list<int> &sharedBuffers)
+{
+    auto blobs = findBlobElements(root);
+    XMLEle * copy = blobs.empty() ? root : cloneXMLEle(root, nullptr, nullptr);
+    auto copies = findBlobElements(copy);
+
+    auto fd = sharedBuffers.begin();
+    for (size_t i = 0; i < blobs.size(); ++i)
+    {
+        if (strcmp(findXMLAttValu(blobs[i], "attached"), "true") == 0)
+        {
+            if (fd == sharedBuffers.end())
+            {
+                elideBlob(copies[i], nullptr, 0);
+                continue;
+            }
+
+            size_t mappedSize;
+            void * data = attachSharedBuffer(*fd, mappedSize);
+            ssize_t blobSize;
+            size_t size = mappedSize;
+            if (parseBlobSize(blobs[i], blobSize) && blobSize >= 0 && (size_t)blobSize <= mappedSize)
+                size = blobSize;
+
+            elideBlob(copies[i], (const char *)data, size);
+            dettachSharedBuffer(*fd++, data, mappedSize);
+        }
+        else if (!hashBlobs && keptBlobBytes == 0)
+        {
+            elideBlob(copies[i], nullptr, decodedSize(pcdataXMLEle(blobs[i]), pcdatalenXMLEle(blobs[i])));
+        }
+        else
+        {
+            int len = pcdatalenXMLEle(blobs[i]);
+            std::vector<char> decoded(3 * len / 4 + 4);
+            int size = from64tobits_fast(decoded.data(), pcdataXMLEle(blobs[i]), len);
+            elideBlob(copies[i], decoded.data(), std::max(size, 0));
+        }
+    }
+
+    std::string text(sprlXMLEle(copy, 0) + 1, '\0');
+    text.resize(sprXMLEle(&text[0], copy, 0));
+
+    if (copy != root)
+        delXMLEle(copy);
+    return text;
+}
+
+/* data is null when only the size is known */
+void Capture::elideBlob(XMLEle * blob, const char * data, size_t size)
+{
+    rmXMLAtt(blob, "attached");
+    rmXMLAtt(blob, "enclen");
+    rmXMLAtt(blob, "len");
+    addXMLAtt(blob, "len", fmt("%lu", (unsigned long)size).c_str());
+
+    if (hashBlobs && data)
+    {
+        addXMLAtt(blob, "hash", fmt("%016llx", (unsigned long long)fnv1a(data, size)).c_str());
+        editXMLEle(blob, "");
+        return;
+    }
+
+    size_t kept = data ? std::min(size, keptBlobBytes) : 0;
+    std::string encoded(4 * kept / 3 + 4, '\0');
+    encoded.resize(to64frombits_s((unsigned char *)&encoded[0], (const unsigned char *)data, kept, encoded.size()));
+    editXMLEle(blob, encoded.c_str());
+}
@@ -0,0 +1,86 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+
+#include "CaptureFormat.hpp"
+#include "lilxml.h"
+
+#include <ev++.h>
+#include <cstdio>
+#include <list>
+#include <string>
+
+class MsgQueue;
+class Msg;
+
+/* Record of the server traffic, for replay by indi_replay (see CaptureFormat.hpp).
+ *
+ * Every message read from a connection and every message queued to one is
+ * written with its time and connection, so a run can be played back later
+ * against another build to compare throughput and latency.
+ *
+ * All methods do nothing unless a capture was set up.
+ */
+class Capture
+{
+    public:
+        /* Capture to path. blobs is the count of BLOB bytes to keep, or "hash" */
+        static void setup(const std::string &path, const std::string &blobs);
+
+        static void opened(CaptureRole role, const MsgQueue * queue, const std::string &name);
+        static void closed(const MsgQueue * queue);
+
+        /* A message read from a connection, before it is dispatched. Returns its id */
+        static uint32_t received(const MsgQueue * from, XMLEle * root, const std::string &raw,
+                                 const std::list<int> &sharedBuffers);
+
+        /* A message queued to a connection */
+        static void queued(const MsgQueue * to, Msg * mp);
+
+    private:
+        static constexpr double flushPeriod {1};
+
+        FILE * file = nullptr;
+        struct timespec start;
+        uint32_t lastMsgId = 0;
+
+        bool hashBlobs = false;
+        size_t keptBlobBytes = 0;
+
+        ev::timer flushTimer;
+
+        Capture(FILE * file);
+        void onFlushTimer(ev::timer &watcher, int revents);
+
+        void header(CaptureRecord type, const MsgQueue * queue);
+        void write(const void * data, size_t size);
+        void writeU8(uint8_t value);
+        void writeU16(uint16_t value);
+        void writeU32(uint32_t value);
+        void writeU64(uint64_t value);
+        uint32_t writeIn(const MsgQueue * from, const std::string &xml);
+
+        /* The text of root, BLOB contents reduced as configured */
+        std::string elide(XMLEle * root, const std::list<int> &sharedBuffers);
+        void elideBlob(XMLEle * blob, const char * data, size_t size);
+
+        /* Never deleted: lives until exit */
+        static Capture * instance;
+};
@@ -0,0 +1,63 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+
+#include <cstdint>
+
+/* Traffic capture file, written by indiserver -C and read by indi_replay.
+ *
+ * All integers are little endian. The file starts with CAPTURE_MAGIC, then
+ * holds records:
+ *
+ *   record  := u8 type, u64 ns since the capture started, u32 connection, body
+ *
+ *   CaptureOpen    u8 role, u16 length, name
+ *   CaptureClose   (no body)
+ *   CaptureIn      u32 message id, u32 length, XML of the message
+ *   CaptureOut     u32 message id queued to the connection
+ *
+ * Connection 0 is the server itself: messages it creates are recorded as
+ * coming in from it. Message ids start at 1.
+ *
+ * BLOB contents are never recorded as is: each oneBLOB has its attached and
+ * enclen attributes removed, a len attribute giving the byte count of the
+ * content, and as pcdata the base64 of at most the first bytes of it (none by
+ * default). With hashing, a hash attribute replaces the pcdata, holding the
+ * FNV-1a 64 bits hash of the content in hexadecimal.
+ */
+#define CAPTURE_MAGIC "INDICAP1"
+#define CAPTURE_MAGIC_SIZE 8
+
+/* Bytes of type, time and connection fields that start each record */
+#define CAPTURE_RECORD_HEADER_SIZE 13
+
+enum CaptureRecord : uint8_t
+{
+    CaptureOpen = 1,
+    CaptureClose = 2,
+    CaptureIn = 3,
+    CaptureOut = 4
+};
+
+enum CaptureRole : uint8_t
+{
+    CaptureClient = 0,
+    CaptureDriver = 1
+};
@@ -23,17 +23,23 @@
 #include "Utils.hpp"
 #include "Property.hpp"
 #include "CommandLineArgs.hpp"
+#include "Metrics.hpp"
+#include "Capture.hpp"
+
+#include "indicore/indicompression.h"
+#include "indicore/indibinaryframe.h"
 
 ConcurrentSet<ClInfo> ClInfo::clients;
+PropertyIndex ClInfo::subscriptions;
 
 // root will be released
 void ClInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
 {
-    char *roottag    = tagXMLEle(root);
+    XMLAtom rootatom = tagAtomXMLEle(root);
 
-    const char *dev  = findXMLAttValu(root, "device");
-    const char *name = findXMLAttValu(root, "name");
-    int isblob       = !strcmp(tagXMLEle(root), "setBLOBVector");
+    const char *dev  = findXMLAttValuAtom(root, XMLATOM_device);
+    const char *name = findXMLAttValuAtom(root, XMLATOM_name);
+    int isblob       = rootatom == XMLATOM_setBLOBVector;
 
     /* snag interested properties.
      * N.B. don't open to alldevs if seen specific dev already, else
@@ -44,18 +50,35 @@ void ClInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
         // Signature for CHAINED SERVER
         // Not a regular client.
         if (dev[0] == '*' && !this->props.size())
+        {
             this->allprops = 2;
+            subscriptions.addWildcard(collectableId());
+        }
         else
             addDevice(dev, name, isblob);
     }
-    else if (!strcmp(roottag, "getProperties") && !this->props.size() && this->allprops != 2)
+    else if (rootatom == XMLATOM_getProperties && !this->props.size() && this->allprops != 2)
+    {
         this->allprops = 1;
+        subscriptions.addWildcard(collectableId());
+    }
 
-    /* snag enableBLOB -- send to remote drivers too */
-    if (!strcmp(roottag, "enableBLOB"))
+    /* snag enableBLOB */
+    if (rootatom == XMLATOM_enableBLOB)
         crackBLOBHandling(dev, name, pcdataXMLEle(root));
 
-    if (!strcmp(roottag, "pingRequest"))
+    /* who receives BLOBs may have changed */
+    if (rootatom == XMLATOM_enableBLOB || rootatom == XMLATOM_getProperties)
+        DvrInfo::updateBLOBDemand();
+
+    /* remote drivers got the demand of all clients instead */
+    if (rootatom == XMLATOM_enableBLOB)
+    {
+        delXMLEle(root);
+        return;
+    }
+
+    if (rootatom == XMLATOM_pingRequest)
     {
         setXMLEleTag(root, "pingReply");
 
@@ -65,6 +88,38 @@ void ClInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
         return;
     }
 
+    /* the client wants what follows compressed: acknowledge with the request itself */
+    if (rootatom == XMLATOM_enableCompression)
+    {
+        bool deflate = !strcmp(findXMLAttValuAtom(root, XMLATOM_format), "deflate");
+        delXMLEle(root);
+        if (deflate && acceptsEncodingChange())
+        {
+            if (userConfigurableArguments->verbosity)
+                log("compression enabled\n");
+            Msg * mp = Msg::fromRaw(this, INDI_COMPRESSION_REQUEST);
+            compressAfter(mp);
+            mp->queuingDone();
+        }
+        return;
+    }
+
+    /* the client wants what follows as binary frames: acknowledge with the request itself */
+    if (rootatom == XMLATOM_enableBinaryFraming)
+    {
+        bool supported = !strcmp(findXMLAttValuAtom(root, XMLATOM_version), "1");
+        delXMLEle(root);
+        if (supported && acceptsEncodingChange())
+        {
+            if (userConfigurableArguments->verbosity)
+                log("binary framing enabled\n");
+            Msg * mp = Msg::fromRaw(this, INDI_BINARY_FRAMING_REQUEST);
+            frameAfter(mp);
+            mp->queuingDone();
+        }
+        return;
+    }
+
     /* build a new message -- set content iff anyone cares */
     Msg* mp = Msg::fromXml(this, root, sharedBuffers);
     if (!mp)
@@ -74,18 +129,23 @@ void ClInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
         return;
     }
 
+    /* answer at once from the cache when it knows all that was asked, else ask the drivers */
+    bool cached = userConfigurableArguments->cacheProperties && rootatom == XMLATOM_getProperties && dev[0] != '*'
+                  && replayCache(dev, name);
+
     /* send message to driver(s) responsible for dev */
-    DvrInfo::q2RDrivers(dev, mp, root);
+    if (!cached)
+        DvrInfo::q2RDrivers(dev, mp, root);
 
     /* JM 2016-05-18: Upstream client can be a chained INDI server. If any driver locally is snooping
     * on any remote drivers, we should catch it and forward it to the responsible snooping driver. */
     /* send to snooping drivers. */
     // JM 2016-05-26: Only forward setXXX messages
-    if (!strncmp(roottag, "set", 3))
+    if (XMLATOM_IS_SET(rootatom))
         DvrInfo::q2SDrivers(NULL, isblob, dev, name, mp, root);
 
     /* echo new* commands back to other clients */
-    if (!strncmp(roottag, "new", 3))
+    if (XMLATOM_IS_NEW(rootatom))
     {
         q2Clients(this, isblob, dev, name, mp, root);
     }
@@ -93,85 +153,144 @@ void ClInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
     mp->queuingDone();
 }
 
+/* whether the cache holds every property a getProperties for dev/name is answered with */
+static bool cacheCovers(const std::string &dev, const std::string &name)
+{
+    if (!dev.empty())
+        return DvrInfo::cache.knows(dev, name);
+
+    /* all devices, each of them defined */
+    if (!name.empty())
+        return false;
+    for (auto dpId : DvrInfo::drivers.ids())
+    {
+        auto dp = DvrInfo::drivers[dpId];
+        if (dp == nullptr) continue;
+
+        for (auto &device : dp->dev)
+        {
+            if (!DvrInfo::cache.knows(device, ""))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool ClInfo::replayCache(const std::string &dev, const std::string &name)
+{
+    /* the cache has no BLOB values */
+    if (blob == B_ONLY || !cacheCovers(dev, name))
+        return false;
+
+    std::vector<const std::string*> msgs;
+    DvrInfo::cache.collect(dev, name, msgs);
+
+    if (userConfigurableArguments->verbosity > 1)
+        log(fmt("replaying %lu cached messages\n", (unsigned long)msgs.size()));
+
+    for (auto xml : msgs)
+    {
+        Msg * mp = Msg::fromRaw(this, *xml);
+        pushMsg(mp);
+        mp->queuingDone();
+    }
+    return true;
+}
+
 void ClInfo::close()
 {
+    if (userConfigurableArguments->verbosity > 0 && getReplacedCount() > 0)
+        log(fmt("%lu queued updates superseded\n", getReplacedCount()));
     if (userConfigurableArguments->verbosity > 0)
         log("shut down complete - bye!\n");
 
     delete(this);
 
+    DvrInfo::updateBLOBDemand();
+
 #ifdef OSX_EMBEDED_MODE
     fprintf(stderr, "CLIENTS %d\n", clients.size());
     fflush(stderr);
 #endif
 }
 
+/* return 1 if the BLOB message root carries a video stream frame */
+static int isStreamBLOB(XMLEle *root)
+{
+    for (XMLEle *ep = nextXMLEle(root, 1); ep; ep = nextXMLEle(root, 0))
+    {
+        if (tagAtomXMLEle(ep) == XMLATOM_oneBLOB)
+        {
+            XMLAtt *fa = findXMLAttAtom(ep, XMLATOM_format);
+
+            if (fa && strstr(valuXMLAtt(fa), "stream"))
+                return 1;
+        }
+    }
+    return 0;
+}
+
+/* return the key under which a queued copy of root may be replaced by a newer
+ * value of the same property, or an empty string if it must be delivered.
+ * Plain set messages qualify with -c, stream frames with -s. Other BLOBs and
+ * messages carry more than a value.
+ */
+static std::string replaceKey(int isblob, int isstream, const std::string &dev, const std::string &name, XMLEle *root)
+{
+    if (dev.empty() || name.empty())
+        return std::string();
+    if (isblob)
+    {
+        if (!isstream || !userConfigurableArguments->latestFrameOnly)
+            return std::string();
+    }
+    else if (!userConfigurableArguments->coalesceUpdates || !XMLATOM_IS_SET(tagAtomXMLEle(root))
+             || findXMLAttAtom(root, XMLATOM_message))
+        return std::string();
+    return dev + '\n' + name;
+}
+
 void ClInfo::q2Clients(ClInfo *notme, int isblob, const std::string &dev, const std::string &name, Msg *mp, XMLEle *root)
 {
+    /* only visit the clients that may be interested in dev/name */
+    std::set<unsigned long> cpIds;
+    if (dev.empty())
+    {
+        for (auto cpId : clients.ids())
+            cpIds.insert(cpId);
+    }
+    else
+        subscriptions.collect(dev, name, cpIds);
+
+    int isstream = isblob && isStreamBLOB(root);
+    std::string key = replaceKey(isblob, isstream, dev, name, root);
+
     /* queue message to each interested client */
-    for (auto cpId : clients.ids())
+    for (auto cpId : cpIds)
     {
         auto cp = clients[cpId];
         if (cp == nullptr) continue;
 
-        /* cp in use? notme? want this dev/name? blob? */
+        /* cp in use? notme? blob? */
         if (cp == notme)
             continue;
-        if (cp->findDevice(dev, name) < 0)
-            continue;
 
         //if ((isblob && cp->blob==B_NEVER) || (!isblob && cp->blob==B_ONLY))
         if (!isblob && cp->blob == B_ONLY)
             continue;
 
-        if (isblob)
-        {
-            if (cp->props.size() > 0)
-            {
-                Property *blobp = nullptr;
-                for (auto pp : cp->props)
-                {
-                    if (pp->dev == dev && pp->name == name)
-                    {
-                        blobp = pp;
-                        break;
-                    }
-                }
-
-                if ((blobp && blobp->blob == B_NEVER) || (!blobp && cp->blob == B_NEVER))
-                    continue;
-            }
-            else if (cp->blob == B_NEVER)
-                continue;
-        }
+        if (isblob && !cp->acceptsBLOB(dev, name))
+            continue;
 
         /* shut down this client if its q is already too large */
         unsigned long ql = cp->msgQSize();
-        if (isblob && userConfigurableArguments->maxStreamSizeMB > 0 && ql > userConfigurableArguments->maxStreamSizeMB)
+        if (isstream && userConfigurableArguments->maxStreamSizeMB > 0 && ql > userConfigurableArguments->maxStreamSizeMB)
         {
             // Drop frames for streaming blobs
-            /* pull out each name/BLOB pair, decode */
-            XMLEle *ep      = NULL;
-            int streamFound = 0;
-            for (ep = nextXMLEle(root, 1); ep; ep = nextXMLEle(root, 0))
-            {
-                if (strcmp(tagXMLEle(ep), "oneBLOB") == 0)
-                {
-                    XMLAtt *fa = findXMLAtt(ep, "format");
-
-                    if (fa && strstr(valuXMLAtt(fa), "stream"))
-                    {
-                        streamFound = 1;
-                        break;
-                    }
-                }
-            }
-            if (streamFound)
-            {
-                if (userConfigurableArguments->verbosity > 1)
-                    cp->log(fmt("%ld bytes behind. Dropping stream BLOB...\n", ql));
-                continue;
-            }
+            cp->droppedStreams++;
+            if (userConfigurableArguments->verbosity > 1)
+                cp->log(fmt("%ld bytes behind. Dropping stream BLOB...\n", ql));
+            continue;
         }
         if (ql > userConfigurableArguments->maxQueueSizeMB)
         {
@@ -186,7 +305,10 @@ void ClInfo::q2Clients(ClInfo *notme, int isblob, const std::string &dev, const
                         tagXMLEle(root), findXMLAttValu(root, "device"), findXMLAttValu(root, "name")));
 
         // pushmsg can kill cp. do at end
-        cp->pushMsg(mp);
+        if (key.empty())
+            cp->pushMsg(mp);
+        else
+            cp->pushMsg(mp, key);
     }
 
     return;
@@ -253,11 +375,8 @@ int ClInfo::findDevice(const std::string &dev, const std::string &name) const
 {
     if (allprops >= 1 || dev.empty())
         return (0);
-    for (auto pp : props)
-    {
-        if ((pp->dev == dev) && (pp->name.empty() || (pp->name == name)))
-            return (0);
-    }
+    if (subscriptions.find(collectableId(), dev, name))
+        return (0);
     return (-1);
 }
 
@@ -265,11 +384,8 @@ void ClInfo::addDevice(const std::string &dev, const std::string &name, int isbl
 {
     if (isblob)
     {
-        for (auto pp : props)
-        {
-            if (pp->dev == dev && pp->name == name)
-                return;
-        }
+        if (subscriptions.findExact(collectableId(), dev, name))
+            return;
     }
     /* no dups */
     else if (!findDevice(dev, name))
@@ -278,6 +394,18 @@ void ClInfo::addDevice(const std::string &dev, const std::string &name, int isbl
     /* add */
     Property *pp = new Property(dev, name);
     props.push_back(pp);
+    subscriptions.add(collectableId(), pp);
+}
+
+bool ClInfo::acceptsBLOB(const std::string &dev, const std::string &name) const
+{
+    if (props.size() > 0)
+    {
+        Property *blobp = subscriptions.findExact(collectableId(), dev, name);
+        if (blobp)
+            return blobp->blob != B_NEVER;
+    }
+    return blob != B_NEVER;
 }
 
 void ClInfo::crackBLOBHandling(const std::string &dev, const std::string &name, const char *enableBLOB)
@@ -291,15 +419,16 @@ void ClInfo::crackBLOBHandling(const std::string &dev, const std::string &name,
 
     /* If whole client blob handling policy was updated, we need to pass that also to all children
        and if the request was for a specific property, then we apply the policy to it */
-    for (auto pp : props)
+    if (name.empty())
     {
-        if (name.empty())
+        for (auto pp : props)
             crackBLOB(enableBLOB, &pp->blob);
-        else if (pp->dev == dev && pp->name == name)
-        {
+    }
+    else
+    {
+        Property *pp = subscriptions.findExact(collectableId(), dev, name);
+        if (pp)
             crackBLOB(enableBLOB, &pp->blob);
-            return;
-        }
     }
 }
 ClInfo::ClInfo(bool useSharedBuffer) : MsgQueue(useSharedBuffer)
@@ -309,8 +438,13 @@ ClInfo::ClInfo(bool useSharedBuffer) : MsgQueue(useSharedBuffer)
 
 ClInfo::~ClInfo()
 {
+    Metrics::retire(Metrics::Client, this);
+    Capture::closed(this);
+
+    subscriptions.removeWildcard(collectableId());
     for(auto prop : props)
     {
+        subscriptions.remove(collectableId(), prop);
         delete prop;
     }
 
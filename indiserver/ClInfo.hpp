@@ -20,6 +20,7 @@
 
 #include "indicore/indidevapi.h"
 #include "MsgQueue.hpp"
+#include "PropertyIndex.hpp"
 #include "lilxml.h"
 
 class DvrInfo;
@@ -37,13 +38,21 @@ class ClInfo: public MsgQueue
         /* Update the client property BLOB handling policy */
         void crackBLOBHandling(const std::string &dev, const std::string &name, const char *enableBLOB);
 
+        /* queue the cached properties of dev/name to this client. false, sending nothing,
+         * when the cache does not hold all of them */
+        bool replayCache(const std::string &dev, const std::string &name);
+
         /* close down the given client */
         virtual void close();
 
+        /* props[] of every client, by device and property name */
+        static PropertyIndex subscriptions;
+
     public:
         std::list<Property*> props;     /* props we want */
         int allprops = 0;               /* saw getProperties w/o device */
         BLOBHandling blob = B_NEVER;    /* when to send setBLOBs */
+        unsigned long droppedStreams = 0; /* stream BLOBs skipped while too far behind */
 
         ClInfo(bool useSharedBuffer);
         virtual ~ClInfo();
@@ -56,6 +65,10 @@ class ClInfo: public MsgQueue
          */
         void addDevice(const std::string &dev, const std::string &name, int isblob);
 
+        /* return true if the BLOB mode of cp lets setBLOBVector of dev/name through
+         */
+        bool acceptsBLOB(const std::string &dev, const std::string &name) const;
+
         virtual void log(const std::string &log) const;
 
         /* put Msg mp on queue of each chained server client, except notme.
@@ -44,6 +44,12 @@ class Collectable
         };
 
     protected:
+        /* id within the current ConcurrentSet, 0 when not collected */
+        unsigned long collectableId() const
+        {
+            return id;
+        }
+
         /* heartbeat.alive will return true as long as this item has not changed collection.
          * Also detect deletion of the Collectable */
         HeartBeat heartBeat() const
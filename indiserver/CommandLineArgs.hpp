@@ -20,6 +20,7 @@
 #include "Constants.hpp"
 
 #include <string>
+#include <vector>
 
 class Fifo;
 
@@ -32,6 +33,20 @@ struct CommandLineArgs
     int maxRestartAttempts{indiserver::constants::defaultMaximumRestarts};
     std::string binaryName{};
     int port{indiserver::constants::indiPortDefault};
+    int webSocketPort{0};
+    std::string webSocketHost{"127.0.0.1"};
+    std::vector<std::string> webSocketOrigins{};
+    std::string linkEncoding{"frames"};
+    int ioThreads{1};
+    bool ioUring{false};
+    int conversionThreads{0};
+    bool coalesceUpdates{false};
+    bool latestFrameOnly{false};
+    bool cacheProperties{false};
+    std::string metricsEndpoint{};
+    int metricsSummaryPeriod{0};
+    std::string capturePath{};
+    std::string captureBlobs{};
 };
 
 extern CommandLineArgs* userConfigurableArguments;
@@ -0,0 +1,135 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "ConversionPool.hpp"
+#include "SerializedMsg.hpp"
+#include "CommandLineArgs.hpp"
+#include "Utils.hpp"
+
+#include <algorithm>
+#include <thread>
+
+ConversionPool * ConversionPool::instance = nullptr;
+
+ConversionPool::ConversionPool(int workers): workerCount(workers)
+{
+    for (int i = 0; i < workers; ++i)
+    {
+        std::thread t([this]()
+        {
+            run();
+        });
+        t.detach();
+    }
+}
+
+void ConversionPool::setup(int workers)
+{
+    if (instance)
+        return;
+
+    if (workers <= 0)
+        workers = std::max(1u, std::thread::hardware_concurrency());
+
+    instance = new ConversionPool(workers);
+}
+
+void ConversionPool::submit(SerializedMsg * msg)
+{
+    setup(0);
+
+    unsigned long depth;
+    bool newHighWater = false;
+    {
+        std::lock_guard<std::mutex> guard(instance->lock);
+        auto &stats = instance->stats;
+        instance->pending.push_back(std::make_pair(msg, Clock::now()));
+        depth = ++stats.queued;
+        if (depth > stats.maxQueued)
+        {
+            stats.maxQueued = depth;
+            newHighWater = depth > 1;
+        }
+    }
+    instance->wakeup.notify_one();
+
+    if (newHighWater && userConfigurableArguments->verbosity > 0)
+        log(fmt("%lu blob conversions waiting for %d threads\n", depth, instance->workerCount));
+}
+
+bool ConversionPool::cancel(SerializedMsg * msg)
+{
+    if (!instance)
+        return false;
+
+    std::lock_guard<std::mutex> guard(instance->lock);
+    auto &pending = instance->pending;
+    for (auto it = pending.begin(); it != pending.end(); ++it)
+    {
+        if (it->first == msg)
+        {
+            pending.erase(it);
+            instance->stats.queued--;
+            instance->stats.canceled++;
+            return true;
+        }
+    }
+    return false;
+}
+
+ConversionPool::Stats ConversionPool::getStats()
+{
+    if (!instance)
+        return Stats();
+
+    std::lock_guard<std::mutex> guard(instance->lock);
+    return instance->stats;
+}
+
+void ConversionPool::run()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    while (true)
+    {
+        wakeup.wait(guard, [this]()
+        {
+            return !pending.empty();
+        });
+
+        auto job = pending.front();
+        pending.pop_front();
+        stats.queued--;
+        stats.running++;
+
+        // msg may be deleted as soon as its conversion reports completion: don't touch it afterwards
+        guard.unlock();
+        job.first->generateContent();
+        guard.lock();
+
+        uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - job.second).count();
+        stats.running--;
+        stats.done++;
+        stats.totalLatencyUs += latency;
+        stats.maxLatencyUs = std::max(stats.maxLatencyUs, latency);
+
+        unsigned bucket = 0;
+        while (bucket < Stats::latencyBuckets && latency > Stats::latencyBoundsUs[bucket])
+            bucket++;
+        stats.latencyHistogram[bucket]++;
+    }
+}
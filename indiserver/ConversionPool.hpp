@@ -0,0 +1,78 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+class SerializedMsg;
+
+/* Fixed set of threads running the asynchronous conversions of SerializedMsg
+ * (base64 encoding, shared buffer attachment), fed by a FIFO work queue.
+ * Conversions that are still queued can be withdrawn when nobody awaits them.
+ */
+class ConversionPool
+{
+    public:
+        struct Stats
+        {
+            unsigned long queued = 0;         /* conversions waiting for a worker */
+            unsigned long maxQueued = 0;      /* high water mark of queued */
+            unsigned long running = 0;        /* conversions in progress */
+            unsigned long done = 0;           /* conversions completed */
+            unsigned long canceled = 0;       /* conversions withdrawn before start */
+            uint64_t totalLatencyUs = 0;      /* from submission to completion, for done */
+            uint64_t maxLatencyUs = 0;
+
+            /* done conversions by latency: up to each bound, then above the last one */
+            static constexpr unsigned latencyBuckets = 5;
+            static constexpr uint64_t latencyBoundsUs[latencyBuckets] = {100, 1000, 10000, 100000, 1000000};
+            unsigned long latencyHistogram[latencyBuckets + 1] = {};
+        };
+
+        /* Start workers threads. 0 stands for the number of cores */
+        static void setup(int workers);
+
+        /* Queue the conversion of msg. Called from the main loop */
+        static void submit(SerializedMsg * msg);
+
+        /* Withdraw msg if no worker picked it yet. Return true if withdrawn */
+        static bool cancel(SerializedMsg * msg);
+
+        static Stats getStats();
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        std::mutex lock;
+        std::condition_variable wakeup;
+        std::deque<std::pair<SerializedMsg*, Clock::time_point>> pending;
+        Stats stats;
+        int workerCount;
+
+        ConversionPool(int workers);
+        void run();
+
+        /* Never deleted: workers live until exit */
+        static ConversionPool * instance;
+};
@@ -24,27 +24,32 @@
 #include "Property.hpp"
 #include "Fifo.hpp"
 #include "CommandLineArgs.hpp"
+#include "Metrics.hpp"
+#include "Capture.hpp"
 
 ConcurrentSet<DvrInfo> DvrInfo::drivers;
+PropertyCache DvrInfo::cache;
+PropertyIndex DvrInfo::snoops;
+unsigned long DvrInfo::snoopDeliveries = 0;
 
 void DvrInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
 {
-    char *roottag    = tagXMLEle(root);
-    const char *dev  = findXMLAttValu(root, "device");
-    const char *name = findXMLAttValu(root, "name");
-    int isblob       = !strcmp(tagXMLEle(root), "setBLOBVector");
+    XMLAtom rootatom = tagAtomXMLEle(root);
+    const char *dev  = findXMLAttValuAtom(root, XMLATOM_device);
+    const char *name = findXMLAttValuAtom(root, XMLATOM_name);
+    int isblob       = rootatom == XMLATOM_setBLOBVector;
 
     if (userConfigurableArguments->verbosity > 2)
         traceMsg("read ", root);
     else if (userConfigurableArguments->verbosity > 1)
     {
         log(fmt("read <%s device='%s' name='%s'>\n",
-                tagXMLEle(root), findXMLAttValu(root, "device"), findXMLAttValu(root, "name")));
+                tagXMLEle(root), dev, name));
     }
 
     /* that's all if driver is just registering a snoop */
     /* JM 2016-05-18: Send getProperties to upstream chained servers as well.*/
-    if (!strcmp(roottag, "getProperties"))
+    if (rootatom == XMLATOM_getProperties)
     {
         this->addSDevice(dev, name);
         Msg *mp = new Msg(this, root);
@@ -61,12 +66,22 @@ void DvrInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
     }
 
     /* that's all if driver desires to snoop BLOBs from other drivers */
-    if (!strcmp(roottag, "enableBLOB"))
+    if (rootatom == XMLATOM_enableBLOB)
     {
         Property *sp = findSDevice(dev, name);
         if (sp)
             crackBLOB(pcdataXMLEle(root), &sp->blob);
         delXMLEle(root);
+        updateBLOBDemand();
+        return;
+    }
+
+    /* that's all if driver wants to know when nobody receives its BLOBs */
+    if (rootatom == XMLATOM_getBLOBDemand)
+    {
+        wantsBLOBDemand = true;
+        delXMLEle(root);
+        sendBLOBDemand();
         return;
     }
 
@@ -85,7 +100,7 @@ void DvrInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
     if (userConfigurableArguments->loggingDir)
         logDMsg(root, dev);
 
-    if (!strcmp(roottag, "pingRequest"))
+    if (rootatom == XMLATOM_pingRequest)
     {
         setXMLEleTag(root, "pingReply");
 
@@ -103,6 +118,32 @@ void DvrInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
         return;
     }
 
+    /* keep track of the BLOB vectors whose demand the driver may want to know */
+    bool blobsChanged = false;
+    if (rootatom == XMLATOM_defBLOBVector)
+    {
+        /* an upstream server sends no BLOB until asked */
+        blobDemand.emplace(std::make_pair(std::string(dev), std::string(name)), remoteServerUid().empty() ? -1 : 0);
+        blobsChanged = true;
+    }
+    else if (rootatom == XMLATOM_delProperty)
+    {
+        for (auto it = blobDemand.begin(); it != blobDemand.end();)
+        {
+            if (it->first.first == dev && (!name[0] || it->first.second == name))
+            {
+                it = blobDemand.erase(it);
+                blobsChanged = true;
+            }
+            else
+                ++it;
+        }
+    }
+
+    /* keep track of the last state of properties */
+    if (userConfigurableArguments->cacheProperties)
+        cache.update(rootatom, dev, name, root);
+
     /* send to interested clients */
     ClInfo::q2Clients(NULL, isblob, dev, name, mp, root);
 
@@ -111,6 +152,10 @@ void DvrInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
 
     /* set message content if anyone cares else forget it */
     mp->queuingDone();
+
+    /* another link to the same chained server may carry these BLOBs now */
+    if (blobsChanged)
+        updateBLOBDemand();
 }
 
 void DvrInfo::closeWritePart()
@@ -129,6 +174,7 @@ void DvrInfo::close()
         /* Inform clients that this driver is dead */
         XMLEle *root = addXMLEle(NULL, "delProperty");
         addXMLAtt(root, "device", dev.c_str());
+        cache.erase(dev);
 
         prXMLEle(stderr, root, 0);
         Msg *mp = new Msg(this, root);
@@ -166,6 +212,7 @@ void DvrInfo::close()
     if (terminate)
     {
         delete(this);
+        updateBLOBDemand();
         if ((!fifoHandle) && (drivers.ids().empty()))
             Bye();
         return;
@@ -174,14 +221,13 @@ void DvrInfo::close()
     {
         DvrInfo * restarted = this->clone();
         delete(this);
+        updateBLOBDemand();
         restarted->start();
     }
 }
 
 void DvrInfo::q2RDrivers(const std::string &dev, Msg *mp, XMLEle *root)
 {
-    char *roottag = tagXMLEle(root);
-
     /* queue message to each interested driver.
      * N.B. don't send generic getProps to more than one remote driver,
      *   otherwise they all fan out and we get multiple responses back.
@@ -211,10 +257,6 @@ void DvrInfo::q2RDrivers(const std::string &dev, Msg *mp, XMLEle *root)
             remoteAdvertised.insert(remoteUid);
         }
 
-        /* JM 2016-10-30: Only send enableBLOB to remote drivers */
-        if (isRemote == 0 && !strcmp(roottag, "enableBLOB"))
-            continue;
-
         /* ok: queue message to this driver */
         if (userConfigurableArguments->verbosity > 1)
         {
@@ -229,8 +271,14 @@ void DvrInfo::q2RDrivers(const std::string &dev, Msg *mp, XMLEle *root)
 
 void DvrInfo::q2SDrivers(DvrInfo *me, int isblob, const std::string &dev, const std::string &name, Msg *mp, XMLEle *root)
 {
+    /* only visit the drivers snooping dev/name */
+    std::set<unsigned long> dpIds;
+    snoops.collect(dev, name, dpIds);
+    if (dpIds.empty())
+        return;
+
     std::string meRemoteServerUid = me ? me->remoteServerUid() : "";
-    for (auto dpId : drivers.ids())
+    for (auto dpId : dpIds)
     {
         auto dp = drivers[dpId];
         if (dp == nullptr) continue;
@@ -256,10 +304,104 @@ void DvrInfo::q2SDrivers(DvrInfo *me, int isblob, const std::string &dev, const
         }
 
         // pushmsg can kill dp. do at end
+        snoopDeliveries++;
         dp->pushMsg(mp);
     }
 }
 
+/* return true if a client or a snooping driver would receive BLOBs of dev/name */
+static bool hasBLOBDemand(const std::string &dev, const std::string &name)
+{
+    for (auto cpId : ClInfo::clients.ids())
+    {
+        auto cp = ClInfo::clients[cpId];
+        if (cp == nullptr) continue;
+
+        if (cp->findDevice(dev, name) == 0 && cp->acceptsBLOB(dev, name))
+            return true;
+    }
+
+    std::set<unsigned long> dpIds;
+    DvrInfo::snoops.collect(dev, name, dpIds);
+    for (auto dpId : dpIds)
+    {
+        auto dp = DvrInfo::drivers[dpId];
+        if (dp == nullptr) continue;
+
+        Property *sp = dp->findSDevice(dev, name);
+        if (sp && sp->blob != B_NEVER)
+            return true;
+    }
+
+    return false;
+}
+
+bool DvrInfo::carriesBLOBs(const std::string &dev, const std::string &name) const
+{
+    std::string uid = remoteServerUid();
+    auto key = std::make_pair(dev, name);
+    for (auto dpId : drivers.ids())
+    {
+        auto dp = drivers[dpId];
+        if (dp == nullptr || dpId >= collectableId()) continue;
+
+        if (dp->remoteServerUid() == uid && dp->blobDemand.count(key))
+            return false;
+    }
+    return true;
+}
+
+void DvrInfo::sendBLOBDemand()
+{
+    bool isRemote = !remoteServerUid().empty();
+    if (!wantsBLOBDemand && !isRemote)
+        return;
+
+    for (auto &entry : blobDemand)
+    {
+        const std::string &dev = entry.first.first;
+        const std::string &name = entry.first.second;
+
+        int demand = hasBLOBDemand(dev, name) && (!isRemote || carriesBLOBs(dev, name)) ? 1 : 0;
+        if (demand == entry.second)
+            continue;
+        entry.second = demand;
+
+        if (userConfigurableArguments->verbosity)
+            log(fmt("BLOB demand for %s.%s: %s\n", dev.c_str(), name.c_str(), demand ? "On" : "Off"));
+
+        XMLEle *root;
+        if (isRemote)
+        {
+            /* a chained server sends BLOBs once for all our clients */
+            root = addXMLEle(NULL, "enableBLOB");
+            editXMLEle(root, demand ? "Also" : "Never");
+        }
+        else
+        {
+            root = addXMLEle(NULL, "blobDemand");
+            editXMLEle(root, demand ? "On" : "Off");
+        }
+        addXMLAtt(root, "device", dev.c_str());
+        addXMLAtt(root, "name", name.c_str());
+
+        Msg *mp = new Msg(this, root);
+        pushMsg(mp);
+        mp->queuingDone();
+    }
+}
+
+void DvrInfo::updateBLOBDemand()
+{
+    for (auto dpId : drivers.ids())
+    {
+        auto dp = drivers[dpId];
+        if (dp == nullptr) continue;
+
+        dp->sendBLOBDemand();
+    }
+}
+
 void DvrInfo::addSDevice(const std::string &dev, const std::string &name)
 {
     Property *sp;
@@ -273,6 +415,7 @@ void DvrInfo::addSDevice(const std::string &dev, const std::string &name)
     sp = new Property(dev, name);
     sp->blob = B_NEVER;
     sprops.push_back(sp);
+    snoops.add(collectableId(), sp);
 
     if (userConfigurableArguments->verbosity)
         log(fmt("snooping on %s.%s\n", dev.c_str(), name.c_str()));
@@ -280,13 +423,9 @@ void DvrInfo::addSDevice(const std::string &dev, const std::string &name)
 
 Property * DvrInfo::findSDevice(const std::string &dev, const std::string &name) const
 {
-    for(auto sp : sprops)
-    {
-        if ((sp->dev == dev) && (sp->name.empty() || sp->name == name))
-            return (sp);
-    }
-
-    return nullptr;
+    if (sprops.empty())
+        return nullptr;
+    return snoops.find(collectableId(), dev, name);
 }
 DvrInfo::DvrInfo(bool useSharedBuffer) :
     MsgQueue(useSharedBuffer),
@@ -305,11 +444,15 @@ DvrInfo::DvrInfo(const DvrInfo &model):
 
 DvrInfo::~DvrInfo()
 {
-    drivers.erase(this);
+    Metrics::retire(Metrics::Driver, this);
+    Capture::closed(this);
+
     for(auto prop : sprops)
     {
+        snoops.remove(collectableId(), prop);
         delete prop;
     }
+    drivers.erase(this);
 }
 
 bool DvrInfo::isHandlingDevice(const std::string &dev) const
@@ -19,9 +19,12 @@
 #pragma once
 
 #include "MsgQueue.hpp"
+#include "PropertyCache.hpp"
+#include "PropertyIndex.hpp"
 #include "lilxml.h"
 
 #include <list>
+#include <map>
 #include <set>
 #include <string>
 
@@ -36,6 +39,22 @@ class DvrInfo: public MsgQueue
          */
         void addSDevice(const std::string &dev, const std::string &name);
 
+        /* BLOB vectors defined by this driver, with the demand last reported to it
+         * (-1 when not reported yet).
+         */
+        std::map<std::pair<std::string, std::string>, int> blobDemand;
+        bool wantsBLOBDemand = false;   /* driver asked for blobDemand hints */
+
+        /* tell the driver about each of its BLOB vectors whose demand changed.
+         * chained servers get enableBLOB instead, on behalf of all our clients.
+         */
+        void sendBLOBDemand();
+
+        /* true unless an older link to the same chained server also defines dev/name:
+         * its BLOBs cross once, on the first link.
+         */
+        bool carriesBLOBs(const std::string &dev, const std::string &name) const;
+
     public:
         /* return Property if dp is this driver is snooping dev/name, else NULL.
          */
@@ -57,7 +76,7 @@ class DvrInfo: public MsgQueue
         std::string name;               /* persistent name */
 
         std::set<std::string> dev;      /* device served by this driver */
-        std::list<Property*>sprops;     /* props we snoop */
+        std::list<Property*>sprops;     /* props we snoop, also in snoops */
         int restarts;                   /* times process has been restarted */
         bool restart = true;            /* Restart on shutdown */
 
@@ -91,10 +110,25 @@ class DvrInfo: public MsgQueue
          */
         static void q2SDrivers(DvrInfo *me, int isblob, const std::string &dev, const std::string &name, Msg *mp, XMLEle *root);
 
+        /* let drivers which asked for it skip BLOBs nobody would receive.
+         * call whenever the BLOB interest of a client or snooping driver may have changed.
+         */
+        static void updateBLOBDemand();
+
         /* Reference to all active drivers */
         static ConcurrentSet<DvrInfo> drivers;
 
-        // decoding of attached blobs from driver is not supported ATM. Be conservative here
+        /* sprops of every driver, by device and property name */
+        static PropertyIndex snoops;
+
+        /* messages queued to snooping drivers since startup */
+        static unsigned long snoopDeliveries;
+
+        /* Properties of all drivers, when -k is set */
+        static PropertyCache cache;
+
+        // Whether messages sent to this driver may carry shared buffers. Attached blobs coming
+        // from drivers are always ingested; snooping drivers are sent base64 to stay conservative
         bool acceptSharedBuffers() const override
         {
             return false;
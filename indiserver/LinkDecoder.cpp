@@ -0,0 +1,330 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "LinkDecoder.hpp"
+#include "Utils.hpp"
+#include "base64.h"
+#include "sharedblob.h"
+#include "indicore/indibinaryframe.h"
+#include "indicore/indicompression.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+
+/* BLOB content of a frame, passed on in shared buffers or as base64 */
+class LinkBlobSink: public INDI::BinaryFrame::BlobSink
+{
+    public:
+        /* fds already handed over, to close if the frame proves bad */
+        std::vector<int> attached;
+        unsigned long bytes = 0;
+
+        ~LinkBlobSink()
+        {
+            for (int fd : attached)
+                ::close(fd);
+        }
+
+        bool store(XMLEle * ep, const unsigned char * content, size_t len) override
+        {
+            bytes += len;
+            if (len == 0)
+            {
+                addXMLAtt(ep, "enclen", "0");
+                return true;
+            }
+
+#ifdef ENABLE_INDI_SHARED_MEMORY
+            // Pass the content on as an attached buffer: no base64 on the way
+            void * blob = IDSharedBlobAlloc(len);
+            if (blob == nullptr)
+            {
+                log(fmt("Unable to allocate shared buffer of size %llu : %s\n", (unsigned long long)len, strerror(errno)));
+                return false;
+            }
+            memcpy(blob, content, len);
+            int fd = IDSharedBlobGetFd(blob);
+            IDSharedBlobDettach(blob);
+
+            // Readers map the whole buffer: make it the size of the content
+            if (ftruncate(fd, len) == -1)
+                log(fmt("shared buffer truncate: %s\n", strerror(errno)));
+
+            attached.push_back(fd);
+            addXMLAtt(ep, "len", std::to_string(len).c_str());
+            addXMLAtt(ep, "attached", "true");
+#else
+            std::vector<unsigned char> encoded(4 * len / 3 + 4);
+            int encodedLen = to64frombits_s(encoded.data(), content, len, encoded.size());
+            encoded.resize(encodedLen);
+            encoded.push_back(0);
+            addXMLAtt(ep, "enclen", std::to_string(encodedLen).c_str());
+            editXMLEle(ep, reinterpret_cast<const char *>(encoded.data()));
+#endif
+            return true;
+        }
+};
+
+}
+
+LinkDecoder::LinkDecoder(Encoding requested): requested(requested), negotiating(requested != Xml)
+{
+}
+
+LinkDecoder::~LinkDecoder()
+{
+    if (inflaterReady)
+        inflateEnd(&inflater);
+}
+
+const char * LinkDecoder::request(Encoding encoding)
+{
+    switch (encoding)
+    {
+        case Frames:
+            return INDI_BINARY_FRAMING_REQUEST;
+        case Deflate:
+            return INDI_COMPRESSION_REQUEST;
+        default:
+            return "";
+    }
+}
+
+const char * LinkDecoder::name(Encoding encoding)
+{
+    switch (encoding)
+    {
+        case Frames:
+            return "frames";
+        case Deflate:
+            return "deflate";
+        default:
+            return "xml";
+    }
+}
+
+bool LinkDecoder::parse(const std::string &name, Encoding &encoding)
+{
+    for (Encoding e : {Xml, Frames, Deflate})
+    {
+        if (name == LinkDecoder::name(e))
+        {
+            encoding = e;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LinkDecoder::decode(const char * data, size_t size, XmlSplitter &splitter,
+                         std::list<ScannedXml> &out, std::list<int> &sharedBuffers, std::string &failure)
+{
+    if (negotiating)
+    {
+        const char * expected = request(requested);
+        size_t expectedSize = strlen(expected);
+        size_t take = std::min(size, expectedSize - ack.size());
+
+        ack.append(data, take);
+        data += take;
+        size -= take;
+
+        if (ack.compare(0, ack.size(), expected, ack.size()) != 0)
+        {
+            // Not an acknowledgment: the upstream sends XML
+            negotiating = false;
+            std::string received;
+            received.swap(ack);
+            return feedXml(received.data(), received.size(), splitter, out, failure)
+                   && feedXml(data, size, splitter, out, failure);
+        }
+
+        if (ack.size() < expectedSize)
+            return true;
+
+        // The acknowledgment itself is not a message
+        negotiating = false;
+        ack = std::string();
+        current.store(requested, std::memory_order_relaxed);
+    }
+
+    if (size == 0)
+        return true;
+
+    switch (encoding())
+    {
+        case Frames:
+            return frameData(data, size, splitter, out, sharedBuffers, failure);
+        case Deflate:
+            return inflateData(data, size, splitter, out, failure);
+        default:
+            return feedXml(data, size, splitter, out, failure);
+    }
+}
+
+bool LinkDecoder::feedXml(const char * data, size_t size, XmlSplitter &splitter, std::list<ScannedXml> &out, std::string &failure)
+{
+    if (size == 0)
+        return true;
+
+    xmlBytes.fetch_add(size, std::memory_order_relaxed);
+
+    std::string err;
+    if (!splitter.feed(data, size, out, err))
+    {
+        failure = fmt("XML error: %s\n", err.c_str());
+        failure += fmt("XML read: %.*s\n", (int)size, data);
+        return false;
+    }
+    return true;
+}
+
+bool LinkDecoder::inflateData(const char * data, size_t size, XmlSplitter &splitter, std::list<ScannedXml> &out, std::string &failure)
+{
+    if (!inflaterReady)
+    {
+        memset(&inflater, 0, sizeof(inflater));
+        if (inflateInit(&inflater) != Z_OK)
+        {
+            failure = "inflateInit failed\n";
+            return false;
+        }
+        inflaterReady = true;
+    }
+
+    char buffer[inflateChunk];
+    inflater.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    inflater.avail_in = size;
+    do
+    {
+        inflater.next_out = reinterpret_cast<Bytef *>(buffer);
+        inflater.avail_out = sizeof(buffer);
+
+        int rc = inflate(&inflater, Z_SYNC_FLUSH);
+        if (rc == Z_NEED_DICT)
+        {
+            if (inflateSetDictionary(&inflater, reinterpret_cast<const Bytef *>(indiCompressionDictionary),
+                                     sizeof(indiCompressionDictionary) - 1) != Z_OK)
+                rc = Z_DATA_ERROR;
+            else
+                rc = inflate(&inflater, Z_SYNC_FLUSH);
+        }
+        if (rc != Z_OK && rc != Z_BUF_ERROR)
+        {
+            failure = fmt("Bad compressed data: %s\n", inflater.msg ? inflater.msg : "stream end");
+            return false;
+        }
+
+        if (!feedXml(buffer, sizeof(buffer) - inflater.avail_out, splitter, out, failure))
+            return false;
+    }
+    while (inflater.avail_in > 0 || inflater.avail_out == 0);
+
+    return true;
+}
+
+bool LinkDecoder::frameData(const char * data, size_t size, XmlSplitter &splitter,
+                            std::list<ScannedXml> &out, std::list<int> &sharedBuffers, std::string &failure)
+{
+    while (size > 0)
+    {
+        // Complete frames are decoded from the incoming data, without copy
+        if (frame.empty() && size >= 4)
+        {
+            uint32_t length = 0;
+            for (int i = 0; i < 4; ++i)
+                length |= uint32_t(static_cast<unsigned char>(data[i])) << (8 * i);
+
+            if (size >= 4 + size_t(length))
+            {
+                if (!dispatchFrame(data + 4, length, splitter, out, sharedBuffers, failure))
+                    return false;
+                data += 4 + length;
+                size -= 4 + length;
+                continue;
+            }
+        }
+
+        // Keep the start of the frame until the rest comes
+        size_t needed = 4;
+        if (frame.size() >= 4)
+        {
+            uint32_t length = 0;
+            for (int i = 0; i < 4; ++i)
+                length |= uint32_t(static_cast<unsigned char>(frame[i])) << (8 * i);
+            needed += length;
+            if (frame.capacity() < needed)
+                frame.reserve(needed);
+        }
+
+        size_t take = std::min(size, needed - frame.size());
+        frame.append(data, take);
+        data += take;
+        size -= take;
+
+        if (frame.size() == needed && needed > 4)
+        {
+            bool ok = dispatchFrame(frame.data() + 4, frame.size() - 4, splitter, out, sharedBuffers, failure);
+            frame = std::string();
+            if (!ok)
+                return false;
+        }
+    }
+    return true;
+}
+
+bool LinkDecoder::dispatchFrame(const char * data, size_t size, XmlSplitter &splitter,
+                                std::list<ScannedXml> &out, std::list<int> &sharedBuffers, std::string &failure)
+{
+    if (size == 0)
+    {
+        failure = "Empty binary frame\n";
+        return false;
+    }
+
+    if (static_cast<unsigned char>(data[0]) == INDI_FRAME_XML)
+        return feedXml(data + 1, size - 1, splitter, out, failure);
+
+    XMLEle * root = decodeFrame(data, size, sharedBuffers);
+    if (root == nullptr)
+    {
+        failure = fmt("Bad binary frame of kind %d\n", static_cast<unsigned char>(data[0]));
+        return false;
+    }
+    out.push_back(ScannedXml{root, std::string()});
+    return true;
+}
+
+XMLEle * LinkDecoder::decodeFrame(const char * data, size_t size, std::list<int> &sharedBuffers)
+{
+    LinkBlobSink blobs;
+    XMLEle * root = INDI::BinaryFrame::decode(data, size, blobs);
+    blobBytes.fetch_add(blobs.bytes, std::memory_order_relaxed);
+    if (root == nullptr)
+        return nullptr;
+
+    sharedBuffers.insert(sharedBuffers.end(), blobs.attached.begin(), blobs.attached.end());
+    blobs.attached.clear();
+    return root;
+}
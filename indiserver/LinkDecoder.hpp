@@ -0,0 +1,107 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+
+#include "XmlSplitter.hpp"
+
+#include <atomic>
+#include <list>
+#include <string>
+#include <zlib.h>
+
+/* Input of a link to a chained server (see RemoteDvrInfo).
+ *
+ * Before anything else, the link asks the upstream server for an encoding
+ * leaner than XML: binary frames (see indibinaryframe.h), whose BLOBs come raw
+ * and are handed over in shared buffers, or deflate (see indicompression.h).
+ * An upstream that agrees answers with the request itself, ahead of any other
+ * message. One that does not know it never answers: the link stays XML.
+ *
+ * Runs in the thread reading the link. Counters are read from the main loop.
+ */
+class LinkDecoder
+{
+    public:
+        enum Encoding { Xml, Frames, Deflate };
+
+        LinkDecoder(Encoding requested);
+        ~LinkDecoder();
+
+        /* The element asking the upstream for encoding, empty for Xml */
+        static const char * request(Encoding encoding);
+
+        static const char * name(Encoding encoding);
+
+        /* return false if name is not one of frames, deflate or xml */
+        static bool parse(const std::string &name, Encoding &encoding);
+
+        /* Decode bytes read from the link. Complete messages are appended to out,
+         * fds of the shared buffers holding their BLOBs to sharedBuffers.
+         * return false on error, with the reason in failure
+         */
+        bool decode(const char * data, size_t size, XmlSplitter &splitter,
+                    std::list<ScannedXml> &out, std::list<int> &sharedBuffers, std::string &failure);
+
+        /* Xml until the upstream acknowledged the request */
+        Encoding encoding() const
+        {
+            return current.load(std::memory_order_relaxed);
+        }
+
+        /* bytes of XML decoded so far */
+        unsigned long getXmlBytes() const
+        {
+            return xmlBytes.load(std::memory_order_relaxed);
+        }
+
+        /* bytes of BLOB content received raw so far */
+        unsigned long getBlobBytes() const
+        {
+            return blobBytes.load(std::memory_order_relaxed);
+        }
+
+    private:
+        static constexpr size_t inflateChunk {65536};
+
+        Encoding requested;
+        std::atomic<Encoding> current {Xml};
+        bool negotiating;
+        std::string ack;            /* start of the acknowledgment received so far */
+
+        z_stream inflater;
+        bool inflaterReady = false;
+
+        std::string frame;          /* incomplete frame, from its length field */
+
+        std::atomic<unsigned long> xmlBytes {0};
+        std::atomic<unsigned long> blobBytes {0};
+
+        bool feedXml(const char * data, size_t size, XmlSplitter &splitter, std::list<ScannedXml> &out, std::string &failure);
+        bool inflateData(const char * data, size_t size, XmlSplitter &splitter, std::list<ScannedXml> &out, std::string &failure);
+        bool frameData(const char * data, size_t size, XmlSplitter &splitter,
+                       std::list<ScannedXml> &out, std::list<int> &sharedBuffers, std::string &failure);
+
+        /* Decode the kind and body of one frame */
+        bool dispatchFrame(const char * data, size_t size, XmlSplitter &splitter,
+                           std::list<ScannedXml> &out, std::list<int> &sharedBuffers, std::string &failure);
+
+        /* The message of a set*Vector frame, nullptr if malformed */
+        XMLEle * decodeFrame(const char * data, size_t size, std::list<int> &sharedBuffers);
+};
@@ -22,6 +22,7 @@
 #include "Msg.hpp"
 #include "Constants.hpp"
 #include "CommandLineArgs.hpp"
+#include "Capture.hpp"
 
 #include "Fifo.hpp"
 #include <sys/socket.h>
@@ -129,6 +130,8 @@ void LocalDvrInfo::start()
         {
             unsetenv("INDISKEL");
         }
+        /* announce that drivers may ask for BLOB demand reports with getBLOBDemand */
+        setenv("INDIBLOBDEMAND", "1", 1);
         std::string executable;
         if (!envPrefix.empty())
         {
@@ -180,6 +183,8 @@ void LocalDvrInfo::start()
 
     ::close(ep[1]);
 
+    Capture::opened(CaptureDriver, this, name);
+
     // Watch pid
     this->pid = pid;
     this->pidwatcher.set(pid);
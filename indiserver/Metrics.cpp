@@ -0,0 +1,526 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "Metrics.hpp"
+#include "ClInfo.hpp"
+#include "DvrInfo.hpp"
+#include "ConversionPool.hpp"
+#include "Allocations.hpp"
+#include "CommandLineArgs.hpp"
+#include "Utils.hpp"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+Metrics * Metrics::instance = nullptr;
+Metrics::Totals Metrics::retired[2];
+
+namespace
+{
+
+/* One exchange on the metrics endpoint: read the request, answer, close */
+class MetricsPeer
+{
+        static constexpr double timeoutDelay {5};
+        static constexpr size_t maxRequestLength {8192};
+
+        int fd;
+        ev::io io;
+        ev::timer timeout;
+        std::string request;
+        std::string response;
+        size_t sent = 0;
+
+        void onTimeout(ev::timer &, int)
+        {
+            delete this;
+        }
+
+        void ioCb(ev::io &, int revents)
+        {
+            if (revents & EV_READ)
+            {
+                char buf[1024];
+                ssize_t nr = read(fd, buf, sizeof(buf));
+                if (nr < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                    return;
+                if (nr <= 0)
+                {
+                    delete this;
+                    return;
+                }
+                request.append(buf, nr);
+                if (request.find("\r\n\r\n") == std::string::npos && request.find("\n\n") == std::string::npos)
+                {
+                    if (request.size() > maxRequestLength)
+                        delete this;
+                    return;
+                }
+                answer();
+                io.stop();
+                io.set(fd, EV_WRITE);
+                io.start();
+            }
+            if (revents & EV_WRITE)
+            {
+                ssize_t nw = write(fd, response.data() + sent, response.size() - sent);
+                if (nw < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                    return;
+                if (nw <= 0 || (sent += nw) == response.size())
+                    delete this;
+            }
+        }
+
+        void answer()
+        {
+            std::string path = request.substr(0, request.find_first_of("\r\n"));
+            if (path.compare(0, 4, "GET ") == 0)
+                path = path.substr(4, path.find(' ', 4) - 4);
+            else
+                path.clear();
+
+            std::string status = "200 OK";
+            std::string body;
+            if (path == "/metrics" || path == "/")
+                body = Metrics::render();
+            else
+            {
+                status = "404 Not Found";
+                body = "Try /metrics\n";
+            }
+
+            response = "HTTP/1.0 " + status + "\r\n";
+            response += "Content-Type: text/plain; version=0.0.4\r\n";
+            response += fmt("Content-Length: %lu\r\n", (unsigned long)body.size());
+            response += "Connection: close\r\n\r\n";
+            response += body;
+        }
+
+    public:
+        MetricsPeer(int fd): fd(fd)
+        {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+            io.set<MetricsPeer, &MetricsPeer::ioCb>(this);
+            io.start(fd, EV_READ);
+            timeout.set<MetricsPeer, &MetricsPeer::onTimeout>(this);
+            timeout.start(timeoutDelay, 0);
+        }
+
+        ~MetricsPeer()
+        {
+            io.stop();
+            timeout.stop();
+            ::close(fd);
+        }
+};
+
+/* escape a label value of the Prometheus text format */
+std::string escapeLabel(const std::string &value)
+{
+    std::string escaped;
+    for (char c : value)
+    {
+        if (c == '\\' || c == '"')
+            escaped += '\\';
+        if (c == '\n')
+        {
+            escaped += "\\n";
+            continue;
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+void family(std::string &out, const char *name, const char *type, const char *help)
+{
+    out += fmt("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+const char * roleName(Metrics::Role role)
+{
+    return role == Metrics::Client ? "client" : "driver";
+}
+
+}
+
+void Metrics::Totals::add(Role role, const MsgQueue * queue)
+{
+    MsgQueue::Traffic traffic = queue->getTraffic();
+
+    connections++;
+    bytesIn += traffic.bytesIn;
+    bytesOut += traffic.bytesOut;
+    msgsIn += traffic.msgsIn;
+    msgsOut += traffic.msgsOut;
+    queuedMsgs += queue->msgQCount();
+    queuedBytes += queue->msgQSize();
+    coalesced += queue->getReplacedCount();
+    if (role == Client)
+        dropped += static_cast<const ClInfo*>(queue)->droppedStreams;
+}
+
+void Metrics::retire(Role role, const MsgQueue * queue)
+{
+    Totals &total = retired[role];
+    unsigned long connections = total.connections;
+    unsigned long queuedMsgs = total.queuedMsgs;
+    unsigned long queuedBytes = total.queuedBytes;
+
+    total.add(role, queue);
+
+    /* only the counters outlive the connection */
+    total.connections = connections;
+    total.queuedMsgs = queuedMsgs;
+    total.queuedBytes = queuedBytes;
+}
+
+Metrics::Totals Metrics::totals(Role role)
+{
+    Totals total = retired[role];
+
+    if (role == Client)
+    {
+        for (auto cpId : ClInfo::clients.ids())
+        {
+            auto cp = ClInfo::clients[cpId];
+            if (cp != nullptr)
+                total.add(role, cp);
+        }
+    }
+    else
+    {
+        for (auto dpId : DvrInfo::drivers.ids())
+        {
+            auto dp = DvrInfo::drivers[dpId];
+            if (dp != nullptr)
+                total.add(role, dp);
+        }
+    }
+    return total;
+}
+
+std::string Metrics::render()
+{
+    struct Connection
+    {
+        Role role;
+        std::string labels;
+        const MsgQueue * queue;
+    };
+
+    std::vector<Connection> connections;
+    for (auto cpId : ClInfo::clients.ids())
+    {
+        auto cp = ClInfo::clients[cpId];
+        if (cp != nullptr)
+            connections.push_back({Client, fmt("role=\"client\",id=\"%lu\"", cpId), cp});
+    }
+    for (auto dpId : DvrInfo::drivers.ids())
+    {
+        auto dp = DvrInfo::drivers[dpId];
+        if (dp != nullptr)
+            connections.push_back({Driver, fmt("role=\"driver\",id=\"%lu\",name=\"%s\"", dpId, escapeLabel(dp->name).c_str()), dp});
+    }
+
+    std::string out;
+
+    family(out, "indiserver_connections", "gauge", "Connected clients and drivers.");
+    for (Role role : {Client, Driver})
+        out += fmt("indiserver_connections{role=\"%s\"} %lu\n", roleName(role), totals(role).connections);
+
+    /* per connection counters, then the totals including the closed connections */
+    struct Counter
+    {
+        const char *name;
+        const char *type;
+        const char *help;
+        unsigned long (*live)(const Connection &);
+        unsigned long Totals::*total;
+    };
+    static const Counter counters[] =
+    {
+        {
+            "indiserver_read_bytes_total", "counter", "Bytes read from the connection.",
+            [](const Connection & c) { return c.queue->getTraffic().bytesIn; }, &Totals::bytesIn
+        },
+        {
+            "indiserver_written_bytes_total", "counter", "Bytes written to the connection.",
+            [](const Connection & c) { return c.queue->getTraffic().bytesOut; }, &Totals::bytesOut
+        },
+        {
+            "indiserver_read_messages_total", "counter", "Messages read from the connection.",
+            [](const Connection & c) { return c.queue->getTraffic().msgsIn; }, &Totals::msgsIn
+        },
+        {
+            "indiserver_written_messages_total", "counter", "Messages completely written to the connection.",
+            [](const Connection & c) { return c.queue->getTraffic().msgsOut; }, &Totals::msgsOut
+        },
+        {
+            "indiserver_queued_messages", "gauge", "Messages waiting to be written.",
+            [](const Connection & c) { return c.queue->msgQCount(); }, &Totals::queuedMsgs
+        },
+        {
+            "indiserver_queued_bytes", "gauge", "Storage of the messages waiting to be written.",
+            [](const Connection & c) { return c.queue->msgQSize(); }, &Totals::queuedBytes
+        },
+        {
+            "indiserver_coalesced_messages_total", "counter", "Queued messages superseded by a newer value.",
+            [](const Connection & c) { return c.queue->getReplacedCount(); }, &Totals::coalesced
+        },
+        {
+            "indiserver_dropped_stream_blobs_total", "counter", "Stream BLOBs skipped because the client was too far behind.",
+            [](const Connection & c) { return c.role == Client ? static_cast<const ClInfo*>(c.queue)->droppedStreams : 0ul; }, &Totals::dropped
+        },
+    };
+
+    Totals roleTotals[2] = { totals(Client), totals(Driver) };
+    for (auto &counter : counters)
+    {
+        family(out, counter.name, counter.type, counter.help);
+        for (auto &c : connections)
+            out += fmt("%s{%s} %lu\n", counter.name, c.labels.c_str(), counter.live(c));
+        for (Role role : {Client, Driver})
+            out += fmt("%s{role=\"%s\",id=\"all\"} %lu\n", counter.name, roleName(role), roleTotals[role].*counter.total);
+    }
+
+    /* links to chained servers: what their encoding saves, against indiserver_read_bytes_total */
+    family(out, "indiserver_link_xml_bytes_total", "counter", "Bytes of XML decoded from a link to a chained server.");
+    for (auto &c : connections)
+    {
+        auto link = c.queue->getLinkDecoder();
+        if (link != nullptr)
+            out += fmt("indiserver_link_xml_bytes_total{%s,encoding=\"%s\"} %lu\n", c.labels.c_str(),
+                       LinkDecoder::name(link->encoding()), link->getXmlBytes());
+    }
+    family(out, "indiserver_link_blob_bytes_total", "counter", "Bytes of BLOB content received raw from a link to a chained server.");
+    for (auto &c : connections)
+    {
+        auto link = c.queue->getLinkDecoder();
+        if (link != nullptr)
+            out += fmt("indiserver_link_blob_bytes_total{%s,encoding=\"%s\"} %lu\n", c.labels.c_str(),
+                       LinkDecoder::name(link->encoding()), link->getBlobBytes());
+    }
+
+    if (Allocations::enabled)
+    {
+        family(out, "indiserver_allocations_total", "counter", "Heap allocations made by operator new and lilxml.");
+        out += fmt("indiserver_allocations_total %lu\n", Allocations::count());
+    }
+
+    family(out, "indiserver_snoop_deliveries_total", "counter", "Messages queued to drivers snooping their property.");
+    out += fmt("indiserver_snoop_deliveries_total %lu\n", DvrInfo::snoopDeliveries);
+
+    ConversionPool::Stats pool = ConversionPool::getStats();
+
+    family(out, "indiserver_blob_conversions_queued", "gauge", "BLOB conversions waiting for a worker thread.");
+    out += fmt("indiserver_blob_conversions_queued %lu\n", pool.queued);
+    family(out, "indiserver_blob_conversions_running", "gauge", "BLOB conversions in progress.");
+    out += fmt("indiserver_blob_conversions_running %lu\n", pool.running);
+    family(out, "indiserver_blob_conversions_canceled_total", "counter", "BLOB conversions withdrawn before they started.");
+    out += fmt("indiserver_blob_conversions_canceled_total %lu\n", pool.canceled);
+
+    family(out, "indiserver_blob_conversion_seconds", "histogram", "Delay from queuing to completion of BLOB conversions.");
+    unsigned long cumulated = 0;
+    for (unsigned i = 0; i < ConversionPool::Stats::latencyBuckets; ++i)
+    {
+        cumulated += pool.latencyHistogram[i];
+        out += fmt("indiserver_blob_conversion_seconds_bucket{le=\"%g\"} %lu\n",
+                   ConversionPool::Stats::latencyBoundsUs[i] / 1e6, cumulated);
+    }
+    out += fmt("indiserver_blob_conversion_seconds_bucket{le=\"+Inf\"} %lu\n", pool.done);
+    out += fmt("indiserver_blob_conversion_seconds_sum %g\n", pool.totalLatencyUs / 1e6);
+    out += fmt("indiserver_blob_conversion_seconds_count %lu\n", pool.done);
+
+    if (instance)
+    {
+        family(out, "indiserver_loop_lag_seconds", "gauge", "Delay of the main event loop at the last sample.");
+        out += fmt("indiserver_loop_lag_seconds %g\n", instance->lastLag);
+        family(out, "indiserver_loop_lag_peak_seconds", "gauge", "Largest delay of the main event loop since startup.");
+        out += fmt("indiserver_loop_lag_peak_seconds %g\n", instance->peakLag);
+    }
+
+    return out;
+}
+
+Metrics::Metrics()
+{
+    lagTimer.set<Metrics, &Metrics::onLagTimer>(this);
+    lagDue = ev_now(EV_DEFAULT) + lagPeriod;
+    lagTimer.start(lagPeriod, 0);
+
+    summaryTimer.set<Metrics, &Metrics::onSummaryTimer>(this);
+    listenIo.set<Metrics, &Metrics::onAccept>(this);
+}
+
+void Metrics::setup(const std::string &endpoint, int summaryPeriod)
+{
+    if (endpoint.empty() && summaryPeriod <= 0)
+        return;
+
+    instance = new Metrics();
+
+    if (!endpoint.empty())
+        instance->listen(endpoint);
+
+    if (summaryPeriod > 0)
+    {
+        instance->lastSummary = ev_now(EV_DEFAULT);
+        instance->lastClients = totals(Client);
+        instance->lastDrivers = totals(Driver);
+        instance->lastSnoopDeliveries = DvrInfo::snoopDeliveries;
+        instance->lastAllocations = Allocations::count();
+        instance->summaryTimer.start(summaryPeriod, summaryPeriod);
+    }
+}
+
+void Metrics::listen(const std::string &endpoint)
+{
+    bool isPort = endpoint.find_first_not_of("0123456789") == std::string::npos;
+
+    if ((sfd = socket(isPort ? AF_INET : AF_UNIX, SOCK_STREAM, 0)) < 0)
+    {
+        log(fmt("metrics socket: %s\n", strerror(errno)));
+        Bye();
+    }
+
+    int rc;
+    if (isPort)
+    {
+        /* metrics are for local tools only */
+        struct sockaddr_in serv_socket;
+        memset(&serv_socket, 0, sizeof(serv_socket));
+        serv_socket.sin_family = AF_INET;
+        serv_socket.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        serv_socket.sin_port = htons((unsigned short)atoi(endpoint.c_str()));
+
+        int reuse = 1;
+        setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        rc = bind(sfd, (struct sockaddr *)&serv_socket, sizeof(serv_socket));
+    }
+    else
+    {
+        struct sockaddr_un serv_socket;
+        memset(&serv_socket, 0, sizeof(serv_socket));
+        serv_socket.sun_family = AF_UNIX;
+        strncpy(serv_socket.sun_path, endpoint.c_str(), sizeof(serv_socket.sun_path) - 1);
+
+        /* a socket left by a previous run is replaced, never anything else */
+        struct stat st;
+        if (lstat(endpoint.c_str(), &st) == 0)
+        {
+            if (!S_ISSOCK(st.st_mode))
+            {
+                log(fmt("metrics %s: exists and is not a socket\n", endpoint.c_str()));
+                Bye();
+            }
+            unlink(endpoint.c_str());
+        }
+        rc = bind(sfd, (struct sockaddr *)&serv_socket, sizeof(serv_socket));
+    }
+    if (rc < 0)
+    {
+        log(fmt("metrics bind %s: %s\n", endpoint.c_str(), strerror(errno)));
+        Bye();
+    }
+
+    if (::listen(sfd, 5) < 0)
+    {
+        log(fmt("metrics listen: %s\n", strerror(errno)));
+        Bye();
+    }
+
+    fcntl(sfd, F_SETFL, fcntl(sfd, F_GETFL, 0) | O_NONBLOCK);
+    fcntl(sfd, F_SETFD, FD_CLOEXEC);
+    listenIo.start(sfd, EV_READ);
+
+    if (userConfigurableArguments->verbosity > 0)
+        log(fmt("metrics available at %s\n", endpoint.c_str()));
+}
+
+void Metrics::onAccept(ev::io &, int)
+{
+    int fd = ::accept(sfd, 0, 0);
+    if (fd < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            log(fmt("metrics accept: %s\n", strerror(errno)));
+        return;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    // Deletes itself once done
+    new MetricsPeer(fd);
+}
+
+void Metrics::onLagTimer(ev::timer &, int)
+{
+    /* the loop was busy since the timer was due */
+    lastLag = std::max(0.0, ev_time() - lagDue);
+    maxLag = std::max(maxLag, lastLag);
+    peakLag = std::max(peakLag, lastLag);
+
+    lagDue = ev_now(EV_DEFAULT) + lagPeriod;
+    lagTimer.start(lagPeriod, 0);
+}
+
+void Metrics::onSummaryTimer(ev::timer &, int)
+{
+    ev::tstamp now = ev_now(EV_DEFAULT);
+    double elapsed = std::max(now - lastSummary, 1e-3);
+
+    Totals clients = totals(Client);
+    Totals drivers = totals(Driver);
+    ConversionPool::Stats pool = ConversionPool::getStats();
+
+    unsigned long msgsIn = clients.msgsIn + drivers.msgsIn - lastClients.msgsIn - lastDrivers.msgsIn;
+    unsigned long msgsOut = clients.msgsOut + drivers.msgsOut - lastClients.msgsOut - lastDrivers.msgsOut;
+    unsigned long bytesIn = clients.bytesIn + drivers.bytesIn - lastClients.bytesIn - lastDrivers.bytesIn;
+    unsigned long bytesOut = clients.bytesOut + drivers.bytesOut - lastClients.bytesOut - lastDrivers.bytesOut;
+    unsigned long snoops = DvrInfo::snoopDeliveries - lastSnoopDeliveries;
+    unsigned long allocations = Allocations::count() - lastAllocations;
+    unsigned long conversions = pool.done - lastConversions;
+    double conversionMs = conversions ? (pool.totalLatencyUs - lastConversionLatencyUs) / 1e3 / conversions : 0;
+
+    std::string allocationsPerMsg;
+    if (Allocations::enabled)
+        allocationsPerMsg = fmt("%.1f allocations/msg, ", msgsIn ? (double)allocations / msgsIn : 0.0);
+
+    log(fmt("metrics: %lu clients, %lu drivers, in %.0f msg/s %.0f kB/s, out %.0f msg/s %.0f kB/s, "
+            "queued %lu msg %lu kB, dropped %lu, coalesced %lu, snooped %.0f msg/s, %lu conversions avg %.1f ms, "
+            "%sloop lag max %.1f ms\n",
+            clients.connections, drivers.connections,
+            msgsIn / elapsed, bytesIn / elapsed / 1024, msgsOut / elapsed, bytesOut / elapsed / 1024,
+            clients.queuedMsgs + drivers.queuedMsgs, (clients.queuedBytes + drivers.queuedBytes) / 1024,
+            clients.dropped - lastClients.dropped, clients.coalesced - lastClients.coalesced, snoops / elapsed,
+            conversions, conversionMs, allocationsPerMsg.c_str(), maxLag * 1e3));
+
+    lastSummary = now;
+    lastClients = clients;
+    lastDrivers = drivers;
+    lastSnoopDeliveries = DvrInfo::snoopDeliveries;
+    lastAllocations = Allocations::count();
+    lastConversions = pool.done;
+    lastConversionLatencyUs = pool.totalLatencyUs;
+    maxLag = 0;
+}
@@ -0,0 +1,98 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <ev++.h>
+#include <cstdint>
+#include <string>
+
+class MsgQueue;
+
+/* Activity of the server: traffic and queues of each connection, BLOB
+ * conversions and lag of the main event loop.
+ *
+ * Counters are always maintained by the connections themselves; this class
+ * only gathers them. They can be published in Prometheus text format on a
+ * local endpoint (a loopback TCP port or a unix socket path), and summarized
+ * in the log at a fixed period.
+ */
+class Metrics
+{
+    public:
+        enum Role { Client, Driver };
+
+        /* Publish on endpoint if not empty, log a summary every summaryPeriod seconds if > 0 */
+        static void setup(const std::string &endpoint, int summaryPeriod);
+
+        /* Keep the counters of a connection being deleted in the totals */
+        static void retire(Role role, const MsgQueue * queue);
+
+        /* Current metrics in Prometheus text exposition format */
+        static std::string render();
+
+    private:
+        struct Totals
+        {
+            unsigned long connections = 0;
+            unsigned long bytesIn = 0;
+            unsigned long bytesOut = 0;
+            unsigned long msgsIn = 0;
+            unsigned long msgsOut = 0;
+            unsigned long queuedMsgs = 0;
+            unsigned long queuedBytes = 0;
+            unsigned long dropped = 0;      /* stream BLOBs skipped for late clients */
+            unsigned long coalesced = 0;    /* queued messages superseded by newer ones */
+
+            void add(Role role, const MsgQueue * queue);
+        };
+
+        /* Counters of the connections already gone */
+        static Totals retired[2];
+
+        /* retired + live connections of role */
+        static Totals totals(Role role);
+
+        static constexpr double lagPeriod {0.1};
+
+        ev::timer lagTimer;
+        ev::tstamp lagDue = 0;
+        double lastLag = 0;
+        double maxLag = 0;                  /* since the last summary */
+        double peakLag = 0;                 /* since startup */
+
+        ev::timer summaryTimer;
+        ev::tstamp lastSummary = 0;
+        Totals lastClients, lastDrivers;
+        unsigned long lastSnoopDeliveries = 0;
+        unsigned long lastAllocations = 0;
+        unsigned long lastConversions = 0;
+        uint64_t lastConversionLatencyUs = 0;
+
+        int sfd = -1;
+        ev::io listenIo;
+
+        Metrics();
+        void listen(const std::string &endpoint);
+        void onLagTimer(ev::timer &watcher, int revents);
+        void onSummaryTimer(ev::timer &watcher, int revents);
+        void onAccept(ev::io &watcher, int revents);
+
+        /* Never deleted: lives until exit */
+        static Metrics * instance;
+};
@@ -22,6 +22,8 @@
 #include "SerializedMsg.hpp"
 #include "SerializedMsgWithSharedBuffer.hpp"
 #include "SerializedMsgWithoutSharedBuffer.hpp"
+#include "SerializedMsgBinary.hpp"
+#include "SerializedMsgWebSocket.hpp"
 #include "Utils.hpp"
 
 #include <string>
@@ -37,6 +39,14 @@ Msg::Msg(MsgQueue * from, XMLEle * ele): sharedBuffers()
 
     convertionToSharedBuffer = nullptr;
     convertionToInline = nullptr;
+    convertionToBinary = nullptr;
+    convertionToWebSocket = nullptr;
+
+    if (xmlContent == nullptr)
+    {
+        queueSize = 0;
+        return;
+    }
 
     queueSize = sprlXMLEle(xmlContent, 0);
     for(auto blobContent : findBlobElements(xmlContent))
@@ -58,6 +68,8 @@ Msg::~Msg()
     // Assume convertionToSharedBlob and convertionToInlineBlob were already dropped
     assert(convertionToSharedBuffer == nullptr);
     assert(convertionToInline == nullptr);
+    assert(convertionToBinary == nullptr);
+    assert(convertionToWebSocket == nullptr);
 
     releaseXmlContent();
     releaseSharedBuffers(std::set<int>());
@@ -75,6 +87,16 @@ void Msg::releaseSerialization(SerializedMsg * msg)
         convertionToInline = nullptr;
     }
 
+    if (msg == convertionToBinary)
+    {
+        convertionToBinary = nullptr;
+    }
+
+    if (msg == convertionToWebSocket)
+    {
+        convertionToWebSocket = nullptr;
+    }
+
     delete(msg);
     prune();
 }
@@ -116,6 +138,14 @@ void Msg::prune()
     {
         convertionToInline->collectRequirements(req);
     }
+    if (convertionToBinary)
+    {
+        convertionToBinary->collectRequirements(req);
+    }
+    if (convertionToWebSocket)
+    {
+        convertionToWebSocket->collectRequirements(req);
+    }
     // Free the resources.
     if (!req.xml)
     {
@@ -125,7 +155,8 @@ void Msg::prune()
     releaseSharedBuffers(req.sharedBuffers);
 
     // Nobody cares anymore ?
-    if (convertionToSharedBuffer == nullptr && convertionToInline == nullptr)
+    if (convertionToSharedBuffer == nullptr && convertionToInline == nullptr && convertionToBinary == nullptr
+            && convertionToWebSocket == nullptr)
     {
         delete(this);
     }
@@ -175,6 +206,12 @@ void Msg::queuingDone()
 Msg * Msg::fromXml(MsgQueue * from, XMLEle * root, std::list<int> &incomingSharedBuffers)
 {
     Msg * m = new Msg(from, root);
+    m->rawContent = from->takeDispatchedRaw();
+    m->captureId = from->takeDispatchedCaptureId();
+    if (!m->rawContent.empty())
+    {
+        m->queueSize = m->rawContent.size();
+    }
     if (!m->fetchBlobs(incomingSharedBuffers))
     {
         delete(m);
@@ -183,6 +220,26 @@ Msg * Msg::fromXml(MsgQueue * from, XMLEle * root, std::list<int> &incomingShare
     return m;
 }
 
+Msg * Msg::fromRaw(MsgQueue * from, const std::string &xml)
+{
+    Msg * m = new Msg(from, nullptr);
+    m->rawContent = xml;
+    m->queueSize = xml.size();
+    return m;
+}
+
+std::string Msg::xmlText() const
+{
+    if (!rawContent.empty() || xmlContent == nullptr)
+    {
+        return rawContent;
+    }
+
+    std::string text(sprlXMLEle(xmlContent, 0) + 1, '\0');
+    text.resize(sprXMLEle(&text[0], xmlContent, 0));
+    return text;
+}
+
 SerializedMsg * Msg::buildConvertionToSharedBuffer()
 {
     if (convertionToSharedBuffer)
@@ -208,8 +265,38 @@ SerializedMsg * Msg::buildConvertionToInline()
     return convertionToInline = new SerializedMsgWithoutSharedBuffer(this);
 }
 
+SerializedMsg * Msg::buildConvertionToBinary()
+{
+    if (convertionToBinary)
+    {
+        return convertionToBinary;
+    }
+
+    return convertionToBinary = new SerializedMsgBinary(this);
+}
+
+SerializedMsg * Msg::buildConvertionToWebSocket()
+{
+    if (convertionToWebSocket)
+    {
+        return convertionToWebSocket;
+    }
+
+    return convertionToWebSocket = new SerializedMsgWebSocket(this);
+}
+
 SerializedMsg * Msg::serialize(MsgQueue * to)
 {
+    if (to->acceptWebSocketFrames())
+    {
+        return buildConvertionToWebSocket();
+    }
+
+    if (to->acceptBinaryFrames())
+    {
+        return buildConvertionToBinary();
+    }
+
     if (hasSharedBufferBlobs || hasInlineBlobs)
     {
         if (to->acceptSharedBuffers())
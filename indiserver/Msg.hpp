@@ -18,29 +18,44 @@
 */
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include <list>
 #include <set>
+#include <string>
 
 #include "lilxml.h"
+#include "BlockPool.hpp"
 
 class MsgQueue;
 class SerializedMsg;
 class SerializedMsgWithSharedBuffer;
 class SerializedMsgWithoutSharedBuffer;
+class SerializedMsgBinary;
+class SerializedMsgWebSocket;
+class Capture;
 
-class Msg
+class Msg: public PoolAllocated
 {
         friend class SerializedMsg;
         friend class SerializedMsgWithSharedBuffer;
         friend class SerializedMsgWithoutSharedBuffer;
+        friend class SerializedMsgBinary;
+        friend class SerializedMsgWebSocket;
+        friend class Capture;
     private:
         // Present for sure until message queueing is doned. Prune asap then
         XMLEle * xmlContent;
 
+        // Original bytes of a scanned message, sent as is. xmlContent then only has the root attributes
+        std::string rawContent;
+
         // Present until message was queued.
         MsgQueue * from;
 
+        // Id of the message in the traffic capture, 0 until recorded
+        uint32_t captureId = 0;
+
         int queueSize;
         bool hasInlineBlobs;
         bool hasSharedBufferBlobs;
@@ -50,9 +65,13 @@ class Msg
         // Convertion task and resultat of the task
         SerializedMsg* convertionToSharedBuffer;
         SerializedMsg* convertionToInline;
+        SerializedMsg* convertionToBinary;
+        SerializedMsg* convertionToWebSocket;
 
         SerializedMsg * buildConvertionToSharedBuffer();
         SerializedMsg * buildConvertionToInline();
+        SerializedMsg * buildConvertionToBinary();
+        SerializedMsg * buildConvertionToWebSocket();
 
         bool fetchBlobs(std::list<int> &incomingSharedBuffers);
 
@@ -75,6 +94,12 @@ class Msg
 
         static Msg * fromXml(MsgQueue * from, XMLEle * root, std::list<int> &incomingSharedBuffers);
 
+        /* Message that sends xml as is. xml must not contain BLOBs */
+        static Msg * fromRaw(MsgQueue * from, const std::string &xml);
+
+        /* return the xml text of the message, as sent to queues that don't share buffers */
+        std::string xmlText() const;
+
         /**
          * Handle multiple cases:
          *
@@ -91,6 +116,9 @@ class Msg
          *  - attached => inline
          * Frequent. The convertion will be made during write. The convert/write must be offshored to a dedicated thread.
          *
+         *  - any => binary frames
+         * For clients that asked for binary framing. BLOBs are sent raw.
+         *
          * The returned AsyncTask will be ready once "to" can write the message
          */
         SerializedMsg * serialize(MsgQueue * from);
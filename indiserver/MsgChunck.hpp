@@ -23,6 +23,8 @@
 class SerializedMsg;
 class SerializedMsgWithSharedBuffer;
 class SerializedMsgWithoutSharedBuffer;
+class SerializedMsgBinary;
+class SerializedMsgWebSocket;
 class MsgChunckIterator;
 
 /**
@@ -35,6 +37,8 @@ class MsgChunck
         friend class SerializedMsg;
         friend class SerializedMsgWithSharedBuffer;
         friend class SerializedMsgWithoutSharedBuffer;
+        friend class SerializedMsgBinary;
+        friend class SerializedMsgWebSocket;
         friend class MsgChunckIterator;
 
         MsgChunck();
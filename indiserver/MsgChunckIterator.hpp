@@ -43,4 +43,10 @@ class MsgChunckIterator
         {
             return endReached;
         }
+
+        // Nothing of the message was passed
+        bool atStart() const
+        {
+            return chunckId == 0 && chunckOffset == 0;
+        }
 };
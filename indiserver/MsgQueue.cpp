@@ -21,9 +21,13 @@
 #include "Constants.hpp"
 #include "SerializedMsg.hpp"
 #include "Msg.hpp"
+#include "ReadShard.hpp"
 #include "CommandLineArgs.hpp"
+#include "Capture.hpp"
 
+#include <algorithm>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #include <unistd.h>
 
@@ -32,10 +36,33 @@ using namespace indiserver::constants;
 void MsgQueue::writeToFd()
 {
     ssize_t nw;
-    void * data;
-    ssize_t nsend;
+    WriteBatch localBatch;
     std::vector<int> sharedBuffers;
 
+    /* compressed bytes go out before anything else */
+    if (compressor && compressor->hasPending())
+    {
+        writeCompressed();
+        return;
+    }
+
+    /* WebSocket handshake response and control frames go between messages */
+    if (webSocket && webSocket->hasPending() && nsent.atStart())
+    {
+        writeWebSocketControl();
+        return;
+    }
+
+    /* with io_uring, the batch must live until the write completes */
+    bool uring = uringWrites();
+    if (uring && uringWrite.isPending())
+        return;
+    WriteBatch &batch = uring ? *uringOutput : localBatch;
+    struct iovec * iov = batch.iov;
+    batch.iovCount = 0;
+    batch.nsend = 0;
+    batch.fixedBuffer = -1;
+
     /* get current message */
     auto mp = headMsg();
     if (mp == nullptr)
@@ -44,91 +71,280 @@ void MsgQueue::writeToFd()
         return;
     }
 
-
-    do
+    /* gather ready chunks from the head message, then from the following ones.
+     * Attached buffers must come with the first byte of a sendmsg, so stop before
+     * any chunk that brings some, unless it is the first. Same for chunks in
+     * registered io_uring buffers, which go alone.
+     * consumeSent maps the iovs back to messages in order, so every message of the
+     * batch must bring at least one: stop at one that has nothing to send.
+     */
+    auto msgIt = msgq.begin();
+    MsgChunckIterator pos = nsent;
+    bool msgGathered = false;
+    while (batch.iovCount < maxWriteIovCount && batch.nsend < writeBudget)
     {
-        if (!mp->getContent(nsent, data, nsend, sharedBuffers))
+        void * data;
+        ssize_t chunckSize;
+        std::vector<int> chunckSharedBuffers;
+
+        if (!(*msgIt)->requestContent(pos) || !(*msgIt)->getContent(pos, data, chunckSize, chunckSharedBuffers))
         {
-            wio.stop();
-            return;
+            if (batch.iovCount == 0)
+            {
+                wio.stop();
+                return;
+            }
+            break;
         }
 
-        if (nsend == 0)
+        if (chunckSize == 0)
         {
-            consumeHeadMsg();
-            mp = headMsg();
-            if (mp == nullptr)
+            if (batch.iovCount == 0)
             {
-                return;
+                /* head message was completely sent */
+                consumeHeadMsg();
+                mp = headMsg();
+                if (mp == nullptr)
+                {
+                    return;
+                }
+                msgIt = msgq.begin();
+                pos = nsent;
+                continue;
             }
+
+            /* empty message: it is consumed once at the head */
+            if (!msgGathered)
+                break;
+
+            /* what follows is compressed: don't send it along */
+            if (*msgIt == compressionStart)
+                break;
+
+            if (++msgIt == msgq.end())
+                break;
+            pos.reset();
+            msgGathered = false;
+            continue;
+        }
+
+        if (!chunckSharedBuffers.empty())
+        {
+            if (batch.iovCount > 0)
+                break;
+            sharedBuffers = chunckSharedBuffers;
+        }
+
+        /* never more than writeBudget per call, to reduce blocking */
+        if ((size_t)chunckSize > writeBudget - batch.nsend)
+            chunckSize = writeBudget - batch.nsend;
+
+        int fixedBuffer = uring ? Uring::instance()->findBuffer(data, chunckSize) : -1;
+        if (fixedBuffer != -1 && batch.iovCount > 0)
+            break;
+
+        /* the kernel reads the messages of the batch until completion: keep them */
+        if (uring)
+            forgetReplaceable(*msgIt);
+
+        iov[batch.iovCount].iov_base = data;
+        iov[batch.iovCount].iov_len = chunckSize;
+        batch.iovCount++;
+        batch.nsend += chunckSize;
+        msgGathered = true;
+
+        (*msgIt)->advance(pos, chunckSize);
+
+        if (fixedBuffer != -1)
+        {
+            batch.fixedBuffer = fixedBuffer;
+            break;
         }
     }
-    while(nsend == 0);
 
-    /* send next chunk, never more than maxWriteBufferLength to reduce blocking */
-    if (nsend > static_cast<ssize_t>(maxWriteBufferLength))
-        nsend = static_cast<ssize_t>(maxWriteBufferLength);
+    if (compressor)
+    {
+        if (!compressor->compress(iov, batch.iovCount))
+        {
+            log("compression failed\n");
+            closeWritePart();
+            return;
+        }
+
+        /* all gathered bytes are in the compressor now */
+        consumeSent(iov, batch.iovCount, batch.nsend);
+        writeCompressed();
+        return;
+    }
+
+    if (useSharedBuffer && !prepareSendmsg(batch, sharedBuffers))
+    {
+        log(fmt("attempt to send too many FD\n"));
+        close();
+        return;
+    }
+
+    if (uring)
+    {
+        /* submitted with the other writes of this loop iteration */
+        auto ring = Uring::instance();
+        if (batch.fixedBuffer != -1)
+            ring->queueWriteFixed(uringWrite, wFd, iov[0].iov_base, iov[0].iov_len, batch.fixedBuffer);
+        else if (!useSharedBuffer)
+            ring->queueWritev(uringWrite, wFd, iov, batch.iovCount);
+        else
+            ring->queueSendmsg(uringWrite, wFd, &batch.msgh, MSG_NOSIGNAL);
+        wio.stop();
+        return;
+    }
 
     if (!useSharedBuffer)
     {
-        nw = write(wFd, data, nsend);
+        nw = writev(wFd, iov, batch.iovCount);
     }
     else
     {
-        struct msghdr msgh;
-        struct iovec iov[1];
-        int cmsghdrlength;
-        struct cmsghdr * cmsgh;
+        nw = sendmsg(wFd, &batch.msgh,  MSG_NOSIGNAL);
+    }
 
-        size_t fdCount = sharedBuffers.size();
-        if (fdCount > 0)
+    /* shut down if trouble */
+    if (nw <= 0)
+    {
+        if (nw == 0)
+            log("write returned 0\n");
+        else
+            log(fmt("write: %s\n", strerror(errno)));
+
+        // Keep the read part open
+        closeWritePart();
+        return;
+    }
+
+    wrote(batch, nw);
+}
+
+bool MsgQueue::prepareSendmsg(WriteBatch &batch, const std::vector<int> &sharedBuffers)
+{
+    struct msghdr &msgh = batch.msgh;
+    memset(&msgh, 0, sizeof(msgh));
+
+    size_t fdCount = sharedBuffers.size();
+    if (fdCount > 0)
+    {
+        if (fdCount > maxFDPerMessage)
         {
-            if (fdCount > maxFDPerMessage)
-            {
-                log(fmt("attempt to send too many FD\n"));
-                close();
-                return;
-            }
+            return false;
+        }
 
-            cmsghdrlength = CMSG_SPACE((fdCount * sizeof(int)));
-            // FIXME: abort on alloc error here
-            cmsgh = (struct cmsghdr*)malloc(cmsghdrlength);
-            memset(cmsgh, 0, cmsghdrlength);
-
-            /* Write the fd as ancillary data */
-            cmsgh->cmsg_len = CMSG_LEN(fdCount * sizeof(int));
-            cmsgh->cmsg_level = SOL_SOCKET;
-            cmsgh->cmsg_type = SCM_RIGHTS;
-            msgh.msg_control = cmsgh;
-            msgh.msg_controllen = cmsghdrlength;
-            for(size_t i = 0; i < fdCount; ++i)
-            {
-                ((int *) CMSG_DATA(CMSG_FIRSTHDR(&msgh)))[i] = sharedBuffers[i];
-            }
+        int cmsghdrlength = CMSG_SPACE((fdCount * sizeof(int)));
+        memset(batch.control_un.control, 0, cmsghdrlength);
+        msgh.msg_control = batch.control_un.control;
+        msgh.msg_controllen = cmsghdrlength;
+
+        /* Write the fd as ancillary data */
+        struct cmsghdr * cmsgh = CMSG_FIRSTHDR(&msgh);
+        cmsgh->cmsg_len = CMSG_LEN(fdCount * sizeof(int));
+        cmsgh->cmsg_level = SOL_SOCKET;
+        cmsgh->cmsg_type = SCM_RIGHTS;
+        for(size_t i = 0; i < fdCount; ++i)
+        {
+            ((int *) CMSG_DATA(cmsgh))[i] = sharedBuffers[i];
         }
-        else
+    }
+
+    msgh.msg_iov = batch.iov;
+    msgh.msg_iovlen = batch.iovCount;
+    return true;
+}
+
+void MsgQueue::wrote(WriteBatch &batch, size_t nw)
+{
+    bytesOut += nw;
+
+    /* trace */
+    if (userConfigurableArguments->verbosity > 1 && !binaryFrames && !webSocket)
+    {
+        size_t left = nw;
+        for (size_t i = 0; i < batch.iovCount && left > 0; ++i)
         {
-            cmsgh = NULL;
-            cmsghdrlength = 0;
-            msgh.msg_control = cmsgh;
-            msgh.msg_controllen = cmsghdrlength;
+            int len = left < batch.iov[i].iov_len ? left : batch.iov[i].iov_len;
+            if (userConfigurableArguments->verbosity > 2)
+                log(fmt("sending msg nq %ld:\n%.*s\n", msgq.size(), len, (char*)batch.iov[i].iov_base));
+            else
+                log(fmt("sending %.*s\n", len, (char*)batch.iov[i].iov_base));
+            left -= len;
         }
+    }
 
-        iov[0].iov_base = data;
-        iov[0].iov_len = nsend;
+    /* adapt the budget: grow while the peer takes everything, else fall back to what it accepted */
+    if (nw == batch.nsend)
+    {
+        if (batch.nsend >= writeBudget && writeBudget < maxWriteBudget)
+            writeBudget = std::min<size_t>(2 * writeBudget, maxWriteBudget);
+    }
+    else
+    {
+        writeBudget = std::max<size_t>(nw, maxWriteBufferLength);
+    }
 
-        msgh.msg_flags = 0;
-        msgh.msg_name = NULL;
-        msgh.msg_namelen = 0;
-        msgh.msg_iov = iov;
-        msgh.msg_iovlen = 1;
+    consumeSent(batch.iov, batch.iovCount, nw);
+}
 
-        nw = sendmsg(wFd, &msgh,  MSG_NOSIGNAL);
+void MsgQueue::uringWriteDone(int result)
+{
+    /* not ready after all (some kernels): wait for the fd like libev does */
+    if (result == -EAGAIN)
+    {
+        wio.start();
+        return;
+    }
 
-        free(cmsgh);
+    if (result <= 0)
+    {
+        if (result == 0)
+            log("write returned 0\n");
+        else
+            log(fmt("write: %s\n", strerror(-result)));
+
+        // Keep the read part open
+        closeWritePart();
+        return;
     }
 
-    /* shut down if trouble */
+    wrote(*uringOutput, result);
+    updateIos();
+}
+
+void MsgQueue::consumeSent(const struct iovec * iov, size_t iovCount, size_t nw)
+{
+    auto mp = headMsg();
+
+    /* update amount sent. when complete: free message if we are the last
+     * to use it and pop from our queue.
+     */
+    for (size_t i = 0; i < iovCount && nw > 0; ++i)
+    {
+        size_t len = nw < iov[i].iov_len ? nw : iov[i].iov_len;
+        mp->advance(nsent, len);
+        nw -= len;
+        if (nsent.done())
+        {
+            msgsOut++;
+            consumeHeadMsg();
+            mp = headMsg();
+        }
+    }
+
+    if (mp != nullptr)
+    {
+        mp->sent(this, nsent);
+    }
+}
+
+void MsgQueue::writeCompressed()
+{
+    size_t size = std::min(compressor->pendingSize(), writeBudget);
+    ssize_t nw = write(wFd, compressor->pendingData(), size);
     if (nw <= 0)
     {
         if (nw == 0)
@@ -141,23 +357,78 @@ void MsgQueue::writeToFd()
         return;
     }
 
-    /* trace */
-    if (userConfigurableArguments->verbosity > 2)
+    bytesOut += nw;
+    compressor->consume(nw);
+
+    if ((size_t)nw == size)
     {
-        log(fmt("sending msg nq %ld:\n%.*s\n",
-                msgq.size(), (int)nw, data));
+        if (size >= writeBudget && writeBudget < maxWriteBudget)
+            writeBudget = std::min<size_t>(2 * writeBudget, maxWriteBudget);
     }
-    else if (userConfigurableArguments->verbosity > 1)
+    else
     {
-        log(fmt("sending %.*s\n", (int)nw, data));
+        writeBudget = std::max<size_t>(nw, maxWriteBufferLength);
     }
 
-    /* update amount sent. when complete: free message if we are the last
-     * to use it and pop from our queue.
-     */
-    mp->advance(nsent, nw);
-    if (nsent.done())
-        consumeHeadMsg();
+    updateIos();
+}
+
+void MsgQueue::writeWebSocketControl()
+{
+    ssize_t nw = write(wFd, webSocket->pendingData(), webSocket->pendingSize());
+    if (nw <= 0)
+    {
+        if (nw == 0)
+            log("write returned 0\n");
+        else
+            log(fmt("write: %s\n", strerror(errno)));
+
+        // Keep the read part open
+        closeWritePart();
+        return;
+    }
+
+    bytesOut += nw;
+    webSocket->consume(nw);
+
+    if (!webSocket->hasPending() && webSocket->isClosing())
+    {
+        if (userConfigurableArguments->verbosity > 0)
+            log("WebSocket closed\n");
+        close();
+        return;
+    }
+
+    updateIos();
+}
+
+bool MsgQueue::acceptsEncodingChange() const
+{
+    // The peer takes the first bytes after its request as the acknowledgement:
+    // nothing else may have been queued or written before
+    return wFd != -1 && msgq.empty() && bytesOut == 0 && !useSharedBuffer && !compressor && !compressionStart && !binaryFrames && !webSocket;
+}
+
+void MsgQueue::compressAfter(Msg * mp)
+{
+    pushMsg(mp);
+    compressionStart = msgq.back();
+}
+
+void MsgQueue::frameAfter(Msg * mp)
+{
+    pushMsg(mp);
+    binaryFrames = true;
+}
+
+void MsgQueue::enableWebSocket()
+{
+    webSocket.reset(new WebSocket(userConfigurableArguments->webSocketOrigins));
+}
+
+void MsgQueue::expectLinkEncoding(LinkDecoder::Encoding encoding)
+{
+    linkDecoder.reset(new LinkDecoder(encoding));
 }
 
 void MsgQueue::log(const std::string &str) const
@@ -219,23 +490,38 @@ void MsgQueue::traceMsg(const std::string &logMsg, XMLEle *root)
 
 MsgQueue::MsgQueue(bool useSharedBuffer): useSharedBuffer(useSharedBuffer)
 {
-    lp = newLilXML();
     rio.set<MsgQueue, &MsgQueue::ioCb>(this);
     wio.set<MsgQueue, &MsgQueue::ioCb>(this);
     rFd = -1;
     wFd = -1;
+
+    if (Uring::instance())
+    {
+        useUring = true;
+        uringRead.set<MsgQueue, &MsgQueue::uringReadDone>(this);
+        uringWrite.set<MsgQueue, &MsgQueue::uringWriteDone>(this);
+        uringFlush.set<MsgQueue, &MsgQueue::writeToFd>(this);
+        uringInput.reset(new ReadBatch());
+        uringOutput.reset(new WriteBatch());
+    }
 }
 
 MsgQueue::~MsgQueue()
 {
-    rio.stop();
+    setFds(-1, -1);
     wio.stop();
+    cancelUring();
 
-    clearMsgQueue();
-    delLilXML(lp);
-    lp = nullptr;
+    if (shard)
+    {
+        ReadShard::forget(this);
+        for (auto &scanned : shardRoots)
+            delXMLEle(scanned.root);
+        for (auto fd : shardSharedBuffers)
+            ::close(fd);
+    }
 
-    setFds(-1, -1);
+    clearMsgQueue();
 
     /* unreference messages queue for this client */
     auto msgqcp = msgq;
@@ -283,9 +569,19 @@ void MsgQueue::closeWritePart()
 
 void MsgQueue::setFds(int rFd, int wFd)
 {
+    /* the kernel may still use the fds and buffers */
+    cancelUring();
+
     if (this->rFd != -1)
     {
-        rio.stop();
+        if (shard)
+        {
+            // The shard may be reading right now
+            ReadShard::Lock lock(shard);
+            rio.stop();
+        }
+        else
+            rio.stop();
         wio.stop();
         ::close(this->rFd);
         if (this->rFd != this->wFd)
@@ -311,8 +607,21 @@ void MsgQueue::setFds(int rFd, int wFd)
             fcntl(wFd, F_SETFL, fcntl(wFd, F_GETFL, 0) | O_NONBLOCK);
         }
 
-        rio.set(rFd, ev::READ);
         wio.set(wFd, ev::WRITE);
+
+        // WebSocket control frames are answered from the main loop
+        if (shard == nullptr && !webSocket)
+            shard = ReadShard::assign();
+        if (shard)
+        {
+            ReadShard::Lock lock(shard);
+            rio.set(shard->evLoop());
+            rio.set<MsgQueue, &MsgQueue::shardReadCb>(this);
+            rio.set(rFd, ev::READ);
+            rio.start();
+        }
+        else
+            rio.set(rFd, ev::READ);
         updateIos();
     }
 }
@@ -327,6 +636,15 @@ void MsgQueue::consumeHeadMsg()
 {
     auto msg = headMsg();
     msgq.pop_front();
+    msgqBytes -= queuedSize(msg);
+    forgetReplaceable(msg);
+
+    /* the peer expects compressed bytes from now on */
+    if (msg == compressionStart)
+    {
+        compressionStart = nullptr;
+        compressor.reset(new StreamCompressor());
+    }
     msg->release(this);
     nsent.reset();
 
@@ -341,31 +659,103 @@ void MsgQueue::pushMsg(Msg * mp)
         return;
     }
 
+    Capture::queued(this, mp);
+
     auto serialized = mp->serialize(this);
 
     msgq.push_back(serialized);
+    msgqBytes += queuedSize(serialized);
     serialized->addAwaiter(this);
 
     // Register for client write
     updateIos();
 }
 
+void MsgQueue::pushMsg(Msg * mp, const std::string &replaceKey)
+{
+    // Don't write messages to client that have been disconnected
+    if (wFd == -1)
+    {
+        return;
+    }
+
+    auto previous = replaceable.find(replaceKey);
+    if (previous != replaceable.end())
+    {
+        auto oldIt = previous->second;
+        auto old = *oldIt;
+        forgetReplaceable(old);
+        // The head may be partially sent already: keep it
+        if (oldIt != msgq.begin())
+        {
+            msgq.erase(oldIt);
+            msgqBytes -= queuedSize(old);
+            old->release(this);
+            replacedCount++;
+        }
+    }
+
+    Capture::queued(this, mp);
+
+    auto serialized = mp->serialize(this);
+
+    msgq.push_back(serialized);
+    msgqBytes += queuedSize(serialized);
+    serialized->addAwaiter(this);
+
+    replaceable[replaceKey] = std::prev(msgq.end());
+    replaceableKeys[serialized] = replaceKey;
+
+    // Register for client write
+    updateIos();
+}
+
+void MsgQueue::forgetReplaceable(const SerializedMsg * msg)
+{
+    auto it = replaceableKeys.find(msg);
+    if (it == replaceableKeys.end())
+        return;
+    replaceable.erase(it->second);
+    replaceableKeys.erase(it);
+}
+
 void MsgQueue::updateIos()
 {
     if (wFd != -1)
     {
-        if (msgq.empty() || !msgq.front()->requestContent(nsent))
+        if (compressor && compressor->hasPending())
+        {
+            wio.start();
+        }
+        else if (webSocket && webSocket->hasPending())
+        {
+            wio.start();
+        }
+        else if (webSocket && !webSocket->isOpen())
+        {
+            // Nothing goes out before the handshake
+            wio.stop();
+        }
+        else if (msgq.empty() || !msgq.front()->requestContent(nsent))
         {
             wio.stop();
         }
+        else if (uringWrites())
+        {
+            wio.stop();
+            Uring::instance()->schedule(uringFlush);
+        }
         else
         {
             wio.start();
         }
     }
-    if (rFd != -1)
+    if (rFd != -1 && shard == nullptr)
     {
-        rio.start();
+        if (useUring)
+            queueUringRead();
+        else
+            rio.start();
     }
 }
 
@@ -379,6 +769,9 @@ void MsgQueue::messageMayHaveProgressed(const SerializedMsg * msg)
 
 void MsgQueue::clearMsgQueue()
 {
+    /* the write in flight points into the messages */
+    cancelUringWrite();
+
     nsent.reset();
 
     auto queueCopy = msgq;
@@ -387,23 +780,24 @@ void MsgQueue::clearMsgQueue()
         mp->release(this);
     }
     msgq.clear();
+    msgqBytes = 0;
+    replaceable.clear();
+    replaceableKeys.clear();
+    compressionStart = nullptr;
 
     // Cancel io write events
     updateIos();
     wio.stop();
 }
 
-unsigned long MsgQueue::msgQSize() const
+unsigned long MsgQueue::queuedSize(SerializedMsg * msg)
 {
-    unsigned long l = 0;
-
-    for (auto mp : msgq)
-    {
-        l += sizeof(Msg);
-        l += mp->queueSize();
-    }
+    return sizeof(Msg) + msg->queueSize();
+}
 
-    return (l);
+unsigned long MsgQueue::msgQSize() const
+{
+    return msgqBytes;
 }
 
 void MsgQueue::ioCb(ev::io &, int revents)
@@ -425,18 +819,31 @@ void MsgQueue::ioCb(ev::io &, int revents)
     }
 
     if (revents & EV_READ)
-        readFromFd();
+    {
+        if (useUring)
+        {
+            /* io_uring read that was not ready: read directly, then queue the next one */
+            rio.stop();
+            auto hb = heartBeat();
+            readFromFd();
+            if (!hb.alive())
+                return;
+            updateIos();
+        }
+        else
+            readFromFd();
+    }
 
     if (revents & EV_WRITE)
         writeToFd();
 }
 
-size_t MsgQueue::doRead(char * buf, size_t nr)
+ssize_t MsgQueue::doRead(char * buf, size_t nr, std::list<int> &sharedBuffers)
 {
     if (!useSharedBuffer)
     {
         /* read client - works for all kinds of fds incl pipe*/
-        return read(rFd, buf, sizeof(buf));
+        return read(rFd, buf, nr);
     }
     else
     {
@@ -474,71 +881,101 @@ size_t MsgQueue::doRead(char * buf, size_t nr)
             return -1;
         }
 
-        for (struct cmsghdr * cmsg = CMSG_FIRSTHDR(&msgh); cmsg != NULL; cmsg = CMSG_NXTHDR(&msgh, cmsg))
+        takeSharedBuffers(msgh, sharedBuffers);
+        return size;
+    }
+}
+
+void MsgQueue::takeSharedBuffers(struct msghdr &msgh, std::list<int> &sharedBuffers)
+{
+    for (struct cmsghdr * cmsg = CMSG_FIRSTHDR(&msgh); cmsg != NULL; cmsg = CMSG_NXTHDR(&msgh, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
         {
-            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+            int fdCount = 0;
+            while(cmsg->cmsg_len >= CMSG_LEN((fdCount + 1) * sizeof(int)))
             {
-                int fdCount = 0;
-                while(cmsg->cmsg_len >= CMSG_LEN((fdCount + 1) * sizeof(int)))
-                {
-                    fdCount++;
-                }
-                //log(fmt("Received %d fds\n", fdCount));
-                int * fds = (int*)CMSG_DATA(cmsg);
-                for(int i = 0; i < fdCount; ++i)
-                {
-#ifndef __linux__
-                    fcntl(fds[i], F_SETFD, FD_CLOEXEC);
-#endif
-                    incomingSharedBuffers.push_back(fds[i]);
-                }
+                fdCount++;
             }
-            else
+            //log(fmt("Received %d fds\n", fdCount));
+            int * fds = (int*)CMSG_DATA(cmsg);
+            for(int i = 0; i < fdCount; ++i)
             {
-                log(fmt("Ignoring ancillary data level %d, type %d\n", cmsg->cmsg_level, cmsg->cmsg_type));
+#ifndef __linux__
+                fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+#endif
+                sharedBuffers.push_back(fds[i]);
             }
         }
-        return size;
+        else
+        {
+            log(fmt("Ignoring ancillary data level %d, type %d\n", cmsg->cmsg_level, cmsg->cmsg_type));
+        }
     }
 }
 
-void MsgQueue::readFromFd()
+bool MsgQueue::parseFromFd(std::list<ScannedXml> &roots, std::list<int> &sharedBuffers, std::string &failure)
 {
     char buf[maxReadBufferLength];
     ssize_t nr;
 
     /* read client */
-    nr = doRead(buf, sizeof(buf));
+    nr = doRead(buf, sizeof(buf), sharedBuffers);
     if (nr <= 0)
     {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+        if (nr < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
 
         if (nr < 0)
-            log(fmt("read: %s\n", strerror(errno)));
+            failure = fmt("read: %s\n", strerror(errno));
         else if (userConfigurableArguments->verbosity > 0)
-            log(fmt("read EOF\n"));
-        close();
-        return;
+            failure = fmt("read EOF\n");
+        return false;
+    }
+
+    return parseInput(buf, nr, roots, sharedBuffers, failure);
+}
+
+bool MsgQueue::parseInput(const char * buf, size_t nr, std::list<ScannedXml> &roots, std::list<int> &sharedBuffers,
+                          std::string &failure)
+{
+    bytesIn.fetch_add(nr, std::memory_order_relaxed);
+
+    /* upstream servers may send frames or compressed bytes */
+    if (linkDecoder)
+        return linkDecoder->decode(buf, nr, splitter, roots, sharedBuffers, failure);
+
+    const char * xml = buf;
+    size_t xmlSize = nr;
+
+    /* WebSocket clients send the XML in text frames */
+    std::string text;
+    if (webSocket)
+    {
+        if (!webSocket->receive(buf, nr, text, failure))
+            return false;
+        xml = text.data();
+        xmlSize = text.size();
     }
 
     /* process XML chunk */
-    char err[1024];
-    XMLEle **nodes = parseXMLChunk(lp, buf, nr, err);
-    if (!nodes)
+    std::string err;
+    if (xmlSize > 0 && !splitter.feed(xml, xmlSize, roots, err))
     {
-        log(fmt("XML error: %s\n", err));
-        log(fmt("XML read: %.*s\n", (int)nr, buf));
-        close();
-        return;
+        failure = fmt("XML error: %s\n", err.c_str());
+        failure += fmt("XML read: %.*s\n", (int)xmlSize, xml);
+        return false;
     }
 
-    int inode = 0;
+    return true;
+}
 
-    XMLEle *root = nodes[inode];
+void MsgQueue::dispatchMessages(std::list<ScannedXml> &roots)
+{
     // Stop processing message in case of deletion...
     auto hb = heartBeat();
-    while (root)
+    for (auto &scanned : roots)
     {
+        auto root = scanned.root;
         if (hb.alive())
         {
             if (userConfigurableArguments->verbosity > 2)
@@ -549,16 +986,211 @@ void MsgQueue::readFromFd()
                         tagXMLEle(root), findXMLAttValu(root, "device"), findXMLAttValu(root, "name")));
             }
 
+            msgsIn++;
+            dispatchedCaptureId = Capture::received(this, root, scanned.raw, incomingSharedBuffers);
+            dispatchedRaw.swap(scanned.raw);
             onMessage(root, incomingSharedBuffers);
+            if (hb.alive())
+            {
+                dispatchedRaw.clear();
+                dispatchedCaptureId = 0;
+            }
         }
         else
         {
             // Otherwise, client got killed. Just release pending messages
             delXMLEle(root);
         }
-        inode++;
-        root = nodes[inode];
     }
+    roots.clear();
+}
+
+MsgQueue::Traffic MsgQueue::getTraffic() const
+{
+    Traffic traffic;
+    traffic.bytesIn = bytesIn.load(std::memory_order_relaxed);
+    traffic.bytesOut = bytesOut;
+    traffic.msgsIn = msgsIn;
+    traffic.msgsOut = msgsOut;
+    return traffic;
+}
+
+std::string MsgQueue::takeDispatchedRaw()
+{
+    std::string raw;
+    raw.swap(dispatchedRaw);
+    return raw;
+}
+
+uint32_t MsgQueue::takeDispatchedCaptureId()
+{
+    uint32_t id = dispatchedCaptureId;
+    dispatchedCaptureId = 0;
+    return id;
+}
+
+void MsgQueue::readFromFd()
+{
+    std::list<ScannedXml> roots;
+    std::string failure;
+
+    bool ok = parseFromFd(roots, incomingSharedBuffers, failure);
+    dispatchInput(ok, roots, failure);
+}
+
+void MsgQueue::queueUringRead()
+{
+    if (uringRead.isPending())
+        return;
+
+    auto ring = Uring::instance();
+    if (!useSharedBuffer)
+    {
+        ring->queueRead(uringRead, rFd, uringInput->buffer, sizeof(uringInput->buffer));
+        return;
+    }
+
+    // Use recvmsg for ancillary data
+    struct msghdr &msgh = uringInput->msgh;
+    uringInput->iov.iov_base = uringInput->buffer;
+    uringInput->iov.iov_len = sizeof(uringInput->buffer);
+
+    memset(&msgh, 0, sizeof(msgh));
+    msgh.msg_iov = &uringInput->iov;
+    msgh.msg_iovlen = 1;
+    msgh.msg_control = uringInput->control_un.control;
+    msgh.msg_controllen = sizeof(uringInput->control_un.control);
+
+    ring->queueRecvmsg(uringRead, rFd, &msgh, MSG_CMSG_CLOEXEC);
+}
+
+void MsgQueue::uringReadDone(int result)
+{
+    /* not ready after all (some kernels): wait for the fd like libev does */
+    if (result == -EAGAIN)
+    {
+        rio.start();
+        return;
+    }
+
+    std::list<ScannedXml> roots;
+    std::string failure;
+    bool ok;
+
+    if (result <= 0)
+    {
+        ok = false;
+        if (result < 0)
+            failure = fmt("read: %s\n", strerror(-result));
+        else if (userConfigurableArguments->verbosity > 0)
+            failure = fmt("read EOF\n");
+    }
+    else
+    {
+        if (useSharedBuffer)
+            takeSharedBuffers(uringInput->msgh, incomingSharedBuffers);
+        ok = parseInput(uringInput->buffer, result, roots, incomingSharedBuffers, failure);
+    }
+
+    auto hb = heartBeat();
+    dispatchInput(ok, roots, failure);
+
+    /* read on */
+    if (hb.alive())
+        updateIos();
+}
+
+void MsgQueue::cancelUringWrite()
+{
+    if (!useUring)
+        return;
+
+    auto ring = Uring::instance();
+    ring->unschedule(uringFlush);
+    ring->cancel(uringWrite);
+}
+
+void MsgQueue::cancelUring()
+{
+    if (!useUring)
+        return;
+
+    cancelUringWrite();
+    Uring::instance()->cancel(uringRead);
+}
+
+void MsgQueue::dispatchInput(bool ok, std::list<ScannedXml> &roots, const std::string &failure)
+{
+    if (!ok)
+    {
+        if (!failure.empty())
+            log(failure);
+        close();
+        return;
+    }
+
+    auto hb = heartBeat();
+    dispatchMessages(roots);
+
+    /* WebSocket handshake response or control frames to write */
+    if (hb.alive() && webSocket && webSocket->hasPending())
+        updateIos();
+}
 
-    free(nodes);
+void MsgQueue::shardReadCb(ev::io &, int revents)
+{
+    // Runs in the shard thread, with the shard lock held
+    bool ok;
+    if (revents & EV_ERROR)
+    {
+        shardFailure = "Communication error\n";
+        ok = false;
+    }
+    else
+    {
+        ok = parseFromFd(shardRoots, shardSharedBuffers, shardFailure);
+    }
+
+    if (!ok)
+        shardClosed = true;
+
+    if (shardClosed || !shardRoots.empty())
+    {
+        // Pause reading until the main loop handled this input
+        rio.stop();
+        ReadShard::notifyReady(this);
+    }
+}
+
+void MsgQueue::dispatchShardInput()
+{
+    std::list<ScannedXml> roots;
+    std::string failure;
+    bool closed;
+    {
+        ReadShard::Lock lock(shard);
+        roots.swap(shardRoots);
+        incomingSharedBuffers.splice(incomingSharedBuffers.end(), shardSharedBuffers);
+        failure.swap(shardFailure);
+        closed = shardClosed;
+    }
+
+    auto hb = heartBeat();
+    dispatchMessages(roots);
+    if (!hb.alive())
+        return;
+
+    if (closed)
+    {
+        if (!failure.empty())
+            log(failure);
+        close();
+        return;
+    }
+
+    if (rFd != -1)
+    {
+        ReadShard::Lock lock(shard);
+        rio.start();
+    }
 }
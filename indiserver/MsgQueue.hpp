@@ -21,23 +21,45 @@
 #include "lilxml.h"
 #include "Collectable.hpp"
 #include "MsgChunckIterator.hpp"
+#include "XmlSplitter.hpp"
+#include "StreamCompressor.hpp"
+#include "WebSocket.hpp"
+#include "LinkDecoder.hpp"
+#include "BlockPool.hpp"
+#include "Uring.hpp"
 #include "indicore/indidevapi.h"
 
 #include <ev++.h>
+#include <atomic>
+#include <climits>
+#include <cstdint>
 #include <list>
+#include <memory>
 #include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/uio.h>
 
 class SerializedMsg;
 class Msg;
+class ReadShard;
 
 class MsgQueue: public Collectable
 {
+        friend class ReadShard;
+
         static constexpr unsigned maxFDPerMessage {16}; /* No more than 16 buffer attached to a message */
         static constexpr unsigned maxReadBufferLength {49152};
         static constexpr unsigned maxWriteBufferLength {49152};
+        static constexpr unsigned maxWriteBudget {1048576};
+        /* Messages gathered by one writev/sendmsg: enough to batch small updates,
+         * and never more than the system accepts */
+        static constexpr unsigned maxWriteIovCount {64 < IOV_MAX ? 64 : IOV_MAX};
 
         int rFd, wFd;
-        LilXML * lp;         /* XML parsing context */
+        XmlSplitter splitter; /* XML parsing context */
         ev::io   rio, wio;   /* Event loop io events */
         void ioCb(ev::io &watcher, int revents);
 
@@ -46,22 +68,164 @@ class MsgQueue: public Collectable
 
         std::set<SerializedMsg*> readBlocker;     /* The message that block this queue */
 
-        std::list<SerializedMsg*> msgq;           /* To send msg queue */
+        using MsgList = std::list<SerializedMsg*, PoolAllocator<SerializedMsg*>>;
+        MsgList msgq;                             /* To send msg queue */
+        unsigned long msgqBytes = 0;              /* storage size of msgq, see msgQSize */
         std::list<int> incomingSharedBuffers; /* During reception, fds accumulate here */
 
         // Position in the head message
         MsgChunckIterator nsent;
 
+        /* Queued messages that a newer one may replace, by key, as long as they
+         * are not at the head of the queue (where sending may have begun)
+         */
+        std::unordered_map<std::string, MsgList::iterator> replaceable;
+        std::unordered_map<const SerializedMsg*, std::string> replaceableKeys;
+        unsigned long replacedCount = 0;
+
+        /* the message left the queue: it can no longer be replaced */
+        void forgetReplaceable(const SerializedMsg * msg);
+
+        /* storage accounted in msgqBytes for one queued message */
+        static unsigned long queuedSize(SerializedMsg * msg);
+
+        /* Traffic counters. bytesIn is updated by the reading loop, which may be a shard */
+        std::atomic<unsigned long> bytesIn {0};
+        unsigned long bytesOut = 0;
+        unsigned long msgsIn = 0;
+        unsigned long msgsOut = 0;
+
+        /* Deflates what is written, once the peer asked for it */
+        std::unique_ptr<StreamCompressor> compressor;
+        /* Last message sent uncompressed, when compression was accepted */
+        SerializedMsg * compressionStart = nullptr;
+
+        /* write as much of the compressor output as the peer accepts */
+        void writeCompressed();
+
+        /* Messages queued from now on are serialized as binary frames */
+        bool binaryFrames = false;
+
+        /* Protocol state of a WebSocket client, nullptr for plain sockets */
+        std::unique_ptr<WebSocket> webSocket;
+
+        /* write the WebSocket handshake response and control frames */
+        void writeWebSocketControl();
+
+        /* Decoding of what an upstream server sends, nullptr for other peers */
+        std::unique_ptr<LinkDecoder> linkDecoder;
+
+        // Bytes to send per write. Grows while the peer keeps up
+        size_t writeBudget {maxWriteBufferLength};
+
+        ReadShard * shard = nullptr;              /* Loop reading this queue. nullptr for the main loop */
+
+        /* Input parsed in the shard, waiting for dispatch. Guarded by the shard lock */
+        std::list<ScannedXml> shardRoots;
+        std::list<int> shardSharedBuffers;
+        std::string shardFailure;
+        bool shardClosed = false;
+
+        void shardReadCb(ev::io &watcher, int revents);
+
+        /* Dispatch the input parsed by the shard, then resume reading. Main loop only */
+        void dispatchShardInput();
+
         // Handle fifo or socket case
-        size_t doRead(char * buff, size_t len);
+        ssize_t doRead(char * buff, size_t len, std::list<int> &sharedBuffers);
+
+        /* read & parse what's available. Append complete messages to roots.
+         * return false on EOF or error, with the reason to log in failure
+         */
+        bool parseFromFd(std::list<ScannedXml> &roots, std::list<int> &sharedBuffers, std::string &failure);
+
+        /* pass parsed messages to onMessage, as long as this queue lives */
+        void dispatchMessages(std::list<ScannedXml> &roots);
+
+        /* Original bytes of the message in onMessage, when it was only scanned */
+        std::string dispatchedRaw;
+
+        /* Capture id of the message in onMessage, 0 if not captured */
+        uint32_t dispatchedCaptureId = 0;
+
         void readFromFd();
 
-        /* write the next chunk of the current message in the queue to the given
-         * client. pop message from queue when complete and free the message if we are
-         * the last one to use it. shut down this client if trouble.
+        /* write the next chunks of the messages in the queue to the given
+         * client, in a single system call. pop messages from queue when complete
+         * and free them if we are the last one to use them. shut down this client
+         * if trouble.
          */
         void writeToFd();
 
+        /* advance in the queue over nw written bytes of iov, pop the completed messages */
+        void consumeSent(const struct iovec * iov, size_t iovCount, size_t nw);
+
+        /* Chunks gathered for one write */
+        struct WriteBatch
+        {
+            struct iovec iov[maxWriteIovCount];
+            size_t iovCount = 0;
+            size_t nsend = 0;
+            int fixedBuffer = -1;     /* io_uring buffer holding the single chunk, or -1 */
+            struct msghdr msgh;
+            union
+            {
+                struct cmsghdr cmsgh;
+                char control[CMSG_SPACE(maxFDPerMessage * sizeof(int))];
+            } control_un;
+        };
+
+        /* prepare batch.msgh to pass sharedBuffers along with the chunks. false if too many */
+        bool prepareSendmsg(WriteBatch &batch, const std::vector<int> &sharedBuffers);
+
+        /* account for nw bytes of batch written */
+        void wrote(WriteBatch &batch, size_t nw);
+
+        /* Reads and writes through io_uring (see Uring): reads of the main loop
+         * connections, and writes of those without compression or WebSocket.
+         * One read and one write in flight at most.
+         */
+        bool useUring = false;
+        Uring::Request uringRead, uringWrite;
+        Uring::Task uringFlush;                   /* gather and queue the next write */
+
+        struct ReadBatch
+        {
+            char buffer[maxReadBufferLength];
+            struct iovec iov;
+            struct msghdr msgh;
+            union
+            {
+                struct cmsghdr cmsgh;
+                char control[CMSG_SPACE(maxFDPerMessage * sizeof(int))];
+            } control_un;
+        };
+        std::unique_ptr<ReadBatch> uringInput;
+        std::unique_ptr<WriteBatch> uringOutput;
+
+        bool uringWrites() const
+        {
+            return useUring && !compressor && !webSocket;
+        }
+
+        void queueUringRead();
+        void uringReadDone(int result);
+        void uringWriteDone(int result);
+
+        /* forget the operations in flight, before their buffers or fds go */
+        void cancelUringWrite();
+        void cancelUring();
+
+        /* collect the fds passed along with the data received in msgh */
+        void takeSharedBuffers(struct msghdr &msgh, std::list<int> &sharedBuffers);
+
+        /* parse nr bytes read. Same result as parseFromFd */
+        bool parseInput(const char * buf, size_t nr, std::list<ScannedXml> &roots, std::list<int> &sharedBuffers,
+                        std::string &failure);
+
+        /* dispatch what a read produced, or close on failure */
+        void dispatchInput(bool ok, std::list<ScannedXml> &roots, const std::string &failure);
+
     protected:
         bool useSharedBuffer;
         int getRFd() const
@@ -82,7 +246,10 @@ class MsgQueue: public Collectable
         /* Close the writing part of the connection. By default, shutdown the write part, but keep on reading. May delete this */
         virtual void closeWritePart();
 
-        /* Handle a message. root will be freed by caller. fds of buffers will be closed, unless set to -1 */
+        /* Handle a message. root will be freed by caller. fds of buffers will be closed, unless set to -1.
+         * root may hold only the tag and attributes of a scanned message: Msg::fromXml then
+         * picks its original bytes (see XmlSplitter)
+         */
         virtual void onMessage(XMLEle *root, std::list<int> &sharedBuffers) = 0;
 
         /* convert the string value of enableBLOB to our B_ state value.
@@ -90,15 +257,60 @@ class MsgQueue: public Collectable
          */
         static void crackBLOB(const char *enableBLOB, BLOBHandling *bp);
 
+        /* true while the peer got nothing yet and can switch to another encoding */
+        bool acceptsEncodingChange() const;
+
+        /* queue mp, then compress everything written after it */
+        void compressAfter(Msg * mp);
+
+        /* queue mp, then send every following message as binary frames */
+        void frameAfter(Msg * mp);
+
         MsgQueue(bool useSharedBuffer);
     public:
         virtual ~MsgQueue();
 
         void pushMsg(Msg * msg);
 
-        /* return storage size of all Msqs on the given q */
+        /* Take the original bytes of the message being handled, if it was only scanned.
+         * return an empty string otherwise
+         */
+        std::string takeDispatchedRaw();
+
+        /* Take the capture id of the message being handled, 0 if none */
+        uint32_t takeDispatchedCaptureId();
+
+        /* same, but a message queued under the same key that was not yet started
+         * is dropped in favour of this one, which goes to the end of the queue
+         */
+        void pushMsg(Msg * msg, const std::string &replaceKey);
+
+        /* number of queued messages dropped in favour of a newer one */
+        unsigned long getReplacedCount() const
+        {
+            return replacedCount;
+        }
+
+        /* return storage size of all Msqs on the given q. O(1), maintained on push & pop */
         unsigned long msgQSize() const;
 
+        /* number of messages on the queue */
+        unsigned long msgQCount() const
+        {
+            return msgq.size();
+        }
+
+        struct Traffic
+        {
+            unsigned long bytesIn = 0;
+            unsigned long bytesOut = 0;
+            unsigned long msgsIn = 0;
+            unsigned long msgsOut = 0;
+        };
+
+        /* bytes and messages read and written so far */
+        Traffic getTraffic() const;
+
         SerializedMsg * headMsg() const;
         void consumeHeadMsg();
 
@@ -114,5 +326,27 @@ class MsgQueue: public Collectable
             return useSharedBuffer;
         }
 
+        bool acceptBinaryFrames() const
+        {
+            return binaryFrames;
+        }
+
+        /* The peer is a WebSocket client. To be called before setFds */
+        void enableWebSocket();
+
+        bool acceptWebSocketFrames() const
+        {
+            return webSocket != nullptr;
+        }
+
+        /* The peer is an upstream server, asked for encoding. To be called before setFds */
+        void expectLinkEncoding(LinkDecoder::Encoding encoding);
+
+        /* Decoder of the input of a link to an upstream server, nullptr for other peers */
+        const LinkDecoder * getLinkDecoder() const
+        {
+            return linkDecoder.get();
+        }
+
         virtual void log(const std::string &log) const;
 };
\ No newline at end of file
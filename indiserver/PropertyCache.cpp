@@ -0,0 +1,203 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "PropertyCache.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+PropertyCache::Entry::~Entry()
+{
+    delXMLEle(def);
+}
+
+PropertyCache::Entry * PropertyCache::find(const std::string &dev, const std::string &name)
+{
+    auto devIt = byName.find(dev);
+    if (devIt == byName.end())
+        return nullptr;
+
+    auto &props = devIt->second->byName;
+    auto propIt = props.find(name);
+    if (propIt == props.end())
+        return nullptr;
+
+    return &*propIt->second;
+}
+
+/* set attribute name of ep to value, adding it if missing */
+static void setAttribute(XMLEle * ep, const char * name, const char * value)
+{
+    XMLAtt *ap = findXMLAtt(ep, name);
+    if (ap)
+        editXMLAtt(ap, value);
+    else
+        addXMLAtt(ep, name, value);
+}
+
+void PropertyCache::merge(XMLEle * def, XMLEle * set)
+{
+    for (XMLAtom atom : { XMLATOM_state, XMLATOM_timeout })
+    {
+        XMLAtt *ap = findXMLAttAtom(set, atom);
+        if (ap)
+            setAttribute(def, atomNameXML(atom), valuXMLAtt(ap));
+    }
+
+    for (XMLEle *one = nextXMLEle(set, 1); one; one = nextXMLEle(set, 0))
+    {
+        const char *elementName = findXMLAttValuAtom(one, XMLATOM_name);
+        XMLEle *element = nextXMLEle(def, 1);
+        while (element && strcmp(findXMLAttValuAtom(element, XMLATOM_name), elementName))
+            element = nextXMLEle(def, 0);
+        if (!element)
+            continue;
+
+        editXMLEle(element, pcdataXMLEle(one));
+
+        // numbers may come with new bounds
+        for (XMLAtt *ap = nextXMLAtt(one, 1); ap; ap = nextXMLAtt(one, 0))
+        {
+            if (nameAtomXMLAtt(ap) != XMLATOM_name)
+                setAttribute(element, nameXMLAtt(ap), valuXMLAtt(ap));
+        }
+    }
+}
+
+void PropertyCache::update(XMLAtom tag, const std::string &dev, const std::string &name, XMLEle * root)
+{
+    if (dev.empty())
+        return;
+
+    if (XMLATOM_IS_DEF(tag))
+    {
+        if (name.empty())
+            return;
+
+        XMLEle * def = cloneXMLEle(root, nullptr, nullptr);
+        rmXMLAtt(def, "message");
+        rmXMLAtt(def, "timestamp");
+
+        auto devIt = byName.find(dev);
+        if (devIt == byName.end())
+        {
+            devices.push_back(Device());
+            devices.back().name = dev;
+            devIt = byName.insert(std::make_pair(dev, std::prev(devices.end()))).first;
+        }
+
+        Device &device = *devIt->second;
+        auto propIt = device.byName.find(name);
+        if (propIt == device.byName.end())
+        {
+            device.props.emplace_back();
+            device.props.back().name = name;
+            propIt = device.byName.insert(std::make_pair(name, std::prev(device.props.end()))).first;
+        }
+
+        Entry &entry = *propIt->second;
+        delXMLEle(entry.def);
+        entry.def = def;
+        entry.xml.clear();
+        return;
+    }
+
+    if (XMLATOM_IS_SET(tag))
+    {
+        // BLOBs are too large to keep, and their value is of no use after delivery
+        if (tag == XMLATOM_setBLOBVector)
+            return;
+
+        Entry * entry = find(dev, name);
+        if (!entry)
+            return;
+
+        merge(entry->def, root);
+        entry->xml.clear();
+        return;
+    }
+
+    if (tag == XMLATOM_delProperty)
+    {
+        if (name.empty())
+        {
+            erase(dev);
+            return;
+        }
+
+        auto devIt = byName.find(dev);
+        if (devIt == byName.end())
+            return;
+
+        Device &device = *devIt->second;
+        auto propIt = device.byName.find(name);
+        if (propIt == device.byName.end())
+            return;
+
+        device.props.erase(propIt->second);
+        device.byName.erase(propIt);
+    }
+}
+
+bool PropertyCache::knows(const std::string &dev, const std::string &name) const
+{
+    auto devIt = byName.find(dev);
+    if (devIt == byName.end())
+        return false;
+    return name.empty() || devIt->second->byName.count(name) != 0;
+}
+
+void PropertyCache::erase(const std::string &dev)
+{
+    auto devIt = byName.find(dev);
+    if (devIt == byName.end())
+        return;
+
+    devices.erase(devIt->second);
+    byName.erase(devIt);
+}
+
+void PropertyCache::collect(const std::string &dev, const std::string &name, std::vector<const std::string*> &msgs)
+{
+    if (!dev.empty())
+    {
+        auto devIt = byName.find(dev);
+        if (devIt != byName.end())
+            collect(*devIt->second, name, msgs);
+        return;
+    }
+
+    for (auto &device : devices)
+        collect(device, name, msgs);
+}
+
+void PropertyCache::collect(Device &device, const std::string &name, std::vector<const std::string*> &msgs)
+{
+    for (auto &entry : device.props)
+    {
+        if (!name.empty() && entry.name != name)
+            continue;
+
+        if (entry.xml.empty())
+        {
+            entry.xml.assign(sprlXMLEle(entry.def, 0) + 1, '\0');
+            entry.xml.resize(sprXMLEle(&entry.xml[0], entry.def, 0));
+        }
+        msgs.push_back(&entry.xml);
+    }
+}
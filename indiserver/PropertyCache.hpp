@@ -0,0 +1,80 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "lilxml.h"
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Latest definition and value of the properties defined by drivers, so that
+ * getProperties from clients can be answered at once.
+ * Properties and devices are kept in definition order, as clients display them
+ * that way. set messages are merged into the cached definition: a partial set
+ * only updates the elements it carries. Messages and timestamps are not kept,
+ * as they only made sense when sent. BLOB values are not kept.
+ */
+class PropertyCache
+{
+        struct Entry
+        {
+            std::string name;
+            XMLEle * def = nullptr;     /* last defXXXVector, with the values of later sets */
+            std::string xml;            /* def as text, empty when def changed since */
+
+            Entry() = default;
+            Entry(const Entry &) = delete;
+            ~Entry();
+        };
+
+        struct Device
+        {
+            std::string name;
+            std::list<Entry> props;
+            std::unordered_map<std::string, std::list<Entry>::iterator> byName;
+        };
+
+        std::list<Device> devices;
+        std::unordered_map<std::string, std::list<Device>::iterator> byName;
+
+        Entry * find(const std::string &dev, const std::string &name);
+
+        /* copy the state and element values of set to def */
+        static void merge(XMLEle * def, XMLEle * set);
+
+        static void collect(Device &device, const std::string &name, std::vector<const std::string*> &msgs);
+
+    public:
+        /* Update from a message sent by a driver, given its tag atom. root must be complete:
+         * with -k, XmlSplitter parses def and set vectors entirely */
+        void update(XMLAtom tag, const std::string &dev, const std::string &name, XMLEle * root);
+
+        /* Whether dev/name was defined, or dev if name is empty */
+        bool knows(const std::string &dev, const std::string &name) const;
+
+        /* Forget everything about dev (driver is gone) */
+        void erase(const std::string &dev);
+
+        /* append to msgs the xml texts describing dev/name. Empty dev or name match all.
+         * The texts stay valid until the next update.
+         */
+        void collect(const std::string &dev, const std::string &name, std::vector<const std::string*> &msgs);
+};
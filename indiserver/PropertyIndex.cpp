@@ -0,0 +1,113 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "PropertyIndex.hpp"
+#include "Property.hpp"
+
+void PropertyIndex::add(unsigned long id, Property *pp)
+{
+    index[pp->dev][pp->name][id] = pp;
+}
+
+void PropertyIndex::remove(unsigned long id, const Property *pp)
+{
+    auto devIt = index.find(pp->dev);
+    if (devIt == index.end())
+        return;
+
+    auto nameIt = devIt->second.find(pp->name);
+    if (nameIt == devIt->second.end())
+        return;
+
+    auto subIt = nameIt->second.find(id);
+    if (subIt == nameIt->second.end() || subIt->second != pp)
+        return;
+
+    nameIt->second.erase(subIt);
+
+    /* don't let dead keys accumulate */
+    if (nameIt->second.empty())
+    {
+        devIt->second.erase(nameIt);
+        if (devIt->second.empty())
+            index.erase(devIt);
+    }
+}
+
+void PropertyIndex::addWildcard(unsigned long id)
+{
+    wildcards.insert(id);
+}
+
+void PropertyIndex::removeWildcard(unsigned long id)
+{
+    wildcards.erase(id);
+}
+
+const PropertyIndex::Subscribers *PropertyIndex::subscribers(const std::string &dev, const std::string &name) const
+{
+    auto devIt = index.find(dev);
+    if (devIt == index.end())
+        return nullptr;
+
+    auto nameIt = devIt->second.find(name);
+    if (nameIt == devIt->second.end())
+        return nullptr;
+
+    return &nameIt->second;
+}
+
+Property *PropertyIndex::findExact(unsigned long id, const std::string &dev, const std::string &name) const
+{
+    auto subs = subscribers(dev, name);
+    if (subs == nullptr)
+        return nullptr;
+
+    auto subIt = subs->find(id);
+    return subIt == subs->end() ? nullptr : subIt->second;
+}
+
+Property *PropertyIndex::find(unsigned long id, const std::string &dev, const std::string &name) const
+{
+    Property *pp = findExact(id, dev, name);
+    if (pp == nullptr && !name.empty())
+        pp = findExact(id, dev, "");
+    return pp;
+}
+
+void PropertyIndex::collect(const std::string &dev, const std::string &name, std::set<unsigned long> &ids) const
+{
+    ids.insert(wildcards.begin(), wildcards.end());
+
+    auto devIt = index.find(dev);
+    if (devIt == index.end())
+        return;
+
+    auto nameIt = devIt->second.find(name);
+    if (nameIt != devIt->second.end())
+        for (auto &sub : nameIt->second)
+            ids.insert(sub.first);
+
+    if (!name.empty())
+    {
+        nameIt = devIt->second.find("");
+        if (nameIt != devIt->second.end())
+            for (auto &sub : nameIt->second)
+                ids.insert(sub.first);
+    }
+}
@@ -0,0 +1,61 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+class Property;
+
+/* Hashed index of the Property subscriptions of a ConcurrentSet population
+ * (clients or drivers), keyed by device then property name.
+ * Subscribers are referenced by their ConcurrentSet id, so that routing can
+ * detect peers that went away while a message is being fanned out.
+ * An empty property name subscribes to every property of the device.
+ */
+class PropertyIndex
+{
+    public:
+        /* Subscriber id -> its Property for one device/name key */
+        using Subscribers = std::map<unsigned long, Property*>;
+
+        void add(unsigned long id, Property *pp);
+        void remove(unsigned long id, const Property *pp);
+
+        /* peers that want every device and property */
+        void addWildcard(unsigned long id);
+        void removeWildcard(unsigned long id);
+
+        /* return the Property of id registered for exactly dev/name, else nullptr */
+        Property *findExact(unsigned long id, const std::string &dev, const std::string &name) const;
+
+        /* return the Property of id matching dev/name, either exactly or device wide, else nullptr */
+        Property *find(unsigned long id, const std::string &dev, const std::string &name) const;
+
+        /* add to ids every peer interested in dev/name, including wildcard ones */
+        void collect(const std::string &dev, const std::string &name, std::set<unsigned long> &ids) const;
+
+    private:
+        const Subscribers *subscribers(const std::string &dev, const std::string &name) const;
+
+        std::unordered_map<std::string, std::unordered_map<std::string, Subscribers>> index;
+        std::set<unsigned long> wildcards;
+};
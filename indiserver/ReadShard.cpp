@@ -0,0 +1,132 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "ReadShard.hpp"
+#include "MsgQueue.hpp"
+
+#include <thread>
+
+std::vector<ReadShard*> ReadShard::shards;
+unsigned long ReadShard::nextShard = 0;
+std::mutex ReadShard::readyLock;
+std::list<MsgQueue*> ReadShard::readyQueues;
+ev::async * ReadShard::readyNotifier = nullptr;
+
+ReadShard::ReadShard()
+{
+    ev_set_userdata(loop, this);
+    ev_set_loop_release_cb(loop, &ReadShard::releaseLoop, &ReadShard::acquireLoop);
+
+    wakeup.set(loop);
+    wakeup.set<ReadShard, &ReadShard::onWakeup>(this);
+    wakeup.start();
+
+    std::thread t([this]()
+    {
+        run();
+    });
+    t.detach();
+}
+
+void ReadShard::run()
+{
+    // The lock is released by releaseLoop while waiting for events
+    loopLock.lock();
+    loop.run(0);
+    loopLock.unlock();
+}
+
+void ReadShard::onWakeup(ev::async &, int)
+{
+    // Nothing to do: watchers changes are taken into account on next iteration
+}
+
+void ReadShard::releaseLoop(struct ev_loop *loop) noexcept
+{
+    ((ReadShard*)ev_userdata(loop))->loopLock.unlock();
+}
+
+void ReadShard::acquireLoop(struct ev_loop *loop) noexcept
+{
+    ((ReadShard*)ev_userdata(loop))->loopLock.lock();
+}
+
+ReadShard::Lock::Lock(ReadShard * shard): shard(shard)
+{
+    shard->loopLock.lock();
+}
+
+ReadShard::Lock::~Lock()
+{
+    shard->wakeup.send();
+    shard->loopLock.unlock();
+}
+
+void ReadShard::setup(int count)
+{
+    if (count <= 1 || readyNotifier)
+        return;
+
+    readyNotifier = new ev::async();
+    readyNotifier->set<&ReadShard::onReady>();
+    readyNotifier->start();
+
+    // The main loop takes its share of the connections
+    shards.push_back(nullptr);
+    while ((int)shards.size() < count)
+        shards.push_back(new ReadShard());
+}
+
+ReadShard * ReadShard::assign()
+{
+    if (shards.empty())
+        return nullptr;
+    return shards[(nextShard++) % shards.size()];
+}
+
+void ReadShard::notifyReady(MsgQueue * queue)
+{
+    {
+        std::lock_guard<std::mutex> guard(readyLock);
+        readyQueues.push_back(queue);
+    }
+    readyNotifier->send();
+}
+
+void ReadShard::forget(MsgQueue * queue)
+{
+    std::lock_guard<std::mutex> guard(readyLock);
+    readyQueues.remove(queue);
+}
+
+void ReadShard::onReady(ev::async &, int)
+{
+    // Dispatching may delete other queues, which then leave readyQueues.
+    while (true)
+    {
+        MsgQueue * queue;
+        {
+            std::lock_guard<std::mutex> guard(readyLock);
+            if (readyQueues.empty())
+                return;
+            queue = readyQueues.front();
+            readyQueues.pop_front();
+        }
+        queue->dispatchShardInput();
+    }
+}
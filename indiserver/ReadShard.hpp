@@ -0,0 +1,99 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <ev++.h>
+#include <list>
+#include <mutex>
+#include <vector>
+
+class MsgQueue;
+
+/* An event loop running in its own thread, which reads and parses the
+ * incoming traffic of the connections assigned to it.
+ *
+ * Parsed messages are handed back to the main loop, where all routing and
+ * writing happen. A connection stops reading until the main loop dispatched
+ * its previous batch, so ordering is preserved and memory stays bounded.
+ *
+ * The shard thread holds the loop lock, except while it waits for events.
+ * Other threads must hold it (see Lock) to touch the shard watchers.
+ *
+ * A shard thread only touches, for the queues it reads:
+ *  - the read watcher, the splitter and the LinkDecoder of the queue;
+ *  - the atomic bytesIn counter;
+ *  - shardRoots, shardSharedBuffers, shardFailure and shardClosed, under
+ *    the shard lock, until the main loop takes them in dispatchShardInput.
+ * Beside these, it calls into code that guards its own global state:
+ * IDSharedBlobAlloc (shared buffer list mutex), the lilxml arena cache
+ * (arenaCacheLock) and the atom table (built once, then read only).
+ * userConfigurableArguments is read only after startup. Everything else -
+ * routing, property cache, output queues, metrics - belongs to the main
+ * loop. WebSocket connections are not sharded: their control frames are
+ * answered by writes from the main loop.
+ */
+class ReadShard
+{
+        std::mutex loopLock;
+        ev::dynamic_loop loop;
+        ev::async wakeup;      /* let the loop notice watcher changes */
+
+        ReadShard();
+        void run();
+        void onWakeup(ev::async &watcher, int revents);
+
+        static void releaseLoop(struct ev_loop *loop) noexcept;
+        static void acquireLoop(struct ev_loop *loop) noexcept;
+
+        static std::vector<ReadShard*> shards;
+        static unsigned long nextShard;
+
+        /* Main loop side: queues that have parsed input to dispatch */
+        static std::mutex readyLock;
+        static std::list<MsgQueue*> readyQueues;
+        static ev::async * readyNotifier;
+        static void onReady(ev::async &watcher, int revents);
+
+    public:
+        /* Exclusive access to the shard loop & its watchers */
+        class Lock
+        {
+                ReadShard * shard;
+            public:
+                Lock(ReadShard * shard);
+                ~Lock();
+        };
+
+        struct ev_loop * evLoop()
+        {
+            return loop;
+        }
+
+        /* Spread reading over count event loops, the main one included */
+        static void setup(int count);
+
+        /* Pick the shard for a new connection. nullptr stands for the main loop */
+        static ReadShard * assign();
+
+        /* Called from a shard thread: queue has input ready for dispatch */
+        static void notifyReady(MsgQueue * queue);
+
+        /* Called from the main loop before queue is deleted */
+        static void forget(MsgQueue * queue);
+};
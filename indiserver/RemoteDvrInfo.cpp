@@ -21,6 +21,7 @@
 #include "Constants.hpp"
 #include "Msg.hpp"
 #include "CommandLineArgs.hpp"
+#include "Capture.hpp"
 
 #include <cstdio>
 #include <netinet/in.h>
@@ -62,9 +63,15 @@ void RemoteDvrInfo::start()
     /* connect */
     sockfd = openINDIServer();
 
+    /* ask for a leaner encoding than XML, if the upstream server supports it */
+    LinkDecoder::Encoding encoding = LinkDecoder::Frames;
+    LinkDecoder::parse(userConfigurableArguments->linkEncoding, encoding);
+    expectLinkEncoding(encoding);
+
     /* record flag pid, io channels, init lp and snoop list */
 
     this->setFds(sockfd, sockfd);
+    Capture::opened(CaptureDriver, this, name);
 
     if (userConfigurableArguments->verbosity > 0)
         log(fmt("socket=%d\n", sockfd));
@@ -96,6 +103,14 @@ void RemoteDvrInfo::start()
 
     Msg *mp = new Msg(nullptr, root);
 
+    /* the request must come before anything else */
+    if (LinkDecoder::request(encoding)[0])
+    {
+        Msg *request = Msg::fromRaw(this, LinkDecoder::request(encoding));
+        pushMsg(request);
+        request->queuingDone();
+    }
+
     // pushmsg can kill this. do at end
     pushMsg(mp);
 }
@@ -21,12 +21,14 @@
 #include "MsgChunck.hpp"
 #include "MsgChunckIterator.hpp"
 #include "MsgQueue.hpp"
+#include "ConversionPool.hpp"
 
-#include <thread>
+#include <algorithm>
 
 SerializedMsg::SerializedMsg(Msg * parent) : asyncProgress(), owner(parent), awaiters(), chuncks(), ownBuffers()
 {
     blockedProducer = nullptr;
+    suspended = false;
     // At first, everything is required.
     for(auto fd : parent->sharedBuffers)
     {
@@ -45,8 +47,36 @@ SerializedMsg::~SerializedMsg()
 {
     for(auto buff : ownBuffers)
     {
-        free(buff);
+        BlockPool::release(buff.first, buff.second);
     }
+    for(auto &slice : slices)
+    {
+        BlockPool::release(slice.buffer, slice.size);
+    }
+}
+
+char * SerializedMsg::ownBuffer(size_t size)
+{
+    char * buffer = static_cast<char *>(BlockPool::allocate(size));
+    ownBuffers.push_back(std::make_pair(buffer, size));
+    return buffer;
+}
+
+char * SerializedMsg::async_sliceBuffer(size_t size)
+{
+    std::lock_guard<std::recursive_mutex> guard(lock);
+
+    if (slices.size() >= maxSlices)
+    {
+        suspended = true;
+        // Let the main loop drop the production if nobody awaits it anymore
+        asyncProgress.send();
+        return nullptr;
+    }
+
+    char * buffer = static_cast<char *>(BlockPool::allocate(size));
+    slices.push_back(Slice{chuncks.size(), buffer, size});
+    return buffer;
 }
 
 bool SerializedMsg::async_canceled()
@@ -94,11 +124,7 @@ void SerializedMsg::async_start()
     {
         asyncProgress.start();
 
-        std::thread t([this]()
-        {
-            generateContent();
-        });
-        t.detach();
+        ConversionPool::submit(this);
     }
     else
     {
@@ -106,24 +132,59 @@ void SerializedMsg::async_start()
     }
 }
 
-void SerializedMsg::async_progressed()
+bool SerializedMsg::async_cancel()
 {
     std::lock_guard<std::recursive_mutex> guard(lock);
 
-    if (asyncStatus == SerializationStatus::terminated)
+    // A suspended production is not queued: just forget it
+    if (suspended)
     {
-        // FIXME: unblock ?
+        suspended = false;
+        asyncStatus = SerializationStatus::terminated;
         asyncProgress.stop();
+        return true;
     }
 
-    // Update ios of awaiters
-    for(auto awaiter : awaiters)
+    // Once started, the conversion runs to completion: a new awaiter may still come
+    if (asyncStatus != SerializationStatus::running || !ConversionPool::cancel(this))
     {
-        awaiter->messageMayHaveProgressed(this);
+        return false;
     }
 
-    // Then prune
-    owner->prune();
+    asyncStatus = SerializationStatus::terminated;
+    asyncProgress.stop();
+    return true;
+}
+
+void SerializedMsg::async_progressed()
+{
+    bool unused;
+    {
+        std::lock_guard<std::recursive_mutex> guard(lock);
+
+        if (asyncStatus == SerializationStatus::terminated)
+        {
+            // FIXME: unblock ?
+            asyncProgress.stop();
+        }
+
+        // Update ios of awaiters
+        for(auto awaiter : awaiters)
+        {
+            awaiter->messageMayHaveProgressed(this);
+        }
+
+        // Then prune
+        owner->prune();
+
+        // Every awaiter left while the conversion was running
+        unused = awaiters.empty() && (asyncStatus == SerializationStatus::terminated || (suspended && async_cancel()));
+    }
+
+    if (unused)
+    {
+        owner->releaseSerialization(this);
+    }
 }
 
 bool SerializedMsg::isAsyncRunning()
@@ -210,6 +271,47 @@ void SerializedMsg::advance(MsgChunckIterator &iter, ssize_t s)
     }
 }
 
+void SerializedMsg::sent(MsgQueue * q, const MsgChunckIterator &position)
+{
+    std::lock_guard<std::recursive_mutex> guard(lock);
+
+    // Only streamed productions care. Awaiters are all added before the first send,
+    // so none can miss a slice released here.
+    if (slices.empty())
+    {
+        return;
+    }
+
+    sentChuncks[q] = position.chunckId;
+    releaseSentSlices();
+}
+
+void SerializedMsg::releaseSentSlices()
+{
+    std::lock_guard<std::recursive_mutex> guard(lock);
+
+    size_t sentByAll = chuncks.size();
+    for(auto awaiter : awaiters)
+    {
+        auto it = sentChuncks.find(awaiter);
+        sentByAll = std::min(sentByAll, it == sentChuncks.end() ? 0 : it->second);
+    }
+
+    while (!slices.empty() && slices.front().chunckId < sentByAll)
+    {
+        BlockPool::release(slices.front().buffer, slices.front().size);
+        chuncks[slices.front().chunckId].content = nullptr;
+        slices.pop_front();
+    }
+
+    // Resume when half of the slices are available again
+    if (suspended && slices.size() <= maxSlices / 2)
+    {
+        suspended = false;
+        ConversionPool::submit(this);
+    }
+}
+
 void SerializedMsg::addAwaiter(MsgQueue * q)
 {
     awaiters.insert(q);
@@ -218,10 +320,18 @@ void SerializedMsg::addAwaiter(MsgQueue * q)
 void SerializedMsg::release(MsgQueue * q)
 {
     awaiters.erase(q);
-    if (awaiters.empty() && !isAsyncRunning())
+    sentChuncks.erase(q);
+    if (awaiters.empty())
     {
-        owner->releaseSerialization(this);
+        if (!isAsyncRunning() || async_cancel())
+        {
+            owner->releaseSerialization(this);
+        }
+        return;
     }
+
+    // The slices may have waited only for this one
+    releaseSentSlices();
 }
 
 void SerializedMsg::collectRequirements(SerializationRequirement &sr)
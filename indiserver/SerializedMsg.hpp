@@ -19,7 +19,10 @@
 #pragma once
 
 #include "SerializationRequirement.hpp"
+#include "BlockPool.hpp"
 
+#include <deque>
+#include <map>
 #include <mutex>
 #include <vector>
 #include <list>
@@ -32,17 +35,19 @@ class MsgQueue;
 
 enum class SerializationStatus { pending, running, canceling, terminated };
 
-class SerializedMsg
+class SerializedMsg: public PoolAllocated
 {
         friend class Msg;
         friend class MsgChunckIterator;
+        friend class ConversionPool;
 
         std::recursive_mutex lock;
         ev::async asyncProgress;
 
-        // Start a thread for execution of asyncRun
+        // Queue asyncRun for execution by the ConversionPool
         void async_start();
-        void async_cancel();
+        // Withdraw a queued asyncRun. Return true if it will not run
+        bool async_cancel();
 
         // Called within main loop when async task did some progress
         void async_progressed();
@@ -52,7 +57,30 @@ class SerializedMsg
 
         void produce(bool sync);
 
+        // A buffer of async_sliceBuffer, and the chunck that uses it
+        struct Slice
+        {
+            size_t chunckId;
+            void * buffer;
+            size_t size;
+        };
+
+        // Slices not yet sent to every awaiter, oldest first
+        std::deque<Slice, PoolAllocator<Slice>> slices;
+
+        // First chunck not completely sent, for awaiters that started sending
+        std::map<MsgQueue *, size_t, std::less<MsgQueue *>, PoolAllocator<std::pair<MsgQueue * const, size_t>>> sentChuncks;
+
+        // The production returned for lack of slices. It is resumed when some are sent
+        bool suspended;
+
+        // Release the slices every awaiter has sent, and resume the production if suspended
+        void releaseSentSlices();
+
     protected:
+        // Slices a production may have pending before being suspended
+        static constexpr size_t maxSlices = 8;
+
         // These methods are to be called from asyncRun
         bool async_canceled();
         void async_updateRequirement(const SerializationRequirement &n);
@@ -67,13 +95,21 @@ class SerializedMsg
 
         MsgQueue* blockedProducer;
 
-        std::set<MsgQueue *> awaiters;
+        std::set<MsgQueue *, std::less<MsgQueue *>, PoolAllocator<MsgQueue *>> awaiters;
     private:
-        std::vector<MsgChunck> chuncks;
+        std::vector<MsgChunck, PoolAllocator<MsgChunck>> chuncks;
+
+        // Buffers of ownBuffer, with their size
+        std::vector<std::pair<void *, size_t>, PoolAllocator<std::pair<void *, size_t>>> ownBuffers;
 
     protected:
-        // Buffers malloced during asyncRun
-        std::list<void*> ownBuffers;
+        // A buffer released with this message. To be called from asyncRun
+        char * ownBuffer(size_t size);
+
+        // A buffer for the next chunck, released as soon as every awaiter has sent it.
+        // Returns null when maxSlices are pending: generateContent must then return
+        // without async_done, and will be called again to continue once some are sent.
+        char * async_sliceBuffer(size_t size);
 
         // This will notify awaiters and possibly release the owner
         void onDataReady();
@@ -104,6 +140,9 @@ class SerializedMsg
 
         void advance(MsgChunckIterator &position, ssize_t s);
 
+        // When a queue has sent everything before position
+        void sent(MsgQueue * from, const MsgChunckIterator &position);
+
         // When a queue is done with sending this message
         void release(MsgQueue * from);
 
@@ -0,0 +1,189 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "SerializedMsgBinary.hpp"
+#include "Utils.hpp"
+#include "Uring.hpp"
+#include "Msg.hpp"
+#include "MsgChunck.hpp"
+#include "indicore/indibinaryframe.h"
+
+#include <cstring>
+
+SerializedMsgBinary::SerializedMsgBinary(Msg * parent): SerializedMsg(parent)
+{
+}
+
+SerializedMsgBinary::~SerializedMsgBinary()
+{
+    for (auto &mapping : mappings)
+    {
+        if (mapping.fixedBuffer != -1)
+            Uring::instance()->unregisterBuffer(mapping.fixedBuffer);
+        dettachSharedBuffer(mapping.fd, mapping.data, mapping.size);
+    }
+}
+
+bool SerializedMsgBinary::generateContentAsync() const
+{
+    return owner->hasInlineBlobs || owner->hasSharedBufferBlobs;
+}
+
+void SerializedMsgBinary::generateContent()
+{
+    XMLEle * root = owner->xmlContent;
+    XMLEle * parsed = nullptr;
+
+    if (!owner->rawContent.empty())
+    {
+        // Scanned message: only its attributes were kept. Parse it again to get the values
+        LilXML * lp = newLilXML();
+        char ynot[1024];
+        XMLEle ** nodes = parseXMLChunk(lp, &owner->rawContent[0], owner->rawContent.size(), ynot);
+        if (nodes != nullptr)
+        {
+            parsed = nodes[0];
+            for (int i = 1; parsed != nullptr && nodes[i] != nullptr; ++i)
+            {
+                delXMLEle(nodes[i]);
+            }
+            free(nodes);
+        }
+        delLilXML(lp);
+        root = parsed;
+    }
+
+    if (root == nullptr || !encode(root))
+    {
+        pushXml(root);
+    }
+
+    if (parsed != nullptr)
+    {
+        delXMLEle(parsed);
+    }
+    async_done();
+}
+
+void SerializedMsgBinary::pushXml(XMLEle * root)
+{
+    size_t size;
+    char * xml;
+
+    if (!owner->rawContent.empty() || root == nullptr)
+    {
+        size = owner->rawContent.size();
+        xml = nullptr;
+    }
+    else
+    {
+        xml = ownBuffer(sprlXMLEle(root, 0) + 1);
+        size = sprXMLEle(xml, root, 0);
+    }
+
+    const size_t length = size + 1;
+    char * header = ownBuffer(INDI_FRAME_HEADER_SIZE);
+    for (int i = 0; i < 4; ++i)
+    {
+        header[i] = char((length >> (8 * i)) & 0xff);
+    }
+    header[4] = INDI_FRAME_XML;
+    async_pushChunck(MsgChunck(header, INDI_FRAME_HEADER_SIZE));
+
+    if (size == 0)
+    {
+        return;
+    }
+    if (xml == nullptr)
+    {
+        async_pushChunck(MsgChunck(&owner->rawContent[0], size));
+    }
+    else
+    {
+        async_pushChunck(MsgChunck(xml, size));
+    }
+}
+
+/* BLOB content of the message being encoded */
+class SerializedMsgBinary::Blobs: public INDI::BinaryFrame::BlobSource
+{
+    public:
+        Blobs(SerializedMsgBinary * msg): msg(msg)
+        { }
+
+        bool attached(const void * &data, size_t &size) override
+        {
+            if (nextSharedBuffer >= msg->owner->sharedBuffers.size())
+            {
+                return false;
+            }
+
+            Mapping mapping;
+            mapping.fd = msg->owner->sharedBuffers[nextSharedBuffer++];
+            /* written to clients as a registered io_uring buffer, when possible.
+             * Only that needs a writable mapping; otherwise it stays read-only */
+            auto ring = Uring::instance();
+            if (ring != nullptr && !ring->registersBuffers())
+                ring = nullptr;
+            mapping.data = attachSharedBuffer(mapping.fd, mapping.size, ring != nullptr);
+            mapping.fixedBuffer = ring ? ring->registerBuffer(mapping.data, mapping.size) : -1;
+            msg->mappings.push_back(mapping);
+
+            data = mapping.data;
+            size = mapping.size;
+            return true;
+        }
+
+        void * allocate(size_t size) override
+        {
+            return msg->ownBuffer(size);
+        }
+
+    private:
+        SerializedMsgBinary * msg;
+        size_t nextSharedBuffer = 0;
+};
+
+bool SerializedMsgBinary::encode(XMLEle * root)
+{
+    Blobs blobs(this);
+    INDI::BinaryFrame::Encoded frame;
+    if (!INDI::BinaryFrame::encode(root, blobs, frame))
+    {
+        return false;
+    }
+
+    char * bytes = ownBuffer(frame.bytes.size());
+    memcpy(bytes, frame.bytes.data(), frame.bytes.size());
+
+    size_t pos = 0;
+    for (auto &payload : frame.payloads)
+    {
+        async_pushChunck(MsgChunck(bytes + pos, payload.offset - pos));
+        pos = payload.offset;
+        if (payload.size > 0)
+        {
+            async_pushChunck(MsgChunck((char*)payload.data, payload.size));
+        }
+    }
+    if (pos < frame.bytes.size())
+    {
+        async_pushChunck(MsgChunck(bytes + pos, frame.bytes.size() - pos));
+    }
+    return true;
+}
@@ -0,0 +1,140 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "SerializedMsgWebSocket.hpp"
+#include "WebSocket.hpp"
+#include "Utils.hpp"
+#include "Msg.hpp"
+#include "MsgChunck.hpp"
+#include "base64.h"
+
+#include <cstring>
+#include <unordered_map>
+
+SerializedMsgWebSocket::SerializedMsgWebSocket(Msg * parent): SerializedMsg(parent)
+{
+}
+
+SerializedMsgWebSocket::~SerializedMsgWebSocket()
+{
+    for (auto &mapping : mappings)
+    {
+        dettachSharedBuffer(mapping.fd, mapping.data, mapping.size);
+    }
+}
+
+bool SerializedMsgWebSocket::generateContentAsync() const
+{
+    return owner->hasInlineBlobs || owner->hasSharedBufferBlobs;
+}
+
+void SerializedMsgWebSocket::pushFrame(int opcode, const char * data, size_t size)
+{
+    char * header = ownBuffer(WebSocket::maxHeaderSize);
+    size_t headerSize = WebSocket::frameHeader(header, (WebSocket::Opcode)opcode, size);
+    async_pushChunck(MsgChunck(header, headerSize));
+    if (size > 0)
+    {
+        async_pushChunck(MsgChunck((char*)data, size));
+    }
+}
+
+void SerializedMsgWebSocket::generateContent()
+{
+    if (!owner->rawContent.empty())
+    {
+        // Scanned message: forward it as received
+        pushFrame(WebSocket::Text, &owner->rawContent[0], owner->rawContent.size());
+        async_done();
+        return;
+    }
+
+    XMLEle * xmlContent = owner->xmlContent;
+
+    struct Payload
+    {
+        const char * data;
+        size_t size;
+    };
+    std::vector<Payload> payloads;
+    std::unordered_map<XMLEle*, XMLEle*> replacement;
+
+    size_t sharedBufferId = 0;
+    for (auto blobContent : findBlobElements(xmlContent))
+    {
+        XMLEle * clone = shallowCloneXMLEle(blobContent);
+        rmXMLAtt(clone, "attached");
+        rmXMLAtt(clone, "enclen");
+        addXMLAtt(clone, "attached", "true");
+        editXMLEle(clone, "");
+        replacement[blobContent] = clone;
+
+        ssize_t size = -1;
+        parseBlobSize(blobContent, size);
+
+        Payload payload = { nullptr, 0 };
+        if (!strcmp(findXMLAttValu(blobContent, "attached"), "true"))
+        {
+            Mapping mapping;
+            mapping.fd = owner->sharedBuffers[sharedBufferId++];
+            mapping.data = attachSharedBuffer(mapping.fd, mapping.size);
+            mappings.push_back(mapping);
+
+            payload.data = (const char *)mapping.data;
+            payload.size = mapping.size;
+            if (size >= 0 && (size_t)size < payload.size)
+            {
+                payload.size = size;
+            }
+        }
+        else if (pcdatalenXMLEle(blobContent) > 0)
+        {
+            int base64Len = pcdatalenXMLEle(blobContent);
+            char * data = ownBuffer(3 * base64Len / 4 + 4);
+            int len = from64tobits_fast(data, pcdataXMLEle(blobContent), base64Len);
+            payload.data = data;
+            payload.size = len < 0 ? 0 : len;
+            // line breaks of the base64 text are counted in len
+            if (size >= 0 && (size_t)size < payload.size)
+            {
+                payload.size = size;
+            }
+        }
+        payloads.push_back(payload);
+    }
+
+    if (!replacement.empty())
+    {
+        xmlContent = cloneXMLEleWithReplacementMap(xmlContent, replacement);
+    }
+
+    char * model = ownBuffer(sprlXMLEle(xmlContent, 0) + 1);
+    int modelSize = sprXMLEle(model, xmlContent, 0);
+
+    if (xmlContent != owner->xmlContent)
+    {
+        delXMLEle(xmlContent);
+    }
+
+    pushFrame(WebSocket::Text, model, modelSize);
+    for (auto &payload : payloads)
+    {
+        pushFrame(WebSocket::Binary, payload.data, payload.size);
+    }
+    async_done();
+}
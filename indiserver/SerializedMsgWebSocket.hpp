@@ -0,0 +1,54 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+
+#include "SerializedMsg.hpp"
+#include "lilxml.h"
+
+#include <vector>
+
+/* Message as WebSocket frames, for clients of WebSocketServer.
+ *
+ * The XML goes in a text frame. Every oneBLOB it holds is sent there with
+ * attached='true' and no content; the content follows in a binary frame,
+ * one per oneBLOB in document order. Attached buffers are mapped and written
+ * as is, base64 contents are decoded: web clients get the raw bytes.
+ */
+class SerializedMsgWebSocket: public SerializedMsg
+{
+        struct Mapping
+        {
+            int fd;
+            void * data;
+            size_t size;
+        };
+
+        /* shared buffers mapped for the lifetime of the serialization */
+        std::vector<Mapping> mappings;
+
+        void pushFrame(int opcode, const char * data, size_t size);
+
+    public:
+        SerializedMsgWebSocket(Msg * parent);
+        virtual ~SerializedMsgWebSocket();
+
+        virtual bool generateContentAsync() const;
+        virtual void generateContent();
+};
@@ -47,6 +47,14 @@ bool SerializedMsgWithSharedBuffer::generateContentAsync() const
 
 void SerializedMsgWithSharedBuffer::generateContent()
 {
+    if (!owner->rawContent.empty())
+    {
+        // Scanned message: forward it as received
+        async_pushChunck(MsgChunck(&owner->rawContent[0], owner->rawContent.size()));
+        async_done();
+        return;
+    }
+
     // Convert every inline base64 blob from xml into an attached buffer
     auto xmlContent = owner->xmlContent;
 
@@ -117,8 +125,7 @@ void SerializedMsgWithSharedBuffer::generateContent()
     // Now create a Chunk from xmlContent
     MsgChunck chunck;
 
-    chunck.content = (char*)malloc(sprlXMLEle(xmlContent, 0) + 1);
-    ownBuffers.push_back(chunck.content);
+    chunck.content = ownBuffer(sprlXMLEle(xmlContent, 0) + 1);
     chunck.contentLength = sprXMLEle(chunck.content, xmlContent, 0);
     chunck.sharedBufferIdsToAttach = sharedBuffers;
 
@@ -22,14 +22,28 @@
 #include "MsgChunck.hpp"
 #include "base64.h"
 
+#include <algorithm>
 #include <unordered_map>
 
 SerializedMsgWithoutSharedBuffer::SerializedMsgWithoutSharedBuffer(Msg * parent): SerializedMsg(parent)
 {
+    prepared = false;
+    model = nullptr;
+    modelSize = 0;
+    modelOffset = 0;
+    currentBlob = 0;
 }
 
 SerializedMsgWithoutSharedBuffer::~SerializedMsgWithoutSharedBuffer()
 {
+    // Production abandoned while suspended
+    for(auto &blob : blobs)
+    {
+        if (blob.data != nullptr)
+        {
+            dettachSharedBuffer(blob.fd, blob.data, blob.attachedSize);
+        }
+    }
 }
 
 bool SerializedMsgWithoutSharedBuffer::generateContentAsync() const
@@ -38,6 +52,30 @@ bool SerializedMsgWithoutSharedBuffer::generateContentAsync() const
 }
 
 void SerializedMsgWithoutSharedBuffer::generateContent()
+{
+    if (!prepared)
+    {
+        if (!owner->rawContent.empty())
+        {
+            // Scanned message: forward it as received
+            async_pushChunck(MsgChunck(&owner->rawContent[0], owner->rawContent.size()));
+            async_done();
+            return;
+        }
+
+        prepare();
+        prepared = true;
+    }
+
+    if (!produceChuncks())
+    {
+        // Called again once some slices were sent
+        return;
+    }
+    async_done();
+}
+
+void SerializedMsgWithoutSharedBuffer::prepare()
 {
     // Convert every shared buffer into an inline base64
     auto xmlContent = owner->xmlContent;
@@ -97,127 +135,126 @@ void SerializedMsgWithoutSharedBuffer::generateContent()
     {
         // Just print the content as is...
 
-        char * model = (char*)malloc(sprlXMLEle(xmlContent, 0) + 1);
-        int modelSize = sprXMLEle(model, xmlContent, 0);
-
-        ownBuffers.push_back(model);
-
-        async_pushChunck(MsgChunck(model, modelSize));
+        model = ownBuffer(sprlXMLEle(xmlContent, 0) + 1);
+        modelSize = sprXMLEle(model, xmlContent, 0);
 
         // FIXME: lower requirements asap... how to do that ?
         // requirements.xml = false;
         // requirements.sharedBuffers.clear();
-
+        return;
     }
-    else
-    {
-        // Create a replacement that shares original CData buffers
-        xmlContent = cloneXMLEleWithReplacementMap(xmlContent, replacement);
 
-        std::vector<size_t> modelCdataOffset(cdata.size());
+    // Create a replacement that shares original CData buffers
+    xmlContent = cloneXMLEleWithReplacementMap(xmlContent, replacement);
 
-        char * model = (char*)malloc(sprlXMLEle(xmlContent, 0) + 1);
-        int modelSize = sprXMLEle(model, xmlContent, 0);
+    model = ownBuffer(sprlXMLEle(xmlContent, 0) + 1);
+    modelSize = sprXMLEle(model, xmlContent, 0);
 
-        ownBuffers.push_back(model);
+    blobs.resize(cdata.size());
 
-        // Get the element offset
-        for(size_t i = 0; i < cdata.size(); ++i)
-        {
-            modelCdataOffset[i] = sprXMLCDataOffset(xmlContent, cdata[i], 0);
-        }
-        delXMLEle(xmlContent);
-
-        std::vector<int> fds(cdata.size());
-        std::vector<void*> blobs(cdata.size());
-        std::vector<size_t> sizes(cdata.size());
-        std::vector<size_t> attachedSizes(cdata.size());
+    // Get the element offset
+    for(size_t i = 0; i < cdata.size(); ++i)
+    {
+        blobs[i].cdataOffset = sprXMLCDataOffset(xmlContent, cdata[i], 0);
+    }
+    delXMLEle(xmlContent);
 
-        // Attach all blobs
-        for(size_t i = 0; i < cdata.size(); ++i)
+    // Attach all blobs
+    for(size_t i = 0; i < cdata.size(); ++i)
+    {
+        Blob &blob = blobs[i];
+        blob.inlineCData = sharedCData[i];
+        blob.fd = sharedBuffers[i];
+        blob.data = nullptr;
+        blob.size = 0;
+        blob.attachedSize = 0;
+        blob.encoded = 0;
+
+        if (blob.fd != -1)
         {
-            if (sharedBuffers[i] != -1)
-            {
-                fds[i] = sharedBuffers[i];
+            size_t dataSize;
+            blob.data = attachSharedBuffer(blob.fd, dataSize);
+            blob.attachedSize = dataSize;
 
-                size_t dataSize;
-                blobs[i] = attachSharedBuffer(fds[i], dataSize);
-                attachedSizes[i] = dataSize;
-
-                // check dataSize is compatible with the blob element's size
-                // It's mandatory for attached blob to give their size
-                if (xmlSizes[i] != -1 && ((size_t)xmlSizes[i]) <= dataSize)
-                {
-                    dataSize = xmlSizes[i];
-                }
-                sizes[i] = dataSize;
-            }
-            else
+            // check dataSize is compatible with the blob element's size
+            // It's mandatory for attached blob to give their size
+            if (xmlSizes[i] != -1 && ((size_t)xmlSizes[i]) <= dataSize)
             {
-                fds[i] = -1;
+                dataSize = xmlSizes[i];
             }
+            blob.size = dataSize;
         }
+    }
+}
+
+bool SerializedMsgWithoutSharedBuffer::produceChuncks()
+{
+    // Copy from model or blob (streaming base64 encode)
+    for(; currentBlob < blobs.size(); ++currentBlob)
+    {
+        Blob &blob = blobs[currentBlob];
 
-        // Copy from model or blob (streaming base64 encode)
-        int modelOffset = 0;
-        for(size_t i = 0; i < cdata.size(); ++i)
+        // Not done yet when resuming within the blob
+        if (modelOffset <= blob.cdataOffset)
         {
-            int cdataOffset = modelCdataOffset[i];
-            if (cdataOffset > modelOffset)
+            if (blob.cdataOffset > modelOffset)
             {
-                async_pushChunck(MsgChunck(model + modelOffset, cdataOffset - modelOffset));
+                async_pushChunck(MsgChunck(model + modelOffset, blob.cdataOffset - modelOffset));
             }
             // Skip the dummy cdata completely
-            modelOffset = cdataOffset + 1;
-
-            // Perform inplace base64
-            // FIXME: could be streamed/splitted
+            modelOffset = blob.cdataOffset + 1;
+        }
 
-            if (fds[i] != -1)
+        if (blob.fd != -1)
+        {
+            // Add binary chuncks. This needs base64 convertion
+            // FIXME: the size here should be the size of the blob element
+            const unsigned char* src = (const unsigned char*)blob.data;
+
+            // split here in smaller chunks for faster startup
+            // This allow starting write before the whole blob is converted,
+            // and bounds the memory to the slices not yet sent
+            // Slices fill a power of two block of BlockPool exactly: the base64 digits of a
+            // multiple of 24 bits (3 bytes), plus the NUL that to64frombits_s writes after them
+            const size_t sliceSize = 65536;
+            const unsigned long sliceBytes = 3 * (sliceSize / 4 - 1);
+            while(blob.encoded < blob.size)
             {
-                // Add a binary chunck. This needs base64 convertion
-                // FIXME: the size here should be the size of the blob element
-                unsigned long buffSze = sizes[i];
-                const unsigned char* src = (const unsigned char*)blobs[i];
-
-                // split here in smaller chunks for faster startup
-                // This allow starting write before the whole blob is converted
-                while(buffSze > 0)
-                {
-                    // We need a block size multiple of 24 bits (3 bytes)
-                    unsigned long sze = buffSze > 3 * 16384 ? 3 * 16384 : buffSze;
-
-                    char* buffer = (char*) malloc(4 * sze / 3 + 4);
-                    ownBuffers.push_back(buffer);
-                    int base64Count = to64frombits_s((unsigned char*)buffer, src, sze, (4 * sze / 3 + 4));
+                unsigned long sze = std::min<unsigned long>(blob.size - blob.encoded, sliceBytes);
+                size_t bufferSize = 4 * ((sze + 2) / 3) + 1;
 
-                    async_pushChunck(MsgChunck(buffer, base64Count));
-
-                    buffSze -= sze;
-                    src += sze;
+                char* buffer = async_sliceBuffer(bufferSize);
+                if (buffer == nullptr)
+                {
+                    return false;
                 }
+                int base64Count = to64frombits_s((unsigned char*)buffer, src + blob.encoded, sze, bufferSize - 1);
 
+                async_pushChunck(MsgChunck(buffer, base64Count));
 
-                // Dettach blobs ASAP
-                dettachSharedBuffer(fds[i], blobs[i], attachedSizes[i]);
-
-                // requirements.sharedBuffers.erase(fds[i]);
+                blob.encoded += sze;
             }
-            else
-            {
-                // Add an already ready cdata section
 
-                auto len = pcdatalenXMLEle(sharedCData[i]);
-                auto data = pcdataXMLEle(sharedCData[i]);
-                async_pushChunck(MsgChunck(data, len));
-            }
-        }
+            // Dettach blobs ASAP
+            dettachSharedBuffer(blob.fd, blob.data, blob.attachedSize);
+            blob.data = nullptr;
 
-        if (modelOffset < modelSize)
+            // requirements.sharedBuffers.erase(fds[i]);
+        }
+        else
         {
-            async_pushChunck(MsgChunck(model + modelOffset, modelSize - modelOffset));
-            modelOffset = modelSize;
+            // Add an already ready cdata section
+
+            auto len = pcdatalenXMLEle(blob.inlineCData);
+            auto data = pcdataXMLEle(blob.inlineCData);
+            async_pushChunck(MsgChunck(data, len));
         }
     }
-    async_done();
+
+    if (modelOffset < modelSize)
+    {
+        async_pushChunck(MsgChunck(model + modelOffset, modelSize - modelOffset));
+        modelOffset = modelSize;
+    }
+    return true;
 }
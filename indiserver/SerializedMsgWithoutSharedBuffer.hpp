@@ -19,9 +19,35 @@
 #pragma once
 
 #include "SerializedMsg.hpp"
+#include "lilxml.h"
+
+#include <vector>
 
 class SerializedMsgWithoutSharedBuffer: public SerializedMsg
 {
+        // A blob element of the message, in the order of the model
+        struct Blob
+        {
+            size_t cdataOffset;         // Position of the placeholder in the model
+            XMLEle * inlineCData;       // For a base64 blob: the element holding it
+            int fd;                     // For an attached blob: its shared buffer
+            void * data;                // Attached content, until completely encoded
+            size_t size;
+            size_t attachedSize;
+            size_t encoded;             // Bytes of data already pushed as base64
+        };
+
+        // Production state, kept when the production is suspended
+        bool prepared;
+        char * model;
+        size_t modelSize;
+        size_t modelOffset;
+        std::vector<Blob> blobs;
+        size_t currentBlob;
+
+        void prepare();
+        // Return false if suspended before the end
+        bool produceChuncks();
 
     public:
         SerializedMsgWithoutSharedBuffer(Msg * parent);
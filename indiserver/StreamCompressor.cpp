@@ -0,0 +1,72 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "StreamCompressor.hpp"
+#include "indicompression.h"
+
+#include <cstring>
+
+StreamCompressor::StreamCompressor()
+{
+    memset(&stream, 0, sizeof(stream));
+    deflateInit(&stream, level);
+    deflateSetDictionary(&stream, reinterpret_cast<const Bytef *>(indiCompressionDictionary),
+                         sizeof(indiCompressionDictionary) - 1);
+}
+
+StreamCompressor::~StreamCompressor()
+{
+    deflateEnd(&stream);
+}
+
+bool StreamCompressor::compress(const struct iovec * iov, size_t count)
+{
+    if (!hasPending())
+    {
+        pending.clear();
+        pendingPos = 0;
+    }
+
+    /* one more round without input to flush */
+    for (size_t i = 0; i <= count; ++i)
+    {
+        bool flush = (i == count);
+        stream.next_in = flush ? nullptr : static_cast<Bytef *>(iov[i].iov_base);
+        stream.avail_in = flush ? 0 : iov[i].iov_len;
+
+        do
+        {
+            size_t used = pending.size();
+            pending.resize(used + outputChunk);
+            stream.next_out = pending.data() + used;
+            stream.avail_out = outputChunk;
+
+            int rc = deflate(&stream, flush ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+            pending.resize(used + outputChunk - stream.avail_out);
+            if (rc == Z_STREAM_ERROR)
+                return false;
+        }
+        while (stream.avail_in > 0 || stream.avail_out == 0);
+    }
+    return true;
+}
+
+void StreamCompressor::consume(size_t size)
+{
+    pendingPos += size;
+}
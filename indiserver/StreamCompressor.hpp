@@ -0,0 +1,65 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <sys/uio.h>
+#include <vector>
+#include <zlib.h>
+
+/* Deflate stream of the bytes written to a client that asked for compressed
+ * traffic (see indicompression.h).
+ *
+ * Each batch is compressed at once into a pending output, then written as
+ * the socket accepts it. Batches end with a sync flush, so the client can
+ * decode every message as soon as its bytes arrive.
+ */
+class StreamCompressor
+{
+        static constexpr int level {1};            /* favour speed: BLOBs are large */
+        static constexpr size_t outputChunk {65536};
+
+        z_stream stream;
+        std::vector<unsigned char> pending;
+        size_t pendingPos = 0;
+
+    public:
+        StreamCompressor();
+        ~StreamCompressor();
+
+        /* Deflate the given data after the pending output. return false on error */
+        bool compress(const struct iovec * iov, size_t count);
+
+        bool hasPending() const
+        {
+            return pendingPos < pending.size();
+        }
+
+        const unsigned char * pendingData() const
+        {
+            return pending.data() + pendingPos;
+        }
+
+        size_t pendingSize() const
+        {
+            return pending.size() - pendingPos;
+        }
+
+        /* The first size bytes of the pending output were written */
+        void consume(size_t size);
+};
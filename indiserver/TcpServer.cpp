@@ -21,12 +21,13 @@
 #include "Utils.hpp"
 #include "ClInfo.hpp"
 #include "CommandLineArgs.hpp"
+#include "Capture.hpp"
 
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <fcntl.h>
 
-TcpServer::TcpServer(int port): port(port)
+TcpServer::TcpServer(int port, const std::string &host): port(port), host(host)
 {
     sfdev.set<TcpServer, &TcpServer::ioCb>(this);
 }
@@ -38,7 +39,7 @@ void TcpServer::ioCb(ev::io &, int revents)
         int sockErrno = readFdError(this->sfd);
         if (sockErrno)
         {
-            log(fmt("Error on tcp server socket: %s\n", strerror(sockErrno)));
+            log(fmt("Error on %s server socket: %s\n", kind(), strerror(sockErrno)));
             Bye();
         }
     }
@@ -60,14 +61,25 @@ void TcpServer::listen()
         Bye();
     }
 
-    /* bind to given port for any IP address */
+    /* bind to given port for the given or any IP address */
     memset(&serv_socket, 0, sizeof(serv_socket));
     serv_socket.sin_family = AF_INET;
+    if (!host.empty())
+    {
+        if (inet_pton(AF_INET, host.c_str(), &serv_socket.sin_addr) != 1)
+        {
+            log(fmt("%s listen address %s is not an IPv4 address\n", kind(), host.c_str()));
+            Bye();
+        }
+    }
+    else
+    {
 #ifdef SSH_TUNNEL
-    serv_socket.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        serv_socket.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
 #else
-    serv_socket.sin_addr.s_addr = htonl(INADDR_ANY);
+        serv_socket.sin_addr.s_addr = htonl(INADDR_ANY);
 #endif
+    }
     serv_socket.sin_port = htons((unsigned short)port);
     if (setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0)
     {
@@ -92,7 +104,7 @@ void TcpServer::listen()
 
     /* ok */
     if (userConfigurableArguments->verbosity > 0)
-        log(fmt("listening to port %d on fd %d\n", port, sfd));
+        log(fmt("listening to %s clients on %s:%d on fd %d\n", kind(), host.empty() ? "*" : host.c_str(), port, sfd));
 }
 
 void TcpServer::accept()
@@ -112,18 +124,23 @@ void TcpServer::accept()
         Bye();
     }
 
+    welcome(cli_fd, fmt("%s:%d", inet_ntoa(cli_socket.sin_addr), ntohs(cli_socket.sin_port)));
+#ifdef OSX_EMBEDED_MODE
+    fprintf(stderr, "CLIENTS %d\n", clients.size());
+    fflush(stderr);
+#endif
+}
+
+void TcpServer::welcome(int fd, const std::string &peer)
+{
     ClInfo * cp = new ClInfo(false);
 
     /* rig up new clinfo entry */
-    cp->setFds(cli_fd, cli_fd);
+    cp->setFds(fd, fd);
+    Capture::opened(CaptureClient, cp, peer);
 
     if (userConfigurableArguments->verbosity > 0)
     {
-        cp->log(fmt("new arrival from %s:%d - welcome!\n",
-                    inet_ntoa(cli_socket.sin_addr), ntohs(cli_socket.sin_port)));
+        cp->log(fmt("new arrival from %s - welcome!\n", peer.c_str()));
     }
-#ifdef OSX_EMBEDED_MODE
-    fprintf(stderr, "CLIENTS %d\n", clients.size());
-    fflush(stderr);
-#endif
 }
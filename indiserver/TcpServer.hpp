@@ -19,10 +19,13 @@
 #pragma once
 
 #include <ev++.h>
+#include <string>
 
+/* Listener for INDI clients over TCP */
 class TcpServer
 {
         int port;
+        std::string host;
         int sfd = -1;
         ev::io sfdev;
 
@@ -31,11 +34,24 @@ class TcpServer
          */
         void accept();
         void ioCb(ev::io &watcher, int revents);
+
+    protected:
+        /* What the listener is for, in log messages */
+        virtual const char * kind() const
+        {
+            return "tcp";
+        }
+
+        /* rig up the connection of a new client, peer being its address:port */
+        virtual void welcome(int fd, const std::string &peer);
+
     public:
-        TcpServer(int port);
+        /* host: numeric IPv4 address to listen on, empty for all of them */
+        TcpServer(int port, const std::string &host = "");
+        virtual ~TcpServer() = default;
 
         /* create the public INDI Driver endpoint lsocket on port.
          * return server socket else exit.
          */
         void listen();
-};
\ No newline at end of file
+};
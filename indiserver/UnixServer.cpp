@@ -21,6 +21,7 @@
 #include "Constants.hpp"
 #include "ClInfo.hpp"
 #include "CommandLineArgs.hpp"
+#include "Capture.hpp"
 
 #include <sys/un.h>
 #include <sys/socket.h>
@@ -148,6 +149,7 @@ void UnixServer::accept()
 
     /* rig up new clinfo entry */
     cp->setFds(cli_fd, cli_fd);
+    Capture::opened(CaptureClient, cp, "local");
 
     if (userConfigurableArguments->verbosity > 0)
     {
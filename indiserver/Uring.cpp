@@ -0,0 +1,471 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "Uring.hpp"
+#include "Utils.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+Uring * Uring::ring = nullptr;
+
+#ifdef HAVE_IO_URING
+
+namespace
+{
+
+constexpr unsigned ringEntries = 256;
+constexpr unsigned bufferSlots = 256;
+
+int sysSetup(unsigned entries, struct io_uring_params * params)
+{
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+int sysEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+int sysRegister(int fd, unsigned opcode, const void * arg, unsigned nrArgs)
+{
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs);
+}
+
+}
+
+void Uring::setup(bool enabled)
+{
+    if (!enabled || ring)
+        return;
+
+    std::unique_ptr<Uring> uring(new Uring());
+    std::string failure;
+    if (!uring->start(ringEntries, failure))
+    {
+        log(fmt("io_uring not available, using libev: %s\n", failure.c_str()));
+        return;
+    }
+    ring = uring.release();
+}
+
+bool Uring::start(unsigned entries, std::string &failure)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CLAMP;
+
+    ringFd = sysSetup(entries, &params);
+    if (ringFd == -1)
+    {
+        failure = fmt("io_uring_setup: %s", strerror(errno));
+        return false;
+    }
+
+    /* A single mapping for both rings, no dropped completions, and sockets polled
+     * by the kernel instead of failing with EAGAIN
+     */
+    unsigned required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_FAST_POLL;
+    if ((params.features & required) != required)
+    {
+        failure = "kernel too old";
+        close(ringFd);
+        return false;
+    }
+
+    size_t ringSize = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                               params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe));
+    void * rings = mmap(nullptr, ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (rings == MAP_FAILED)
+    {
+        failure = fmt("ring mmap: %s", strerror(errno));
+        close(ringFd);
+        return false;
+    }
+
+    void * sqeArray = mmap(nullptr, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (sqeArray == MAP_FAILED)
+    {
+        failure = fmt("sqe mmap: %s", strerror(errno));
+        munmap(rings, ringSize);
+        close(ringFd);
+        return false;
+    }
+
+    char * base = static_cast<char *>(rings);
+    sqHead = reinterpret_cast<unsigned *>(base + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned *>(base + params.sq_off.tail);
+    sqArray = reinterpret_cast<unsigned *>(base + params.sq_off.array);
+    sqMask = *reinterpret_cast<unsigned *>(base + params.sq_off.ring_mask);
+    sqEntries = params.sq_entries;
+    sqes = static_cast<struct io_uring_sqe *>(sqeArray);
+
+    cqHead = reinterpret_cast<unsigned *>(base + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned *>(base + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned *>(base + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe *>(base + params.cq_off.cqes);
+
+    /* An empty table, filled as buffers get registered. Writes work without it */
+#ifdef IORING_RSRC_REGISTER_SPARSE
+    struct io_uring_rsrc_register reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.nr = bufferSlots;
+    reg.flags = IORING_RSRC_REGISTER_SPARSE;
+    fixedBuffers = sysRegister(ringFd, IORING_REGISTER_BUFFERS2, &reg, sizeof(reg)) == 0;
+    usedBufferSlots.resize(bufferSlots);
+#endif
+
+    watcher.set<Uring, &Uring::ioCb>(this);
+    watcher.start(ringFd, ev::READ);
+    prepare.set<Uring, &Uring::prepareCb>(this);
+    prepare.start();
+    return true;
+}
+
+struct io_uring_sqe * Uring::nextSqe(Request &request)
+{
+    unsigned tail = *sqTail;
+    while (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries)
+    {
+        // Full: hand what is queued to the kernel, making room for completions if needed
+        submit();
+        if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries)
+            collect();
+    }
+
+    unsigned index = tail & sqMask;
+    struct io_uring_sqe * sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = reinterpret_cast<uintptr_t>(&request);
+    sqArray[index] = index;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+    request.pending = true;
+    toSubmit++;
+    return sqe;
+}
+
+void Uring::queueRead(Request &request, int fd, void * buffer, size_t size)
+{
+    struct io_uring_sqe * sqe = nextSqe(request);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uintptr_t>(buffer);
+    sqe->len = size;
+    sqe->off = (__u64) - 1;    /* current position: pipes and sockets */
+}
+
+void Uring::queueRecvmsg(Request &request, int fd, struct msghdr * msgh, int flags)
+{
+    struct io_uring_sqe * sqe = nextSqe(request);
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uintptr_t>(msgh);
+    sqe->len = 1;
+    sqe->msg_flags = flags;
+}
+
+void Uring::queueWritev(Request &request, int fd, const struct iovec * iov, unsigned count)
+{
+    struct io_uring_sqe * sqe = nextSqe(request);
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uintptr_t>(iov);
+    sqe->len = count;
+    sqe->off = (__u64) - 1;
+}
+
+void Uring::queueSendmsg(Request &request, int fd, const struct msghdr * msgh, int flags)
+{
+    struct io_uring_sqe * sqe = nextSqe(request);
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uintptr_t>(msgh);
+    sqe->len = 1;
+    sqe->msg_flags = flags;
+}
+
+void Uring::queueWriteFixed(Request &request, int fd, const void * data, size_t size, int bufferIndex)
+{
+    struct io_uring_sqe * sqe = nextSqe(request);
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uintptr_t>(data);
+    sqe->len = size;
+    sqe->off = (__u64) - 1;
+    sqe->buf_index = bufferIndex;
+}
+
+void Uring::cancel(Request &request)
+{
+    if (request.pending)
+    {
+        // The cancel must find it in the kernel
+        submit();
+
+        struct io_uring_sqe * sqe = nextSqe(cancelRequest);
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = reinterpret_cast<uintptr_t>(&request);
+        submit();
+
+        // submit() leaves the cancel queued when the kernel is busy: keep submitting it while waiting
+        while (request.pending)
+        {
+            collect();
+            if (!request.pending)
+                break;
+
+            int submitted = sysEnter(ringFd, toSubmit, 1, IORING_ENTER_GETEVENTS);
+            if (submitted >= 0)
+                toSubmit -= submitted;
+            else if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            {
+                log(fmt("io_uring_enter: %s\n", strerror(errno)));
+                Bye();
+            }
+        }
+    }
+
+    for (auto it = completed.begin(); it != completed.end(); )
+    {
+        if (it->first == &request)
+            it = completed.erase(it);
+        else
+            ++it;
+    }
+}
+
+void Uring::schedule(Task &task)
+{
+    if (task.scheduled)
+        return;
+    task.scheduled = true;
+    tasks.push_back(&task);
+}
+
+void Uring::unschedule(Task &task)
+{
+    if (!task.scheduled)
+        return;
+    task.scheduled = false;
+    for (auto &scheduled : tasks)
+    {
+        if (scheduled == &task)
+            scheduled = nullptr;
+    }
+}
+
+void Uring::submit()
+{
+    while (toSubmit > 0)
+    {
+        int submitted = sysEnter(ringFd, toSubmit, 0, 0);
+        if (submitted == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EBUSY)
+            {
+                // Completions must be collected first: retry at the next iteration
+                collect();
+                return;
+            }
+            log(fmt("io_uring_enter: %s\n", strerror(errno)));
+            Bye();
+        }
+        toSubmit -= submitted;
+    }
+}
+
+void Uring::collect()
+{
+    unsigned head = *cqHead;
+    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    while (head != tail)
+    {
+        struct io_uring_cqe * cqe = &cqes[head & cqMask];
+        Request * request = reinterpret_cast<Request *>(static_cast<uintptr_t>(cqe->user_data));
+        if (request != &cancelRequest)
+        {
+            request->pending = false;
+            completed.emplace_back(request, cqe->res);
+        }
+        head++;
+    }
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+}
+
+void Uring::dispatch()
+{
+    // Callbacks may queue, cancel or complete others
+    while (!completed.empty())
+    {
+        auto completion = completed.front();
+        completed.pop_front();
+        completion.first->callback(completion.first->object, completion.second);
+    }
+}
+
+void Uring::ioCb(ev::io &, int)
+{
+    collect();
+    dispatch();
+}
+
+void Uring::prepareCb(ev::prepare &, int)
+{
+    /* completions collected while cancelling */
+    dispatch();
+
+    // Tasks scheduled meanwhile run as well
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        Task * task = tasks[i];
+        if (task == nullptr)
+            continue;
+        tasks[i] = nullptr;
+        task->scheduled = false;
+        task->callback(task->object);
+    }
+    tasks.clear();
+
+    submit();
+}
+
+int Uring::registerBuffer(const void * data, size_t size)
+{
+    if (!fixedBuffers)
+        return -1;
+
+    std::lock_guard<std::mutex> guard(buffersLock);
+
+    int index = 0;
+    while (index < (int)usedBufferSlots.size() && usedBufferSlots[index])
+        index++;
+    if (index == (int)usedBufferSlots.size())
+        return -1;
+
+#ifdef IORING_RSRC_REGISTER_SPARSE
+    struct iovec iov;
+    iov.iov_base = const_cast<void *>(data);
+    iov.iov_len = size;
+
+    struct io_uring_rsrc_update2 update;
+    memset(&update, 0, sizeof(update));
+    update.offset = index;
+    update.data = reinterpret_cast<uintptr_t>(&iov);
+    update.nr = 1;
+
+    // Fails when locked memory is limited: plain writes then
+    if (sysRegister(ringFd, IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update)) != 1)
+        return -1;
+#endif
+
+    usedBufferSlots[index] = true;
+    buffers[static_cast<const char *>(data)] = Buffer { size, index };
+    return index;
+}
+
+void Uring::unregisterBuffer(int index)
+{
+    if (index < 0)
+        return;
+
+    std::lock_guard<std::mutex> guard(buffersLock);
+
+#ifdef IORING_RSRC_REGISTER_SPARSE
+    struct iovec iov;
+    iov.iov_base = nullptr;
+    iov.iov_len = 0;
+
+    struct io_uring_rsrc_update2 update;
+    memset(&update, 0, sizeof(update));
+    update.offset = index;
+    update.data = reinterpret_cast<uintptr_t>(&iov);
+    update.nr = 1;
+    sysRegister(ringFd, IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update));
+#endif
+
+    usedBufferSlots[index] = false;
+    for (auto it = buffers.begin(); it != buffers.end(); ++it)
+    {
+        if (it->second.index == index)
+        {
+            buffers.erase(it);
+            break;
+        }
+    }
+}
+
+int Uring::findBuffer(const void * data, size_t size)
+{
+    std::lock_guard<std::mutex> guard(buffersLock);
+    if (buffers.empty())
+        return -1;
+
+    const char * start = static_cast<const char *>(data);
+    auto it = buffers.upper_bound(start);
+    if (it == buffers.begin())
+        return -1;
+    --it;
+    if (start + size > it->first + it->second.size)
+        return -1;
+    return it->second.index;
+}
+
+#else
+
+void Uring::setup(bool enabled)
+{
+    if (enabled)
+        log("io_uring not supported by this build, using libev\n");
+}
+
+/* Never called without a ring */
+void Uring::queueRead(Request &, int, void *, size_t) {}
+void Uring::queueRecvmsg(Request &, int, struct msghdr *, int) {}
+void Uring::queueWritev(Request &, int, const struct iovec *, unsigned) {}
+void Uring::queueSendmsg(Request &, int, const struct msghdr *, int) {}
+void Uring::queueWriteFixed(Request &, int, const void *, size_t, int) {}
+void Uring::cancel(Request &) {}
+void Uring::schedule(Task &) {}
+void Uring::unschedule(Task &) {}
+int Uring::registerBuffer(const void *, size_t)
+{
+    return -1;
+}
+void Uring::unregisterBuffer(int) {}
+int Uring::findBuffer(const void *, size_t)
+{
+    return -1;
+}
+
+#endif
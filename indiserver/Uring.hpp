@@ -0,0 +1,191 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+
+#include <ev++.h>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct iovec;
+struct msghdr;
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/* io_uring backend for the reads and writes of the connections (Linux).
+ *
+ * Operations are queued in the ring as the main loop runs, and submitted
+ * together in a single system call just before the loop waits again. Their
+ * completions are collected when the ring fd becomes readable.
+ *
+ * Shared BLOB buffers mapped by the serializations can be registered as fixed
+ * buffers: their pages are then pinned once, and not again for every client
+ * they are written to.
+ *
+ * The kernel interface is used directly. When the build or the running kernel
+ * lacks it, instance() stays nullptr and connections keep their libev watchers.
+ */
+class Uring
+{
+    public:
+        /* An operation in the ring. It and what it points to must live until completion */
+        class Request
+        {
+                friend class Uring;
+
+                void * object = nullptr;
+                void (*callback)(void * object, int result) = nullptr;
+                bool pending = false;
+
+                template <class K, void (K::*method)(int)>
+                static void thunk(void * object, int result)
+                {
+                    (static_cast<K *>(object)->*method)(result);
+                }
+
+            public:
+                /* completions call object->method with the result: a size or -errno */
+                template <class K, void (K::*method)(int)>
+                void set(K * object)
+                {
+                    this->object = object;
+                    callback = &thunk<K, method>;
+                }
+
+                bool isPending() const
+                {
+                    return pending;
+                }
+        };
+
+        /* Work run once per loop iteration, before the submission */
+        class Task
+        {
+                friend class Uring;
+
+                void * object = nullptr;
+                void (*callback)(void * object) = nullptr;
+                bool scheduled = false;
+
+                template <class K, void (K::*method)()>
+                static void thunk(void * object)
+                {
+                    (static_cast<K *>(object)->*method)();
+                }
+
+            public:
+                template <class K, void (K::*method)()>
+                void set(K * object)
+                {
+                    this->object = object;
+                    callback = &thunk<K, method>;
+                }
+        };
+
+        /* Start the ring of the main loop. Logs why when it is not available */
+        static void setup(bool enabled);
+
+        /* The ring, nullptr when connections use libev */
+        static Uring * instance()
+        {
+            return ring;
+        }
+
+        void queueRead(Request &request, int fd, void * buffer, size_t size);
+        void queueRecvmsg(Request &request, int fd, struct msghdr * msgh, int flags);
+        void queueWritev(Request &request, int fd, const struct iovec * iov, unsigned count);
+        void queueSendmsg(Request &request, int fd, const struct msghdr * msgh, int flags);
+        void queueWriteFixed(Request &request, int fd, const void * data, size_t size, int bufferIndex);
+
+        /* Return once the kernel is done with request. It is not called back */
+        void cancel(Request &request);
+
+        /* Run task before the next submission */
+        void schedule(Task &task);
+        void unschedule(Task &task);
+
+        /* Register [data, data + size[ for queueWriteFixed. Return its index, -1 if not possible.
+         * Any thread. data must be a writable mapping (the kernel pins it for writing)
+         */
+        int registerBuffer(const void * data, size_t size);
+
+        /* Whether registerBuffer may succeed. Otherwise, buffers need no writable mapping */
+        bool registersBuffers() const
+        {
+            return fixedBuffers;
+        }
+        void unregisterBuffer(int index);
+
+        /* Index of the registered buffer that holds [data, data + size[, -1 if none */
+        int findBuffer(const void * data, size_t size);
+
+    private:
+        static Uring * ring;
+
+        int ringFd = -1;
+
+        unsigned * sqHead = nullptr;
+        unsigned * sqTail = nullptr;
+        unsigned * sqArray = nullptr;
+        unsigned sqMask = 0;
+        unsigned sqEntries = 0;
+        struct io_uring_sqe * sqes = nullptr;
+        unsigned toSubmit = 0;
+
+        unsigned * cqHead = nullptr;
+        unsigned * cqTail = nullptr;
+        unsigned cqMask = 0;
+        struct io_uring_cqe * cqes = nullptr;
+
+        ev::io watcher;         /* completions are ready */
+        ev::prepare prepare;    /* the loop is about to wait: submit */
+
+        std::vector<Task *> tasks;
+
+        /* Collected completions, to call back */
+        std::deque<std::pair<Request *, int>> completed;
+
+        /* Target of the cancel operations, never called back */
+        Request cancelRequest;
+
+        struct Buffer
+        {
+            size_t size;
+            int index;
+        };
+        std::mutex buffersLock;
+        bool fixedBuffers = false;
+        std::map<const char *, Buffer> buffers;     /* by address */
+        std::vector<bool> usedBufferSlots;
+
+        Uring() = default;
+        bool start(unsigned entries, std::string &failure);
+
+        struct io_uring_sqe * nextSqe(Request &request);
+        void submit();
+        void collect();
+        void dispatch();
+
+        void ioCb(ev::io &watcher, int revents);
+        void prepareCb(ev::prepare &watcher, int revents);
+};
@@ -208,7 +208,7 @@ int readFdError(int fd)
     return EIO;
 }
 
-void * attachSharedBuffer(int fd, size_t &size)
+void * attachSharedBuffer(int fd, size_t &size, bool writable)
 {
     struct stat sb;
     if (fstat(fd, &sb) == -1)
@@ -217,7 +217,16 @@ void * attachSharedBuffer(int fd, size_t &size)
         Bye();
     }
     size = sb.st_size;
-    void * ret = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+    void * ret = MAP_FAILED;
+    /* Registering a buffer with io_uring pins its pages for writing, as a
+     * registered buffer may also be the target of a read: the kernel refuses
+     * read-only mappings. indiserver never writes to these buffers. When the
+     * fd was not opened for writing, the read-only mapping is used and the
+     * registration fails: the buffer is then written with plain writes. */
+    if (writable)
+        ret = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ret == MAP_FAILED)
+        ret = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
 
     if (ret == MAP_FAILED)
     {
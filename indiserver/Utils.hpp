@@ -37,7 +37,9 @@ void Bye(void);
 std::vector<XMLEle *> findBlobElements(XMLEle * root);
 int readFdError(int
                 fd);                       /* Read a pending error condition on the given fd. Return errno value or 0 if none */
-void * attachSharedBuffer(int fd, size_t &size);
+/* Map a shared buffer, read-only unless writable is set. writable is only for
+ * buffers registered with io_uring: see attachSharedBuffer in Utils.cpp */
+void * attachSharedBuffer(int fd, size_t &size, bool writable = false);
 void dettachSharedBuffer(int fd, void * ptr, size_t size);
 bool parseBlobSize(XMLEle * blobWithAttachedBuffer, ssize_t &size);
 XMLEle * cloneXMLEleWithReplacementMap(XMLEle * root, const std::unordered_map<XMLEle*, XMLEle*> &replacement);
@@ -0,0 +1,456 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "WebSocket.hpp"
+
+#include "base64.h"
+
+#include <algorithm>
+#include <cstring>
+#include <strings.h>
+
+namespace
+{
+
+/* Suffix of the client key hashed for Sec-WebSocket-Accept */
+const char * const acceptGuid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+uint32_t rotl(uint32_t value, int bits)
+{
+    return (value << bits) | (value >> (32 - bits));
+}
+
+/* SHA-1 of data. Only used for the handshake, where its weakness does not matter */
+void sha1(const std::string &data, unsigned char digest[20])
+{
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+    std::string msg = data;
+    uint64_t bits = (uint64_t)data.size() * 8;
+    msg.push_back((char)0x80);
+    while (msg.size() % 64 != 56)
+        msg.push_back(0);
+    for (int i = 7; i >= 0; --i)
+        msg.push_back((char)(bits >> (8 * i)));
+
+    for (size_t chunk = 0; chunk < msg.size(); chunk += 64)
+    {
+        const unsigned char * p = (const unsigned char *)msg.data() + chunk;
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i)
+            w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+        for (int i = 16; i < 80; ++i)
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i)
+        {
+            uint32_t f, k;
+            if (i < 20)
+            {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            }
+            else if (i < 40)
+            {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            }
+            else if (i < 60)
+            {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            }
+            else
+            {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t t = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    for (int i = 0; i < 5; ++i)
+        for (int j = 0; j < 4; ++j)
+            digest[4 * i + j] = (unsigned char)(h[i] >> (24 - 8 * j));
+}
+
+std::string trim(const std::string &str)
+{
+    size_t start = str.find_first_not_of(" \t");
+    if (start == std::string::npos)
+        return std::string();
+    return str.substr(start, str.find_last_not_of(" \t") + 1 - start);
+}
+
+/* true if the comma separated list holds token, ignoring case */
+bool hasToken(const std::string &list, const char * token)
+{
+    size_t pos = 0;
+    while (pos <= list.size())
+    {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos)
+            end = list.size();
+        if (!strcasecmp(trim(list.substr(pos, end - pos)).c_str(), token))
+            return true;
+        pos = end + 1;
+    }
+    return false;
+}
+
+}
+
+WebSocket::WebSocket(const std::vector<std::string> &allowedOrigins): allowedOrigins(allowedOrigins)
+{
+}
+
+std::string WebSocket::acceptKey(const std::string &key)
+{
+    unsigned char digest[20];
+    sha1(key + acceptGuid, digest);
+    char accept[32];
+    int acceptSize = to64frombits_s((unsigned char *)accept, digest, sizeof(digest), sizeof(accept));
+    return std::string(accept, acceptSize);
+}
+
+bool WebSocket::isAllowedOrigin(const std::string &origin) const
+{
+    if (origin.empty())
+        return true;
+    for (auto &allowed : allowedOrigins)
+    {
+        if (allowed == "*" || !strcasecmp(allowed.c_str(), origin.c_str()))
+            return true;
+    }
+    return false;
+}
+
+size_t WebSocket::frameHeader(char * header, Opcode opcode, uint64_t length)
+{
+    header[0] = (char)(0x80 | opcode);
+    if (length < 126)
+    {
+        header[1] = (char)length;
+        return 2;
+    }
+    if (length <= 0xffff)
+    {
+        header[1] = 126;
+        header[2] = (char)(length >> 8);
+        header[3] = (char)length;
+        return 4;
+    }
+    header[1] = 127;
+    for (int i = 0; i < 8; ++i)
+        header[2 + i] = (char)(length >> (8 * (7 - i)));
+    return 10;
+}
+
+void WebSocket::consume(size_t size)
+{
+    pendingPos += size;
+    if (pendingPos >= pending.size())
+    {
+        pending.clear();
+        pendingPos = 0;
+    }
+}
+
+void WebSocket::reject(const std::string &status)
+{
+    pending += "HTTP/1.1 " + status + "\r\n";
+    if (status.compare(0, 3, "426") == 0)
+        pending += "Sec-WebSocket-Version: 13\r\n";
+    pending += "Connection: close\r\nContent-Length: 0\r\n\r\n";
+    closing = true;
+}
+
+bool WebSocket::handshake(const char * data, size_t size, size_t &used, std::string &failure)
+{
+    size_t previous = request.size();
+    request.append(data, size);
+
+    size_t end = request.find("\r\n\r\n", previous < 3 ? 0 : previous - 3);
+    if (end == std::string::npos)
+    {
+        if (request.size() > maxRequestSize)
+        {
+            failure = "WebSocket handshake too long\n";
+            return false;
+        }
+        used = size;
+        return true;
+    }
+    /* what follows the request is already framed */
+    used = end + 4 - previous;
+
+    std::string upgrade, connection, key, version, protocols, origin;
+    bool isGet = request.compare(0, 4, "GET ") == 0;
+
+    size_t pos = request.find("\r\n") + 2;
+    while (pos < end)
+    {
+        size_t eol = request.find("\r\n", pos);
+        std::string line = request.substr(pos, eol - pos);
+        pos = eol + 2;
+
+        size_t colon = line.find(':');
+        if (colon == std::string::npos)
+            continue;
+        std::string name = line.substr(0, colon);
+        std::string value = trim(line.substr(colon + 1));
+
+        if (!strcasecmp(name.c_str(), "Upgrade"))
+            upgrade = value;
+        else if (!strcasecmp(name.c_str(), "Connection"))
+            connection = value;
+        else if (!strcasecmp(name.c_str(), "Sec-WebSocket-Key"))
+            key = value;
+        else if (!strcasecmp(name.c_str(), "Sec-WebSocket-Version"))
+            version = value;
+        else if (!strcasecmp(name.c_str(), "Sec-WebSocket-Protocol"))
+            protocols += (protocols.empty() ? "" : ",") + value;
+        else if (!strcasecmp(name.c_str(), "Origin"))
+            origin = value;
+    }
+    request.clear();
+
+    if (!isGet || !hasToken(upgrade, "websocket") || !hasToken(connection, "upgrade") || key.empty())
+    {
+        reject("400 Bad Request");
+        return true;
+    }
+    if (version != "13")
+    {
+        reject("426 Upgrade Required");
+        return true;
+    }
+    if (!isAllowedOrigin(origin))
+    {
+        reject("403 Forbidden");
+        return true;
+    }
+
+    pending += "HTTP/1.1 101 Switching Protocols\r\n"
+               "Upgrade: websocket\r\n"
+               "Connection: Upgrade\r\n"
+               "Sec-WebSocket-Accept: ";
+    pending += acceptKey(key);
+    pending += "\r\n";
+    if (hasToken(protocols, "indi"))
+        pending += "Sec-WebSocket-Protocol: indi\r\n";
+    pending += "\r\n";
+
+    open = true;
+    return true;
+}
+
+size_t WebSocket::expectedHeaderSize() const
+{
+    if (headerSize < 2)
+        return 0;
+
+    size_t size = 2;
+    switch (header[1] & 0x7f)
+    {
+        case 126:
+            size += 2;
+            break;
+        case 127:
+            size += 8;
+            break;
+    }
+    if (header[1] & 0x80)
+        size += 4;
+    return size;
+}
+
+bool WebSocket::startFrame(std::string &failure)
+{
+    final = (header[0] & 0x80) != 0;
+    opcode = (Opcode)(header[0] & 0x0f);
+
+    if (header[0] & 0x70)
+    {
+        failure = "WebSocket frame with reserved bits\n";
+        return false;
+    }
+    /* client frames are always masked */
+    if (!(header[1] & 0x80))
+    {
+        failure = "unmasked WebSocket frame\n";
+        return false;
+    }
+
+    size_t pos = 2;
+    payloadLeft = header[1] & 0x7f;
+    if (payloadLeft == 126 || payloadLeft == 127)
+    {
+        int bytes = payloadLeft == 126 ? 2 : 8;
+        payloadLeft = 0;
+        for (int i = 0; i < bytes; ++i)
+            payloadLeft = (payloadLeft << 8) | header[pos++];
+        /* the most significant bit of a 64 bit length must be 0 */
+        if (payloadLeft >> 63)
+        {
+            failure = "oversized WebSocket frame\n";
+            return false;
+        }
+    }
+    memcpy(mask, header + pos, 4);
+    maskPos = 0;
+    headerSize = 0;
+
+    switch (opcode)
+    {
+        case Continuation:
+            if (!inText)
+            {
+                failure = "unexpected WebSocket continuation frame\n";
+                return false;
+            }
+            break;
+
+        case Text:
+            if (inText)
+            {
+                failure = "WebSocket text frame within a fragmented message\n";
+                return false;
+            }
+            inText = true;
+            break;
+
+        case Binary:
+            failure = "WebSocket binary frames are not supported from clients\n";
+            return false;
+
+        case Close:
+        case Ping:
+        case Pong:
+            if (!final || payloadLeft > maxControlSize)
+            {
+                failure = "invalid WebSocket control frame\n";
+                return false;
+            }
+            control.clear();
+            break;
+
+        default:
+            failure = "unknown WebSocket opcode\n";
+            return false;
+    }
+
+    inPayload = true;
+    return true;
+}
+
+void WebSocket::endFrame()
+{
+    inPayload = false;
+
+    switch (opcode)
+    {
+        case Continuation:
+        case Text:
+            if (final)
+                inText = false;
+            break;
+
+        case Ping:
+            sendControl(Pong, control);
+            break;
+
+        case Close:
+            /* echo the status code, then end the connection */
+            sendControl(Close, control.substr(0, 2));
+            closing = true;
+            break;
+
+        default:
+            break;
+    }
+}
+
+void WebSocket::sendControl(Opcode opcode, const std::string &payload)
+{
+    char frame[maxHeaderSize];
+    pending.append(frame, frameHeader(frame, opcode, payload.size()));
+    pending += payload;
+}
+
+bool WebSocket::receive(const char * data, size_t size, std::string &text, std::string &failure)
+{
+    /* nothing matters after a close */
+    if (closing)
+        return true;
+
+    if (!open)
+    {
+        size_t used;
+        if (!handshake(data, size, used, failure))
+            return false;
+        if (!open)
+            return true;
+        data += used;
+        size -= used;
+    }
+
+    while (size > 0 && !closing)
+    {
+        if (!inPayload)
+        {
+            header[headerSize++] = (unsigned char)*data++;
+            size--;
+
+            size_t expected = expectedHeaderSize();
+            if (expected == 0 || headerSize < expected)
+                continue;
+
+            if (!startFrame(failure))
+                return false;
+            if (payloadLeft == 0)
+                endFrame();
+            continue;
+        }
+
+        size_t count = (size_t)std::min<uint64_t>(size, payloadLeft);
+        std::string &target = (opcode == Text || opcode == Continuation) ? text : control;
+        size_t start = target.size();
+        target.resize(start + count);
+        for (size_t i = 0; i < count; ++i)
+            target[start + i] = (char)(data[i] ^ mask[maskPos++ & 3]);
+
+        data += count;
+        size -= count;
+        payloadLeft -= count;
+        if (payloadLeft == 0)
+            endFrame();
+    }
+    return true;
+}
@@ -0,0 +1,138 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Server side of the WebSocket protocol (RFC 6455) for one client connection.
+ *
+ * The client speaks INDI XML in text frames. What the server writes is framed
+ * by SerializedMsgWebSocket; this handles the opening handshake, the frames
+ * read from the client and the control frames written back.
+ *
+ * Browsers let any page open a WebSocket to any host, and tell the server
+ * which page did in the Origin header. A handshake with an Origin is refused
+ * unless that origin is allowed, so that a page the user visits cannot drive
+ * the devices. Clients that are not browsers send no Origin.
+ */
+class WebSocket
+{
+    public:
+        enum Opcode
+        {
+            Continuation = 0x0,
+            Text = 0x1,
+            Binary = 0x2,
+            Close = 0x8,
+            Ping = 0x9,
+            Pong = 0xa
+        };
+
+        /* allowedOrigins: scheme://host[:port] of the pages that may connect, "*" for any */
+        explicit WebSocket(const std::vector<std::string> &allowedOrigins = {});
+
+        /* Largest header of a server frame */
+        static constexpr size_t maxHeaderSize {10};
+
+        /* Sec-WebSocket-Accept value for the Sec-WebSocket-Key of a client */
+        static std::string acceptKey(const std::string &key);
+
+        /* Write the header of an unmasked final frame to header. return its size */
+        static size_t frameHeader(char * header, Opcode opcode, uint64_t length);
+
+        /* Consume bytes read from the client. The payload of text frames is appended to text.
+         * return false when the connection must be dropped, with the reason in failure
+         */
+        bool receive(const char * data, size_t size, std::string &text, std::string &failure);
+
+        /* The handshake completed: messages can be sent */
+        bool isOpen() const
+        {
+            return open;
+        }
+
+        /* The connection ends once the pending bytes are written */
+        bool isClosing() const
+        {
+            return closing;
+        }
+
+        /* Handshake response and control frames, to write between messages */
+        bool hasPending() const
+        {
+            return pendingPos < pending.size();
+        }
+
+        const char * pendingData() const
+        {
+            return pending.data() + pendingPos;
+        }
+
+        size_t pendingSize() const
+        {
+            return pending.size() - pendingPos;
+        }
+
+        /* The first size bytes of the pending output were written */
+        void consume(size_t size);
+
+    private:
+        static constexpr size_t maxRequestSize {8192};
+        static constexpr size_t maxControlSize {125};
+
+        std::vector<std::string> allowedOrigins;
+
+        bool open = false;
+        bool closing = false;
+
+        std::string pending;
+        size_t pendingPos = 0;
+
+        /* Handshake request, until complete */
+        std::string request;
+
+        /* Frame being read: header until complete, then payload */
+        bool inPayload = false;
+        unsigned char header[14];
+        size_t headerSize = 0;
+        uint64_t payloadLeft = 0;
+        unsigned char mask[4];
+        size_t maskPos = 0;
+        Opcode opcode = Continuation;
+        bool final = false;
+        std::string control;
+
+        /* A fragmented text message is being read */
+        bool inText = false;
+
+        bool handshake(const char * data, size_t size, size_t &used, std::string &failure);
+        void reject(const std::string &status);
+        bool isAllowedOrigin(const std::string &origin) const;
+
+        /* Size of the header in header[], 0 if more bytes are needed to know it */
+        size_t expectedHeaderSize() const;
+        bool startFrame(std::string &failure);
+        void endFrame();
+
+        void sendControl(Opcode opcode, const std::string &payload);
+};
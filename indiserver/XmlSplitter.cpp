@@ -0,0 +1,252 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "XmlSplitter.hpp"
+#include "CommandLineArgs.hpp"
+#include "Utils.hpp"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+XmlSplitter::XmlSplitter()
+{
+    domParser = newLilXML();
+    headParser = newLilXML();
+    setArenaLilXML(domParser, 1);
+    setArenaLilXML(headParser, 1);
+}
+
+XmlSplitter::~XmlSplitter()
+{
+    delLilXML(domParser);
+    delLilXML(headParser);
+}
+
+bool XmlSplitter::needsDom(const std::string &name)
+{
+    // Full messages are traced from -vvv
+    if (userConfigurableArguments->verbosity > 2)
+        return true;
+
+    return name.find("BLOB") != std::string::npos
+           || name == "getProperties"
+           || name == "pingRequest";
+}
+
+bool XmlSplitter::isCached(const std::string &name)
+{
+    return userConfigurableArguments->cacheProperties
+           && (name.compare(0, 3, "def") == 0 || name.compare(0, 3, "set") == 0);
+}
+
+bool XmlSplitter::feed(const char * buf, size_t len, std::list<ScannedXml> &out, std::string &err)
+{
+    // First byte of the current element not consumed yet
+    size_t start = 0;
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        char c = buf[i];
+        switch (state)
+        {
+            case State::Outside:
+                if (c == '<')
+                {
+                    state = State::Tag;
+                    tag.assign(1, c);
+                }
+                else if (!isspace(static_cast<unsigned char>(c)))
+                {
+                    // only whitespace may separate messages
+                    err = fmt("bogus char %c outside of elements", c);
+                    return false;
+                }
+                break;
+
+            case State::Text:
+                if (c == '<')
+                {
+                    state = State::Tag;
+                    tag.assign(1, c);
+                }
+                break;
+
+            case State::Quote:
+                tag += c;
+                if (c == quote)
+                    state = State::Tag;
+                break;
+
+            case State::Skip:
+                // like lilxml, comments and declarations end at the first '>'
+                if (c == '>')
+                    state = openTags.empty() ? State::Outside : State::Text;
+                break;
+
+            case State::Tag:
+                tag += c;
+                if (tag.size() == 2 && (c == '?' || c == '!'))
+                {
+                    state = State::Skip;
+                }
+                else if (c == '"' || c == '\'')
+                {
+                    quote = c;
+                    state = State::Quote;
+                }
+                else if (c == '>')
+                {
+                    bool isRoot = openTags.empty();
+                    if (!tagDone(err))
+                        return false;
+
+                    if (isRoot)
+                    {
+                        // The start of a new element
+                        if (!dom)
+                            rootTag = tag;
+                        if (!consume(tag.data(), tag.size(), out, err))
+                            return false;
+                        start = i + 1;
+                    }
+                    else if (openTags.empty())
+                    {
+                        if (!consume(buf + start, i + 1 - start, out, err))
+                            return false;
+                        start = i + 1;
+                    }
+
+                    if (openTags.empty() && !elementDone(out, err))
+                        return false;
+                }
+                break;
+        }
+    }
+
+    if (!openTags.empty() && start < len)
+        return consume(buf + start, len - start, out, err);
+
+    return true;
+}
+
+bool XmlSplitter::tagDone(std::string &err)
+{
+    bool closing = tag[1] == '/';
+    bool selfClosing = !closing && tag[tag.size() - 2] == '/';
+
+    size_t nameStart = closing ? 2 : 1;
+    size_t nameEnd = tag.find_first_of(" \t\r\n/>", nameStart);
+    std::string name = tag.substr(nameStart, nameEnd - nameStart);
+    if (name.empty())
+    {
+        err = fmt("bad tag %.32s", tag.c_str());
+        return false;
+    }
+
+    if (openTags.empty())
+    {
+        if (closing)
+        {
+            err = fmt("unexpected end tag %.32s", tag.c_str());
+            return false;
+        }
+        dom = needsDom(name);
+        keepRaw = !dom && isCached(name);
+        dom = dom || keepRaw;
+    }
+
+    if (closing)
+    {
+        if (name != openTags.back())
+        {
+            err = fmt("%.32s does not close %.32s", tag.c_str(), openTags.back().c_str());
+            return false;
+        }
+        openTags.pop_back();
+    }
+    else if (!selfClosing)
+    {
+        openTags.push_back(name);
+    }
+
+    state = openTags.empty() ? State::Outside : State::Text;
+    return true;
+}
+
+bool XmlSplitter::consume(const char * buf, size_t len, std::list<ScannedXml> &out, std::string &err)
+{
+    if (!dom || keepRaw)
+        raw.append(buf, len);
+    if (!dom)
+        return true;
+
+    char ynot[1024];
+    XMLEle **nodes = parseXMLChunk(domParser, const_cast<char*>(buf), len, ynot);
+    if (!nodes)
+    {
+        err = ynot;
+        return false;
+    }
+
+    for (int inode = 0; nodes[inode]; ++inode)
+        out.push_back(ScannedXml{nodes[inode], std::string()});
+
+    free(nodes);
+    return true;
+}
+
+bool XmlSplitter::elementDone(std::list<ScannedXml> &out, std::string &err)
+{
+    if (dom)
+    {
+        // parseXMLChunk already returned it
+        if (keepRaw && !out.empty())
+        {
+            raw += '\n';
+            out.back().raw = std::move(raw);
+        }
+        raw = std::string();
+        return true;
+    }
+
+    // Parse only the start tag, closed in place
+    if (rootTag[rootTag.size() - 2] != '/')
+        rootTag.insert(rootTag.size() - 1, 1, '/');
+
+    char ynot[1024];
+    XMLEle **nodes = parseXMLChunk(headParser, &rootTag[0], rootTag.size(), ynot);
+    if (!nodes)
+    {
+        err = ynot;
+        return false;
+    }
+
+    XMLEle *root = nodes[0];
+    free(nodes);
+    if (root == nullptr)
+    {
+        err = fmt("bad tag %.32s", rootTag.c_str());
+        return false;
+    }
+
+    raw += '\n';
+    out.push_back(ScannedXml{root, std::move(raw)});
+    raw = std::string();
+    return true;
+}
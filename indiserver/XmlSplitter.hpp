@@ -0,0 +1,82 @@
+/* INDI Server for protocol version 1.7.
+ * Copyright (C) 2007 Elwood C. Downey <ecdowney@clearskyinstitute.com>
+                 2013 Jasem Mutlaq <mutlaqja@ikarustech.com>
+                 2022 Ludovic Pollet
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "lilxml.h"
+
+#include <list>
+#include <string>
+#include <vector>
+
+/* One top level element read from a connection */
+struct ScannedXml
+{
+    XMLEle * root;      /* complete element, or only its tag and attributes when it was only scanned */
+    std::string raw;    /* original bytes of the element, forwarded verbatim. Empty if not kept */
+};
+
+/* Split the byte stream of a connection into top level elements.
+ *
+ * Most messages are only scanned: the attributes of their root are parsed for
+ * routing and their bytes are kept as they came. Messages that the server
+ * inspects or rewrites (BLOBs, getProperties, enableBLOB, pings) go through
+ * the complete lilxml parser, as does everything when tracing whole messages.
+ * With -k, def and set vectors are parsed for the property cache, and their
+ * bytes kept for forwarding as well: the parsing happens in the reading thread.
+ */
+class XmlSplitter
+{
+        enum class State { Outside, Text, Tag, Quote, Skip };
+
+        LilXML * domParser;     /* complete parsing of the current element */
+        LilXML * headParser;    /* parsing of scanned roots */
+
+        State state = State::Outside;
+        char quote = 0;
+        std::string tag;                    /* tag being read, from its '<' */
+        std::vector<std::string> openTags;  /* inside the current element */
+
+        bool dom = false;       /* current element goes to domParser */
+        bool keepRaw = false;   /* and to raw as well */
+        std::string rootTag;    /* start tag of the current scanned element */
+        std::string raw;        /* bytes of the current scanned element so far */
+
+        /* pass bytes of the current element to raw or domParser */
+        bool consume(const char * buf, size_t len, std::list<ScannedXml> &out, std::string &err);
+
+        /* a tag just ended. Return false on XML error */
+        bool tagDone(std::string &err);
+
+        bool elementDone(std::list<ScannedXml> &out, std::string &err);
+
+        /* return true if the whole element must be parsed */
+        static bool needsDom(const std::string &name);
+
+        /* return true if the element is parsed for the property cache */
+        static bool isCached(const std::string &name);
+
+    public:
+        XmlSplitter();
+        ~XmlSplitter();
+
+        /* Consume len bytes of input. Append complete elements to out.
+         * return false on XML error, with the reason in err
+         */
+        bool feed(const char * buf, size_t len, std::list<ScannedXml> &out, std::string &err);
+};
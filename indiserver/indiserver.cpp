@@ -53,8 +53,16 @@
 #include "DvrInfo.hpp"
 #include "LocalDrvInfo.hpp"
 #include "RemoteDvrInfo.hpp"
+#include "LinkDecoder.hpp"
 #include "TcpServer.hpp"
+#include "WebSocketServer.hpp"
 #include "UnixServer.hpp"
+#include "ReadShard.hpp"
+#include "Uring.hpp"
+#include "ConversionPool.hpp"
+#include "Metrics.hpp"
+#include "Allocations.hpp"
+#include "Capture.hpp"
 #include "Utils.hpp"
 #include "Constants.hpp"
 #include "CommandLineArgs.hpp"
@@ -106,7 +114,14 @@ void usage(void)
     fprintf(stderr, "Purpose: server for local and remote INDI drivers\n");
     fprintf(stderr, "INDI Library: %s\nCode %s. Protocol %g.\n", CMAKE_INDI_VERSION_STRING, GIT_TAG_STRING, INDIV);
     fprintf(stderr, "Options:\n");
+    fprintf(stderr, " -B b     : with -C, keep the first b bytes of each blob, or a hash of it if b is 'hash'\n");
+    fprintf(stderr, " -C path  : capture the traffic to path, for indi_replay\n");
+    fprintf(stderr, " -c       : only keep the latest queued set message of each property for slow clients\n");
+    fprintf(stderr, " -i n     : log a summary of the server activity every n seconds\n");
+    fprintf(stderr, " -k       : answer getProperties of clients at once from the last properties sent by drivers\n");
     fprintf(stderr, " -l d     : log driver messages to <d>/YYYY-MM-DD.islog\n");
+    fprintf(stderr, " -L e     : encoding asked to chained servers: frames, deflate or xml, default frames\n");
+    fprintf(stderr, " -M e     : publish metrics in Prometheus format on e, a local port or a unix socket path\n");
     fprintf(stderr, " -m m     : kill client if gets more than this many MB behind, default %d\n", defaultMaxQueueSizeMB);
     fprintf(stderr,
             " -d m     : drop streaming blobs if client gets more than this many MB behind, default %d. 0 to disable\n",
@@ -116,7 +131,15 @@ void usage(void)
 #endif
     fprintf(stderr, " -p p     : alternate IP port, default %d\n", indiPortDefault);
     fprintf(stderr, " -r r     : maximum driver restarts on error, default %d\n", defaultMaximumRestarts);
+    fprintf(stderr, " -s       : only keep the latest pending frame of streaming blobs for each client\n");
     fprintf(stderr, " -f path  : Path to fifo for dynamic startup and shutdown of drivers.\n");
+    fprintf(stderr, " -t n     : read and parse connections using n threads, default 1\n");
+    fprintf(stderr, " -U       : read and write connections of the main loop through io_uring (Linux)\n");
+    fprintf(stderr, " -w n     : convert blobs using n threads, default one per core\n");
+    fprintf(stderr, " -W [h:]p : also accept WebSocket clients on port p of address h, default 127.0.0.1\n");
+    fprintf(stderr, "            use 0.0.0.0 for all interfaces\n");
+    fprintf(stderr, " -O o     : accept WebSocket clients from web pages of origin o, such as http://host:8080,\n");
+    fprintf(stderr, "            or * for any. Repeat for several. Pages of other origins are refused\n");
     fprintf(stderr, " -v       : show key events, no traffic\n");
     fprintf(stderr, " -vv      : -v + key message content\n");
     fprintf(stderr, " -vvv     : -vv + complete xml\n");
@@ -127,6 +150,9 @@ void usage(void)
 
 int main(int ac, char *av[])
 {
+    /* count allocations, before any use of lilxml */
+    Allocations::setup();
+
     /* log startup */
     logStartup(ac, av);
 
@@ -173,6 +199,45 @@ int main(int ac, char *av[])
         for (s = av[0] + 1; *s != '\0'; s++)
             switch (*s)
             {
+                case 'B':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-B requires blob byte count or hash\n");
+                        usage();
+                    }
+                    userConfigurableArguments->captureBlobs = *++av;
+                    ac--;
+                    break;
+                case 'C':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-C requires capture path\n");
+                        usage();
+                    }
+                    userConfigurableArguments->capturePath = *++av;
+                    ac--;
+                    break;
+                case 'i':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-i requires summary period\n");
+                        usage();
+                    }
+                    userConfigurableArguments->metricsSummaryPeriod = atoi(*++av);
+                    ac--;
+                    break;
+                case 'k':
+                    userConfigurableArguments->cacheProperties = true;
+                    break;
+                case 'M':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-M requires metrics port or path\n");
+                        usage();
+                    }
+                    userConfigurableArguments->metricsEndpoint = *++av;
+                    ac--;
+                    break;
                 case 'l':
                     if (ac < 2)
                     {
@@ -182,6 +247,18 @@ int main(int ac, char *av[])
                     userConfigurableArguments->loggingDir = *++av;
                     ac--;
                     break;
+                case 'L':
+                {
+                    LinkDecoder::Encoding encoding;
+                    if (ac < 2 || !LinkDecoder::parse(av[1], encoding))
+                    {
+                        fprintf(stderr, "-L requires frames, deflate or xml\n");
+                        usage();
+                    }
+                    userConfigurableArguments->linkEncoding = *++av;
+                    ac--;
+                    break;
+                }
                 case 'm':
                     if (ac < 2)
                     {
@@ -242,6 +319,64 @@ int main(int ac, char *av[])
                         userConfigurableArguments->maxRestartAttempts = 0;
                     ac--;
                     break;
+                case 't':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-t requires number of threads\n");
+                        usage();
+                    }
+                    userConfigurableArguments->ioThreads = atoi(*++av);
+                    if (userConfigurableArguments->ioThreads < 1)
+                        userConfigurableArguments->ioThreads = 1;
+                    ac--;
+                    break;
+                case 'U':
+                    userConfigurableArguments->ioUring = true;
+                    break;
+                case 'c':
+                    userConfigurableArguments->coalesceUpdates = true;
+                    break;
+                case 's':
+                    userConfigurableArguments->latestFrameOnly = true;
+                    break;
+                case 'w':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-w requires number of threads\n");
+                        usage();
+                    }
+                    userConfigurableArguments->conversionThreads = atoi(*++av);
+                    if (userConfigurableArguments->conversionThreads < 0)
+                        userConfigurableArguments->conversionThreads = 0;
+                    ac--;
+                    break;
+                case 'W':
+                {
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-W requires WebSocket port value\n");
+                        usage();
+                    }
+                    std::string endpoint = *++av;
+                    size_t colon = endpoint.rfind(':');
+                    if (colon != std::string::npos)
+                    {
+                        userConfigurableArguments->webSocketHost = endpoint.substr(0, colon);
+                        endpoint = endpoint.substr(colon + 1);
+                    }
+                    userConfigurableArguments->webSocketPort = atoi(endpoint.c_str());
+                    ac--;
+                    break;
+                }
+                case 'O':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-O requires an origin\n");
+                        usage();
+                    }
+                    userConfigurableArguments->webSocketOrigins.push_back(*++av);
+                    ac--;
+                    break;
                 case 'v':
                     userConfigurableArguments->verbosity++;
                     break;
@@ -258,6 +393,13 @@ int main(int ac, char *av[])
     /* take care of some unixisms */
     noSIGPIPE();
 
+    /* spread connections reading over the requested threads */
+    ReadShard::setup(userConfigurableArguments->ioThreads);
+    Uring::setup(userConfigurableArguments->ioUring);
+    ConversionPool::setup(userConfigurableArguments->conversionThreads);
+    Metrics::setup(userConfigurableArguments->metricsEndpoint, userConfigurableArguments->metricsSummaryPeriod);
+    Capture::setup(userConfigurableArguments->capturePath, userConfigurableArguments->captureBlobs);
+
     std::vector<std::unique_ptr<DvrInfo>> drivers(ac);
 
     /* start each driver */
@@ -280,6 +422,14 @@ int main(int ac, char *av[])
     const auto tcpServer = std::make_unique<TcpServer>(userConfigurableArguments->port);
     tcpServer->listen();
 
+    std::unique_ptr<WebSocketServer> webSocketServer;
+    if (userConfigurableArguments->webSocketPort)
+    {
+        webSocketServer = std::make_unique<WebSocketServer>(userConfigurableArguments->webSocketPort,
+                          userConfigurableArguments->webSocketHost);
+        webSocketServer->listen();
+    }
+
 #ifdef ENABLE_INDI_SHARED_MEMORY
     /* create a new unix server */
     const auto unixServer = std::make_unique<UnixServer>(UnixServer::unixSocketPath);
@@ -381,7 +381,7 @@ void ConnectionMock::send(const std::string &str, const SharedBuffer ** buffers)
     memset(cmsgh, 0, cmsghdrlength);
 
     /* Write the fd as ancillary data */
-    cmsgh->cmsg_len = CMSG_LEN(sizeof(int));
+    cmsgh->cmsg_len = CMSG_LEN(fdCount * sizeof(int));
     cmsgh->cmsg_level = SOL_SOCKET;
     cmsgh->cmsg_type = SCM_RIGHTS;
     msgh.msg_control = cmsgh;
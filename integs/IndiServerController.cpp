@@ -17,6 +17,8 @@
 *******************************************************************************/
 
 #include <system_error>
+#include <sstream>
+#include <cstdlib>
 #include <sys/wait.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -48,7 +50,19 @@ void IndiServerController::setFifo(bool fifo) {
 }
 
 void IndiServerController::start(const std::vector<std::string> & args) {
-    ProcessController::start("../indiserver/indiserver", args);
+    // Options set by ctest for the variants of a suite (see CMakeLists.txt)
+    std::vector<std::string> fullArgs;
+    const char * extraArgs = getenv("INDISERVER_TEST_ARGS");
+    if (extraArgs) {
+        std::istringstream words(extraArgs);
+        std::string word;
+        while (words >> word) {
+            fullArgs.push_back(word);
+        }
+    }
+    fullArgs.insert(fullArgs.end(), args.begin(), args.end());
+
+    ProcessController::start("../indiserver/indiserver", fullArgs);
 }
 
 void IndiServerController::startDriver(const std::string & path) {
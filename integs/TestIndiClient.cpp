@@ -100,3 +100,33 @@ TEST(IndiclientTcpConnect, ClientConnect)
     indiServerCnx.cnx.send("<pingRequest uid='123456'/>");
     indiServerCnx.cnx.expectXml("<pingReply uid='123456'/>");
 }
+
+TEST(IndiclientTcpConnect, CompressionFallbackWithoutAck)
+{
+    ServerMock fakeServer;
+    IndiClientMock indiServerCnx;
+
+    setupSigPipe();
+
+    fakeServer.listen(TEST_TCP_PORT);
+
+    MyClient * client = new MyClient("machin", "truc");
+    client->setServer("127.0.0.1", TEST_TCP_PORT);
+    client->setCompression(true);
+
+    std::thread t1([&fakeServer, &indiServerCnx]()
+    {
+        fakeServer.accept(indiServerCnx);
+        indiServerCnx.cnx.expectXml("<enableCompression format='deflate'/>");
+        indiServerCnx.cnx.expectXml("<getProperties version='1.7'/>");
+    });
+    bool connected = client->connectServer();
+    ASSERT_EQ(connected, true);
+
+    t1.join();
+
+    // Another message comes first: the client keeps parsing XML
+    indiServerCnx.cnx.send("<message message='not an ack'/>\n");
+    indiServerCnx.cnx.send("<pingRequest uid='123456'/>");
+    indiServerCnx.cnx.expectXml("<pingReply uid='123456'/>");
+}
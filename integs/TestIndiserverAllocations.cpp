@@ -0,0 +1,178 @@
+/*******************************************************************************
+  Copyright(c) 2022 Ludovic Pollet. All rights reserved.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <system_error>
+
+#include "gtest/gtest.h"
+
+#include "utils.h"
+
+#include "DriverMock.h"
+#include "IndiServerController.h"
+#include "IndiClientMock.h"
+
+// Messages routed before counting, to fill the pools
+#define WARMUP_COUNT 100
+#define MEASURE_COUNT 1000
+
+static const std::string numberUpdate =
+    "<setNumberVector device='fakedev1' name='testnumber' state='Ok'>\n"
+    "<oneNumber name='content'>51</oneNumber>\n"
+    "</setNumberVector>\n";
+
+// A port nobody listens on, for the metrics endpoint: parallel runs must not collide
+static int freeTcpPort()
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "socket");
+    }
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t len = sizeof(addr);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || getsockname(fd, (struct sockaddr *)&addr, &len) < 0)
+    {
+        auto e = errno;
+        close(fd);
+        throw std::system_error(e, std::generic_category(), "bind");
+    }
+    close(fd);
+    return ntohs(addr.sin_port);
+}
+
+// Value of indiserver_allocations_total, from the metrics endpoint. -1 if not counted
+static long readAllocations(int metricsPort)
+{
+    int fd = tcpSocketConnect("127.0.0.1", metricsPort);
+
+    std::string request = "GET /metrics HTTP/1.0\r\n\r\n";
+    if (write(fd, request.data(), request.size()) != (ssize_t)request.size())
+    {
+        auto e = errno;
+        close(fd);
+        throw std::system_error(e, std::generic_category(), "write metrics request");
+    }
+
+    std::string response;
+    char buffer[4096];
+    ssize_t rd;
+    while ((rd = read(fd, buffer, sizeof(buffer))) > 0)
+    {
+        response.append(buffer, rd);
+    }
+    close(fd);
+
+    std::string name = "\nindiserver_allocations_total ";
+    auto pos = response.find(name);
+    if (pos == std::string::npos)
+    {
+        return -1;
+    }
+    return strtol(response.c_str() + pos + name.size(), nullptr, 10);
+}
+
+static void routeUpdates(DriverMock &fakeDriver, IndiClientMock &indiClient, int count)
+{
+    for(int i = 0; i < count; ++i)
+    {
+        fakeDriver.cnx.send(numberUpdate);
+        indiClient.cnx.expectXml("<setNumberVector device='fakedev1' name='testnumber' state='Ok'>");
+        indiClient.cnx.expectXml("<oneNumber name='content'>");
+        indiClient.cnx.expect("51");
+        indiClient.cnx.expectXml("</oneNumber>");
+        indiClient.cnx.expectXml("</setNumberVector>");
+    }
+}
+
+TEST(IndiserverAllocations, AllocationsPerMessage)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    setupSigPipe();
+
+    fakeDriver.setup();
+
+    int metricsPort = freeTcpPort();
+
+    // Not verbose: logging would be counted as well
+    std::vector<std::string> args = { "-p", std::to_string(indiServer.getTcpPort()), "-r", "0",
+                                      "-M", std::to_string(metricsPort)
+                                    };
+#ifdef ENABLE_INDI_SHARED_MEMORY
+    args.push_back("-u");
+    args.push_back(indiServer.getUnixSocketPath());
+#endif
+    args.push_back(getTestExePath("fakedriver"));
+    indiServer.start(args);
+    fprintf(stderr, "indiserver started\n");
+
+    fakeDriver.waitEstablish();
+    fakeDriver.cnx.expectXml("<getProperties version='1.7'/>");
+
+    IndiClientMock indiClient;
+    indiClient.connect(indiServer);
+
+    indiClient.cnx.send("<getProperties version='1.7'/>\n");
+    fakeDriver.cnx.expectXml("<getProperties version='1.7'/>");
+
+    fakeDriver.cnx.send("<defNumberVector device='fakedev1' name='testnumber' label='test label' group='test_group' state='Idle' perm='ro' timeout='100' timestamp='2018-01-01T00:00:00'>\n");
+    fakeDriver.cnx.send("<defNumber name='content' label='content' min='0' max='100' step='1'>50</defNumber>\n");
+    fakeDriver.cnx.send("</defNumberVector>\n");
+
+    indiClient.cnx.expectXml("<defNumberVector device='fakedev1' name='testnumber' label='test label' group='test_group' state='Idle' perm='ro' timeout='100' timestamp='2018-01-01T00:00:00'>");
+    indiClient.cnx.expectXml("<defNumber name='content' label='content' min='0' max='100' step='1'>");
+    indiClient.cnx.expect("50");
+    indiClient.cnx.expectXml("</defNumber>");
+    indiClient.cnx.expectXml("</defNumberVector>");
+
+    routeUpdates(fakeDriver, indiClient, WARMUP_COUNT);
+    long before = readAllocations(metricsPort);
+    if (before == -1)
+    {
+        fakeDriver.terminateDriver();
+        indiServer.waitProcessEnd(1);
+        GTEST_SKIP() << "indiserver built without INDISERVER_COUNT_ALLOCATIONS";
+    }
+
+    routeUpdates(fakeDriver, indiClient, MEASURE_COUNT);
+    long after = readAllocations(metricsPort);
+
+    // The metrics request itself allocates a little: negligible over the run
+    double perMessage = (double)(after - before) / MEASURE_COUNT;
+    fprintf(stderr, "%.1f allocations per routed message\n", perMessage);
+
+    // 21 with the pools, 26 without: catches a regression to per-message containers and buffers
+    EXPECT_LT(perMessage, 23);
+
+    fakeDriver.terminateDriver();
+
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
@@ -0,0 +1,134 @@
+/*******************************************************************************
+  Copyright(c) 2022 Ludovic Pollet. All rights reserved.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "gtest/gtest.h"
+
+#include "utils.h"
+
+#include "DriverMock.h"
+#include "IndiServerController.h"
+#include "IndiClientMock.h"
+
+#define COMPRESSION_REQUEST "<enableCompression format='deflate'/>\n"
+#define FRAMING_REQUEST "<enableBinaryFraming version='1'/>\n"
+
+static void startFakeDev(IndiServerController &indiServer, DriverMock &fakeDriver)
+{
+    setupSigPipe();
+
+    fakeDriver.setup();
+
+    indiServer.startDriver(getTestExePath("fakedriver"));
+    fprintf(stderr, "indiserver started\n");
+
+    fakeDriver.waitEstablish();
+    fakeDriver.cnx.expectXml("<getProperties version='1.7'/>");
+}
+
+TEST(IndiserverEncoding, CompressionAcknowledgedFirst)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    startFakeDev(indiServer, fakeDriver);
+
+    IndiClientMock indiClient;
+    indiClient.connectTcp(indiServer);
+
+    // The acknowledgement is the request itself, before anything else
+    indiClient.cnx.send(COMPRESSION_REQUEST);
+    indiClient.cnx.expect(COMPRESSION_REQUEST);
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
+TEST(IndiserverEncoding, CompressionRefusedAfterTraffic)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    startFakeDev(indiServer, fakeDriver);
+
+    IndiClientMock indiClient;
+    indiClient.connectTcp(indiServer);
+
+    // Replies and broadcasts reach the client before its request
+    indiClient.cnx.send("<pingRequest uid='0'/>\n");
+    indiClient.cnx.expectXml("<pingReply uid='0'/>");
+    fakeDriver.cnx.send("<message message='hello'/>\n");
+    indiClient.cnx.expectXml("<message message='hello'/>");
+
+    // The client already saw other bytes than an acknowledgement: keep XML
+    indiClient.cnx.send(COMPRESSION_REQUEST);
+    indiClient.cnx.send("<pingRequest uid='1'/>\n");
+    indiClient.cnx.expectXml("<pingReply uid='1'/>");
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
+TEST(IndiserverEncoding, FramingAcknowledgedFirst)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    startFakeDev(indiServer, fakeDriver);
+
+    IndiClientMock indiClient;
+    indiClient.connectTcp(indiServer);
+
+    indiClient.cnx.send(FRAMING_REQUEST);
+    indiClient.cnx.expect(FRAMING_REQUEST);
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
+TEST(IndiserverEncoding, FramingRefusedAfterTraffic)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    startFakeDev(indiServer, fakeDriver);
+
+    IndiClientMock indiClient;
+    indiClient.connectTcp(indiServer);
+
+    indiClient.cnx.send("<pingRequest uid='0'/>\n");
+    indiClient.cnx.expectXml("<pingReply uid='0'/>");
+    fakeDriver.cnx.send("<message message='hello'/>\n");
+    indiClient.cnx.expectXml("<message message='hello'/>");
+
+    // Frames would be mistaken for XML by a client that missed the acknowledgement
+    indiClient.cnx.send(FRAMING_REQUEST);
+    indiClient.cnx.send("<pingRequest uid='1'/>\n");
+    indiClient.cnx.expectXml("<pingReply uid='1'/>");
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
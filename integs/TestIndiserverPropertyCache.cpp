@@ -0,0 +1,154 @@
+/*******************************************************************************
+  Copyright(c) 2022 Ludovic Pollet. All rights reserved.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "gtest/gtest.h"
+
+#include "utils.h"
+
+#include "DriverMock.h"
+#include "IndiServerController.h"
+#include "IndiClientMock.h"
+
+// Start indiserver with -k, and get the driver ready
+static void startCachingServer(IndiServerController &indiServer, DriverMock &fakeDriver)
+{
+    setupSigPipe();
+
+    fakeDriver.setup();
+
+    std::vector<std::string> args = { "-p", std::to_string(indiServer.getTcpPort()), "-r", "0", "-k" };
+#ifdef ENABLE_INDI_SHARED_MEMORY
+    args.push_back("-u");
+    args.push_back(indiServer.getUnixSocketPath());
+#endif
+    args.push_back(getTestExePath("fakedriver"));
+    indiServer.start(args);
+    fprintf(stderr, "indiserver started\n");
+
+    fakeDriver.waitEstablish();
+    fakeDriver.cnx.expectXml("<getProperties version='1.7'/>");
+
+    fakeDriver.cnx.send("<defNumberVector device='fakedev1' name='coords' label='coords' group='main' state='Idle' perm='rw' timeout='100' timestamp='2018-01-01T00:00:00' message='starting'>\n");
+    fakeDriver.cnx.send("<defNumber name='ra' label='ra' format='%g' min='0' max='24' step='0'>1</defNumber>\n");
+    fakeDriver.cnx.send("<defNumber name='dec' label='dec' format='%g' min='-90' max='90' step='0'>2</defNumber>\n");
+    fakeDriver.cnx.send("</defNumberVector>\n");
+}
+
+// A client asking for the properties gets the cache content, and the driver is not woken
+static void connectLateClient(IndiServerController &indiServer, DriverMock &fakeDriver, IndiClientMock &indiClient,
+                              const std::string &state, const std::string &ra, const std::string &dec)
+{
+    // all driver messages are in the cache after the reply
+    fakeDriver.ping();
+
+    indiClient.connect(indiServer);
+    indiClient.cnx.send("<getProperties version='1.7'/>\n");
+
+    // state merged, message and timestamp gone
+    indiClient.cnx.expectXml("<defNumberVector device='fakedev1' name='coords' label='coords' group='main' state='" + state + "' perm='rw' timeout='100'>");
+    indiClient.cnx.expectXml("<defNumber name='ra' label='ra' format='%g' min='0' max='24' step='0'>");
+    indiClient.cnx.expect("\n" + ra);
+    indiClient.cnx.expectXml("</defNumber>");
+    indiClient.cnx.expectXml("<defNumber name='dec' label='dec' format='%g' min='-90' max='90' step='0'>");
+    indiClient.cnx.expect("\n" + dec);
+    indiClient.cnx.expectXml("</defNumber>");
+    indiClient.cnx.expectXml("</defNumberVector>");
+
+    // the driver got nothing before the ping
+    fakeDriver.ping();
+}
+
+TEST(IndiserverPropertyCache, ReplayToLateClient)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    startCachingServer(indiServer, fakeDriver);
+
+    fakeDriver.cnx.send("<setNumberVector device='fakedev1' name='coords' state='Busy' timestamp='2018-01-01T00:00:01' message='slewing'>\n");
+    fakeDriver.cnx.send("<oneNumber name='ra'>3</oneNumber>\n");
+    fakeDriver.cnx.send("<oneNumber name='dec'>4</oneNumber>\n");
+    fakeDriver.cnx.send("</setNumberVector>\n");
+
+    IndiClientMock indiClient;
+    connectLateClient(indiServer, fakeDriver, indiClient, "Busy", "3", "4");
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
+TEST(IndiserverPropertyCache, PartialUpdates)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    startCachingServer(indiServer, fakeDriver);
+
+    // each update carries only one element
+    fakeDriver.cnx.send("<setNumberVector device='fakedev1' name='coords' state='Busy'>\n");
+    fakeDriver.cnx.send("<oneNumber name='ra'>5</oneNumber>\n");
+    fakeDriver.cnx.send("</setNumberVector>\n");
+    fakeDriver.cnx.send("<setNumberVector device='fakedev1' name='coords' message='almost there'>\n");
+    fakeDriver.cnx.send("<oneNumber name='dec'>6</oneNumber>\n");
+    fakeDriver.cnx.send("</setNumberVector>\n");
+
+    IndiClientMock firstClient;
+    connectLateClient(indiServer, fakeDriver, firstClient, "Busy", "5", "6");
+
+    // new state only
+    fakeDriver.cnx.send("<setNumberVector device='fakedev1' name='coords' state='Ok'/>\n");
+    firstClient.cnx.expectXml("<setNumberVector device='fakedev1' name='coords' state='Ok'/>");
+
+    IndiClientMock secondClient;
+    connectLateClient(indiServer, fakeDriver, secondClient, "Ok", "5", "6");
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
+TEST(IndiserverPropertyCache, UnknownPropertiesAskTheDriver)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    startCachingServer(indiServer, fakeDriver);
+    fakeDriver.ping();
+
+    IndiClientMock indiClient;
+    indiClient.connect(indiServer);
+
+    // known device and property: from the cache only
+    indiClient.cnx.send("<getProperties version='1.7' device='fakedev1' name='coords'/>\n");
+    indiClient.cnx.expectXml("<defNumberVector device='fakedev1' name='coords' label='coords' group='main' state='Idle' perm='rw' timeout='100'>");
+    fakeDriver.ping();
+
+    // a property the cache does not know is asked to the driver, which answers
+    indiClient.cnx.send("<getProperties version='1.7' device='fakedev1' name='focus'/>\n");
+    fakeDriver.cnx.expectXml("<getProperties version='1.7' device='fakedev1' name='focus'/>");
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
@@ -419,27 +419,33 @@ TEST(IndiserverSingleDriver, ForwardBase64BlobToUnixClient)
     indiServer.waitProcessEnd(1);
 }
 
-void driverSendAttachedBlob(DriverMock &fakeDriver, ssize_t size)
+// Fill fd with at least size bytes, cycling from first through the period next chars
+static void fillAttachment(SharedBuffer &fd, ssize_t size, char first = '0', int period = 10)
 {
-    fprintf(stderr, "Driver send new blob value as attachment\n");
-
     // Allocate more memory than asked (simulate kernel BSD kernel rounding up)
     ssize_t physical_size=0x10000;
     if (physical_size < size) {
         physical_size = size;
     }
 
-    // The attachment must be done before EOF
-    SharedBuffer fd;
     fd.allocate(physical_size);
 
     char * buffer = (char*)malloc(physical_size);
     for(auto i = 0; i < physical_size; ++i)
     {
-        buffer[i] = {(char)('0' + (i % 10))};
+        buffer[i] = {(char)(first + (i % period))};
     }
     fd.write(buffer, 0, physical_size);
     free(buffer);
+}
+
+void driverSendAttachedBlob(DriverMock &fakeDriver, ssize_t size)
+{
+    fprintf(stderr, "Driver send new blob value as attachment\n");
+
+    // The attachment must be done before EOF
+    SharedBuffer fd;
+    fillAttachment(fd, size);
 
     fakeDriver.cnx.send("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>\n");
     fakeDriver.cnx.send("<oneBLOB name='content' size='" + std::to_string(size) + "' format='.fits' attached='true'/>\n", fd);
@@ -459,6 +465,27 @@ void driverSendAttachedBlob(DriverMock &fakeDriver, ssize_t size)
     fakeDriver.ping();
 }
 
+// One message carrying two attachments: digits for 'content', letters for 'second'
+void driverSendTwoAttachedBlobs(DriverMock &fakeDriver)
+{
+    fprintf(stderr, "Driver send two blob values as attachments\n");
+
+    SharedBuffer digits, letters;
+    fillAttachment(digits, 32);
+    fillAttachment(letters, 16, 'a', 26);
+
+    const SharedBuffer * buffers[] = { &digits, &letters, nullptr };
+    fakeDriver.cnx.send("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>\n"
+                        "<oneBLOB name='content' size='32' format='.fits' attached='true'/>\n"
+                        "<oneBLOB name='second' size='16' format='.fits' attached='true'/>\n", buffers);
+    fakeDriver.cnx.send("</setBLOBVector>");
+
+    digits.release();
+    letters.release();
+
+    fakeDriver.ping();
+}
+
 TEST(IndiserverSingleDriver, ForwardAttachedBlobToUnixClient)
 {
     // This tests attached blob pass through
@@ -540,6 +567,80 @@ TEST(IndiserverSingleDriver, ForwardAttachedBlobToIPClient)
     indiServer.waitProcessEnd(1);
 }
 
+TEST(IndiserverSingleDriver, ForwardTwoAttachedBlobsToUnixClient)
+{
+    // This tests that every attachment of a driver message is ingested and passed through
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    startFakeDev1(indiServer, fakeDriver);
+
+    IndiClientMock indiClient;
+
+    indiClient.connectUnix(indiServer);
+
+    connectFakeDev1Client(indiServer, fakeDriver, indiClient);
+
+    fprintf(stderr, "Client ask blobs\n");
+    indiClient.cnx.send("<enableBLOB device='fakedev1' name='testblob'>Also</enableBLOB>\n");
+    indiClient.ping();
+
+    driverSendTwoAttachedBlobs(fakeDriver);
+
+    fprintf(stderr, "Client receive blobs\n");
+    indiClient.cnx.allowBufferReceive(true);
+    indiClient.cnx.expectXml("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>");
+    indiClient.cnx.expectXml("<oneBLOB name='content' size='32' format='.fits' attached='true'/>");
+    indiClient.cnx.expectXml("<oneBLOB name='second' size='16' format='.fits' attached='true'/>");
+    indiClient.cnx.expectXml("</setBLOBVector>");
+
+    SharedBuffer first, second;
+    indiClient.cnx.expectBuffer(first);
+    indiClient.cnx.expectBuffer(second);
+    indiClient.cnx.allowBufferReceive(false);
+
+    EXPECT_GE( first.getSize(), 32);
+    EXPECT_GE( second.getSize(), 16);
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
+TEST(IndiserverSingleDriver, ForwardTwoAttachedBlobsToIPClient)
+{
+    // This tests base64 encoding by server of each attachment, in order
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    startFakeDev1(indiServer, fakeDriver);
+
+    IndiClientMock indiClient;
+
+    indiClient.connectTcp(indiServer);
+
+    connectFakeDev1Client(indiServer, fakeDriver, indiClient);
+
+    fprintf(stderr, "Client ask blobs\n");
+    indiClient.cnx.send("<enableBLOB device='fakedev1' name='testblob'>Also</enableBLOB>\n");
+    indiClient.ping();
+
+    driverSendTwoAttachedBlobs(fakeDriver);
+
+    fprintf(stderr, "Client receive blobs\n");
+    indiClient.cnx.expectXml("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>");
+    indiClient.cnx.expectXml("<oneBLOB name='content' size='32' format='.fits'>");
+    indiClient.cnx.expect("\nMDEyMzQ1Njc4OTAxMjM0NTY3ODkwMTIzNDU2Nzg5MDE=");
+    indiClient.cnx.expectXml("</oneBLOB>");
+    indiClient.cnx.expectXml("<oneBLOB name='second' size='16' format='.fits'>");
+    indiClient.cnx.expect("\nYWJjZGVmZ2hpamtsbW5vcA==");
+    indiClient.cnx.expectXml("</oneBLOB>");
+    indiClient.cnx.expectXml("</setBLOBVector>");
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
 
 TEST(IndiserverSingleDriver, ForwardAttachedBlobToDriver)
 {
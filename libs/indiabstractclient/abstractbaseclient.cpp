@@ -28,6 +28,15 @@
 #include "indiuserio.h"
 #include "locale_compat.h"
 #include "indistandardproperty.h"
+#include "indibinaryframe.h"
+#include "base64.h"
+
+#ifdef ENABLE_INDI_SHARED_MEMORY
+# include "sharedblob.h"
+# include "sharedblob_parse.h"
+#endif
+
+#include <cstring>
 
 #if defined(_MSC_VER)
 #define snprintf _snprintf
@@ -69,36 +78,38 @@ void AbstractBaseClientPrivate::clear()
 
 int AbstractBaseClientPrivate::dispatchCommand(const LilXmlElement &root, char *errmsg)
 {
+    const XMLAtom tag = root.tagAtom();
+
     // Ignore echoed newXXX
-    if (root.tagName().find("new") == 0)
+    if (XMLATOM_IS_NEW(tag))
     {
         return 0;
     }
 
-    if (root.tagName() == "pingRequest")
+    if (tag == XMLATOM_pingRequest)
     {
         parent->sendPingReply(root.getAttribute("uid"));
         return 0;
     }
 
-    if (root.tagName() == "pingReply")
+    if (tag == XMLATOM_pingReply)
     {
         parent->newPingReply(root.getAttribute("uid").toString());
         return 0;
     }
 
-    if (root.tagName() == "message")
+    if (tag == XMLATOM_message)
     {
         return messageCmd(root, errmsg);
     }
 
-    if (root.tagName() == "delProperty")
+    if (tag == XMLATOM_delProperty)
     {
         return delPropertyCmd(root, errmsg);
     }
 
     // Just ignore any getProperties we might get
-    if (root.tagName() == "getProperties")
+    if (tag == XMLATOM_getProperties)
     {
         return INDI_PROPERTY_DUPLICATED;
     }
@@ -106,9 +117,9 @@ int AbstractBaseClientPrivate::dispatchCommand(const LilXmlElement &root, char *
     // If device is set to BLOB_ONLY, we ignore everything else
     // not related to blobs
     if (
-        parent->getBLOBMode(root.getAttribute("device")) == B_ONLY &&
-        root.tagName() != "defBLOBVector" &&
-        root.tagName() != "setBLOBVector"
+        parent->getBLOBMode(root.getAttribute(XMLATOM_device)) == B_ONLY &&
+        tag != XMLATOM_defBLOBVector &&
+        tag != XMLATOM_setBLOBVector
     )
     {
         return 0;
@@ -122,6 +133,55 @@ int AbstractBaseClientPrivate::dispatchCommand(const LilXmlElement &root, char *
     });
 }
 
+namespace
+{
+
+/* BLOB content of a frame, as the client reads it */
+class ClientBlobSink: public INDI::BinaryFrame::BlobSink
+{
+    public:
+        explicit ClientBlobSink(std::vector<std::string> &blobIds): blobIds(blobIds)
+        { }
+
+        bool store(XMLEle *ep, const unsigned char *data, size_t len) override
+        {
+            if (len == 0)
+                return true;
+
+#ifdef ENABLE_INDI_SHARED_MEMORY
+            // Hand the content over as an attached buffer: no base64 on the way
+            void *blob = IDSharedBlobAlloc(len);
+            if (blob == nullptr)
+                return false;
+            memcpy(blob, data, len);
+            int fd = IDSharedBlobGetFd(blob);
+            IDSharedBlobDettach(blob);
+
+            auto id = INDI::allocateBlobUid(fd);
+            blobIds.push_back(id);
+            addXMLAtt(ep, "attached-data-id", id.c_str());
+#else
+            std::vector<unsigned char> encoded(4 * len / 3 + 4);
+            int encodedLen = to64frombits_s(encoded.data(), data, len, encoded.size());
+            encoded.resize(encodedLen);
+            encoded.push_back(0);
+            editXMLEle(ep, reinterpret_cast<const char *>(encoded.data()));
+#endif
+            return true;
+        }
+
+    private:
+        std::vector<std::string> &blobIds;
+};
+
+}
+
+LilXmlDocument AbstractBaseClientPrivate::decodeFrame(const char *frame, size_t size, std::vector<std::string> &blobIds)
+{
+    ClientBlobSink blobs(blobIds);
+    return LilXmlDocument(INDI::BinaryFrame::decode(frame, size, blobs));
+}
+
 int AbstractBaseClientPrivate::deleteDevice(const char *devName, char *errmsg)
 {
     if (auto device = watchDevice.getDeviceByName(devName))
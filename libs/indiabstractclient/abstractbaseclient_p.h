@@ -30,6 +30,7 @@
 #include <string>
 #include <map>
 #include <set>
+#include <vector>
 
 namespace INDI
 {
@@ -67,6 +68,12 @@ class AbstractBaseClientPrivate
         /**  Process messages */
         int messageCmd(const INDI::LilXmlElement &root, char *errmsg);
 
+        /** @brief Rebuild the set*Vector carried by a binary frame (see indibinaryframe.h), without its size.
+         *  BLOB contents become shared buffers, whose ids are appended to blobIds.
+         *  @return an invalid document if the frame is malformed.
+         */
+        static LilXmlDocument decodeFrame(const char *frame, size_t size, std::vector<std::string> &blobIds);
+
     public:
         void userIoGetProperties();
 
@@ -2377,6 +2377,19 @@ bool CCD::ExposureCompletePrivate(CCDChip * targetChip)
     if (targetChip->getFrameBufferSize() == 0)
         sendImage = saveImage = false;
 
+    // Do not prepare an image indiserver said no client would receive.
+    // Without a report, the image is sent as usual.
+    if (sendImage)
+    {
+        bool skip = !IDHasBLOBDemand(getDeviceName(), targetChip->FitsBP.getName());
+        if (skip && !m_UploadSkipped)
+            LOG_INFO("No client accepts images, uploads skipped. Clients must enable BLOBs before the exposure ends.");
+        else if (!skip && m_UploadSkipped)
+            LOG_INFO("A client accepts images, uploads resumed.");
+        m_UploadSkipped = skip;
+        sendImage = !skip;
+    }
+
     if (sendImage || saveImage)
     {
         if (EncodeFormatSP[FORMAT_FITS].getState() == ISS_ON)
@@ -2712,7 +2725,7 @@ bool CCD::uploadFile(CCDChip * targetChip, const void * fitsData, size_t totalBy
         FileNameTP.apply();
     }
 
-    if (targetChip->SendCompressed && EncodeFormatSP[FORMAT_XISF].getState() != ISS_ON)
+    if (sendImage && targetChip->SendCompressed && EncodeFormatSP[FORMAT_XISF].getState() != ISS_ON)
     {
         if (EncodeFormatSP[FORMAT_FITS].getState() == ISS_ON && !strcmp(targetChip->getImageExtension(), "fits"))
         {
@@ -754,6 +754,8 @@ class CCD : public DefaultDevice, GuiderInterface
         std::string m_ConfigCaptureFormatName;
         int m_ConfigEncodeFormatIndex {-1};
         int m_ConfigFastExposureIndex {INDI_DISABLED};
+        // Whether the last image was not uploaded for lack of BLOB demand, to log changes only
+        bool m_UploadSkipped {false};
 
         std::map<std::string, FITSRecord> m_CustomFITSKeywords;
 
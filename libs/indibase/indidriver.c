@@ -72,6 +72,7 @@ typedef struct {
     IPerm perm;
     const void *ptr;
     int type;
+    int demand; /* 0 if indiserver reported nobody receives this BLOB */
 } ROSC;
 
 static pthread_mutex_t rosc_mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -79,6 +80,8 @@ static pthread_mutex_t rosc_mutex = PTHREAD_MUTEX_INITIALIZER;
 static ROSC *propCache = NULL;
 static int nPropCache = 0; /* # of elements in roCheck */
 
+static int blobDemandRequested = 0; /* sent getBLOBDemand to indiserver */
+
 static ROSC *rosc_new()
 {
     assert_mem(propCache = (ROSC *)(realloc(propCache, (nPropCache + 1) * sizeof *propCache)));
@@ -93,6 +96,7 @@ static void rosc_add(const char *propName, const char *devName, IPerm perm, cons
     SC->perm = perm;
     SC->ptr  = ptr;
     SC->type = type;
+    SC->demand = 1;
 }
 
 /* Return pointer of property if already cached, NULL otherwise */
@@ -172,6 +176,21 @@ void IDSnoopBLOBs(const char *snooped_device, const char *snooped_property, BLOB
     }
 }
 
+/* return 0 if indiserver explicitly reported that nobody receives BLOBs of dev/name, else 1.
+ */
+int IDHasBLOBDemand(const char *dev, const char *name)
+{
+    int demand = 1;
+
+    pthread_mutex_lock(&rosc_mutex);
+    ROSC *prop = rosc_find(name, dev);
+    if (prop)
+        demand = prop->demand;
+    pthread_mutex_unlock(&rosc_mutex);
+
+    return demand;
+}
+
 /* crack the given INDI XML element and call driver's IS* entry points as they
  *   are recognized.
  * return 0 if ok else -1 with reason in msg[].
@@ -180,19 +199,20 @@ void IDSnoopBLOBs(const char *snooped_device, const char *snooped_property, BLOB
 int dispatch(XMLEle *root, char msg[])
 {
     char *rtag = tagXMLEle(root);
+    XMLAtom ratom = tagAtomXMLEle(root);
     XMLEle *ep;
     int n;
 
     if (verbose)
         prXMLEle(stderr, root, 0);
 
-    if (!strcmp(rtag, "getProperties"))
+    if (ratom == XMLATOM_getProperties)
     {
         XMLAtt *ap, *name, *dev;
         double v;
 
         /* check version */
-        ap = findXMLAtt(root, "version");
+        ap = findXMLAttAtom(root, XMLATOM_version);
         if (!ap)
         {
             fprintf(stderr, "%s: getProperties missing version\n", me);
@@ -206,10 +226,10 @@ int dispatch(XMLEle *root, char msg[])
         }
 
         // Get device
-        dev = findXMLAtt(root, "device");
+        dev = findXMLAttAtom(root, XMLATOM_device);
 
         // Get property name
-        name = findXMLAtt(root, "name");
+        name = findXMLAttAtom(root, XMLATOM_name);
 
         if (name && dev)
         {
@@ -252,14 +272,28 @@ int dispatch(XMLEle *root, char msg[])
         return (0);
     }
 
+    /* indiserver tells whether anyone receives the BLOBs of a property */
+    if (ratom == XMLATOM_blobDemand)
+    {
+        XMLAtt *dev  = findXMLAttAtom(root, XMLATOM_device);
+        XMLAtt *name = findXMLAttAtom(root, XMLATOM_name);
+
+        if (dev && name)
+        {
+            pthread_mutex_lock(&rosc_mutex);
+            ROSC *prop = rosc_find(valuXMLAtt(name), valuXMLAtt(dev));
+            if (prop)
+                prop->demand = strcmp(pcdataXMLEle(root), "Off") != 0;
+            pthread_mutex_unlock(&rosc_mutex);
+        }
+        return 0;
+    }
+
     /* other commands might be from a snooped device.
          * we don't know here which devices are being snooped so we send
          * all remaining valid messages
          */
-    if (!strcmp(rtag, "setNumberVector") || !strcmp(rtag, "setTextVector") || !strcmp(rtag, "setLightVector") ||
-            !strcmp(rtag, "setSwitchVector") || !strcmp(rtag, "setBLOBVector") || !strcmp(rtag, "defNumberVector") ||
-            !strcmp(rtag, "defTextVector") || !strcmp(rtag, "defLightVector") || !strcmp(rtag, "defSwitchVector") ||
-            !strcmp(rtag, "defBLOBVector") || !strcmp(rtag, "message") || !strcmp(rtag, "delProperty"))
+    if (XMLATOM_IS_SET(ratom) || XMLATOM_IS_DEF(ratom) || ratom == XMLATOM_message || ratom == XMLATOM_delProperty)
     {
         ISSnoopDevice(root);
         return (0);
@@ -296,7 +330,7 @@ int dispatch(XMLEle *root, char msg[])
 
     /* check tag in surmised decreasing order of likelihood */
 
-    if (!strcmp(rtag, "newNumberVector"))
+    if (ratom == XMLATOM_newNumberVector)
     {
         static double *doubles = NULL;
         static char **names = NULL;
@@ -308,9 +342,9 @@ int dispatch(XMLEle *root, char msg[])
         /* pull out each name/value pair */
         for (n = 0, ep = nextXMLEle(root, 1); ep; ep = nextXMLEle(root, 0))
         {
-            if (strcmp(tagXMLEle(ep), "oneNumber") == 0)
+            if (tagAtomXMLEle(ep) == XMLATOM_oneNumber)
             {
-                XMLAtt *na = findXMLAtt(ep, "name");
+                XMLAtt *na = findXMLAttAtom(ep, XMLATOM_name);
                 if (na)
                 {
                     if (n >= maxn)
@@ -339,7 +373,7 @@ int dispatch(XMLEle *root, char msg[])
         return (0);
     }
 
-    if (!strcmp(rtag, "newSwitchVector"))
+    if (ratom == XMLATOM_newSwitchVector)
     {
         static ISState *states = NULL;
         static char **names = NULL;
@@ -349,9 +383,9 @@ int dispatch(XMLEle *root, char msg[])
         /* pull out each name/state pair */
         for (n = 0, ep = nextXMLEle(root, 1); ep; ep = nextXMLEle(root, 0))
         {
-            if (strcmp(tagXMLEle(ep), "oneSwitch") == 0)
+            if (tagAtomXMLEle(ep) == XMLATOM_oneSwitch)
             {
-                XMLAtt *na = findXMLAtt(ep, "name");
+                XMLAtt *na = findXMLAttAtom(ep, XMLATOM_name);
                 if (na)
                 {
                     if (n >= maxn)
@@ -386,7 +420,7 @@ int dispatch(XMLEle *root, char msg[])
         return (0);
     }
 
-    if (!strcmp(rtag, "newTextVector"))
+    if (ratom == XMLATOM_newTextVector)
     {
         static char **texts = NULL;
         static char **names = NULL;
@@ -395,9 +429,9 @@ int dispatch(XMLEle *root, char msg[])
         /* pull out each name/text pair */
         for (n = 0, ep = nextXMLEle(root, 1); ep; ep = nextXMLEle(root, 0))
         {
-            if (strcmp(tagXMLEle(ep), "oneText") == 0)
+            if (tagAtomXMLEle(ep) == XMLATOM_oneText)
             {
-                XMLAtt *na = findXMLAtt(ep, "name");
+                XMLAtt *na = findXMLAttAtom(ep, XMLATOM_name);
                 if (na)
                 {
                     if (n >= maxn)
@@ -421,7 +455,7 @@ int dispatch(XMLEle *root, char msg[])
         return (0);
     }
 
-    if (!strcmp(rtag, "newBLOBVector"))
+    if (ratom == XMLATOM_newBLOBVector)
     {
         static char **blobs = NULL;
         static char **names = NULL;
@@ -434,12 +468,12 @@ int dispatch(XMLEle *root, char msg[])
         /* pull out each name/BLOB pair, decode */
         for (n = 0, ep = nextXMLEle(root, 1); ep; ep = nextXMLEle(root, 0))
         {
-            if (strcmp(tagXMLEle(ep), "oneBLOB") == 0)
+            if (tagAtomXMLEle(ep) == XMLATOM_oneBLOB)
             {
-                XMLAtt *na = findXMLAtt(ep, "name");
-                XMLAtt *fa = findXMLAtt(ep, "format");
-                XMLAtt *sa = findXMLAtt(ep, "size");
-                XMLAtt *el = findXMLAtt(ep, "enclen");
+                XMLAtt *na = findXMLAttAtom(ep, XMLATOM_name);
+                XMLAtt *fa = findXMLAttAtom(ep, XMLATOM_format);
+                XMLAtt *sa = findXMLAttAtom(ep, XMLATOM_size);
+                XMLAtt *el = findXMLAttAtom(ep, XMLATOM_enclen);
                 if (na && fa && sa)
                 {
                     if (n >= maxn)
@@ -1182,6 +1216,17 @@ void IDDefBLOBVA(const IBLOBVectorProperty *bvp, const char *fmt, va_list ap)
     driverio_init(&io);
 
     userio_xmlv1(&io.userio, io.user);
+
+    /* ask indiserver to report when nobody receives our BLOBs. Only servers
+     * that announced it in our environment know the request: older ones
+     * would broadcast it to their clients.
+     */
+    if (!blobDemandRequested && getenv("INDIBLOBDEMAND") != NULL)
+    {
+        blobDemandRequested = 1;
+        IUUserIOGetBLOBDemand(&io.userio, io.user);
+    }
+
     IUUserIODefBLOBVA(&io.userio, io.user, bvp, fmt, ap);
 
     driverio_finish(&io);
@@ -167,7 +167,7 @@ static void driverio_flush(driverio * dio, const void * additional, size_t add_s
             temporaryBuffers = (void**)malloc(sizeof(void*)*fdCount);
 
             /* Write the fd as ancillary data */
-            cmsgh->cmsg_len = CMSG_LEN(sizeof(int));
+            cmsgh->cmsg_len = CMSG_LEN(fdCount * sizeof(int));
             cmsgh->cmsg_level = SOL_SOCKET;
             cmsgh->cmsg_type = SCM_RIGHTS;
             msgh.msg_control = cmsgh;
@@ -265,6 +265,7 @@ static void driverio_flush(driverio * dio, const void * additional, size_t add_s
     {
         free(dio->outBuff);
     }
+    dio->outBuff = NULL;
     dio->outPos = 0;
 
 }
@@ -71,8 +71,9 @@ static int messageHandling = PROCEED_IMMEDIATE;
  */
 static void clientMsgCB(int fd, void *arg)
 {
-    char buf[MAXRBUF], msg[MAXRBUF], *bp;
-    int nr;
+    char buf[MAXRBUF], msg[MAXRBUF];
+    XMLEle **nodes;
+    int nr, i;
 
     (void) arg;
 
@@ -97,22 +98,21 @@ static void clientMsgCB(int fd, void *arg)
     }
 
     /* crack and dispatch when complete */
-    for (bp = buf; nr-- > 0; bp++)
+    nodes = parseXMLChunk(clixml, buf, nr, msg);
+    for (i = 0; nodes[i]; i++)
     {
-        XMLEle *root = readXMLEle(clixml, *bp, msg);
-        if (root)
+        XMLEle *root = nodes[i];
+        if (strcmp(tagXMLEle(root), "pingReply") == 0)
         {
-            if (strcmp(tagXMLEle(root), "pingReply") == 0)
-            {
-                handlePingReply(root);
-                delXMLEle(root);
-                continue;
-            }
-            deferMessage(root);
+            handlePingReply(root);
+            delXMLEle(root);
+            continue;
         }
-        else if (msg[0])
-            fprintf(stderr, "%s XML error: %s\n", me, msg);
+        deferMessage(root);
     }
+    free(nodes);
+    if (msg[0])
+        fprintf(stderr, "%s XML error: %s\n", me, msg);
 }
 
 typedef struct DeferredMessage
@@ -340,6 +340,7 @@ int main(int ac, char *av[])
 
     /* init */
     clixml = newLilXML();
+    setArenaLilXML(clixml, 1);
     addCallback(0, clientMsgCB, clixml);
 
     /* service client */
@@ -493,7 +493,8 @@ void StreamManagerPrivate::asyncStreamThread()
         // For streaming, downscale to 8bit if higher than 8bit to reduce bandwidth
         // unless Full Depth mode is enabled.
         // You can reduce the number of frames by setting a frame limit.
-        if (isStreaming && FPSPreview.newFrame())
+        // Skip preview frames entirely when no client receives them.
+        if (isStreaming && IDHasBLOBDemand(imageBP.getDeviceName(), imageBP.getName()) && FPSPreview.newFrame())
         {
             // Downscale to 8bit for streaming to reduce bandwidth, unless full depth is enabled
             if (PixelFormat != INDI_JPG && PixelDepth > 8 && FullDepthSP[FULL_DEPTH_16BIT].getState() != ISS_ON)
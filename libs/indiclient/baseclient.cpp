@@ -22,6 +22,9 @@
 #include "baseclient.h"
 #include "baseclient_p.h"
 
+#include "indicompression.h"
+#include "indibinaryframe.h"
+
 #define MAXINDIBUF 49152
 #define DISCONNECTION_DELAY_US 500000
 #define MAXFD_PER_MESSAGE 16 /* No more than 16 buffer attached to a message */
@@ -221,62 +224,266 @@ BaseClientPrivate::BaseClientPrivate(BaseClient *parent)
 {
     clientSocket.onData([this](const char *data, size_t size)
     {
-        char msg[MAXRBUF];
-        auto documents = xmlParser.parseChunk(data, size);
+        receiveData(data, size);
+    });
 
-        if (documents.size() == 0)
-        {
-            if (xmlParser.hasErrorMessage())
-            {
-                IDLog("Bad XML from %s/%d: %s\n%.*s\n", cServer.c_str(), cPort, xmlParser.errorMessage(), int(size), data);
-            }
+    clientSocket.onErrorOccurred([this] (TcpSocket::SocketError)
+    {
+        if (sConnected == false)
             return;
+
+        this->parent->serverDisconnected(-1);
+        clear();
+        watchDevice.unwatchDevices();
+    });
+}
+
+BaseClientPrivate::~BaseClientPrivate()
+{
+    resetStream();
+}
+
+void BaseClientPrivate::receiveData(const char *data, size_t size)
+{
+    /* The acknowledgement, if any, comes first */
+    if (streamState == AwaitingAck)
+    {
+        size_t ackSize = strlen(pendingAck);
+        while (size > 0 && ackMatched < ackSize && *data == pendingAck[ackMatched])
+        {
+            ++data;
+            --size;
+            ++ackMatched;
         }
 
-        for (const auto &doc : documents)
+        if (ackMatched == ackSize)
         {
-            LilXmlElement root = doc.root();
+            streamState = ackedState;
+        }
+        else if (size > 0)
+        {
+            /* the server kept XML: give back what looked like an answer */
+            streamState = Plain;
+            parseData(pendingAck, ackMatched);
+        }
+    }
 
-            if (verbose)
-                root.print(stderr, 0);
+    if (size == 0)
+        return;
 
-#ifdef ENABLE_INDI_SHARED_MEMORY
-            ClientSharedBlobs::Blobs blobs;
+    switch (streamState)
+    {
+        case Inflating:
+            if (!inflateData(data, size))
+            {
+                IDLog("Bad compressed data from %s/%d: %s\n", cServer.c_str(), cPort, inflater.msg ? inflater.msg : "");
+                clientSocket.disconnectFromHost();
+            }
+            break;
 
-            if (!clientSocket.sharedBlobs.parseAttachedBlobs(root, blobs))
+        case Framing:
+            if (!frameData(data, size))
             {
-                IDLog("Missing attachment from %s/%d\n", cServer.c_str(), cPort);
-                return;
+                IDLog("Bad binary frame from %s/%d\n", cServer.c_str(), cPort);
+                clientSocket.disconnectFromHost();
             }
-#endif
+            break;
 
-            int err_code = dispatchCommand(root, msg);
+        default:
+            parseData(data, size);
+            break;
+    }
+}
 
-            if (err_code < 0)
+bool BaseClientPrivate::frameData(const char *data, size_t size)
+{
+    while (size > 0)
+    {
+        /* complete frames are dispatched from the incoming data, without copy */
+        if (frame.empty() && size >= 4)
+        {
+            uint32_t length = 0;
+            for (int i = 0; i < 4; ++i)
+                length |= uint32_t(static_cast<unsigned char>(data[i])) << (8 * i);
+
+            if (size - 4 >= length)
             {
-                // Silently ignore property duplication errors
-                if (err_code != INDI_PROPERTY_DUPLICATED)
-                {
-                    IDLog("Dispatch command error(%d): %s\n", err_code, msg);
-                    root.print(stderr, 0);
-                }
+                if (!dispatchFrame(data + 4, length))
+                    return false;
+                data += 4 + length;
+                size -= 4 + length;
+                continue;
             }
         }
-    });
 
-    clientSocket.onErrorOccurred([this] (TcpSocket::SocketError)
+        /* keep the start of the frame until the rest comes */
+        size_t needed = 4;
+        if (frame.size() >= 4)
+        {
+            uint32_t length = 0;
+            for (int i = 0; i < 4; ++i)
+                length |= uint32_t(static_cast<unsigned char>(frame[i])) << (8 * i);
+            needed = 4 + size_t(length);
+        }
+
+        size_t take = std::min(size, needed - frame.size());
+        frame.insert(frame.end(), data, data + take);
+        data += take;
+        size -= take;
+
+        if (frame.size() == needed && needed > 4)
+        {
+            bool ok = dispatchFrame(frame.data() + 4, frame.size() - 4);
+            frame.clear();
+            if (!ok)
+                return false;
+        }
+    }
+    return true;
+}
+
+bool BaseClientPrivate::dispatchFrame(const char *data, size_t size)
+{
+    if (size == 0)
+        return false;
+
+    if (data[0] == INDI_FRAME_XML)
     {
-        if (sConnected == false)
+        parseData(data + 1, size - 1);
+        return true;
+    }
+
+#ifdef ENABLE_INDI_SHARED_MEMORY
+    ClientSharedBlobs::Blobs blobs;
+#else
+    std::vector<std::string> blobs;
+#endif
+    LilXmlDocument document = decodeFrame(data, size, blobs);
+    if (!document.isValid())
+        return false;
+
+    LilXmlElement root = document.root();
+
+    if (verbose)
+        root.print(stderr, 0);
+
+#ifdef ENABLE_INDI_SHARED_MEMORY
+    // Content decoded from the frame may be handed over as is
+    if (clientSocket.sharedBlobs.isDirectBlobAccess(root.getAttribute("device").toString(), root.getAttribute("name").toString()))
+    {
+        for (auto &blobContent : root.getElementsByTagName("oneBLOB"))
+        {
+            if (blobContent.getAttribute("attached-data-id"))
+                blobContent.addAttribute("attachment-direct", "true");
+        }
+    }
+#endif
+    dispatchElement(root);
+    return true;
+}
+
+bool BaseClientPrivate::inflateData(const char *data, size_t size)
+{
+    char buffer[65536];
+
+    if (!inflaterReady)
+    {
+        memset(&inflater, 0, sizeof(inflater));
+        if (inflateInit(&inflater) != Z_OK)
+            return false;
+        inflaterReady = true;
+    }
+
+    inflater.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    inflater.avail_in = size;
+
+    do
+    {
+        inflater.next_out = reinterpret_cast<Bytef *>(buffer);
+        inflater.avail_out = sizeof(buffer);
+
+        int ret = inflate(&inflater, Z_SYNC_FLUSH);
+        if (ret == Z_NEED_DICT)
+        {
+            if (inflateSetDictionary(&inflater, reinterpret_cast<const Bytef *>(indiCompressionDictionary),
+                                     sizeof(indiCompressionDictionary) - 1) != Z_OK)
+                return false;
+            continue;
+        }
+        if (ret != Z_OK && ret != Z_BUF_ERROR && ret != Z_STREAM_END)
+            return false;
+
+        size_t produced = sizeof(buffer) - inflater.avail_out;
+        if (produced > 0)
+            parseData(buffer, produced);
+        else if (ret == Z_BUF_ERROR || ret == Z_STREAM_END)
+            break;
+    }
+    while (inflater.avail_in > 0 || inflater.avail_out == 0);
+
+    return true;
+}
+
+void BaseClientPrivate::resetStream()
+{
+    if (inflaterReady)
+        inflateEnd(&inflater);
+    inflaterReady = false;
+    streamState = Plain;
+    pendingAck = nullptr;
+    ackMatched = 0;
+    frame.clear();
+}
+
+void BaseClientPrivate::parseData(const char *data, size_t size)
+{
+    auto documents = xmlParser.parseChunk(data, size);
+
+    if (documents.size() == 0)
+    {
+        if (xmlParser.hasErrorMessage())
+        {
+            IDLog("Bad XML from %s/%d: %s\n%.*s\n", cServer.c_str(), cPort, xmlParser.errorMessage(), int(size), data);
+        }
+        return;
+    }
+
+    for (const auto &doc : documents)
+    {
+        LilXmlElement root = doc.root();
+
+        if (verbose)
+            root.print(stderr, 0);
+
+#ifdef ENABLE_INDI_SHARED_MEMORY
+        ClientSharedBlobs::Blobs blobs;
+
+        if (!clientSocket.sharedBlobs.parseAttachedBlobs(root, blobs))
+        {
+            IDLog("Missing attachment from %s/%d\n", cServer.c_str(), cPort);
             return;
+        }
+#endif
 
-        this->parent->serverDisconnected(-1);
-        clear();
-        watchDevice.unwatchDevices();
-    });
+        dispatchElement(root);
+    }
 }
 
-BaseClientPrivate::~BaseClientPrivate()
-{ }
+void BaseClientPrivate::dispatchElement(const LilXmlElement &root)
+{
+    char msg[MAXRBUF];
+    int err_code = dispatchCommand(root, msg);
+
+    if (err_code < 0)
+    {
+        // Silently ignore property duplication errors
+        if (err_code != INDI_PROPERTY_DUPLICATED)
+        {
+            IDLog("Dispatch command error(%d): %s\n", err_code, msg);
+            root.print(stderr, 0);
+        }
+    }
+}
 
 ssize_t BaseClientPrivate::sendData(const void *data, size_t size)
 {
@@ -330,11 +537,29 @@ bool BaseClient::connectServer()
     }
 
     d->clear();
+    d->resetStream();
 
     d->sConnected = true;
 
     serverConnected();
 
+    /* must be the first request, so that the answer comes before anything else */
+    if (d->framingRequested)
+    {
+        d->pendingAck = INDI_BINARY_FRAMING_REQUEST;
+        d->ackedState = BaseClientPrivate::Framing;
+    }
+    else if (d->compressionRequested)
+    {
+        d->pendingAck = INDI_COMPRESSION_REQUEST;
+        d->ackedState = BaseClientPrivate::Inflating;
+    }
+    if (d->pendingAck)
+    {
+        d->streamState = BaseClientPrivate::AwaitingAck;
+        d->sendData(d->pendingAck, strlen(d->pendingAck));
+    }
+
     d->userIoGetProperties();
 
     return true;
@@ -357,6 +582,18 @@ bool BaseClient::disconnectServer(int exit_code)
     return ret;
 }
 
+void BaseClient::setCompression(bool enabled)
+{
+    D_PTR(BaseClient);
+    d->compressionRequested = enabled;
+}
+
+void BaseClient::setBinaryFraming(bool enabled)
+{
+    D_PTR(BaseClient);
+    d->framingRequested = enabled;
+}
+
 void BaseClient::enableDirectBlobAccess(const char * dev, const char * prop)
 {
 #ifdef ENABLE_INDI_SHARED_MEMORY
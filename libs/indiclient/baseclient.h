@@ -81,4 +81,20 @@ class INDI::BaseClient : public INDI::AbstractBaseClient
          *  @param prop property name, can be NULL to activate for all property of dev
          */
         void enableDirectBlobAccess(const char * dev = nullptr, const char * prop = nullptr);
+
+        /** @brief Ask the server to compress what it sends, from the next connection on.
+         * Traffic is deflated with zlib, which mostly pays off on slow links and for
+         * numerous small messages. A server that does not support it, or a local
+         * connection, simply stays uncompressed.
+         *  @param enabled true to request compression.
+         */
+        void setCompression(bool enabled);
+
+        /** @brief Ask the server for binary frames instead of XML, from the next connection on.
+         * Property updates then come with raw values, and BLOBs without base64 encoding.
+         * Meant for local and LAN clients; it takes precedence over compression.
+         * A server that does not support it simply keeps sending XML.
+         *  @param enabled true to request binary framing.
+         */
+        void setBinaryFraming(bool enabled);
 };
@@ -4,6 +4,7 @@
 #include "indililxml.h"
 
 #include <tcpsocket.h>
+#include <zlib.h>
 
 namespace INDI
 {
@@ -61,12 +62,35 @@ class BaseClientPrivate : public AbstractBaseClientPrivate
     public:
         ssize_t sendData(const void *data, size_t size) override;
 
+        /* bytes from the server: uncompressed if needed, then parsed */
+        void receiveData(const char *data, size_t size);
+        void parseData(const char *data, size_t size);
+
+        /* forget the encoding of the previous connection */
+        void resetStream();
+        bool inflateData(const char *data, size_t size);
+        bool frameData(const char *data, size_t size);
+        bool dispatchFrame(const char *frame, size_t size);
+        void dispatchElement(const INDI::LilXmlElement &root);
+
 #ifdef ENABLE_INDI_SHARED_MEMORY
         TcpSocketSharedBlobs clientSocket;
 #else
         TcpSocket clientSocket;
 #endif
         LilXmlParser xmlParser;
+
+        enum StreamState { Plain, AwaitingAck, Inflating, Framing };
+
+        bool compressionRequested {false};
+        bool framingRequested {false};
+        StreamState streamState {Plain};
+        StreamState ackedState {Plain};     /* state once the request is acknowledged */
+        const char *pendingAck {nullptr};   /* the request, which the server answers with */
+        size_t ackMatched {0};              /* bytes of the acknowledgement received so far */
+        z_stream inflater;
+        bool inflaterReady {false};
+        std::vector<char> frame;            /* incomplete binary frame */
 };
 
 }
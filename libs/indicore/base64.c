@@ -36,8 +36,10 @@
 
 #include <ctype.h>
 #include <stdint.h>
+#include <string.h>
 #include "base64.h"
 #include "base64_luts.h"
+#include "base64_variant.h"
 #include <stdio.h>
 
 /* 
@@ -56,6 +58,404 @@
 
 #define  IS_LITTLE_ENDIAN  (!IS_BIG_ENDIAN)
 
+/* SIMD code paths. x86 ones are compiled for their instruction set whatever the
+ * build flags, and only used when the CPU has it. NEON is part of ARM64.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BASE64_X86
+#include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__)
+#define BASE64_NEON_PATH
+#include <arm_neon.h>
+#endif
+
+/* Bulk conversions of a code path. They handle whole blocks only and return the
+ * count of input bytes (characters when decoding) they consumed: the tables do
+ * the rest. Decoding stops before any group of 4 characters with a line break,
+ * padding or anything else than a base64 digit.
+ */
+struct base64_code
+{
+    enum base64_variant variant;
+    size_t (*encode)(unsigned char *out, const unsigned char *in, size_t inlen);
+    size_t (*decode)(unsigned char *out, const char *in, size_t inlen);
+};
+
+/* a byte of x is < n (n <= 128) */
+#define HAS_LESS(x, n) (((x) - 0x01010101u * (n)) & ~(x) & 0x80808080u)
+/* a byte of x is 0 */
+#define HAS_ZERO(x)    HAS_LESS(x, 1)
+
+/* decode 4 digits (padding reads as 'A') to 3 bytes */
+static inline void decode_group(unsigned char *out, const unsigned char *in)
+{
+    uint16_t s1  = rbase64lut[in[0] | in[1] << 8];
+    uint16_t s2  = rbase64lut[in[2] | in[3] << 8];
+    uint32_t n32 = (uint32_t)s1 << 10 | s2 >> 2;
+
+    out[0] = n32 >> 16;
+    out[1] = n32 >> 8;
+    out[2] = n32;
+}
+
+static size_t encode_scalar(unsigned char *out, const unsigned char *in, size_t inlen)
+{
+    (void)out;
+    (void)in;
+    (void)inlen;
+    return 0;
+}
+
+static size_t decode_scalar(unsigned char *out, const char *in, size_t inlen)
+{
+    size_t done = 0;
+
+    for (; inlen - done >= 4; done += 4)
+    {
+        uint32_t chars;
+        memcpy(&chars, in + done, 4);
+        /* line breaks and other blanks are below '+', the lowest digit */
+        if (HAS_LESS(chars, '+') || HAS_ZERO(chars ^ 0x3d3d3d3du))
+            break;
+        decode_group(out, (const unsigned char *)in + done);
+        out += 3;
+    }
+    return done;
+}
+
+#ifdef BASE64_X86
+
+/* Vector algorithms by Wojciech Muła and Daniel Lemire,
+ * "Faster Base64 Encoding and Decoding using AVX2 Instructions" (2018)
+ */
+
+/* 12 bytes per 128 bits lane to 16 indices of 6 bits */
+__attribute__((target("sse4.1")))
+static inline __m128i encode_reshuffle_sse41(__m128i in)
+{
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t1, t3);
+}
+
+/* indices to digits: offset of each range, picked by pshufb */
+__attribute__((target("sse4.1")))
+static inline __m128i encode_translate_sse41(__m128i in)
+{
+    const __m128i lut = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+    __m128i indices = _mm_subs_epu8(in, _mm_set1_epi8(51));
+    __m128i mask = _mm_cmpgt_epi8(in, _mm_set1_epi8(25));
+    indices = _mm_sub_epi8(indices, mask);
+    return _mm_add_epi8(in, _mm_shuffle_epi8(lut, indices));
+}
+
+__attribute__((target("sse4.1")))
+static size_t encode_sse41(unsigned char *out, const unsigned char *in, size_t inlen)
+{
+    size_t done = 0;
+
+    /* 12 bytes to 16 digits, loading 16 */
+    for (; inlen - done >= 16; done += 12)
+    {
+        __m128i str = _mm_loadu_si128((const __m128i *)(in + done));
+        str = encode_translate_sse41(encode_reshuffle_sse41(str));
+        _mm_storeu_si128((__m128i *)out, str);
+        out += 16;
+    }
+    return done;
+}
+
+/* digits to 6 bits values. 0 if one is not a digit */
+__attribute__((target("sse4.1")))
+static inline int decode_translate_sse41(__m128i *str)
+{
+    const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                         0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                         0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_2f = _mm_set1_epi8(0x2f);
+
+    __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(*str, 4), mask_2f);
+    __m128i lo_nibbles = _mm_and_si128(*str, mask_2f);
+    __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+    __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+    if (!_mm_testz_si128(lo, hi))
+        return 0;
+
+    __m128i eq_2f = _mm_cmpeq_epi8(*str, mask_2f);
+    __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+    *str = _mm_add_epi8(*str, roll);
+    return 1;
+}
+
+/* 16 values of 6 bits to 12 bytes, at the start of each 128 bits lane */
+__attribute__((target("sse4.1")))
+static inline __m128i decode_reshuffle_sse41(__m128i in)
+{
+    __m128i merge_ab_and_bc = _mm_maddubs_epi16(in, _mm_set1_epi32(0x01400140));
+    __m128i out = _mm_madd_epi16(merge_ab_and_bc, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(out, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+__attribute__((target("sse4.1")))
+static size_t decode_sse41(unsigned char *out, const char *in, size_t inlen)
+{
+    size_t done = 0;
+
+    /* 16 digits to 12 bytes. The output is exactly the size of what was decoded */
+    for (; inlen - done >= 16; done += 16)
+    {
+        __m128i str = _mm_loadu_si128((const __m128i *)(in + done));
+        if (!decode_translate_sse41(&str))
+            break;
+        str = decode_reshuffle_sse41(str);
+
+        uint32_t last = _mm_extract_epi32(str, 2);
+        _mm_storel_epi64((__m128i *)out, str);
+        memcpy(out + 8, &last, 4);
+        out += 12;
+    }
+    return done + decode_scalar(out, in + done, inlen - done);
+}
+
+__attribute__((target("avx2")))
+static size_t encode_avx2(unsigned char *out, const unsigned char *in, size_t inlen)
+{
+    size_t done = 0;
+
+    /* 24 bytes to 32 digits, loading 12 + 16 */
+    for (; inlen - done >= 28; done += 24)
+    {
+        __m256i str = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(in + done))),
+                                              _mm_loadu_si128((const __m128i *)(in + done + 12)), 1);
+
+        str = _mm256_shuffle_epi8(str, _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                  10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+        __m256i t0 = _mm256_and_si256(str, _mm256_set1_epi32(0x0fc0fc00));
+        __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        __m256i t2 = _mm256_and_si256(str, _mm256_set1_epi32(0x003f03f0));
+        __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        str = _mm256_or_si256(t1, t3);
+
+        const __m256i lut = _mm256_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0,
+                                             65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+        __m256i indices = _mm256_subs_epu8(str, _mm256_set1_epi8(51));
+        __m256i mask = _mm256_cmpgt_epi8(str, _mm256_set1_epi8(25));
+        indices = _mm256_sub_epi8(indices, mask);
+        str = _mm256_add_epi8(str, _mm256_shuffle_epi8(lut, indices));
+
+        _mm256_storeu_si256((__m256i *)out, str);
+        out += 32;
+    }
+    /* leave the AVX state before running SSE code, which would be slowed down */
+    _mm256_zeroupper();
+    return done + encode_sse41(out, in + done, inlen - done);
+}
+
+__attribute__((target("avx2")))
+static size_t decode_avx2(unsigned char *out, const char *in, size_t inlen)
+{
+    const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                            0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+                                            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                            0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                              0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+    size_t done = 0;
+
+    /* 32 digits to 24 bytes */
+    for (; inlen - done >= 32; done += 32)
+    {
+        __m256i str = _mm256_loadu_si256((const __m256i *)(in + done));
+
+        __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask_2f);
+        __m256i lo_nibbles = _mm256_and_si256(str, mask_2f);
+        __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+        __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+        if (!_mm256_testz_si256(lo, hi))
+            break;
+
+        __m256i eq_2f = _mm256_cmpeq_epi8(str, mask_2f);
+        __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles));
+        str = _mm256_add_epi8(str, roll);
+
+        __m256i merge_ab_and_bc = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+        str = _mm256_madd_epi16(merge_ab_and_bc, _mm256_set1_epi32(0x00011000));
+        str = _mm256_shuffle_epi8(str, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                  2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        str = _mm256_permutevar8x32_epi32(str, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1));
+
+        _mm_storeu_si128((__m128i *)out, _mm256_castsi256_si128(str));
+        _mm_storel_epi64((__m128i *)(out + 16), _mm256_extracti128_si256(str, 1));
+        out += 24;
+    }
+    /* what is left of a line may still hold a 128 bits block */
+    _mm256_zeroupper();
+    return done + decode_sse41(out, in + done, inlen - done);
+}
+
+#endif
+
+#ifdef BASE64_NEON_PATH
+
+/* 6 bits value of ASCII characters, 0xff when not a digit */
+static const uint8_t neon_decode_lut[128] =
+{
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x3e, 0xff, 0xff, 0xff, 0x3f,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+    0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+
+static inline uint8x16x4_t load_table_neon(const uint8_t *table)
+{
+    uint8x16x4_t result;
+    result.val[0] = vld1q_u8(table);
+    result.val[1] = vld1q_u8(table + 16);
+    result.val[2] = vld1q_u8(table + 32);
+    result.val[3] = vld1q_u8(table + 48);
+    return result;
+}
+
+static size_t encode_neon(unsigned char *out, const unsigned char *in, size_t inlen)
+{
+    const uint8x16x4_t digits = load_table_neon((const uint8_t *)base64digits);
+    const uint8x16_t mask = vdupq_n_u8(0x3f);
+    size_t done = 0;
+
+    /* 48 bytes, deinterleaved by 3, to 64 digits */
+    for (; inlen - done >= 48; done += 48)
+    {
+        uint8x16x3_t src = vld3q_u8(in + done);
+        uint8x16x4_t result;
+
+        result.val[0] = vshrq_n_u8(src.val[0], 2);
+        result.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(src.val[0], 4), vshrq_n_u8(src.val[1], 4)), mask);
+        result.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(src.val[1], 2), vshrq_n_u8(src.val[2], 6)), mask);
+        result.val[3] = vandq_u8(src.val[2], mask);
+
+        result.val[0] = vqtbl4q_u8(digits, result.val[0]);
+        result.val[1] = vqtbl4q_u8(digits, result.val[1]);
+        result.val[2] = vqtbl4q_u8(digits, result.val[2]);
+        result.val[3] = vqtbl4q_u8(digits, result.val[3]);
+
+        vst4q_u8(out, result);
+        out += 64;
+    }
+    return done;
+}
+
+static size_t decode_neon(unsigned char *out, const char *in, size_t inlen)
+{
+    const uint8x16x4_t lut_lo = load_table_neon(neon_decode_lut);
+    const uint8x16x4_t lut_hi = load_table_neon(neon_decode_lut + 64);
+    const uint8x16_t high = vdupq_n_u8(0x40);
+    size_t done = 0;
+
+    /* 64 digits, deinterleaved by 4, to 48 bytes */
+    for (; inlen - done >= 64; done += 64)
+    {
+        uint8x16x4_t str = vld4q_u8((const uint8_t *)in + done);
+        uint8x16_t error = vdupq_n_u8(0);
+        int i;
+
+        /* characters >= 128 and non digits have their top bit set in error */
+        for (i = 0; i < 4; i++)
+        {
+            uint8x16_t value = vqtbx4q_u8(vqtbl4q_u8(lut_lo, str.val[i]), lut_hi, veorq_u8(str.val[i], high));
+            error = vorrq_u8(error, vorrq_u8(value, str.val[i]));
+            str.val[i] = value;
+        }
+        if (vmaxvq_u8(error) & 0x80)
+            break;
+
+        uint8x16x3_t result;
+        result.val[0] = vorrq_u8(vshlq_n_u8(str.val[0], 2), vshrq_n_u8(str.val[1], 4));
+        result.val[1] = vorrq_u8(vshlq_n_u8(str.val[1], 4), vshrq_n_u8(str.val[2], 2));
+        result.val[2] = vorrq_u8(vshlq_n_u8(str.val[2], 6), str.val[3]);
+        vst3q_u8(out, result);
+        out += 48;
+    }
+    return done + decode_scalar(out, in + done, inlen - done);
+}
+
+#endif
+
+static const struct base64_code scalar_code = { BASE64_SCALAR, encode_scalar, decode_scalar };
+#ifdef BASE64_X86
+static const struct base64_code sse41_code = { BASE64_SSE41, encode_sse41, decode_sse41 };
+static const struct base64_code avx2_code = { BASE64_AVX2, encode_avx2, decode_avx2 };
+#endif
+/* set before main, then changed by the tests only (base64_variant.h) */
+#ifdef BASE64_NEON_PATH
+static const struct base64_code neon_code = { BASE64_NEON, encode_neon, decode_neon };
+static const struct base64_code *code = &neon_code;
+#else
+static const struct base64_code *code = &scalar_code;
+#endif
+
+#ifdef BASE64_X86
+/* pick the fastest code path of this CPU, before any conversion */
+__attribute__((constructor))
+static void select_fastest_code(void)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        code = &avx2_code;
+    else if (__builtin_cpu_supports("sse4.1"))
+        code = &sse41_code;
+}
+#endif
+
+int base64_select_variant(enum base64_variant variant)
+{
+    switch (variant)
+    {
+        case BASE64_SCALAR:
+            code = &scalar_code;
+            return 0;
+#ifdef BASE64_X86
+        case BASE64_SSE41:
+            __builtin_cpu_init();
+            if (!__builtin_cpu_supports("sse4.1"))
+                return -1;
+            code = &sse41_code;
+            return 0;
+        case BASE64_AVX2:
+            __builtin_cpu_init();
+            if (!__builtin_cpu_supports("avx2"))
+                return -1;
+            code = &avx2_code;
+            return 0;
+#endif
+#ifdef BASE64_NEON_PATH
+        case BASE64_NEON:
+            code = &neon_code;
+            return 0;
+#endif
+        default:
+            return -1;
+    }
+}
+
+enum base64_variant base64_current_variant(void)
+{
+    return code->variant;
+}
+
 /* convert inlen raw bytes at in to base64 string (NUL-terminated) at out. 
  * out size should be at least 4*inlen/3 + 4.
  * return length of out (sans trailing NUL).
@@ -78,7 +478,14 @@ int to64frombits(unsigned char *out, const unsigned char *in, int inlen)
 {
     uint16_t *b64lut = (uint16_t *)base64lut;
     int dlen         = ((inlen + 2) / 3) * 4; /* 4/3, rounded up */
-    uint16_t *wbuf   = (uint16_t *)out;
+    size_t done      = inlen > 0 ? code->encode(out, in, inlen) : 0;
+    uint16_t *wbuf;
+
+    /* the tables finish the job */
+    in += done;
+    inlen -= done;
+    out += done / 3 * 4;
+    wbuf = (uint16_t *)out;
 
     for (; inlen > 2; inlen -= 3)
     {
@@ -107,93 +514,79 @@ int to64frombits(unsigned char *out, const unsigned char *in, int inlen)
     return dlen;
 }
 
+size_t to64frombits_lines(unsigned char *out, const unsigned char *in, size_t inlen, size_t linelen)
+{
+    size_t linebytes = linelen / 4 * 3;
+    unsigned char *start = out;
+
+    while (inlen > 0)
+    {
+        size_t count = inlen < linebytes ? inlen : linebytes;
+
+        /* the NUL after the digits is where the line ends */
+        out += to64frombits_s(out, in, count, linelen + 1);
+        *out++ = '\n';
+
+        in += count;
+        inlen -= count;
+    }
+    return out - start;
+}
+
 /* convert base64 at in to raw bytes out, returning count or <0 on error.
  * base64 should not contain whitespaces.
  * out should be at least 3/4 the length of in.
  */
 int from64tobits(char *out, const char *in)
 {
-    char *cp = (char *)in;
-    while (*cp != 0)
-        cp += 4;
-    return from64tobits_fast(out, in, cp - in);
+    return from64tobits_fast(out, in, strlen(in));
 }
 
 int from64tobits_fast(char *out, const char *in, int inlen)
 {
-    int outlen = 0;
-    uint8_t b1, b2, b3;
-    uint16_t s1, s2;
-    uint32_t n32;
-    int j;
-    int n         = (inlen / 4) - 1;
-    uint16_t *inp = (uint16_t *)in;
+    const char *end    = in + (inlen > 0 ? inlen : 0);
+    unsigned char *dst = (unsigned char *)out;
 
-    for (j = 0; j < n; j++)
+    for (;;)
     {
-        if (in[0] == '\n')
-            in++;
-        inp = (uint16_t *)in;
-
-        if IS_BIG_ENDIAN {
-         inp[0]=bswap_16(inp[0]);
-         inp[1]=bswap_16(inp[1]);
-       }
-        s1 = rbase64lut[inp[0]];
-        s2 = rbase64lut[inp[1]];
-
-        n32 = s1;
-        n32 <<= 10;
-        n32 |= s2 >> 2;
-
-        b3 = (n32 & 0x00ff);
-        n32 >>= 8;
-        b2 = (n32 & 0x00ff);
-        n32 >>= 8;
-        b1 = (n32 & 0x00ff);
-
-        out[0] = b1;
-        out[1] = b2;
-        out[2] = b3;
+        unsigned char group[4];
+        int count = 0;
 
-        in += 4;
-        out += 3;
-    }
-    outlen = (inlen / 4 - 1) * 3;
-    if (in[0] == '\n')
-        in++;
-    inp = (uint16_t *)in;
-    if IS_BIG_ENDIAN {
-      inp[0]=bswap_16(inp[0]);
-      inp[1]=bswap_16(inp[1]);
-    }
-
-    s1 = rbase64lut[inp[0]];
-    s2 = rbase64lut[inp[1]];
+        /* runs of digits, up to a line break */
+        size_t done = code->decode(dst, in, end - in);
+        in += done;
+        dst += done / 4 * 3;
 
-    n32 = s1;
-    n32 <<= 10;
-    n32 |= s2 >> 2;
-
-    b3 = (n32 & 0x00ff);
-    n32 >>= 8;
-    b2 = (n32 & 0x00ff);
-    n32 >>= 8;
-    b1 = (n32 & 0x00ff);
+        if (in < end && (*in == '\n' || *in == '\r'))
+        {
+            while (in < end && (*in == '\n' || *in == '\r'))
+                in++;
+            continue;
+        }
 
-    *out++ = b1;
-    outlen++;
-    if ((inp[1] & 0x00FF) != 0x003D)
-    {
-        *out++ = b2;
-        outlen++;
-        if ((inp[1] & 0xFF00) != 0x3D00)
+        /* then one group, across line breaks, maybe padded or incomplete */
+        while (count < 4 && in < end)
         {
-            *out++ = b3;
-            outlen++;
+            char c = *in++;
+            if (c == '\n' || c == '\r')
+                continue;
+            group[count++] = c;
         }
+        if (count < 2)
+            break;
+        while (count < 4)
+            group[count++] = '=';
+
+        decode_group(dst, group);
+        dst++;
+        if (group[2] == '=')
+            break;
+        dst++;
+        if (group[3] == '=')
+            break;
+        dst++;
     }
-    return outlen;
+    return dst - (unsigned char *)out;
 }
 
 int from64tobits_fast_with_bug(char *out, const char *in, int inlen)
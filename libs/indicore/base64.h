@@ -48,11 +48,24 @@ __attribute__((deprecated("unsafe function, use to64frombits_s instead")))
 #endif
 extern int to64frombits(unsigned char *out, const unsigned char *in, int inlen);
 
+/** \brief Convert bytes array to base64 text made of lines, each followed by a line feed.
+    \param out output buffer in base64. The buffer size must be at least (4 * inlen / 3 + 4) bytes, plus one per line.
+    \param in input binary buffer
+    \param inlen number of bytes to convert
+    \param linelen count of base64 digits of the lines, the last one excepted. Must be a multiple of 4.
+    \return length of the text written to out. It is not NUL terminated.
+
+    Text longer than a line can be converted in pieces, each one a multiple of (3 * linelen / 4) bytes but the last.
+ */
+extern size_t to64frombits_lines(unsigned char *out, const unsigned char *in, size_t inlen, size_t linelen);
+
 /** \brief Convert base64 to bytes array.
     \param out output buffer in bytes. The buffer size must be at least (3 * size_of_in_buffer / 4) bytes long.
     \param in input base64 buffer
     \param inlen base64 buffer length
     \return 0 on success, -1 on failure.
+
+    Line feeds and carriage returns anywhere in the input are skipped, and no more than inlen bytes are read.
  */
 
 extern int from64tobits(char *out, const char *in);
@@ -0,0 +1,53 @@
+#if 0
+INDI
+
+This library is free software;
+you can redistribute it and / or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation;
+either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY;
+without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library;
+if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110 - 1301  USA
+
+#endif
+
+#pragma once
+
+/* Code paths of the base64 conversions, for the tests only: not installed.
+ * The fastest one the CPU supports is picked at load time.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum base64_variant
+{
+    BASE64_SCALAR, /* Lookup tables only */
+    BASE64_SSE41,  /* x86 SSE4.1, 16 digits at a time */
+    BASE64_AVX2,   /* x86 AVX2, 32 digits at a time */
+    BASE64_NEON    /* ARM64 NEON, 64 digits at a time */
+};
+
+/* Force the code path of the conversions, to compare them.
+ * Not synchronized: no conversion may run meanwhile, in any thread.
+ * Return 0 on success, -1 if the build or the CPU does not support it.
+ */
+extern int base64_select_variant(enum base64_variant variant);
+
+/* Code path of the conversions */
+extern enum base64_variant base64_current_variant(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,422 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include "indibinaryframe.h"
+
+#include "base64.h"
+#include "indicom.h"
+#include "indidevapi.h"
+#include "locale_compat.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+
+static const struct
+{
+    const char *tag;
+    const char *member;
+} frameTags[] =
+{
+    { nullptr, nullptr },
+    { "setNumberVector", "oneNumber" },
+    { "setSwitchVector", "oneSwitch" },
+    { "setTextVector", "oneText" },
+    { "setLightVector", "oneLight" },
+    { "setBLOBVector", "oneBLOB" }
+};
+
+class FrameWriter
+{
+    public:
+        explicit FrameWriter(INDI::BinaryFrame::Encoded &frame): frame(frame)
+        { }
+
+        void putInt(uint64_t value, int size)
+        {
+            for (int i = 0; i < size; ++i)
+                frame.bytes.push_back(char((value >> (8 * i)) & 0xff));
+        }
+
+        bool putString(const char *str)
+        {
+            size_t len = strlen(str);
+            if (len > std::numeric_limits<uint16_t>::max())
+                return false;
+            putInt(len, 2);
+            frame.bytes.append(str, len);
+            return true;
+        }
+
+        void putDouble(double value)
+        {
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            putInt(bits, 8);
+        }
+
+        void putPayload(const void *data, size_t size)
+        {
+            putInt(size, 4);
+            frame.payloads.push_back({frame.bytes.size(), data, size});
+            frame.payloadSize += size;
+        }
+
+    private:
+        INDI::BinaryFrame::Encoded &frame;
+};
+
+/* Reads the fields of a binary frame, failing once past its end */
+class FrameReader
+{
+    public:
+        FrameReader(const char *data, size_t size)
+            : pos(reinterpret_cast<const unsigned char *>(data)), end(pos + size)
+        { }
+
+        bool getInt(uint64_t &value, int size)
+        {
+            if (end - pos < size)
+                return false;
+            value = 0;
+            for (int i = 0; i < size; ++i)
+                value |= uint64_t(pos[i]) << (8 * i);
+            pos += size;
+            return true;
+        }
+
+        bool getBytes(std::string &value, uint64_t size)
+        {
+            if (uint64_t(end - pos) < size)
+                return false;
+            value.assign(reinterpret_cast<const char *>(pos), size);
+            pos += size;
+            return true;
+        }
+
+        bool getString(std::string &value)
+        {
+            uint64_t len;
+            return getInt(len, 2) && getBytes(value, len);
+        }
+
+        bool getPayload(const unsigned char *&data, uint64_t size)
+        {
+            if (uint64_t(end - pos) < size)
+                return false;
+            data = pos;
+            pos += size;
+            return true;
+        }
+
+        bool atEnd() const
+        {
+            return pos == end;
+        }
+
+    private:
+        const unsigned char *pos;
+        const unsigned char *end;
+};
+
+bool hasOnlyAttributes(XMLEle *ep, std::initializer_list<const char *> allowed)
+{
+    for (XMLAtt *ap = nextXMLAtt(ep, 1); ap != nullptr; ap = nextXMLAtt(ep, 0))
+    {
+        bool found = false;
+        for (auto name : allowed)
+        {
+            if (!strcmp(nameXMLAtt(ap), name))
+            {
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+            return false;
+    }
+    return true;
+}
+
+void addNonEmptyAttribute(XMLEle *ep, const char *name, const std::string &value)
+{
+    if (!value.empty())
+        addXMLAtt(ep, name, value.c_str());
+}
+
+}
+
+namespace INDI
+{
+
+namespace BinaryFrame
+{
+
+bool encode(XMLEle *root, BlobSource &blobs, Encoded &frame)
+{
+    int kind = -1;
+    for (int k = INDI_FRAME_SET_NUMBER; k <= INDI_FRAME_SET_BLOB; ++k)
+    {
+        if (!strcmp(tagXMLEle(root), frameTags[k].tag))
+        {
+            kind = k;
+            break;
+        }
+    }
+    if (kind == -1)
+        return false;
+
+    bool blob = (kind == INDI_FRAME_SET_BLOB);
+
+    // BLOBs can't go back to XML once their content was taken: whatever else they carry is dropped
+    if (!blob && !hasOnlyAttributes(root, {"device", "name", "state", "timestamp", "timeout", "message"}))
+        return false;
+
+    frame = Encoded();
+    FrameWriter writer(frame);
+    writer.putInt(0, 4);
+    writer.putInt(kind, 1);
+
+    if (!writer.putString(findXMLAttValu(root, "device")) || !writer.putString(findXMLAttValu(root, "name")))
+        return false;
+
+    const char *stateStr = findXMLAttValu(root, "state");
+    IPState state;
+    if (!stateStr[0])
+        writer.putInt(INDI_FRAME_NO_STATE, 1);
+    else if (crackIPState(stateStr, &state) == 0)
+        writer.putInt(state, 1);
+    else
+        return false;
+
+    if (!writer.putString(findXMLAttValu(root, "timestamp")) || !writer.putString(findXMLAttValu(root, "timeout"))
+            || !writer.putString(findXMLAttValu(root, "message")))
+        return false;
+
+    int count = nXMLEle(root);
+    if (count > std::numeric_limits<uint16_t>::max())
+        return false;
+    writer.putInt(count, 2);
+
+    for (XMLEle *ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
+    {
+        if (strcmp(tagXMLEle(ep), frameTags[kind].member))
+            return false;
+
+        if (!blob && !hasOnlyAttributes(ep, {"name"}))
+            return false;
+
+        if (!writer.putString(findXMLAttValu(ep, "name")))
+            return false;
+
+        const char *value = pcdataXMLEle(ep);
+        switch (kind)
+        {
+            case INDI_FRAME_SET_NUMBER:
+            {
+                double number;
+                if (f_scansexa(value, &number) != 0)
+                    return false;
+                writer.putDouble(number);
+                break;
+            }
+
+            case INDI_FRAME_SET_SWITCH:
+            {
+                ISState s;
+                if (crackISState(value, &s) != 0)
+                    return false;
+                writer.putInt(s, 1);
+                break;
+            }
+
+            case INDI_FRAME_SET_LIGHT:
+            {
+                IPState s;
+                if (crackIPState(value, &s) != 0)
+                    return false;
+                writer.putInt(s, 1);
+                break;
+            }
+
+            case INDI_FRAME_SET_TEXT:
+            {
+                int len = pcdatalenXMLEle(ep);
+                writer.putInt(len, 4);
+                frame.bytes.append(value, len);
+                break;
+            }
+
+            case INDI_FRAME_SET_BLOB:
+            {
+                const void *data = nullptr;
+                size_t len = 0;
+                if (!strcmp(findXMLAttValu(ep, "attached"), "true"))
+                {
+                    if (!blobs.attached(data, len))
+                        return false;
+                }
+                else if (pcdatalenXMLEle(ep) > 0)
+                {
+                    int base64Len = pcdatalenXMLEle(ep);
+                    char *decoded = static_cast<char *>(blobs.allocate(3 * base64Len / 4 + 4));
+                    int decodedLen = from64tobits_fast(decoded, value, base64Len);
+                    if (decodedLen < 0)
+                        return false;
+                    data = decoded;
+                    len = decodedLen;
+                }
+
+                // The content is no longer than the size announced: a shared
+                // buffer may be larger, decoded base64 may keep padding
+                char *end;
+                const char *sizeStr = findXMLAttValu(ep, "size");
+                unsigned long long size = strtoull(sizeStr, &end, 10);
+                if (!sizeStr[0] || *end)
+                    size = len;
+                else if (size < len)
+                    len = size;
+                if (size > std::numeric_limits<uint32_t>::max())
+                    return false;
+
+                if (!writer.putString(findXMLAttValu(ep, "format")))
+                    return false;
+                writer.putInt(size, 4);
+                writer.putPayload(data, len);
+                break;
+            }
+        }
+    }
+
+    size_t length = frame.bytes.size() - 4 + frame.payloadSize;
+    if (length > std::numeric_limits<uint32_t>::max())
+        return false;
+    for (int i = 0; i < 4; ++i)
+        frame.bytes[i] = char((length >> (8 * i)) & 0xff);
+    return true;
+}
+
+XMLEle *decode(const char *body, size_t size, BlobSink &blobs)
+{
+    FrameReader reader(body, size);
+    uint64_t kind, state, count;
+    std::string device, name, timestamp, timeout, message;
+
+    if (!reader.getInt(kind, 1) || kind < INDI_FRAME_SET_NUMBER || kind > INDI_FRAME_SET_BLOB
+            || !reader.getString(device) || !reader.getString(name) || !reader.getInt(state, 1)
+            || (state > IPS_ALERT && state != INDI_FRAME_NO_STATE)
+            || !reader.getString(timestamp) || !reader.getString(timeout) || !reader.getString(message)
+            || !reader.getInt(count, 2))
+    {
+        return nullptr;
+    }
+
+    XMLEle *root = addXMLEle(nullptr, frameTags[kind].tag);
+    addXMLAtt(root, "device", device.c_str());
+    addXMLAtt(root, "name", name.c_str());
+    if (state != INDI_FRAME_NO_STATE)
+        addXMLAtt(root, "state", pstateStr(IPState(state)));
+    addNonEmptyAttribute(root, "timestamp", timestamp);
+    addNonEmptyAttribute(root, "timeout", timeout);
+    addNonEmptyAttribute(root, "message", message);
+
+    bool ok = true;
+    for (uint64_t i = 0; ok && i < count; ++i)
+    {
+        XMLEle *ep = addXMLEle(root, frameTags[kind].member);
+        std::string member;
+        if (!(ok = reader.getString(member)))
+            break;
+        addXMLAtt(ep, "name", member.c_str());
+
+        uint64_t value;
+        switch (kind)
+        {
+            case INDI_FRAME_SET_NUMBER:
+            {
+                double number;
+                if (!(ok = reader.getInt(value, 8)))
+                    break;
+                memcpy(&number, &value, sizeof(number));
+                editXMLEle(ep, formatNumber(number).c_str());
+                break;
+            }
+
+            case INDI_FRAME_SET_SWITCH:
+                if ((ok = reader.getInt(value, 1) && value <= ISS_ON))
+                    editXMLEle(ep, sstateStr(ISState(value)));
+                break;
+
+            case INDI_FRAME_SET_LIGHT:
+                if ((ok = reader.getInt(value, 1) && value <= IPS_ALERT))
+                    editXMLEle(ep, pstateStr(IPState(value)));
+                break;
+
+            case INDI_FRAME_SET_TEXT:
+            {
+                std::string text;
+                if ((ok = reader.getInt(value, 4) && reader.getBytes(text, value)))
+                    editXMLEle(ep, text.c_str());
+                break;
+            }
+
+            case INDI_FRAME_SET_BLOB:
+            {
+                std::string format;
+                uint64_t blobSize, len;
+                const unsigned char *content;
+                if (!(ok = reader.getString(format) && reader.getInt(blobSize, 4) && reader.getInt(len, 4)
+                           && reader.getPayload(content, len)))
+                    break;
+
+                addXMLAtt(ep, "size", std::to_string(blobSize).c_str());
+                addXMLAtt(ep, "format", format.c_str());
+                ok = blobs.store(ep, content, len);
+                break;
+            }
+        }
+    }
+
+    if (!ok || !reader.atEnd())
+    {
+        delXMLEle(root);
+        return nullptr;
+    }
+    return root;
+}
+
+std::string formatNumber(double number)
+{
+    AutoCNumeric locale;
+    char text[32];
+    for (int precision = 15; precision < 17; ++precision)
+    {
+        snprintf(text, sizeof(text), "%.*g", precision, number);
+        if (strtod(text, nullptr) == number)
+            return text;
+    }
+    snprintf(text, sizeof(text), "%.17g", number);
+    return text;
+}
+
+}
+
+}
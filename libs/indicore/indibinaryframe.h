@@ -0,0 +1,143 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#pragma once
+
+/* Binary framing between indiserver and its TCP clients.
+ *
+ * A client asks for it by sending INDI_BINARY_FRAMING_REQUEST before anything
+ * else. A server that agrees answers with the very same element, as XML and
+ * ahead of any other message; everything it sends after that element is a
+ * sequence of frames. A server that does not support framing never answers,
+ * and the connection stays XML. Client to server traffic stays XML.
+ *
+ * All integers are little endian. A string is a u16 length then its bytes.
+ *
+ *   frame   := u32 length of what follows, u8 kind, body
+ *
+ * INDI_FRAME_XML: the body is one XML element, for every message that is not
+ * a set*Vector or carries attributes the binary form does not have.
+ *
+ * INDI_FRAME_SET_*: a set*Vector.
+ *
+ *   body    := string device, string name, u8 state, string timestamp,
+ *              string timeout, string message, u16 count, count * member
+ *
+ *   state is one of IPState, or INDI_FRAME_NO_STATE. Empty strings stand
+ *   for missing attributes. Members depend on the kind:
+ *
+ *   number  := string name, f64 value
+ *   switch  := string name, u8 ISState
+ *   light   := string name, u8 IPState
+ *   text    := string name, u32 length, bytes
+ *   blob    := string name, string format, u32 size, u32 length, bytes
+ *
+ * BLOB bytes are the raw content: never base64 encoded.
+ */
+#define INDI_BINARY_FRAMING_REQUEST "<enableBinaryFraming version='1'/>\n"
+
+enum
+{
+    INDI_FRAME_XML = 0,
+    INDI_FRAME_SET_NUMBER = 1,
+    INDI_FRAME_SET_SWITCH = 2,
+    INDI_FRAME_SET_TEXT = 3,
+    INDI_FRAME_SET_LIGHT = 4,
+    INDI_FRAME_SET_BLOB = 5
+};
+
+#define INDI_FRAME_NO_STATE 0xff
+
+/* Bytes of the length and kind fields that start each frame */
+#define INDI_FRAME_HEADER_SIZE 5
+
+#ifdef __cplusplus
+
+#include "lilxml.h"
+
+#include <string>
+#include <vector>
+
+namespace INDI
+{
+
+/* Conversion between set*Vector messages and the frames described above.
+ * Shared by indiserver, which sends and relays frames, and the client.
+ */
+namespace BinaryFrame
+{
+
+/* Where the encoder gets BLOB content from */
+class BlobSource
+{
+    public:
+        virtual ~BlobSource() = default;
+
+        /* Content of the next member with attached="true", false if unavailable */
+        virtual bool attached(const void *&data, size_t &size) = 0;
+
+        /* Room for decoded base64 content, valid as long as the frame is */
+        virtual void *allocate(size_t size) = 0;
+};
+
+/* Where the decoder puts BLOB content. member already has its name, size and
+ * format attributes: the sink adds the content, the way its reader wants it.
+ */
+class BlobSink
+{
+    public:
+        virtual ~BlobSink() = default;
+
+        /* return false to fail the decoding */
+        virtual bool store(XMLEle *member, const unsigned char *data, size_t len) = 0;
+};
+
+/* A frame with its length and kind. BLOB content is referenced, not copied:
+ * each payload goes at its offset in bytes, after the u32 length already there.
+ */
+struct Encoded
+{
+    struct Payload
+    {
+        size_t offset;
+        const void *data;
+        size_t size;
+    };
+
+    std::string bytes;
+    std::vector<Payload> payloads;
+    size_t payloadSize = 0;
+};
+
+/* Encode a set*Vector as a frame.
+ * return false if root has no binary form: it then goes as INDI_FRAME_XML.
+ */
+bool encode(XMLEle *root, BlobSource &blobs, Encoded &frame);
+
+/* Decode the kind and body of a set*Vector frame.
+ * return the message, or nullptr if the frame is malformed or holds
+ * out of range values.
+ */
+XMLEle *decode(const char *body, size_t size, BlobSink &blobs);
+
+/* Shortest text reading back as number, in the C locale */
+std::string formatNumber(double number);
+
+}
+
+}
+
+#endif
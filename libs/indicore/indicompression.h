@@ -0,0 +1,51 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#pragma once
+
+/* Compressed transport between indiserver and its TCP clients.
+ *
+ * A client asks for it by sending INDI_COMPRESSION_REQUEST before anything
+ * else. A server that agrees answers with the very same element, uncompressed
+ * and ahead of any other message; every byte it sends after that element is
+ * a zlib stream, deflated with the preset dictionary below and flushed at each
+ * write so messages are never delayed. A server that does not support
+ * compression never answers, and the connection simply stays uncompressed.
+ * Client to server traffic is never compressed.
+ */
+#define INDI_COMPRESSION_REQUEST "<enableCompression format='deflate'/>\n"
+
+/* Preset dictionary: the markup drivers produce (see indiuserio.c), the most
+ * frequent last, as zlib favours the end of the dictionary.
+ */
+static const char indiCompressionDictionary[] =
+    "<delProperty\n  device='<message\n  device='"
+    "<defBLOBVector\n  device='  <defBLOB\n    name='</defBLOBVector>\n"
+    "<defLightVector\n  device='  <defLight\n    name='</defLightVector>\n"
+    "<defTextVector\n  device='  <defText\n    name='  </defText>\n</defTextVector>\n"
+    "  rule='OneOfMany'\n  rule='AtMostOne'\n  rule='AnyOfMany'\n"
+    "<defSwitchVector\n  device='  <defSwitch\n    name='  </defSwitch>\n</defSwitchVector>\n"
+    "    format='%g'\n    min='0'\n    max='0'\n    step='0'>\n"
+    "<defNumberVector\n  device='  <defNumber\n    name='  </defNumber>\n</defNumberVector>\n"
+    "'\n  label='Main Control'\n  group='Options'\n  perm='ro'\n  perm='rw'\n  timeout='60'\n"
+    "  <oneBLOB\n    name='    size='    format='.fits'\n    enclen='  </oneBLOB>\n</setBLOBVector>\n"
+    "<setBLOBVector\n  device='"
+    "  <oneLight\n    name='  </oneLight>\n</setLightVector>\n<setLightVector\n  device='"
+    "  <oneText\n    name='  </oneText>\n</setTextVector>\n<setTextVector\n  device='"
+    "      Off\n  <oneSwitch\n    name='  </oneSwitch>\n</setSwitchVector>\n<setSwitchVector\n  device='"
+    "  state='Alert'\n  state='Idle'\n  state='Busy'\n  state='Ok'\n"
+    "  <oneNumber\n    name='  </oneNumber>\n</setNumberVector>\n<setNumberVector\n  device='"
+    "'\n  name='  timeout='0'\n  timestamp='2025-01-01T00:00:00'>\n      On\n";
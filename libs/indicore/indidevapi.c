@@ -545,6 +545,18 @@ void IUFillBLOBVector(IBLOBVectorProperty *bvp, IBLOB *bp, int nbp, const char *
 
 /** \section IUSnoop **/
 
+/* 1 if the tag atom is one of the given vectors, which may be XMLATOM_NONE */
+static int isVectorAtom(XMLAtom atom, XMLAtom def, XMLAtom set, XMLAtom new_)
+{
+    return atom != XMLATOM_NONE && (atom == def || atom == set || atom == new_);
+}
+
+/* 1 if the tag atom is one of the given members */
+static int isMemberAtom(XMLAtom atom, XMLAtom def, XMLAtom one)
+{
+    return atom == def || atom == one;
+}
+
 /* crack the snooped driver setNumberVector or defNumberVector message into
  * the given INumberVectorProperty.
  * return 0 if type, device and name match and all members are present, else
@@ -556,11 +568,12 @@ int IUSnoopNumber(XMLEle *root, INumberVectorProperty *nvp)
     XMLEle *ep;
 
     /* check and crack type, device, name and state */
-    if (strcmp(tagXMLEle(root) + 3, "NumberVector") || crackDN(root, &dev, &name, NULL) < 0)
+    if (!isVectorAtom(tagAtomXMLEle(root), XMLATOM_defNumberVector, XMLATOM_setNumberVector, XMLATOM_newNumberVector) ||
+            crackDN(root, &dev, &name, NULL) < 0)
         return (-1);
     if (strcmp(dev, nvp->device) || strcmp(name, nvp->name))
         return (-1); /* not this property */
-    (void)crackIPState(findXMLAttValu(root, "state"), &nvp->s);
+    (void)crackIPState(findXMLAttValuAtom(root, XMLATOM_state), &nvp->s);
 
     /* match each INumber with a oneNumber */
     locale_char_t *orig = indi_locale_C_numeric_push();
@@ -568,7 +581,8 @@ int IUSnoopNumber(XMLEle *root, INumberVectorProperty *nvp)
     {
         for (ep = nextXMLEle(root, 1); ep; ep = nextXMLEle(root, 0))
         {
-            if (!strcmp(tagXMLEle(ep) + 3, "Number") && !strcmp(nvp->np[i].name, findXMLAttValu(ep, "name")))
+            if (isMemberAtom(tagAtomXMLEle(ep), XMLATOM_defNumber, XMLATOM_oneNumber) &&
+                    !strcmp(nvp->np[i].name, findXMLAttValuAtom(ep, XMLATOM_name)))
             {
                 if (f_scansexa(pcdataXMLEle(ep), &nvp->np[i].value) < 0)
                 {
@@ -601,18 +615,20 @@ int IUSnoopText(XMLEle *root, ITextVectorProperty *tvp)
     XMLEle *ep;
 
     /* check and crack type, device, name and state */
-    if (strcmp(tagXMLEle(root) + 3, "TextVector") || crackDN(root, &dev, &name, NULL) < 0)
+    if (!isVectorAtom(tagAtomXMLEle(root), XMLATOM_defTextVector, XMLATOM_setTextVector, XMLATOM_newTextVector) ||
+            crackDN(root, &dev, &name, NULL) < 0)
         return (-1);
     if (strcmp(dev, tvp->device) || strcmp(name, tvp->name))
         return (-1); /* not this property */
-    (void)crackIPState(findXMLAttValu(root, "state"), &tvp->s);
+    (void)crackIPState(findXMLAttValuAtom(root, XMLATOM_state), &tvp->s);
 
     /* match each IText with a oneText */
     for (int i = 0; i < tvp->ntp; i++)
     {
         for (ep = nextXMLEle(root, 1); ep; ep = nextXMLEle(root, 0))
         {
-            if (!strcmp(tagXMLEle(ep) + 3, "Text") && !strcmp(tvp->tp[i].name, findXMLAttValu(ep, "name")))
+            if (isMemberAtom(tagAtomXMLEle(ep), XMLATOM_defText, XMLATOM_oneText) &&
+                    !strcmp(tvp->tp[i].name, findXMLAttValuAtom(ep, XMLATOM_name)))
             {
                 IUSaveText(&tvp->tp[i], pcdataXMLEle(ep));
                 break;
@@ -637,19 +653,20 @@ int IUSnoopLight(XMLEle *root, ILightVectorProperty *lvp)
     XMLEle *ep;
 
     /* check and crack type, device, name and state */
-    if (strcmp(tagXMLEle(root) + 3, "LightVector") || crackDN(root, &dev, &name, NULL) < 0)
+    if (!isVectorAtom(tagAtomXMLEle(root), XMLATOM_defLightVector, XMLATOM_setLightVector, XMLATOM_NONE) ||
+            crackDN(root, &dev, &name, NULL) < 0)
         return (-1);
     if (strcmp(dev, lvp->device) || strcmp(name, lvp->name))
         return (-1); /* not this property */
 
-    (void)crackIPState(findXMLAttValu(root, "state"), &lvp->s);
+    (void)crackIPState(findXMLAttValuAtom(root, XMLATOM_state), &lvp->s);
 
     /* match each oneLight with one ILight */
     for (ep = nextXMLEle(root, 1); ep; ep = nextXMLEle(root, 0))
     {
-        if (!strcmp(tagXMLEle(ep) + 3, "Light"))
+        if (isMemberAtom(tagAtomXMLEle(ep), XMLATOM_defLight, XMLATOM_oneLight))
         {
-            const char *name = findXMLAttValu(ep, "name");
+            const char *name = findXMLAttValuAtom(ep, XMLATOM_name);
             for (int i = 0; i < lvp->nlp; i++)
             {
                 if (!strcmp(lvp->lp[i].name, name))
@@ -679,18 +696,19 @@ int IUSnoopSwitch(XMLEle *root, ISwitchVectorProperty *svp)
     XMLEle *ep;
 
     /* check and crack type, device, name and state */
-    if (strcmp(tagXMLEle(root) + 3, "SwitchVector") || crackDN(root, &dev, &name, NULL) < 0)
+    if (!isVectorAtom(tagAtomXMLEle(root), XMLATOM_defSwitchVector, XMLATOM_setSwitchVector, XMLATOM_newSwitchVector) ||
+            crackDN(root, &dev, &name, NULL) < 0)
         return (-1);
     if (strcmp(dev, svp->device) || strcmp(name, svp->name))
         return (-1); /* not this property */
-    (void)crackIPState(findXMLAttValu(root, "state"), &svp->s);
+    (void)crackIPState(findXMLAttValuAtom(root, XMLATOM_state), &svp->s);
 
     /* match each oneSwitch with one ISwitch */
     for (ep = nextXMLEle(root, 1); ep; ep = nextXMLEle(root, 0))
     {
-        if (!strcmp(tagXMLEle(ep) + 3, "Switch"))
+        if (isMemberAtom(tagAtomXMLEle(ep), XMLATOM_defSwitch, XMLATOM_oneSwitch))
         {
-            const char *name = findXMLAttValu(ep, "name");
+            const char *name = findXMLAttValuAtom(ep, XMLATOM_name);
             for (int i = 0; i < svp->nsp; i++)
             {
                 if (!strcmp(svp->sp[i].name, name))
@@ -721,19 +739,19 @@ int IUSnoopBLOB(XMLEle *root, IBLOBVectorProperty *bvp)
     XMLEle *ep;
 
     /* check and crack type, device, name and state */
-    if (strcmp(tagXMLEle(root), "setBLOBVector") || crackDN(root, &dev, &name, NULL) < 0)
+    if (tagAtomXMLEle(root) != XMLATOM_setBLOBVector || crackDN(root, &dev, &name, NULL) < 0)
         return (-1);
 
     if (strcmp(dev, bvp->device) || strcmp(name, bvp->name))
         return (-1); /* not this property */
 
-    crackIPState(findXMLAttValu(root, "state"), &bvp->s);
+    crackIPState(findXMLAttValuAtom(root, XMLATOM_state), &bvp->s);
 
     for (ep = nextXMLEle(root, 1); ep; ep = nextXMLEle(root, 0))
     {
-        if (strcmp(tagXMLEle(ep), "oneBLOB") == 0)
+        if (tagAtomXMLEle(ep) == XMLATOM_oneBLOB)
         {
-            XMLAtt *na = findXMLAtt(ep, "name");
+            XMLAtt *na = findXMLAttAtom(ep, XMLATOM_name);
             if (na == NULL)
                 return (-1);
 
@@ -742,8 +760,8 @@ int IUSnoopBLOB(XMLEle *root, IBLOBVectorProperty *bvp)
             if (bp == NULL)
                 return (-1);
 
-            XMLAtt *fa = findXMLAtt(ep, "format");
-            XMLAtt *sa = findXMLAtt(ep, "size");
+            XMLAtt *fa = findXMLAttAtom(ep, XMLATOM_format);
+            XMLAtt *sa = findXMLAttAtom(ep, XMLATOM_size);
             if (fa && sa)
             {
                 int base64datalen = pcdatalenXMLEle(ep);
@@ -769,7 +787,7 @@ int crackDN(XMLEle *root, char **dev, char **name, char msg[])
 {
     XMLAtt *ap;
 
-    ap = findXMLAtt(root, "device");
+    ap = findXMLAttAtom(root, XMLATOM_device);
     if (!ap)
     {
         sprintf(msg, "%s requires 'device' attribute", tagXMLEle(root));
@@ -777,7 +795,7 @@ int crackDN(XMLEle *root, char **dev, char **name, char msg[])
     }
     *dev = valuXMLAtt(ap);
 
-    ap = findXMLAtt(root, "name");
+    ap = findXMLAttAtom(root, XMLATOM_name);
     if (!ap)
     {
         sprintf(msg, "%s requires 'name' attribute", tagXMLEle(root));
@@ -283,6 +283,17 @@ extern void IDSnoopDevice(const char *snooped_device, const char *snooped_proper
  */
 extern void IDSnoopBLOBs(const char *snooped_device, const char *snooped_property, BLOBHandling bh);
 
+/** @brief Function a Driver calls to know whether anyone will receive the BLOBs of one of its properties.
+ *  indiserver reports when no client nor snooping driver accepts BLOBs of the property, so that the
+ *  driver can skip preparing them. Only servers that set INDIBLOBDEMAND in the environment of the
+ *  drivers they start are asked for these reports.
+ *  @param dev name of the device.
+ *  @param name name of the BLOB vector property.
+ *  @return 0 if indiserver explicitly reported nobody receives these BLOBs, 1 otherwise, including
+ *  when nothing was reported.
+ */
+extern int IDHasBLOBDemand(const char *dev, const char *name);
+
 /* @} */
 
 /**
@@ -131,11 +131,14 @@ class LilXmlElement
     public:
         bool isValid() const;
         std::string tagName() const;
+        XMLAtom tagAtom() const;
 
     public:
         Elements getElements() const;
         Elements getElementsByTagName(const char *tagName) const;
+        Elements getElementsByTagName(XMLAtom tag) const;
         LilXmlAttribute getAttribute(const char *name) const;
+        LilXmlAttribute getAttribute(XMLAtom name) const;
         LilXmlAttribute addAttribute(const char *name, const char *value);
         void removeAttribute(const char *name);
 
@@ -374,6 +377,11 @@ inline std::string LilXmlElement::tagName() const
     return tagXMLEle(mHandle);
 }
 
+inline XMLAtom LilXmlElement::tagAtom() const
+{
+    return tagAtomXMLEle(mHandle);
+}
+
 inline LilXmlElement::Elements LilXmlElement::getElements() const
 {
     Elements result;
@@ -402,11 +410,30 @@ inline LilXmlElement::Elements LilXmlElement::getElementsByTagName(const char *t
     return result;
 }
 
+inline LilXmlElement::Elements LilXmlElement::getElementsByTagName(XMLAtom tag) const
+{
+    LilXmlElement::Elements result;
+    if (handle() == nullptr)
+        return result;
+
+    for (XMLEle *ep = nextXMLEle(mHandle, 1); ep != nullptr; ep = nextXMLEle(mHandle, 0))
+    {
+        if (tagAtomXMLEle(ep) == tag)
+            result.push_back(LilXmlElement(ep));
+    }
+    return result;
+}
+
 inline LilXmlAttribute LilXmlElement::getAttribute(const char *name) const
 {
     return LilXmlAttribute(findXMLAtt(mHandle, name));
 }
 
+inline LilXmlAttribute LilXmlElement::getAttribute(XMLAtom name) const
+{
+    return LilXmlAttribute(findXMLAttAtom(mHandle, name));
+}
+
 inline LilXmlAttribute LilXmlElement::addAttribute(const char *name, const char *value)
 {
     return LilXmlAttribute(addXMLAtt(mHandle, name, value));
@@ -456,7 +483,9 @@ inline LilXmlElement LilXmlDocument::root() const
 
 inline LilXmlParser::LilXmlParser()
     : mHandle(newLilXML(), [](LilXML *handle) { delLilXML(handle); })
-{ }
+{
+    setArenaLilXML(mHandle.get(), 1);
+}
 
 inline LilXmlDocument LilXmlParser::readFromFile(FILE *file)
 {
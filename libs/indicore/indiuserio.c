@@ -98,14 +98,17 @@ void IUUserIOSwitchContext(const userio *io, void *user, const ISwitchVectorProp
         IUUserIOSwitchContextFull(io, user, svp);
 }
 
+/* base64 digits per line of BLOB content */
+#define BLOB_LINE_LENGTH 72
+/* lines encoded at once: their bytes are written together */
+#define BLOB_BLOCK_LINES 128
+#define BLOB_BLOCK_BYTES (BLOB_BLOCK_LINES * BLOB_LINE_LENGTH / 4 * 3)
+
 void IUUserIOBLOBContextOne(
     const userio *io, void *user,
     const char *name, unsigned int size, unsigned int bloblen, const void *blob, const char *format
 )
 {
-    unsigned char *encblob;
-    int l;
-
     userio_prints    (io, user, "  <oneBLOB\n"
                                 "    name='");
     userio_xml_escape(io, user, name);
@@ -130,39 +133,28 @@ void IUUserIOBLOBContextOne(
 
             io->joinbuff(user, "    attached='true'>\n", (void*)blob, bloblen);
         } else {
-            size_t sz = 4 * bloblen / 3 + 4;
-            assert_mem(encblob = (unsigned char *)malloc(sz)); // #PS: TODO
-            l = to64frombits_s(encblob, blob, bloblen, sz);
-            if (l == 0) {
-                fprintf(stderr, "%s: Not enough memory for decoding.\n", __func__);
-                exit(1);
-            }
-            userio_printf    (io, user, "    enclen='%d'\n", l); // safe
+            unsigned char encblob[BLOB_BLOCK_LINES * (BLOB_LINE_LENGTH + 1)];
+            const unsigned char *src = (const unsigned char *)blob;
+            size_t left = bloblen;
+
+            userio_printf    (io, user, "    enclen='%u'\n", (bloblen + 2) / 3 * 4); // safe
             userio_prints    (io, user, "    format='");
             userio_xml_escape(io, user, format);
             userio_prints    (io, user, "'>\n");
-            size_t written = 0;
-            // FIXME: this is not efficient. The CR/LF imply one more copy... Do we need them ?
-            while ((int)written < l)
+
+            // Encode and write a block of lines at a time. Outputs that can join
+            // buffers never get here: this is stdio, whose buffer is its own
+            while (left > 0)
             {
-                size_t towrite = ((l - written) > 72) ? 72 : l - written;
-                size_t wr      = userio_write(io, user, encblob + written, towrite);
+                size_t count = left < BLOB_BLOCK_BYTES ? left : BLOB_BLOCK_BYTES;
+                size_t l     = to64frombits_lines(encblob, src, count, BLOB_LINE_LENGTH);
 
-                if (wr == 0)
-                {
-                    free(encblob);
+                if (userio_write(io, user, encblob, l) == 0)
                     return;
-                }
 
-                written += wr;
-                if ((written % 72) == 0)
-                    userio_putc(io, user, '\n');
+                src  += count;
+                left -= count;
             }
-
-            if ((written % 72) != 0)
-                userio_putc(io, user, '\n');
-
-            free(encblob);
         }
     }
 
@@ -784,6 +776,11 @@ void IUUserIOUpdateMinMax(
     indi_locale_C_numeric_pop(orig);
 }
 
+void IUUserIOGetBLOBDemand(const userio * io, void *user)
+{
+    userio_prints    (io, user, "<getBLOBDemand/>\n");
+}
+
 void IUUserIOPingRequest(const userio * io, void *user, const char * pingUid)
 {
     userio_prints    (io, user, "<pingRequest uid='");
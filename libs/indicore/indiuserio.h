@@ -89,6 +89,8 @@ void IDUserIOMessageVA(const userio *io, void *user, const char *dev, const char
 
 void IUUserIOConfigTag(const userio *io, void *user, int ctag);
 
+void IUUserIOGetBLOBDemand(const userio * io, void *user);
+
 void IUUserIOPingRequest(const userio * io, void *user, const char * pingUid);
 void IUUserIOPingReply(const userio * io, void *user, const char * pingUid);
 
@@ -31,11 +31,16 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110 - 1301  USA
  */
 
 #include <ctype.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
+#include <atomic>
+#include <mutex>
+#include <new>
+
 #if defined(_MSC_VER)
 #define snprintf _snprintf
 #pragma warning(push)
@@ -45,30 +50,56 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110 - 1301  USA
 
 #include "lilxml.h"
 
+typedef struct XMLArena_ XMLArena;
+
 /* used to efficiently manage growing malloced string space */
 typedef struct
 {
-    char *s; /* malloced memory for string */
-    int sl;  /* string length, sans trailing \0 */
-    int sm;  /* total malloced bytes */
+    char *s;         /* malloced memory for string */
+    int sl;          /* string length, sans trailing \0 */
+    int sm;          /* total malloced bytes */
+    XMLArena *arena; /* holder of s if not malloced */
 } String;
 #define MINMEM 64 /* starting string length */
 
+/* memory of a parsed document, see newArena() */
+#define ARENA_BLOCK   4096 /* bytes of the first block, and least of the others */
+#define ARENA_MINMEM  16   /* starting string length */
+#define ARENA_MAXMEM  2048 /* longer strings are moved to malloced memory */
+#define ARENA_CACHED  64   /* first blocks kept for new documents */
+
+#define BLOB_LINE    72         /* base64 characters per line of BLOB content */
+#define BLOB_MAXHINT (32 << 20) /* most of a BLOB preallocated before any of its content arrived */
+
 static int oneXMLchar(LilXML *lp, int c, char ynot[]);
 static void initParser(LilXML *lp);
 static void pushXMLEle(LilXML *lp);
 static void popXMLEle(LilXML *lp);
 static void resetEndTag(LilXML *lp);
 static XMLAtt *growAtt(XMLEle *e);
-static XMLEle *growEle(XMLEle *pe);
+static XMLEle *growEle(XMLEle *pe, XMLArena *arena);
 static void freeAtt(XMLAtt *a);
 static int isTokenChar(int start, int c);
 static void growString(String *sp, int c);
+static void reserveString(String *sp, int l);
+static void resizeString(String *sp, int sm);
 static void appendString(String *sp, const char *str);
+static void appendBytes(String *sp, const char *str, int len);
 static void freeString(String *sp);
 static void newString(String *sp);
+static void resetString(String *sp);
+static void newArenaString(String *sp, XMLArena *arena);
 static void *moremem(void *old, size_t n);
 static void appXMLEle(XMLEle *ep, XMLEle *newep);
+static XMLArena *newArena();
+static void releaseArena(XMLArena *arena);
+static void *arenaAlloc(XMLArena *arena, size_t n);
+static void *arenaGrow(XMLArena *arena, void *old, size_t oldn, size_t n);
+static void *growList(XMLArena *arena, void *list, int n, size_t itemsize);
+static XMLEle *rootXMLEle(XMLEle *ep);
+static void sizeContent(LilXML *lp);
+static XMLAtom atomString(String *sp);
+static char *contentRun(LilXML *lp, char *s, int n);
 
 typedef enum
 {
@@ -100,7 +131,9 @@ struct LilXML_
     int delim;     /* attribute value delimiter */
     int lastc;     /* last char (just used with skipping)*/
     int skipping;  /* in comment or declaration */
-    int inblob;    /* in oneBLOB element */
+    int inblob;    /* room announced for the content of the current oneBLOB, 0 if none */
+    int usearena;  /* allocate documents in arenas */
+    XMLArena *arena; /* arena of the document being parsed */
 };
 
 /* internal representation of a (possibly nested) XML element */
@@ -116,6 +149,8 @@ struct xml_ele_
     int eit;           /* used to iterate over el[] */
     String pcdata;     /* character data in this element */
     int pcdata_hasent; /* 1 if pcdata contains an entity char*/
+    XMLArena *arena;   /* holder of this element, its lists and attributes, or NULL if malloced */
+    XMLAtom atom;      /* interned tag */
 };
 
 /* internal representation of an attribute */
@@ -124,13 +159,14 @@ struct xml_att_
     String name; /* name */
     String valu; /* value */
     XMLEle *ce;  /* containing element */
+    XMLAtom atom; /* interned name */
 };
 
 /* characters that need escaping as "entities" in attr values and pcdata
  */
 static char entities[] = "&<>'\"";
 
-/* default memory managers, override with lilxmlMalloc() */
+/* default memory managers, override with indi_xmlMalloc() */
 static void *(*mymalloc)(size_t size)             = malloc;
 static void *(*myrealloc)(void *ptr, size_t size) = realloc;
 static void (*myfree)(void *ptr)                  = free;
@@ -138,14 +174,201 @@ static void (*myfree)(void *ptr)                  = free;
 /* install new version of malloc/realloc/free.
  * N.B. don't call after first use of any other lilxml function
  */
-void lilxmlMalloc(void *(*newmalloc)(size_t size), void *(*newrealloc)(void *ptr, size_t size),
-                  void (*newfree)(void *ptr))
+void indi_xmlMalloc(void *(*newmalloc)(size_t size), void *(*newrealloc)(void *ptr, size_t size),
+                    void (*newfree)(void *ptr))
 {
     mymalloc  = newmalloc;
     myrealloc = newrealloc;
     myfree    = newfree;
 }
 
+/* The elements of a document parsed with an arena, their attributes, lists
+ * and strings are carved out of a few large blocks instead of being malloced
+ * one by one. The arena lives as long as one of the elements: it counts them,
+ * and its blocks go when the last one is deleted. The first block is then
+ * kept for another document, so a steady flow of small messages is parsed
+ * without calling malloc at all.
+ *
+ * Strings only stay in the arena while short: pcdata of BLOBs and the likes
+ * are moved to malloced memory as they grow. Strings replaced by editing
+ * functions are malloced too.
+ */
+typedef struct ArenaBlock_
+{
+    struct ArenaBlock_ *next; /* other blocks of the arena */
+} ArenaBlock;
+
+struct XMLArena_
+{
+    std::atomic<int> nele; /* elements alive */
+    char *pos;             /* free space of the current block */
+    char *end;
+    char *last;            /* last allocation, that can grow in place */
+    ArenaBlock *blocks;    /* blocks after the first one */
+};
+
+/* allocations are aligned for any of our structures */
+#define ARENA_ALIGN(n) (((n) + 7) & ~(size_t)7)
+
+static std::mutex arenaCacheLock;
+static void *arenaCache[ARENA_CACHED];
+static int arenaCached = 0;
+
+/* an arena for a new document */
+static XMLArena *newArena()
+{
+    void *block = NULL;
+    {
+        std::lock_guard<std::mutex> guard(arenaCacheLock);
+        if (arenaCached > 0)
+            block = arenaCache[--arenaCached];
+    }
+    if (!block)
+        block = moremem(NULL, ARENA_BLOCK);
+
+    XMLArena *arena = new (block) XMLArena;
+    arena->nele   = 0;
+    arena->pos    = (char *)block + ARENA_ALIGN(sizeof(XMLArena));
+    arena->end    = (char *)block + ARENA_BLOCK;
+    arena->last   = NULL;
+    arena->blocks = NULL;
+    return arena;
+}
+
+/* the last element of arena is gone */
+static void releaseArena(XMLArena *arena)
+{
+    ArenaBlock *block = arena->blocks;
+    while (block)
+    {
+        ArenaBlock *next = block->next;
+        (*myfree)(block);
+        block = next;
+    }
+
+    arena->~XMLArena();
+    {
+        std::lock_guard<std::mutex> guard(arenaCacheLock);
+        if (arenaCached < ARENA_CACHED)
+        {
+            arenaCache[arenaCached++] = arena;
+            return;
+        }
+    }
+    (*myfree)(arena);
+}
+
+/* n bytes from arena */
+static void *arenaAlloc(XMLArena *arena, size_t n)
+{
+    n = ARENA_ALIGN(n);
+    if ((size_t)(arena->end - arena->pos) < n)
+    {
+        size_t header = ARENA_ALIGN(sizeof(ArenaBlock));
+        size_t size   = header + n > ARENA_BLOCK ? header + n : ARENA_BLOCK;
+        ArenaBlock *block = (ArenaBlock *)moremem(NULL, size);
+
+        block->next   = arena->blocks;
+        arena->blocks = block;
+        arena->pos    = (char *)block + header;
+        arena->end    = (char *)block + size;
+    }
+
+    arena->last = arena->pos;
+    arena->pos += n;
+    return arena->last;
+}
+
+/* resize old, of oldn bytes, to n bytes. in place if it was the last allocation */
+static void *arenaGrow(XMLArena *arena, void *old, size_t oldn, size_t n)
+{
+    if (old && old == arena->last && (size_t)(arena->end - (char *)old) >= ARENA_ALIGN(n))
+    {
+        arena->pos = (char *)old + ARENA_ALIGN(n);
+        return old;
+    }
+
+    void *p = arenaAlloc(arena, n);
+    if (old)
+        memcpy(p, old, oldn);
+    return p;
+}
+
+/* return list, which has n items, with room for one more.
+ * in an arena, lists have room for 4 items then powers of 2.
+ */
+static void *growList(XMLArena *arena, void *list, int n, size_t itemsize)
+{
+    if (!arena)
+        return moremem(list, (n + 1) * itemsize);
+
+    if (n == 0 || (n >= 4 && (n & (n - 1)) == 0))
+        return arenaGrow(arena, list, n * itemsize, (n ? 2 * n : 4) * itemsize);
+    return list;
+}
+
+/* Tags and attribute names of the protocol are interned as they are parsed
+ * or set, so dispatch code can compare integers instead of strings. They are
+ * found in a small open addressing table keyed by their FNV-1a hash.
+ */
+#define XML_ATOM_NAME(n) #n,
+static const char *atomNames[XMLATOM_COUNT] = { "", XML_ATOMS(XML_ATOM_NAME) };
+#undef XML_ATOM_NAME
+
+#define ATOM_SLOTS 256 /* power of 2, well above XMLATOM_COUNT */
+
+static unsigned atomHash(const char *s, int l)
+{
+    unsigned h = 2166136261u;
+    for (int i = 0; i < l; i++)
+        h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+/* the atom of the l characters at s, which end with a \0 */
+static XMLAtom lookupAtom(const char *s, int l)
+{
+    static unsigned char slots[ATOM_SLOTS];
+    static const bool ready = []()
+    {
+        for (int a = 1; a < XMLATOM_COUNT; a++)
+        {
+            unsigned h = atomHash(atomNames[a], int(strlen(atomNames[a])));
+            while (slots[h & (ATOM_SLOTS - 1)])
+                h++;
+            slots[h & (ATOM_SLOTS - 1)] = (unsigned char)a;
+        }
+        return true;
+    }();
+    (void)ready;
+
+    for (unsigned h = atomHash(s, l); slots[h & (ATOM_SLOTS - 1)]; h++)
+    {
+        int a = slots[h & (ATOM_SLOTS - 1)];
+        if (!strcmp(atomNames[a], s))
+            return (XMLAtom)a;
+    }
+    return XMLATOM_NONE;
+}
+
+/* the atom of the string at sp */
+static XMLAtom atomString(String *sp)
+{
+    return sp->s ? lookupAtom(sp->s, sp->sl) : XMLATOM_NONE;
+}
+
+/* return the atom of name */
+XMLAtom atomXML(const char *name)
+{
+    return lookupAtom(name, int(strlen(name)));
+}
+
+/* return the name atom stands for */
+const char *atomNameXML(XMLAtom atom)
+{
+    return (atom > XMLATOM_NONE && atom < XMLATOM_COUNT ? atomNames[atom] : "");
+}
+
 /* pass back a fresh handle for use with our other functions */
 LilXML *newLilXML()
 {
@@ -158,11 +381,18 @@ LilXML *newLilXML()
 /* discard */
 void delLilXML(LilXML *lp)
 {
-    delXMLEle(lp->ce);
+    delXMLEle(rootXMLEle(lp->ce));
     freeString(&lp->endtag);
+    freeString(&lp->entity);
     (*myfree)(lp);
 }
 
+/* allocate the documents parsed from now on in arenas */
+void setArenaLilXML(LilXML *lp, int on)
+{
+    lp->usearena = on;
+}
+
 /* delete ep and all its children and remove from parent's list if known */
 void delXMLEle(XMLEle *ep)
 {
@@ -179,7 +409,8 @@ void delXMLEle(XMLEle *ep)
     {
         for (i = 0; i < ep->nat; i++)
             freeAtt(ep->at[i]);
-        (*myfree)(ep->at);
+        if (!ep->arena)
+            (*myfree)(ep->at);
     }
     if (ep->el)
     {
@@ -190,7 +421,8 @@ void delXMLEle(XMLEle *ep)
 
             delXMLEle(ep->el[i]);
         }
-        (*myfree)(ep->el);
+        if (!ep->arena)
+            (*myfree)(ep->el);
     }
 
     /* remove from parent's list if known */
@@ -208,10 +440,12 @@ void delXMLEle(XMLEle *ep)
     }
 
     /* delete ep itself */
-    (*myfree)(ep);
+    if (!ep->arena)
+        (*myfree)(ep);
+    else if (--ep->arena->nele == 0)
+        releaseArena(ep->arena);
 }
 
-//#define WITH_MEMCHR
 XMLEle **parseXMLChunk(LilXML *lp, char *buf, int size, char ynot[])
 {
     unsigned int nnodes     = 1;
@@ -221,80 +455,27 @@ XMLEle **parseXMLChunk(LilXML *lp, char *buf, int size, char ynot[])
     int s;
     ynot[0] = '\0';
 
-    if (lp->inblob)
-    {
-#ifdef WITH_ENCLEN
-        if (size < lp->ce->pcdata.sm - lp->ce->pcdata.sl)
-        {
-            memcpy((void *)(lp->ce->pcdata.s + lp->ce->pcdata.sl), (const void *)buf, size);
-            lp->ce->pcdata.sl += size;
-            return nodes;
-        }
-        else
-            lp->inblob = 0;
-#endif
-#ifdef WITH_MEMCHR
-        char *ltpos = memchr(buf, '<', size);
-        if (!ltpos)
-        {
-            lp->ce->pcdata.s = (char *)moremem(lp->ce->pcdata.s, lp->ce->pcdata.sm + size);
-            lp->ce->pcdata.sm += size;
-            memcpy((void *)(lp->ce->pcdata.s + lp->ce->pcdata.sl), (const void *)buf, size);
-            lp->ce->pcdata.sl += size;
-            return nodes;
-        }
-        else
-            lp->inblob = 0;
-#endif
-    }
-    else
+    while (curr - buf < size)
     {
-        if (lp->ce)
+        /* plain character data is appended in runs */
+        if (lp->cs == INCON && !lp->skipping && lp->lastc != '<')
         {
-            char *ctag = tagXMLEle(lp->ce);
-            if (ctag && !(strcmp(ctag, "oneBLOB")) && (lp->cs == INCON))
+            char *end = contentRun(lp, curr, size - int(curr - buf));
+            if (end > curr)
             {
-#ifdef WITH_ENCLEN
-                XMLAtt *blenatt = findXMLAtt(lp->ce, "enclen");
-                if (blenatt)
-                {
-                    int blen;
-                    sscanf(valuXMLAtt(blenatt), "%d", &blen);
-
-                    // Add room for those '\n' on every 72 character line + extra half-full line.
-                    blen += (blen / 72) + 1;
-
-                    lp->ce->pcdata.s  = (char *)moremem(lp->ce->pcdata.s, blen);
-                    lp->ce->pcdata.sm = blen; // always set sm
-
-                    if (size <= blen - lp->ce->pcdata.sl)
-                    {
-                        memcpy((void *)(lp->ce->pcdata.s + lp->ce->pcdata.sl), (const void *)buf, size);
-                        lp->ce->pcdata.sl += size;
-                        lp->inblob = 1;
-                        return nodes;
-                    }
-                }
-#endif
-#ifdef WITH_MEMCHR
-                char *ltpos = memchr(buf, '<', size);
-                if (!ltpos)
-                {
-                    lp->ce->pcdata.s = (char *)moremem(lp->ce->pcdata.s, lp->ce->pcdata.sm + size);
-                    lp->ce->pcdata.sm += size;
-                    memcpy((void *)(lp->ce->pcdata.s + lp->ce->pcdata.sl), (const void *)buf, size);
-                    lp->ce->pcdata.sl += size;
-                    lp->inblob = 1;
-                    return nodes;
-                }
-                else
-                    lp->inblob = 0;
-#endif
+                String *sp = &lp->ce->pcdata;
+                int l = sp->sl + int(end - curr) + 1;
+
+                /* grow a BLOB at the pace of its content, up to the size it announced */
+                if (lp->inblob && l > sp->sm && l <= lp->inblob)
+                    resizeString(sp, sp->sm > lp->inblob / 2 ? lp->inblob : (l > 2 * sp->sm ? l : 2 * sp->sm));
+                appendBytes(sp, curr, int(end - curr));
+                lp->lastc = end[-1];
+                curr      = end;
+                continue;
             }
         }
-    }
-    while (curr - buf < size)
-    {
+
         char newc = *curr;
         /* EOF? */
         if (newc == 0)
@@ -531,6 +712,19 @@ XMLAtt *findXMLAtt(XMLEle *ep, const char *name)
     return (NULL);
 }
 
+/* search ep for an attribute with given atom.
+ * return NULL if not found.
+ */
+XMLAtt *findXMLAttAtom(XMLEle *ep, XMLAtom name)
+{
+    int i;
+
+    for (i = 0; i < ep->nat; i++)
+        if (ep->at[i]->atom == name)
+            return (ep->at[i]);
+    return (NULL);
+}
+
 /* search ep for an element with given tag.
  * return NULL if not found.
  */
@@ -602,6 +796,12 @@ char *tagXMLEle(XMLEle *ep)
     return (ep->tag.s);
 }
 
+/* return the interned tag of the given element */
+XMLAtom tagAtomXMLEle(XMLEle *ep)
+{
+    return (ep->atom);
+}
+
 /* return the pcdata portion of the given element */
 char *pcdataXMLEle(XMLEle *ep)
 {
@@ -620,6 +820,12 @@ char *nameXMLAtt(XMLAtt *ap)
     return (ap->name.s);
 }
 
+/* return the interned name of the given attribute */
+XMLAtom nameAtomXMLAtt(XMLAtt *ap)
+{
+    return (ap->atom);
+}
+
 /* return the value of the given attribute */
 char *valuXMLAtt(XMLAtt *ap)
 {
@@ -647,6 +853,15 @@ const char *findXMLAttValu(XMLEle *ep, const char *name)
     return (a ? a->valu.s : "");
 }
 
+/* search ep for an attribute with the given atom and return its value.
+ * return "" if not found.
+ */
+const char *findXMLAttValuAtom(XMLEle *ep, XMLAtom name)
+{
+    XMLAtt *a = findXMLAttAtom(ep, name);
+    return (a ? a->valu.s : "");
+}
+
 /* handy wrapper to read one xml file.
  * return root element else NULL with report in ynot[]
  */
@@ -669,8 +884,9 @@ XMLEle *readXMLFile(FILE *fp, LilXML *lp, char ynot[])
  */
 XMLEle *addXMLEle(XMLEle *parent, const char *tag)
 {
-    XMLEle *ep = growEle(parent);
+    XMLEle *ep = growEle(parent, NULL);
     appendString(&ep->tag, tag);
+    ep->atom = atomString(&ep->tag);
     return (ep);
 }
 
@@ -679,7 +895,7 @@ XMLEle *addXMLEle(XMLEle *parent, const char *tag)
  */
 static void appXMLEle(XMLEle *ep, XMLEle *newep)
 {
-    ep->el            = (XMLEle **)moremem(ep->el, (ep->nel + 1) * sizeof(XMLEle *));
+    ep->el            = (XMLEle **)growList(ep->arena, ep->el, ep->nel, sizeof(XMLEle *));
     ep->el[ep->nel++] = newep;
 }
 
@@ -690,6 +906,7 @@ XMLEle *setXMLEleTag(XMLEle *ep, const char * tag)
     freeString(&ep->tag);
     newString(&ep->tag);
     appendString(&ep->tag, tag);
+    ep->atom = atomString(&ep->tag);
     return ep;
 }
 
@@ -708,6 +925,7 @@ XMLAtt *addXMLAtt(XMLEle *ep, const char *name, const char *valu)
     XMLAtt *ap = growAtt(ep);
     appendString(&ap->name, name);
     appendString(&ap->valu, valu);
+    ap->atom = atomString(&ap->name);
     return (ap);
 }
 
@@ -1090,9 +1308,16 @@ static int oneXMLchar(LilXML *lp, int c, char ynot[])
 
         case INTAG: /* reading tag */
             if (isTokenChar(0, c))
+            {
                 growString(&lp->ce->tag, c);
-            else if (c == '>')
+                break;
+            }
+            lp->ce->atom = atomString(&lp->ce->tag);
+            if (c == '>')
+            {
+                sizeContent(lp);
                 lp->cs = LOOK4CON;
+            }
             else if (c == '/')
                 lp->cs = SAWSLASH;
             else
@@ -1101,7 +1326,10 @@ static int oneXMLchar(LilXML *lp, int c, char ynot[])
 
         case LOOK4ATTRN: /* looking for attr name, > or / */
             if (c == '>')
+            {
+                sizeContent(lp);
                 lp->cs = LOOK4CON;
+            }
             else if (c == '/')
                 lp->cs = SAWSLASH;
             else if (isTokenChar(1, c))
@@ -1136,7 +1364,11 @@ static int oneXMLchar(LilXML *lp, int c, char ynot[])
             if (isTokenChar(0, c))
                 growString(&lp->ce->at[lp->ce->nat - 1]->name, c);
             else if (isspace(c) || c == '=')
-                lp->cs = LOOK4ATTRV;
+            {
+                XMLAtt *ap = lp->ce->at[lp->ce->nat - 1];
+                ap->atom   = atomString(&ap->name);
+                lp->cs     = LOOK4ATTRV;
+            }
             else
             {
                 sprintf(ynot, "Line %d: Bogus attr name char: %c", lp->ln, c);
@@ -1160,7 +1392,7 @@ static int oneXMLchar(LilXML *lp, int c, char ynot[])
         case INATTRV: /* in attr value */
             if (c == '&')
             {
-                newString(&lp->entity);
+                resetString(&lp->entity);
                 growString(&lp->entity, c);
                 lp->cs = ENTINATTRV;
             }
@@ -1179,7 +1411,6 @@ static int oneXMLchar(LilXML *lp, int c, char ynot[])
                     growString(&lp->ce->at[lp->ce->nat - 1]->valu, c);
                 else
                     appendString(&lp->ce->at[lp->ce->nat - 1]->valu, lp->entity.s);
-                freeString(&lp->entity);
                 lp->cs = INATTRV;
             }
             else
@@ -1199,7 +1430,7 @@ static int oneXMLchar(LilXML *lp, int c, char ynot[])
         case INCON: /* reading content */
             if (c == '&')
             {
-                newString(&lp->entity);
+                resetString(&lp->entity);
                 growString(&lp->entity, c);
                 lp->cs = ENTINCON;
             }
@@ -1232,7 +1463,6 @@ static int oneXMLchar(LilXML *lp, int c, char ynot[])
                 // pcdata_hasent to 1 since we need to encode it again
                 // before sending it over to clients and drivers.
                 lp->ce->pcdata_hasent = 1;
-                freeString(&lp->entity);
                 lp->cs = INCON;
             }
             else
@@ -1303,10 +1533,17 @@ static int oneXMLchar(LilXML *lp, int c, char ynot[])
 /* set up for a fresh start again */
 static void initParser(LilXML *lp)
 {
-    delXMLEle(lp->ce);
-    freeString(&lp->endtag);
+    /* the strings of the parser are kept */
+    String endtag = lp->endtag;
+    String entity = lp->entity;
+    int usearena  = lp->usearena;
+
+    delXMLEle(rootXMLEle(lp->ce));
     memset(lp, 0, sizeof(*lp));
-    newString(&lp->endtag);
+    lp->endtag = endtag;
+    lp->entity = entity;
+    lp->usearena = usearena;
+    resetString(&lp->endtag);
     lp->cs = LOOK4START;
     lp->ln = 1;
 }
@@ -1318,7 +1555,10 @@ static void initParser(LilXML *lp)
  */
 static void pushXMLEle(LilXML *lp)
 {
-    lp->ce = growEle(lp->ce);
+    if (!lp->ce && lp->usearena)
+        lp->arena = newArena();
+    lp->ce = growEle(lp->ce, lp->arena);
+    lp->inblob = 0;
     resetEndTag(lp);
 }
 
@@ -1328,22 +1568,95 @@ static void pushXMLEle(LilXML *lp)
 static void popXMLEle(LilXML *lp)
 {
     lp->ce = lp->ce->pe;
+    lp->inblob = 0;
     resetEndTag(lp);
 }
 
-/* return one new XMLEle, added to the given element if given */
-static XMLEle *growEle(XMLEle *pe)
+/* the opening tag of ce is complete.
+ * if ce is a oneBLOB announcing the size of its content, make room for it: all of it
+ * when small, else BLOB_MAXHINT and the rest as it arrives. A peer can announce
+ * anything, so the announced size is never trusted further.
+ */
+static void sizeContent(LilXML *lp)
+{
+    XMLEle *ep = lp->ce;
+    XMLAtt *ap;
+    long n;
+
+    if (ep->atom != XMLATOM_oneBLOB)
+        return;
+
+    /* enclen counts base64 characters, len the bytes they encode unless attached */
+    if ((ap = findXMLAttAtom(ep, XMLATOM_enclen)) != NULL)
+        n = atol(ap->valu.s);
+    else if ((ap = findXMLAttAtom(ep, XMLATOM_len)) != NULL && strcmp(findXMLAttValuAtom(ep, XMLATOM_attached), "true"))
+        n = (atol(ap->valu.s) + 2) / 3 * 4;
+    else
+        return;
+    if (n <= 0)
+        return;
+
+    /* room for a line feed per line and the trailing \0 */
+    unsigned long long room = ep->pcdata.sl + (unsigned long long)n + n / BLOB_LINE + 2;
+    if (room > INT_MAX)
+        return;
+
+    reserveString(&ep->pcdata, int(room < BLOB_MAXHINT ? room : BLOB_MAXHINT));
+    lp->inblob = int(room);
+}
+
+/* return the end of the plain characters starting at s, at most n, and count their lines.
+ * BLOB content is searched with memchr, it has no entities and rarely ends in this run.
+ */
+static char *contentRun(LilXML *lp, char *s, int n)
 {
-    XMLEle *newe = (XMLEle *)moremem(NULL, sizeof(XMLEle));
+    char *end = s + n;
+    char *p;
+
+    if (lp->inblob)
+    {
+        if ((p = (char *)memchr(s, '<', n)) != NULL)
+            end = p;
+        if ((p = (char *)memchr(s, '&', end - s)) != NULL)
+            end = p;
+        if ((p = (char *)memchr(s, '\0', end - s)) != NULL)
+            end = p;
+        for (p = s; (p = (char *)memchr(p, '\n', end - p)) != NULL; p++)
+            lp->ln++;
+        return end;
+    }
+
+    for (p = s; p < end && *p != '<' && *p != '&' && *p != '\0'; p++)
+    {
+        if (*p == '\n')
+            lp->ln++;
+    }
+    return p;
+}
+
+/* return one new XMLEle, in arena if not NULL, added to the given element if given */
+static XMLEle *growEle(XMLEle *pe, XMLArena *arena)
+{
+    XMLEle *newe = (XMLEle *)(arena ? arenaAlloc(arena, sizeof(XMLEle)) : moremem(NULL, sizeof(XMLEle)));
 
     memset(newe, 0, sizeof(XMLEle));
-    newString(&newe->tag);
-    newString(&newe->pcdata);
-    newe->pe = pe;
+    if (arena)
+    {
+        arena->nele++;
+        newArenaString(&newe->tag, arena);
+        newArenaString(&newe->pcdata, arena);
+    }
+    else
+    {
+        newString(&newe->tag);
+        newString(&newe->pcdata);
+    }
+    newe->arena = arena;
+    newe->pe    = pe;
 
     if (pe)
     {
-        pe->el            = (XMLEle **)moremem(pe->el, (pe->nel + 1) * sizeof(XMLEle *));
+        pe->el            = (XMLEle **)growList(pe->arena, pe->el, pe->nel, sizeof(XMLEle *));
         pe->el[pe->nel++] = newe;
     }
 
@@ -1353,14 +1666,22 @@ static XMLEle *growEle(XMLEle *pe)
 /* add room for and return one new XMLAtt to the given element */
 static XMLAtt *growAtt(XMLEle *ep)
 {
-    XMLAtt *newa = (XMLAtt *)moremem(NULL, sizeof * newa);
+    XMLAtt *newa = (XMLAtt *)(ep->arena ? arenaAlloc(ep->arena, sizeof * newa) : moremem(NULL, sizeof * newa));
 
     memset(newa, 0, sizeof(*newa));
-    newString(&newa->name);
-    newString(&newa->valu);
+    if (ep->arena)
+    {
+        newArenaString(&newa->name, ep->arena);
+        newArenaString(&newa->valu, ep->arena);
+    }
+    else
+    {
+        newString(&newa->name);
+        newString(&newa->valu);
+    }
     newa->ce = ep;
 
-    ep->at            = (XMLAtt **)moremem(ep->at, (ep->nat + 1) * sizeof(XMLAtt *));
+    ep->at            = (XMLAtt **)growList(ep->arena, ep->at, ep->nat, sizeof(XMLAtt *));
     ep->at[ep->nat++] = newa;
 
     return (newa);
@@ -1373,14 +1694,22 @@ static void freeAtt(XMLAtt *a)
         return;
     freeString(&a->name);
     freeString(&a->valu);
-    (*myfree)(a);
+    if (!a->ce->arena)
+        (*myfree)(a);
 }
 
 /* reset endtag */
 static void resetEndTag(LilXML *lp)
 {
-    freeString(&lp->endtag);
-    newString(&lp->endtag);
+    resetString(&lp->endtag);
+}
+
+/* return the root of the tree holding ep */
+static XMLEle *rootXMLEle(XMLEle *ep)
+{
+    while (ep && ep->pe)
+        ep = ep->pe;
+    return (ep);
 }
 
 /* 1 if c is a valid token character, else 0.
@@ -1397,14 +1726,7 @@ static void growString(String *sp, int c)
     int l = sp->sl + 2; /* need room for '\0' plus c */
 
     if (l > sp->sm)
-    {
-        if (!sp->s)
-            newString(sp);
-        else
-        {
-            sp->s = (char *)moremem(sp->s, sp->sm *= 2);
-        }
-    }
+        reserveString(sp, l);
     sp->s[--l] = '\0';
     sp->s[--l] = (char)c;
     sp->sl++;
@@ -1416,23 +1738,64 @@ static void appendString(String *sp, const char *str)
     if (!sp || !str)
         return;
 
-    int strl = int(strlen(str));
-    int l    = sp->sl + strl + 1; /* need room for '\0' */
+    appendBytes(sp, str, int(strlen(str)));
+}
+
+/* append the len bytes at str to the String storage at *sp */
+static void appendBytes(String *sp, const char *str, int len)
+{
+    int l = sp->sl + len + 1; /* need room for '\0' */
 
     if (l > sp->sm)
+        reserveString(sp, l);
+    memcpy(&sp->s[sp->sl], str, len);
+    sp->sl += len;
+    sp->s[sp->sl] = '\0';
+}
+
+/* make room for at least l bytes in the String storage at *sp, doubling its size.
+ * strings of an arena move to malloced memory past ARENA_MAXMEM.
+ */
+static void reserveString(String *sp, int l)
+{
+    if (!sp->s)
+        newString(sp);
+
+    /* l went past INT_MAX */
+    if (l < 0)
     {
-        if (!sp->s)
-            newString(sp);
-        if (l > sp->sm)
-        {
-            sp->s = (char *)moremem(sp->s, (sp->sm = l));
-        }
+        fprintf(stderr, "%s(%s): String too long.\n", __FILE__, __func__);
+        exit(1);
     }
-    if (sp->s)
+
+    size_t sm = sp->sm;
+    while (sm < (size_t)l)
+        sm *= 2;
+    if (sm == (size_t)sp->sm)
+        return;
+
+    /* no string is longer than INT_MAX, which l never exceeds */
+    resizeString(sp, sm > INT_MAX ? INT_MAX : int(sm));
+}
+
+/* set the storage of the String at *sp to sm bytes, at least its length plus \0 */
+static void resizeString(String *sp, int sm)
+{
+    if (!sp->s)
+        newString(sp);
+
+    if (!sp->arena)
+        sp->s = (char *)moremem(sp->s, sm);
+    else if (sm <= ARENA_MAXMEM)
+        sp->s = (char *)arenaGrow(sp->arena, sp->s, sp->sl + 1, sm);
+    else
     {
-        strcpy(&sp->s[sp->sl], str);
-        sp->sl += strl;
+        char *s = (char *)moremem(NULL, sm);
+        memcpy(s, sp->s, sp->sl + 1);
+        sp->s     = s;
+        sp->arena = NULL;
     }
+    sp->sm = sm;
 }
 
 /* init a String with a malloced string containing just \0 */
@@ -1441,8 +1804,31 @@ static void newString(String *sp)
     if (!sp)
         return;
 
-    sp->s  = (char *)moremem(NULL, MINMEM);
-    sp->sm = MINMEM;
+    sp->s     = (char *)moremem(NULL, MINMEM);
+    sp->sm    = MINMEM;
+    *sp->s    = '\0';
+    sp->sl    = 0;
+    sp->arena = NULL;
+}
+
+/* init a String with a string of arena containing just \0 */
+static void newArenaString(String *sp, XMLArena *arena)
+{
+    sp->s     = (char *)arenaAlloc(arena, ARENA_MINMEM);
+    sp->sm    = ARENA_MINMEM;
+    *sp->s    = '\0';
+    sp->sl    = 0;
+    sp->arena = arena;
+}
+
+/* empty the given String, keeping its memory */
+static void resetString(String *sp)
+{
+    if (!sp->s)
+    {
+        newString(sp);
+        return;
+    }
     *sp->s = '\0';
     sp->sl = 0;
 }
@@ -1450,11 +1836,12 @@ static void newString(String *sp)
 /* free memory used by the given String */
 static void freeString(String *sp)
 {
-    if (sp->s)
+    if (sp->s && !sp->arena)
         (*myfree)(sp->s);
-    sp->s  = NULL;
-    sp->sl = 0;
-    sp->sm = 0;
+    sp->s     = NULL;
+    sp->sl    = 0;
+    sp->sm    = 0;
+    sp->arena = NULL;
 }
 
 /* like malloc but knows to use realloc if already started */
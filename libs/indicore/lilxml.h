@@ -75,6 +75,39 @@ typedef struct xml_att_ XMLAtt;
 typedef struct xml_ele_ XMLEle;
 typedef struct LilXML_ LilXML;
 
+/* names of the INDI protocol, interned by the parser.
+ * the vectors of each kind are listed together, so they form ranges.
+ * Append only: the values of XMLAtom follow this list and are compiled into
+ * code using this header. New names go at the end, none is ever removed.
+ */
+#define XML_ATOMS(X) \
+    X(getProperties) X(delProperty) X(message) X(enableBLOB) X(pingRequest) X(pingReply) \
+    X(defTextVector) X(defNumberVector) X(defSwitchVector) X(defLightVector) X(defBLOBVector) \
+    X(setTextVector) X(setNumberVector) X(setSwitchVector) X(setLightVector) X(setBLOBVector) \
+    X(newTextVector) X(newNumberVector) X(newSwitchVector) X(newBLOBVector) \
+    X(defText) X(defNumber) X(defSwitch) X(defLight) X(defBLOB) \
+    X(oneText) X(oneNumber) X(oneSwitch) X(oneLight) X(oneBLOB) \
+    X(version) X(device) X(name) X(label) X(group) X(state) X(perm) X(rule) X(timeout) X(timestamp) \
+    X(format) X(min) X(max) X(step) X(size) X(enclen) X(len) X(attached) \
+    X(getBLOBDemand) X(blobDemand) X(enableCompression) X(enableBinaryFraming)
+
+#define XML_ATOM_ENUM(n) XMLATOM_##n,
+
+/** \brief Interned name of a tag or an attribute, XMLATOM_NONE for names not in XML_ATOMS. */
+typedef enum
+{
+    XMLATOM_NONE = 0,
+    XML_ATOMS(XML_ATOM_ENUM)
+    XMLATOM_COUNT /* grows with the list: not a stable value */
+} XMLAtom;
+
+#undef XML_ATOM_ENUM
+
+/* kind of vector of an atom */
+#define XMLATOM_IS_DEF(a) ((a) >= XMLATOM_defTextVector && (a) <= XMLATOM_defBLOBVector)
+#define XMLATOM_IS_SET(a) ((a) >= XMLATOM_setTextVector && (a) <= XMLATOM_setBLOBVector)
+#define XMLATOM_IS_NEW(a) ((a) >= XMLATOM_newTextVector && (a) <= XMLATOM_newBLOBVector)
+
 /**
  * \defgroup lilxmlFunctions XML Functions: Functions to parse, process, and search XML.
  */
@@ -92,6 +125,13 @@ extern LilXML *newLilXML();
 */
 extern void delLilXML(LilXML *lp);
 
+/** \brief Allocate the documents parsed from now on in arenas.
+    \param lp a pointer to a lilxml parser.
+    \param on 1 to allocate each document, its attributes and short strings in a few large blocks, 0 to malloc them one by one.
+    \note The blocks of a document are released when its last element is deleted with delXMLEle(). Elements of a document may be edited as usual.
+*/
+extern void setArenaLilXML(LilXML *lp, int on);
+
 /**
  * @brief delXMLEle Delete XML element.
  * @param e Pointer to XML element to delete. If nullptr, no action is taken.
@@ -123,6 +163,13 @@ extern XMLEle *readXMLEle(LilXML *lp, int c, char errmsg[]);
 */
 extern XMLAtt *findXMLAtt(XMLEle *e, const char *name);
 
+/** \brief Find an XML attribute within an XML element by its interned name.
+    \param e a pointer to the XML element to search.
+    \param name the attribute atom to search for.
+    \return A pointer to the XML attribute if found or NULL on failure.
+*/
+extern XMLAtt *findXMLAttAtom(XMLEle *e, XMLAtom name);
+
 /** \brief Find an XML element within an XML element.
     \param e a pointer to the XML element to search.
     \param tag the element tag to search for.
@@ -163,6 +210,12 @@ extern XMLEle *parentXMLAtt(XMLAtt *ap);
 */
 extern char *tagXMLEle(XMLEle *ep);
 
+/** \brief Return the interned tag of an XML element.
+    \param ep a pointer to an XML element.
+    \return the atom of the tag, XMLATOM_NONE if it is not a name of XML_ATOMS.
+*/
+extern XMLAtom tagAtomXMLEle(XMLEle *ep);
+
 /** \brief Return the pcdata of an XML element.
     \param ep a pointer to an XML element.
     \return the pcdata string on success.
@@ -175,6 +228,12 @@ extern char *pcdataXMLEle(XMLEle *ep);
 */
 extern char *nameXMLAtt(XMLAtt *ap);
 
+/** \brief Return the interned name of an XML attribute.
+    \param ap a pointer to an XML attribute.
+    \return the atom of the name, XMLATOM_NONE if it is not a name of XML_ATOMS.
+*/
+extern XMLAtom nameAtomXMLAtt(XMLAtt *ap);
+
 /** \brief Return the value of an XML attribute.
     \param ap a pointer to an XML attribute.
     \return the value string of the attribute.
@@ -251,6 +310,25 @@ extern char *entityXML(char *str);
 */
 extern const char *findXMLAttValu(XMLEle *ep, const char *name);
 
+/** \brief Find an XML element's attribute value by its interned name.
+    \param ep a pointer to an XML element.
+    \param name the atom of the XML attribute to retrieve its value.
+    \return the value string of the attribute, "" if not found.
+*/
+extern const char *findXMLAttValuAtom(XMLEle *ep, XMLAtom name);
+
+/** \brief Return the atom of a name.
+    \param name a tag or attribute name.
+    \return the atom of name, XMLATOM_NONE if it is not a name of XML_ATOMS.
+*/
+extern XMLAtom atomXML(const char *name);
+
+/** \brief Return the name of an atom.
+    \param atom an atom other than XMLATOM_NONE.
+    \return the tag or attribute name the atom stands for.
+*/
+extern const char *atomNameXML(XMLAtom atom);
+
 /** \brief return a surface copy of a node.
     Don't copy childs or cdata.
     \return a new independent node
@@ -322,6 +322,31 @@ bool BaseDevice::buildSkeleton(const char *filename)
     return true;
 }
 
+// type of the properties of a def or set vector tag
+static INDI_PROPERTY_TYPE sVectorType(XMLAtom tag)
+{
+    switch (tag)
+    {
+        case XMLATOM_defNumberVector:
+        case XMLATOM_setNumberVector:
+            return INDI_NUMBER;
+        case XMLATOM_defSwitchVector:
+        case XMLATOM_setSwitchVector:
+            return INDI_SWITCH;
+        case XMLATOM_defTextVector:
+        case XMLATOM_setTextVector:
+            return INDI_TEXT;
+        case XMLATOM_defLightVector:
+        case XMLATOM_setLightVector:
+            return INDI_LIGHT;
+        case XMLATOM_defBLOBVector:
+        case XMLATOM_setBLOBVector:
+            return INDI_BLOB;
+        default:
+            return INDI_UNKNOWN;
+    }
+}
+
 int BaseDevice::buildProp(const INDI::LilXmlElement &root, char *errmsg, bool isDynamic)
 {
     D_PTR(BaseDevice);
@@ -334,29 +359,17 @@ int BaseDevice::buildProp(const INDI::LilXmlElement &root, char *errmsg, bool is
     }
 
     // find type of tag
-    static const std::map<INDI_PROPERTY_TYPE, std::string> tagTypeName =
-    {
-        {INDI_NUMBER, "defNumberVector"},
-        {INDI_SWITCH, "defSwitchVector"},
-        {INDI_TEXT,   "defTextVector"},
-        {INDI_LIGHT,  "defLightVector"},
-        {INDI_BLOB,   "defBLOBVector"}
-    };
+    const auto rootTagAtom = root.tagAtom();
+    const auto rootTagType = XMLATOM_IS_DEF(rootTagAtom) ? sVectorType(rootTagAtom) : INDI_UNKNOWN;
 
-    const auto rootTagName = root.tagName();
-    const auto rootTagType = std::find_if(tagTypeName.begin(), tagTypeName.end(), [&rootTagName](const auto & it)
+    if (rootTagType == INDI_UNKNOWN)
     {
-        return rootTagName == it.second;
-    });
-
-    if (rootTagType == tagTypeName.end())
-    {
-        snprintf(errmsg, MAXRBUF, "INDI: <%s> Unable to process tag", rootTagName.c_str());
+        snprintf(errmsg, MAXRBUF, "INDI: <%s> Unable to process tag", root.tagName().c_str());
         return -1;
     }
 
     //
-    const char * propertyName = root.getAttribute("name").toCString();
+    const char * propertyName = root.getAttribute(XMLATOM_name).toCString();
 
     if (getProperty(propertyName).isValid())
     {
@@ -364,27 +377,27 @@ int BaseDevice::buildProp(const INDI::LilXmlElement &root, char *errmsg, bool is
     }
 
     if (d->deviceName.empty())
-        d->deviceName = root.getAttribute("device").toString();
+        d->deviceName = root.getAttribute(XMLATOM_device).toString();
 
     INDI::Property property;
-    switch (rootTagType->first)
+    switch (rootTagType)
     {
         case INDI_NUMBER:
         {
             INDI::PropertyNumber typedProperty {0};
-            for (const auto &element : root.getElementsByTagName("defNumber"))
+            for (const auto &element : root.getElementsByTagName(XMLATOM_defNumber))
             {
                 INDI::WidgetViewNumber widget;
 
                 widget.setParent(typedProperty.getNumber());
 
-                widget.setName   (element.getAttribute("name"));
-                widget.setLabel  (element.getAttribute("label"));
+                widget.setName   (element.getAttribute(XMLATOM_name));
+                widget.setLabel  (element.getAttribute(XMLATOM_label));
 
-                widget.setFormat (element.getAttribute("format"));
-                widget.setMin    (element.getAttribute("min"));
-                widget.setMax    (element.getAttribute("max"));
-                widget.setStep   (element.getAttribute("step"));
+                widget.setFormat (element.getAttribute(XMLATOM_format));
+                widget.setMin    (element.getAttribute(XMLATOM_min));
+                widget.setMax    (element.getAttribute(XMLATOM_max));
+                widget.setStep   (element.getAttribute(XMLATOM_step));
 
                 widget.setValue  (element.context().toDoubleSexa());
 
@@ -397,15 +410,15 @@ int BaseDevice::buildProp(const INDI::LilXmlElement &root, char *errmsg, bool is
         case INDI_SWITCH:
         {
             INDI::PropertySwitch typedProperty {0};
-            typedProperty.setRule(root.getAttribute("rule"));
-            for (const auto &element : root.getElementsByTagName("defSwitch"))
+            typedProperty.setRule(root.getAttribute(XMLATOM_rule));
+            for (const auto &element : root.getElementsByTagName(XMLATOM_defSwitch))
             {
                 INDI::WidgetViewSwitch widget;
 
                 widget.setParent(typedProperty.getSwitch());
 
-                widget.setName   (element.getAttribute("name"));
-                widget.setLabel  (element.getAttribute("label"));
+                widget.setName   (element.getAttribute(XMLATOM_name));
+                widget.setLabel  (element.getAttribute(XMLATOM_label));
 
                 widget.setState  (element.context());
 
@@ -419,14 +432,14 @@ int BaseDevice::buildProp(const INDI::LilXmlElement &root, char *errmsg, bool is
         case INDI_TEXT:
         {
             INDI::PropertyText typedProperty {0};
-            for (const auto &element : root.getElementsByTagName("defText"))
+            for (const auto &element : root.getElementsByTagName(XMLATOM_defText))
             {
                 INDI::WidgetViewText widget;
 
                 widget.setParent(typedProperty.getText());
 
-                widget.setName   (element.getAttribute("name"));
-                widget.setLabel  (element.getAttribute("label"));
+                widget.setName   (element.getAttribute(XMLATOM_name));
+                widget.setLabel  (element.getAttribute(XMLATOM_label));
 
                 widget.setText   (element.context());
 
@@ -440,14 +453,14 @@ int BaseDevice::buildProp(const INDI::LilXmlElement &root, char *errmsg, bool is
         case INDI_LIGHT:
         {
             INDI::PropertyLight typedProperty {0};
-            for (const auto &element : root.getElementsByTagName("defLight"))
+            for (const auto &element : root.getElementsByTagName(XMLATOM_defLight))
             {
                 INDI::WidgetViewLight widget;
 
                 widget.setParent(typedProperty.getLight());
 
-                widget.setName   (element.getAttribute("name"));
-                widget.setLabel  (element.getAttribute("label"));
+                widget.setName   (element.getAttribute(XMLATOM_name));
+                widget.setLabel  (element.getAttribute(XMLATOM_label));
 
                 widget.setState  (element.context());
 
@@ -470,16 +483,16 @@ int BaseDevice::buildProp(const INDI::LilXmlElement &root, char *errmsg, bool is
 #endif
                 blob = nullptr;
             });
-            for (const auto &element : root.getElementsByTagName("defBLOB"))
+            for (const auto &element : root.getElementsByTagName(XMLATOM_defBLOB))
             {
                 INDI::WidgetViewBlob widget;
 
                 widget.setParent(typedProperty.getBLOB());
 
-                widget.setName   (element.getAttribute("name"));
-                widget.setLabel  (element.getAttribute("label"));
+                widget.setName   (element.getAttribute(XMLATOM_name));
+                widget.setLabel  (element.getAttribute(XMLATOM_label));
 
-                widget.setFormat (element.getAttribute("format"));
+                widget.setFormat (element.getAttribute(XMLATOM_format));
 
                 if (!widget.isNameMatch(""))
                     typedProperty.push(std::move(widget));
@@ -494,13 +507,13 @@ int BaseDevice::buildProp(const INDI::LilXmlElement &root, char *errmsg, bool is
 
     if (!property.isValid())
     {
-        IDLog("%s: invalid name '%s'\n", propertyName, rootTagName.c_str());
+        IDLog("%s: invalid name '%s'\n", propertyName, root.tagName().c_str());
         return 0;
     }
 
     if (property.isEmpty())
     {
-        IDLog("%s: %s with no valid members\n", propertyName, rootTagName.c_str());
+        IDLog("%s: %s with no valid members\n", propertyName, root.tagName().c_str());
         return 0;
     }
 
@@ -509,14 +522,14 @@ int BaseDevice::buildProp(const INDI::LilXmlElement &root, char *errmsg, bool is
     property.setDynamic    (isDynamic);
     property.setDeviceName (getDeviceName());
 
-    property.setLabel      (root.getAttribute("label"));
-    property.setGroupName  (root.getAttribute("group"));
-    property.setState      (root.getAttribute("state"));
+    property.setLabel      (root.getAttribute(XMLATOM_label));
+    property.setGroupName  (root.getAttribute(XMLATOM_group));
+    property.setState      (root.getAttribute(XMLATOM_state));
 
-    if (rootTagType->first != INDI_LIGHT)
+    if (rootTagType != INDI_LIGHT)
     {
-        property.setTimeout(root.getAttribute("timeout"));
-        property.setPermission(root.getAttribute("perm").toIPerm());
+        property.setTimeout(root.getAttribute(XMLATOM_timeout));
+        property.setPermission(root.getAttribute(XMLATOM_perm).toIPerm());
     }
 
     d->addProperty(property);
@@ -563,7 +576,7 @@ static void for_property(
 
     for (const auto &element : root.getElements())
     {
-        auto * item = typedProperty.findWidgetByName(element.getAttribute("name"));
+        auto * item = typedProperty.findWidgetByName(element.getAttribute(XMLATOM_name));
         if (item)
             function(element, item);
     }
@@ -578,7 +591,7 @@ int BaseDevice::setValue(const INDI::LilXmlElement &root, char *errmsg)
 {
     D_PTR(BaseDevice);
 
-    if (!root.getAttribute("name").isValid())
+    if (!root.getAttribute(XMLATOM_name).isValid())
     {
         snprintf(errmsg, MAXRBUF, "INDI: <%s> unable to find name attribute", root.tagName().c_str());
         return -1;
@@ -588,31 +601,19 @@ int BaseDevice::setValue(const INDI::LilXmlElement &root, char *errmsg)
     checkMessage(root.handle());
 
     // find type of tag
-    static const std::map<INDI_PROPERTY_TYPE, std::string> tagTypeName =
-    {
-        {INDI_NUMBER, "setNumberVector"},
-        {INDI_SWITCH, "setSwitchVector"},
-        {INDI_TEXT,   "setTextVector"},
-        {INDI_LIGHT,  "setLightVector"},
-        {INDI_BLOB,   "setBLOBVector"}
-    };
-
-    const auto rootTagName = root.tagName();
-    const auto rootTagType = std::find_if(tagTypeName.begin(), tagTypeName.end(), [&rootTagName](const auto & it)
-    {
-        return rootTagName == it.second;
-    });
+    const auto rootTagAtom = root.tagAtom();
+    const auto rootTagType = XMLATOM_IS_SET(rootTagAtom) ? sVectorType(rootTagAtom) : INDI_UNKNOWN;
 
-    if (rootTagType == tagTypeName.end())
+    if (rootTagType == INDI_UNKNOWN)
     {
-        snprintf(errmsg, MAXRBUF, "INDI: <%s> Unable to process tag", rootTagName.c_str());
+        snprintf(errmsg, MAXRBUF, "INDI: <%s> Unable to process tag", root.tagName().c_str());
         return -1;
     }
 
     // update generic values
-    const char * propertyName = root.getAttribute("name").toCString();
+    const char * propertyName = root.getAttribute(XMLATOM_name).toCString();
 
-    INDI::Property property = getProperty(propertyName, rootTagType->first);
+    INDI::Property property = getProperty(propertyName, rootTagType);
 
     if (!property.isValid())
     {
@@ -623,28 +624,28 @@ int BaseDevice::setValue(const INDI::LilXmlElement &root, char *errmsg)
     // 1. set overall property state, if any
     {
         bool ok = false;
-        property.setState(root.getAttribute("state").toIPState(&ok));
+        property.setState(root.getAttribute(XMLATOM_state).toIPState(&ok));
 
         if (!ok)
         {
-            snprintf(errmsg, MAXRBUF, "INDI: <%s> bogus state %s for %s", rootTagName.c_str(), root.getAttribute("state").toCString(),
+            snprintf(errmsg, MAXRBUF, "INDI: <%s> bogus state %s for %s", root.tagName().c_str(), root.getAttribute(XMLATOM_state).toCString(),
                      propertyName);
             return -1;
         }
     }
 
     // 2. allow changing the timeout
-    if (rootTagType->first != INDI_LIGHT)
+    if (rootTagType != INDI_LIGHT)
     {
         AutoCNumeric locale;
         bool ok = false;
-        auto timeoutValue = root.getAttribute("timeout").toDouble(&ok);
+        auto timeoutValue = root.getAttribute(XMLATOM_timeout).toDouble(&ok);
         if (ok)
             property.setTimeout(timeoutValue);
     }
 
     // update specific values
-    switch (rootTagType->first)
+    switch (rootTagType)
     {
         case INDI_NUMBER:
         {
@@ -654,8 +655,8 @@ int BaseDevice::setValue(const INDI::LilXmlElement &root, char *errmsg)
                 item->setValue(element.context());
 
                 // Permit changing of min/max
-                if (auto min = element.getAttribute("min")) item->setMin(min);
-                if (auto max = element.getAttribute("max")) item->setMax(max);
+                if (auto min = element.getAttribute(XMLATOM_min)) item->setMin(min);
+                if (auto max = element.getAttribute(XMLATOM_max)) item->setMax(max);
             });
             locale.Restore();
             break;
@@ -714,7 +715,7 @@ static bool sSharedToBlob(const INDI::LilXmlElement &element, INDI::WidgetViewBl
         return false;
     }
 
-    auto size = element.getAttribute("size");
+    auto size = element.getAttribute(XMLATOM_size);
     // Client mark blob that can be attached directly
 
     // FIXME: Where is the blob data buffer freed at the end ?
@@ -748,11 +749,11 @@ static bool sSharedToBlob(const INDI::LilXmlElement &element, INDI::WidgetViewBl
 */
 int BaseDevicePrivate::setBLOB(INDI::PropertyBlob property, const LilXmlElement &root, char *errmsg)
 {
-    for (const auto &element : root.getElementsByTagName("oneBLOB"))
+    for (const auto &element : root.getElementsByTagName(XMLATOM_oneBLOB))
     {
-        auto name   = element.getAttribute("name");
-        auto format = element.getAttribute("format");
-        auto size   = element.getAttribute("size");
+        auto name   = element.getAttribute(XMLATOM_name);
+        auto format = element.getAttribute(XMLATOM_format);
+        auto size   = element.getAttribute(XMLATOM_size);
 
         auto widget = property.findWidgetByName(name);
 
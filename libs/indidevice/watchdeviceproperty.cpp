@@ -116,7 +116,7 @@ bool WatchDeviceProperty::deleteDevice(const BaseDevice &device)
 int WatchDeviceProperty::processXml(const INDI::LilXmlElement &root, char *errmsg,
                                     const std::function<ParentDevice()> &constructor)
 {
-    auto deviceName = root.getAttribute("device");
+    auto deviceName = root.getAttribute(XMLATOM_device);
     if (!deviceName.isValid() || deviceName.toString() == "" || !isDeviceWatched(deviceName))
     {
         return 0;
@@ -128,29 +128,17 @@ int WatchDeviceProperty::processXml(const INDI::LilXmlElement &root, char *errms
     // If we are asked to watch for specific properties only, we ignore everything else
     if (deviceInfo.properties.size() != 0)
     {
-        const auto it = deviceInfo.properties.find(root.getAttribute("name").toString());
+        const auto it = deviceInfo.properties.find(root.getAttribute(XMLATOM_name).toString());
         if (it == deviceInfo.properties.end())
             return 0;
     }
 
-    static const std::set<std::string> defVectors
-    {
-        "defTextVector",  "defNumberVector", "defSwitchVector",
-        "defLightVector", "defBLOBVector"
-    };
-
-    if (defVectors.find(root.tagName()) != defVectors.end())
+    if (XMLATOM_IS_DEF(root.tagAtom()))
     {
         return deviceInfo.device.buildProp(root, errmsg);
     }
 
-    static const std::set<std::string> setVectors
-    {
-        "setTextVector",  "setNumberVector", "setSwitchVector",
-        "setLightVector", "setBLOBVector"
-    };
-
-    if (setVectors.find(root.tagName()) != setVectors.end())
+    if (XMLATOM_IS_SET(root.tagAtom()))
     {
         return deviceInfo.device.setValue(root, errmsg);
     }
@@ -22,9 +22,14 @@
 #endif
 
 #include <cstdlib>
+#include <algorithm>
+#include <chrono>
 #include <cstring>
+#include <string>
+#include <vector>
 
 #include "base64.h"
+#include "base64_variant.h"
 
 TEST(CORE_BASE64, Test_to64frombits)
 {
@@ -115,3 +120,198 @@ TEST(CORE_BASE64, Test_from64tobits_fast_with_bug_time)
     }
 }
 
+
+static const base64_variant variants[] = { BASE64_SCALAR, BASE64_SSE41, BASE64_AVX2, BASE64_NEON };
+static const char *variantNames[] = { "scalar", "sse4.1", "avx2", "neon" };
+
+static std::vector<unsigned char> randomBytes(size_t size)
+{
+    std::vector<unsigned char> result(size);
+    for (auto &byte : result)
+        byte = rand() & 0xff;
+    return result;
+}
+
+static std::string encode(const std::vector<unsigned char> &bytes)
+{
+    std::string result(4 * bytes.size() / 3 + 4, '\0');
+    int len = to64frombits_s(reinterpret_cast<unsigned char *>(&result[0]), bytes.data(), bytes.size(), result.size());
+    result.resize(len);
+    return result;
+}
+
+static std::vector<unsigned char> decode(const std::string &text)
+{
+    std::vector<unsigned char> result(3 * text.size() / 4 + 4);
+    int len = from64tobits_fast(reinterpret_cast<char *>(result.data()), text.data(), text.size());
+    result.resize(len);
+    return result;
+}
+
+// Insert separator every width characters, as wrapped by the drivers
+static std::string wrap(const std::string &text, size_t width, const std::string &separator)
+{
+    std::string result;
+    for (size_t pos = 0; pos < text.size(); pos += width)
+    {
+        result += text.substr(pos, width);
+        result += separator;
+    }
+    return result;
+}
+
+TEST(CORE_BASE64, Test_variants_match_scalar)
+{
+    srand(42);
+    std::vector<size_t> sizes;
+    for (size_t size = 0; size < 300; size++)
+        sizes.push_back(size);
+    for (int i = 0; i < 50; i++)
+        sizes.push_back(rand() % 100000);
+    sizes.push_back(3 * 1024 * 1024 + 1);
+
+    for (auto size : sizes)
+    {
+        auto bytes = randomBytes(size);
+
+        ASSERT_EQ(0, base64_select_variant(BASE64_SCALAR));
+        std::string expected = encode(bytes);
+        ASSERT_EQ(bytes, decode(expected));
+
+        for (size_t i = 1; i < sizeof(variants) / sizeof(variants[0]); i++)
+        {
+            if (base64_select_variant(variants[i]) != 0)
+                continue;
+            SCOPED_TRACE(std::string(variantNames[i]) + " size " + std::to_string(size));
+            ASSERT_EQ(expected, encode(bytes));
+            ASSERT_EQ(bytes, decode(expected));
+        }
+    }
+    base64_select_variant(BASE64_SCALAR);
+}
+
+TEST(CORE_BASE64, Test_variants_line_breaks)
+{
+    srand(43);
+    const size_t widths[] = { 1, 3, 4, 5, 17, 63, 64, 72, 76, 1000 };
+
+    for (size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); i++)
+    {
+        if (base64_select_variant(variants[i]) != 0)
+            continue;
+        for (size_t size : { 1, 2, 3, 100, 1001, 20000 })
+        {
+            auto bytes = randomBytes(size);
+            std::string text = encode(bytes);
+            for (auto width : widths)
+            {
+                SCOPED_TRACE(std::string(variantNames[i]) + " size " + std::to_string(size) + " width " + std::to_string(width));
+                ASSERT_EQ(bytes, decode(wrap(text, width, "\n")));
+                ASSERT_EQ(bytes, decode(wrap(text, width, "\r\n")));
+                ASSERT_EQ(bytes, decode("\n" + wrap(text, width, "\n\n")));
+            }
+        }
+    }
+    base64_select_variant(BASE64_SCALAR);
+}
+
+TEST(CORE_BASE64, Test_variants_padding)
+{
+    for (size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); i++)
+    {
+        if (base64_select_variant(variants[i]) != 0)
+            continue;
+        SCOPED_TRACE(variantNames[i]);
+
+        std::string text = "Rk9PQkFSQkFaRk9PQkFSQkFaRk9PQkFSQkFaRk9PQkFSQkFaRk9PQkFSQkFaRk9PQkFSQkFa";
+        std::string plain = "FOOBARBAZFOOBARBAZFOOBARBAZFOOBARBAZFOOBARBAZFOOBARBAZ";
+        for (auto tail : { std::make_pair("Rg==", "F"), std::make_pair("Rk8=", "FO"), std::make_pair("Rk9P", "FOO") })
+        {
+            auto result = decode(text + tail.first);
+            ASSERT_EQ(plain + tail.second, std::string(result.begin(), result.end()));
+        }
+        // padding is what ends the data
+        auto result = decode(text + "Rg==Rk9P");
+        ASSERT_EQ(plain + "F", std::string(result.begin(), result.end()));
+    }
+    base64_select_variant(BASE64_SCALAR);
+}
+
+TEST(CORE_BASE64, Test_to64frombits_lines)
+{
+    srand(44);
+    for (size_t size : { 0, 1, 53, 54, 55, 107, 108, 6912, 6913, 100000 })
+    {
+        auto bytes = randomBytes(size);
+        std::string expected = wrap(encode(bytes), 72, "\n");
+
+        // in one piece, then in pieces of whole lines
+        std::string text(expected.size() + 4, '\0');
+        size_t len = to64frombits_lines(reinterpret_cast<unsigned char *>(&text[0]), bytes.data(), bytes.size(), 72);
+        ASSERT_EQ(expected, text.substr(0, len));
+
+        std::string pieces;
+        for (size_t pos = 0; pos < size; pos += 54 * 3)
+        {
+            std::string piece(4 * 54 + 4, '\0');
+            len = to64frombits_lines(reinterpret_cast<unsigned char *>(&piece[0]), bytes.data() + pos, std::min<size_t>(54 * 3, size - pos), 72);
+            pieces += piece.substr(0, len);
+        }
+        ASSERT_EQ(expected, pieces);
+        ASSERT_EQ(bytes, decode(pieces));
+    }
+}
+
+// Best rate of a few runs, in MB/s of binary data
+template <class Function>
+static double throughput(size_t size, Function function)
+{
+    double best = 0;
+    for (int run = 0; run < 5; run++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::max(best, size / seconds / (1024 * 1024));
+    }
+    return best;
+}
+
+// A benchmark, not run by default: --gtest_also_run_disabled_tests --gtest_filter=*throughput
+TEST(CORE_BASE64, DISABLED_Test_variants_throughput)
+{
+    auto bytes = randomBytes(16 * 1024 * 1024);
+    std::string text = encode(bytes);
+    std::string wrapped = wrap(text, 72, "\n");
+
+    std::vector<unsigned char> encoded(text.size() + 4);
+    std::vector<char> decoded(bytes.size() + 4);
+
+    for (size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); i++)
+    {
+        if (base64_select_variant(variants[i]) != 0)
+            continue;
+
+        double encodeRate = throughput(bytes.size(), [&]()
+        {
+            to64frombits_s(encoded.data(), bytes.data(), bytes.size(), encoded.size());
+        });
+        ASSERT_EQ(0, memcmp(text.data(), encoded.data(), text.size()));
+
+        double decodeRate = throughput(bytes.size(), [&]()
+        {
+            ASSERT_EQ((int)bytes.size(), from64tobits_fast(decoded.data(), text.data(), text.size()));
+        });
+        ASSERT_EQ(0, memcmp(bytes.data(), decoded.data(), bytes.size()));
+
+        double unwrapRate = throughput(bytes.size(), [&]()
+        {
+            ASSERT_EQ((int)bytes.size(), from64tobits_fast(decoded.data(), wrapped.data(), wrapped.size()));
+        });
+        ASSERT_EQ(0, memcmp(bytes.data(), decoded.data(), bytes.size()));
+
+        printf("%-8s encode %8.1f MB/s, decode %8.1f MB/s, decode with line breaks %8.1f MB/s\n",
+               variantNames[i], encodeRate, decodeRate, unwrapRate);
+    }
+    base64_select_variant(BASE64_SCALAR);
+}
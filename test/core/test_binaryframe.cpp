@@ -0,0 +1,297 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <list>
+#include <string>
+#include <vector>
+
+#include "base64.h"
+#include "indiapi.h"
+#include "indibinaryframe.h"
+#include "lilxml.h"
+
+namespace
+{
+
+class TestBlobs: public INDI::BinaryFrame::BlobSource, public INDI::BinaryFrame::BlobSink
+{
+    public:
+        std::string attachedContent;
+        std::list<std::vector<char>> buffers;
+        std::vector<std::string> stored;
+
+        bool attached(const void *&data, size_t &size) override
+        {
+            data = attachedContent.data();
+            size = attachedContent.size();
+            return true;
+        }
+
+        void *allocate(size_t size) override
+        {
+            buffers.emplace_back(size);
+            return buffers.back().data();
+        }
+
+        bool store(XMLEle *ep, const unsigned char *data, size_t len) override
+        {
+            stored.emplace_back(reinterpret_cast<const char *>(data), len);
+            addXMLAtt(ep, "len", std::to_string(len).c_str());
+            return true;
+        }
+};
+
+XMLEle *parse(const char *xml)
+{
+    LilXML *lp = newLilXML();
+    char errmsg[1024];
+    XMLEle *root = readXMLEle(lp, 0, errmsg);
+    for (const char *c = xml; *c; ++c)
+    {
+        root = readXMLEle(lp, *c, errmsg);
+        if (root != nullptr)
+            break;
+    }
+    delLilXML(lp);
+    return root;
+}
+
+/* The frame body, past its length, with the payloads in place */
+std::string body(const INDI::BinaryFrame::Encoded &frame)
+{
+    std::string bytes;
+    size_t pos = 0;
+    for (auto &payload : frame.payloads)
+    {
+        bytes.append(frame.bytes, pos, payload.offset - pos);
+        bytes.append(static_cast<const char *>(payload.data), payload.size);
+        pos = payload.offset;
+    }
+    bytes.append(frame.bytes, pos, std::string::npos);
+
+    uint32_t length = 0;
+    for (int i = 0; i < 4; ++i)
+        length |= uint32_t(static_cast<unsigned char>(bytes[i])) << (8 * i);
+    EXPECT_EQ(length, bytes.size() - 4);
+    return bytes.substr(4);
+}
+
+std::string print(XMLEle *root)
+{
+    std::string xml(sprlXMLEle(root, 0), '\0');
+    sprXMLEle(&xml[0], root, 0);
+    return xml;
+}
+
+std::string roundTrip(const char *xml, TestBlobs &blobs)
+{
+    XMLEle *root = parse(xml);
+    EXPECT_NE(root, nullptr);
+
+    INDI::BinaryFrame::Encoded frame;
+    EXPECT_TRUE(INDI::BinaryFrame::encode(root, blobs, frame));
+    delXMLEle(root);
+
+    std::string bytes = body(frame);
+    XMLEle *decoded = INDI::BinaryFrame::decode(bytes.data(), bytes.size(), blobs);
+    EXPECT_NE(decoded, nullptr);
+    if (decoded == nullptr)
+        return "";
+
+    std::string result = print(decoded);
+    delXMLEle(decoded);
+    return result;
+}
+
+/* A valid body, with the member bytes given */
+std::string frameBody(int kind, int state, const std::string &members, int count = 1)
+{
+    std::string bytes;
+    bytes.push_back(char(kind));
+    bytes.append("\x03\x00" "dev", 5);
+    bytes.append("\x04\x00" "prop", 6);
+    bytes.push_back(char(state));
+    bytes.append(std::string(6, '\0'));     // timestamp, timeout, message
+    bytes.push_back(char(count));
+    bytes.push_back('\0');
+    return bytes + members;
+}
+
+XMLEle *decode(const std::string &bytes)
+{
+    TestBlobs blobs;
+    return INDI::BinaryFrame::decode(bytes.data(), bytes.size(), blobs);
+}
+
+}
+
+TEST(CORE_BINARYFRAME, NumberRoundTrip)
+{
+    TestBlobs blobs;
+    EXPECT_EQ(roundTrip("<setNumberVector device='dev' name='prop' state='Ok' timestamp='2024-01-01T00:00:00'>"
+                        "<oneNumber name='a'>0.1</oneNumber>"
+                        "<oneNumber name='b'>12:30:00</oneNumber>"
+                        "<oneNumber name='c'>-3e-300</oneNumber>"
+                        "</setNumberVector>", blobs),
+              "<setNumberVector device=\"dev\" name=\"prop\" state=\"Ok\" timestamp=\"2024-01-01T00:00:00\">\n"
+              "    <oneNumber name=\"a\">\n0.1\n    </oneNumber>\n"
+              "    <oneNumber name=\"b\">\n12.5\n    </oneNumber>\n"
+              "    <oneNumber name=\"c\">\n-3e-300\n    </oneNumber>\n"
+              "</setNumberVector>\n");
+}
+
+TEST(CORE_BINARYFRAME, SwitchLightTextRoundTrip)
+{
+    TestBlobs blobs;
+    EXPECT_EQ(roundTrip("<setSwitchVector device='dev' name='prop'>"
+                        "<oneSwitch name='a'>On</oneSwitch><oneSwitch name='b'>Off</oneSwitch>"
+                        "</setSwitchVector>", blobs),
+              "<setSwitchVector device=\"dev\" name=\"prop\">\n"
+              "    <oneSwitch name=\"a\">\nOn\n    </oneSwitch>\n"
+              "    <oneSwitch name=\"b\">\nOff\n    </oneSwitch>\n"
+              "</setSwitchVector>\n");
+
+    EXPECT_EQ(roundTrip("<setLightVector device='dev' name='prop' state='Alert' message='hot'>"
+                        "<oneLight name='a'>Busy</oneLight>"
+                        "</setLightVector>", blobs),
+              "<setLightVector device=\"dev\" name=\"prop\" state=\"Alert\" message=\"hot\">\n"
+              "    <oneLight name=\"a\">\nBusy\n    </oneLight>\n"
+              "</setLightVector>\n");
+
+    EXPECT_EQ(roundTrip("<setTextVector device='dev' name='prop' timeout='60'>"
+                        "<oneText name='a'>a &lt;b&gt; &amp; c</oneText>"
+                        "</setTextVector>", blobs),
+              "<setTextVector device=\"dev\" name=\"prop\" timeout=\"60\">\n"
+              "    <oneText name=\"a\">\na &lt;b&gt; &amp; c\n    </oneText>\n"
+              "</setTextVector>\n");
+}
+
+TEST(CORE_BINARYFRAME, WrappedBase64HasNoTrailingBytes)
+{
+    std::string content;
+    for (int i = 0; i < 1000; ++i)
+        content.push_back(char(i * 7));
+
+    std::vector<char> encoded(4 * content.size() / 3 + 4);
+    int encodedLen = to64frombits_s(reinterpret_cast<unsigned char *>(encoded.data()),
+                                    reinterpret_cast<const unsigned char *>(content.data()), content.size(), encoded.size());
+
+    // Wrapped the way drivers send it
+    std::string wrapped;
+    for (int i = 0; i < encodedLen; i += 72)
+        wrapped += std::string(encoded.data() + i, std::min(72, encodedLen - i)) + "\n";
+
+    std::string xml = "<setBLOBVector device='dev' name='prop' state='Ok'>"
+                      "<oneBLOB name='img' size='1000' format='.fits' enclen='" + std::to_string(encodedLen) + "'>"
+                      + wrapped + "</oneBLOB></setBLOBVector>";
+
+    TestBlobs blobs;
+    EXPECT_EQ(roundTrip(xml.c_str(), blobs),
+              "<setBLOBVector device=\"dev\" name=\"prop\" state=\"Ok\">\n"
+              "    <oneBLOB name=\"img\" size=\"1000\" format=\".fits\" len=\"1000\"/>\n"
+              "</setBLOBVector>\n");
+    ASSERT_EQ(blobs.stored.size(), 1u);
+    EXPECT_EQ(blobs.stored[0], content);
+}
+
+TEST(CORE_BINARYFRAME, AttachedBufferIsCutToSize)
+{
+    TestBlobs blobs;
+    blobs.attachedContent = std::string("content") + std::string(4089, '\0');
+
+    EXPECT_EQ(roundTrip("<setBLOBVector device='dev' name='prop'>"
+                        "<oneBLOB name='img' size='7' format='.txt' attached='true'/>"
+                        "</setBLOBVector>", blobs),
+              "<setBLOBVector device=\"dev\" name=\"prop\">\n"
+              "    <oneBLOB name=\"img\" size=\"7\" format=\".txt\" len=\"7\"/>\n"
+              "</setBLOBVector>\n");
+    ASSERT_EQ(blobs.stored.size(), 1u);
+    EXPECT_EQ(blobs.stored[0], "content");
+}
+
+TEST(CORE_BINARYFRAME, NoBinaryForm)
+{
+    TestBlobs blobs;
+    INDI::BinaryFrame::Encoded frame;
+    for (const char *xml :
+            {
+                "<defNumberVector device='dev' name='prop'/>",
+                "<setNumberVector device='dev' name='prop' extra='1'><oneNumber name='a'>1</oneNumber></setNumberVector>",
+                "<setNumberVector device='dev' name='prop'><oneNumber name='a'>abc</oneNumber></setNumberVector>",
+                "<setSwitchVector device='dev' name='prop'><oneSwitch name='a'>Maybe</oneSwitch></setSwitchVector>",
+                "<setSwitchVector device='dev' name='prop' state='Bad'/>",
+                "<setTextVector device='dev' name='prop'><oneNumber name='a'>1</oneNumber></setTextVector>",
+            })
+    {
+        XMLEle *root = parse(xml);
+        ASSERT_NE(root, nullptr) << xml;
+        EXPECT_FALSE(INDI::BinaryFrame::encode(root, blobs, frame)) << xml;
+        delXMLEle(root);
+    }
+}
+
+TEST(CORE_BINARYFRAME, RejectsOutOfRangeValues)
+{
+    const std::string on("\x01\x00" "a" "\x01", 4);
+    XMLEle *root = decode(frameBody(INDI_FRAME_SET_SWITCH, IPS_OK, on));
+    ASSERT_NE(root, nullptr);
+    delXMLEle(root);
+
+    root = decode(frameBody(INDI_FRAME_SET_SWITCH, INDI_FRAME_NO_STATE, on));
+    ASSERT_NE(root, nullptr);
+    delXMLEle(root);
+
+    // vector state
+    EXPECT_EQ(decode(frameBody(INDI_FRAME_SET_SWITCH, IPS_ALERT + 1, on)), nullptr);
+    EXPECT_EQ(decode(frameBody(INDI_FRAME_SET_SWITCH, 0xfe, on)), nullptr);
+    // switch state
+    EXPECT_EQ(decode(frameBody(INDI_FRAME_SET_SWITCH, IPS_OK, std::string("\x01\x00" "a" "\x02", 4))), nullptr);
+    // light state
+    EXPECT_EQ(decode(frameBody(INDI_FRAME_SET_LIGHT, IPS_OK, std::string("\x01\x00" "a" "\x04", 4))), nullptr);
+    // kind
+    EXPECT_EQ(decode(frameBody(INDI_FRAME_XML, IPS_OK, on)), nullptr);
+    EXPECT_EQ(decode(frameBody(INDI_FRAME_SET_BLOB + 1, IPS_OK, on)), nullptr);
+}
+
+TEST(CORE_BINARYFRAME, RejectsBadLengths)
+{
+    const std::string on("\x01\x00" "a" "\x01", 4);
+    std::string bytes = frameBody(INDI_FRAME_SET_SWITCH, IPS_OK, on);
+
+    // truncated anywhere
+    for (size_t size = 0; size < bytes.size(); ++size)
+        EXPECT_EQ(decode(bytes.substr(0, size)), nullptr) << size;
+
+    // trailing bytes
+    EXPECT_EQ(decode(bytes + "x"), nullptr);
+
+    // more members than present
+    EXPECT_EQ(decode(frameBody(INDI_FRAME_SET_SWITCH, IPS_OK, on, 2)), nullptr);
+
+    // text longer than the frame
+    EXPECT_EQ(decode(frameBody(INDI_FRAME_SET_TEXT, IPS_OK, std::string("\x01\x00" "a" "\xff\x00\x00\x00" "abc", 10))), nullptr);
+}
+
+TEST(CORE_BINARYFRAME, ShortestNumbers)
+{
+    EXPECT_EQ(INDI::BinaryFrame::formatNumber(0.1), "0.1");
+    EXPECT_EQ(INDI::BinaryFrame::formatNumber(1.0 / 3), "0.3333333333333333");
+    EXPECT_EQ(INDI::BinaryFrame::formatNumber(0.1 + 0.2), "0.30000000000000004");
+    EXPECT_EQ(INDI::BinaryFrame::formatNumber(-42), "-42");
+}
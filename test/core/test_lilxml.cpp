@@ -0,0 +1,292 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "lilxml.h"
+
+static int allocations;
+static int largeAllocations; /* of more than 1 MB */
+static size_t largestAllocation;
+
+static void *countedMalloc(size_t size)
+{
+    allocations++;
+    largeAllocations += size > (1 << 20);
+    largestAllocation = std::max(largestAllocation, size);
+    return malloc(size);
+}
+
+static void *countedRealloc(void *ptr, size_t size)
+{
+    allocations++;
+    largeAllocations += size > (1 << 20);
+    largestAllocation = std::max(largestAllocation, size);
+    return realloc(ptr, size);
+}
+
+/* traffic of a mount and a camera, with entities, comments and a BLOB */
+static std::string traffic(int count)
+{
+    std::string xml;
+    for (int i = 0; i < count; i++)
+    {
+        xml += "<setNumberVector device='Telescope Simulator' name='EQUATORIAL_EOD_COORD' state='Ok' timeout='60'"
+               " timestamp='2024-01-01T00:00:00'>\n"
+               "    <oneNumber name='RA'>\n      " + std::to_string(i * 0.25) + "\n    </oneNumber>\n"
+               "    <oneNumber name='DEC'>\n      -" + std::to_string(i) + "\n    </oneNumber>\n"
+               "</setNumberVector>\n"
+               "<!-- a comment --><message device='CCD Simulator' message='a &quot;b&quot; &amp; c'/>\n"
+               "<setTextVector device='CCD Simulator' name='FITS_HEADER'>\n"
+               "    <oneText name='OBSERVER'>x &lt; y &bogus; z</oneText>\n"
+               "</setTextVector>\n";
+        if (i % 10 == 0)
+            xml += "<setBLOBVector device='CCD Simulator' name='CCD1'>\n"
+                   "    <oneBLOB name='CCD1' size='3000' format='.fits'>\n" + std::string(4000 + i, 'Q') + "\n"
+                   "    </oneBLOB>\n</setBLOBVector>\n";
+    }
+    return xml;
+}
+
+static std::string print(XMLEle *root)
+{
+    std::string s(sprlXMLEle(root, 0) + 1, '\0');
+    s.resize(sprXMLEle(&s[0], root, 0));
+    return s;
+}
+
+/* parse xml chunk bytes at a time and return each message printed */
+static std::vector<std::string> parse(std::string xml, int chunk, int arena)
+{
+    std::vector<std::string> result;
+    char ynot[1024];
+    LilXML *lp = newLilXML();
+    setArenaLilXML(lp, arena);
+
+    for (size_t off = 0; off < xml.size(); off += chunk)
+    {
+        XMLEle **nodes = parseXMLChunk(lp, &xml[off], int(std::min(xml.size() - off, size_t(chunk))), ynot);
+        EXPECT_EQ(ynot[0], '\0') << ynot;
+        for (int i = 0; nodes[i]; i++)
+        {
+            result.push_back(print(nodes[i]));
+            delXMLEle(nodes[i]);
+        }
+        free(nodes);
+    }
+
+    delLilXML(lp);
+    return result;
+}
+
+TEST(CORE_LILXML, ArenaParsesLikeMalloc)
+{
+    std::string xml = traffic(50);
+    for (int chunk : { 1, 13, 4096, 1 << 20 })
+    {
+        std::vector<std::string> plain = parse(xml, chunk, 0);
+        ASSERT_EQ(plain.size(), 155u);
+        ASSERT_EQ(plain, parse(xml, chunk, 1)) << "chunk " << chunk;
+    }
+}
+
+TEST(CORE_LILXML, ArenaDocumentsCanBeEdited)
+{
+    std::string xml = traffic(1);
+    char ynot[1024];
+    LilXML *lp = newLilXML();
+    setArenaLilXML(lp, 1);
+    XMLEle **nodes = parseXMLChunk(lp, &xml[0], int(xml.size()), ynot);
+    XMLEle *root = nodes[0];
+    delXMLEle(nodes[1]);
+    delXMLEle(nodes[2]);
+    delXMLEle(nodes[3]);
+    free(nodes);
+    delLilXML(lp);
+
+    XMLEle *ra = findXMLEle(root, "oneNumber");
+    ASSERT_NE(ra, nullptr);
+    editXMLEle(ra, std::string(5000, '1').c_str());
+    editXMLAtt(findXMLAtt(root, "state"), "Busy");
+    addXMLAtt(root, "message", "moving");
+    rmXMLAtt(root, "timeout");
+    editXMLEle(addXMLEle(root, "oneNumber"), "3");
+    delXMLEle(ra);
+
+    EXPECT_EQ(std::string(findXMLAttValu(root, "state")), "Busy");
+    EXPECT_EQ(std::string(findXMLAttValu(root, "message")), "moving");
+    EXPECT_EQ(std::string(findXMLAttValu(root, "timeout")), "");
+    EXPECT_EQ(nXMLEle(root), 2);
+    EXPECT_EQ(std::string(pcdataXMLEle(nextXMLEle(root, 1))), "-0");
+    delXMLEle(root);
+}
+
+TEST(CORE_LILXML, ArenaSavesAllocations)
+{
+    std::string xml = traffic(100);
+    int counts[2];
+
+    indi_xmlMalloc(countedMalloc, countedRealloc, free);
+    for (int arena = 0; arena < 2; arena++)
+    {
+        // warm up then count
+        parse(xml, 4096, arena);
+        allocations = 0;
+        ASSERT_EQ(parse(xml, 4096, arena).size(), 310u);
+        counts[arena] = allocations;
+    }
+    indi_xmlMalloc(malloc, realloc, free);
+
+    // the BLOBs are still malloced once they grow
+    EXPECT_LT(counts[1] * 10, counts[0]);
+}
+
+/* a BLOB of n base64 characters, in lines of 72, with the given attributes */
+static std::string blob(size_t n, const std::string &attributes)
+{
+    std::string xml = "<setBLOBVector device='CCD Simulator' name='CCD1'>\n"
+                      "    <oneBLOB name='CCD1' size='" + std::to_string(n / 4 * 3) + "' format='.fits'" + attributes + ">\n";
+    for (size_t i = 0; i < n; i += 72)
+    {
+        for (size_t j = i; j < n && j < i + 72; j++)
+            xml += "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"[(j * 7) % 64];
+        xml += '\n';
+    }
+    return xml + "    </oneBLOB>\n</setBLOBVector>\n";
+}
+
+TEST(CORE_LILXML, BlobOfAnnouncedSize)
+{
+    const size_t n = 16 << 20;
+    std::string plain = blob(n, "");
+    std::string expected = parse(plain, 65536, 0)[0];
+
+    // the first two announce the right size, the others fall back to growing the pcdata
+    const char *cases[] = { " enclen='16777216'", " len='12582912'", " enclen='1000'", " enclen='bogus'" };
+    for (int c = 0; c < 4; c++)
+    {
+        const char *attributes = cases[c];
+        std::string xml = blob(n, attributes);
+
+        indi_xmlMalloc(countedMalloc, countedRealloc, free);
+        largeAllocations = 0;
+        char ynot[1024];
+        LilXML *lp = newLilXML();
+        std::vector<XMLEle *> roots;
+        for (size_t off = 0; off < xml.size(); off += 65536)
+        {
+            XMLEle **nodes = parseXMLChunk(lp, &xml[off], int(std::min(xml.size() - off, size_t(65536))), ynot);
+            for (int i = 0; nodes[i]; i++)
+                roots.push_back(nodes[i]);
+            free(nodes);
+        }
+        int count = largeAllocations;
+        indi_xmlMalloc(malloc, realloc, free);
+        delLilXML(lp);
+
+        ASSERT_EQ(roots.size(), 1u) << attributes;
+        XMLEle *ep = nextXMLEle(roots[0], 1);
+        EXPECT_EQ(pcdatalenXMLEle(ep), int(n + (n + 71) / 72 - 1));
+        rmXMLAtt(ep, "enclen");
+        rmXMLAtt(ep, "len");
+        EXPECT_EQ(print(roots[0]), expected) << attributes;
+        delXMLEle(roots[0]);
+
+        if (c < 2)
+        {
+            EXPECT_EQ(count, 1) << attributes;
+        }
+    }
+}
+
+// XMLAtom values are part of the ABI: names are only ever appended
+static_assert(XMLATOM_getProperties == 1, "XMLAtom values changed");
+static_assert(XMLATOM_defTextVector == 7, "XMLAtom values changed");
+static_assert(XMLATOM_attached == 48, "XMLAtom values changed");
+static_assert(XMLATOM_enableBinaryFraming == 52, "XMLAtom values changed");
+
+TEST(CORE_LILXML, BlobOfHostileSize)
+{
+    const size_t n = 4000;
+    std::string expected = parse(blob(n, ""), 4096, 0)[0];
+
+    // huge, negative or lying sizes: at most a bounded room is reserved, and all that arrives is kept
+    const char *cases[] =
+    {
+        " enclen='1073741824'", " enclen='1060000000'", " enclen='2147483647'", " enclen='99999999999999999999'",
+        " enclen='-1'", " enclen='-2147483648'", " len='4000000000'", " len='-3'", " enclen='4'", " len='30'"
+    };
+    for (auto attributes : cases)
+    {
+        for (int arena = 0; arena < 2; arena++)
+        {
+            indi_xmlMalloc(countedMalloc, countedRealloc, free);
+            largestAllocation = 0;
+            auto result = parse(blob(n, attributes), 1000, arena);
+            size_t largest = largestAllocation;
+            indi_xmlMalloc(malloc, realloc, free);
+
+            ASSERT_EQ(result.size(), 1u) << attributes;
+            std::string printed = attributes;
+            std::replace(printed.begin(), printed.end(), '\'', '"');
+            size_t pos = result[0].find(printed);
+            ASSERT_NE(pos, std::string::npos) << attributes;
+            EXPECT_EQ(result[0].erase(pos, printed.size()), expected) << attributes;
+            EXPECT_LE(largest, size_t(32 << 20)) << attributes;
+        }
+    }
+}
+
+TEST(CORE_LILXML, AtomsOfParsedAndEditedNames)
+{
+    for (int a = XMLATOM_NONE + 1; a < XMLATOM_COUNT; a++)
+        EXPECT_EQ(atomXML(atomNameXML(XMLAtom(a))), a) << atomNameXML(XMLAtom(a));
+    EXPECT_EQ(atomXML("setNumberVecto"), XMLATOM_NONE);
+    EXPECT_EQ(atomXML("oneNumbers"), XMLATOM_NONE);
+    EXPECT_EQ(atomXML(""), XMLATOM_NONE);
+
+    std::string xml = traffic(1);
+    char ynot[1024];
+    LilXML *lp = newLilXML();
+    XMLEle **nodes = parseXMLChunk(lp, &xml[0], int(xml.size()), ynot);
+    delLilXML(lp);
+
+    XMLEle *root = nodes[0];
+    EXPECT_EQ(tagAtomXMLEle(root), XMLATOM_setNumberVector);
+    EXPECT_TRUE(XMLATOM_IS_SET(tagAtomXMLEle(root)));
+    EXPECT_EQ(tagAtomXMLEle(nextXMLEle(root, 1)), XMLATOM_oneNumber);
+    EXPECT_EQ(nameAtomXMLAtt(nextXMLAtt(root, 1)), XMLATOM_device);
+    EXPECT_EQ(std::string(findXMLAttValuAtom(root, XMLATOM_state)), "Ok");
+    EXPECT_EQ(findXMLAttAtom(root, XMLATOM_format), nullptr);
+    EXPECT_EQ(tagAtomXMLEle(nodes[1]), XMLATOM_message);
+    EXPECT_EQ(nameAtomXMLAtt(findXMLAtt(nodes[1], "message")), XMLATOM_message);
+
+    setXMLEleTag(root, "pingReply");
+    EXPECT_EQ(tagAtomXMLEle(root), XMLATOM_pingReply);
+    addXMLAtt(root, "format", "%g");
+    EXPECT_EQ(std::string(findXMLAttValuAtom(root, XMLATOM_format)), "%g");
+    EXPECT_EQ(tagAtomXMLEle(addXMLEle(root, "custom")), XMLATOM_NONE);
+
+    for (int i = 0; nodes[i]; i++)
+        delXMLEle(nodes[i]);
+    free(nodes);
+}
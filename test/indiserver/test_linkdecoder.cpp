@@ -0,0 +1,252 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <list>
+#include <string>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "indiserver/LinkDecoder.hpp"
+#include "indiserver/CommandLineArgs.hpp"
+#include "indicore/indibinaryframe.h"
+#include "indicore/indicompression.h"
+#include "indicore/sharedblob.h"
+
+static CommandLineArgs arguments;
+CommandLineArgs* userConfigurableArguments = &arguments;
+
+static const std::string message = "<message device='dev' message='hello'/>\n";
+
+class LinkDecoderTest : public ::testing::Test
+{
+    protected:
+        XmlSplitter splitter;
+        std::list<ScannedXml> out;
+        std::list<int> sharedBuffers;
+        std::string failure;
+
+        void TearDown() override
+        {
+            release();
+        }
+
+        void release()
+        {
+            for (auto &scanned : out)
+                delXMLEle(scanned.root);
+            out.clear();
+            for (int fd : sharedBuffers)
+                close(fd);
+            sharedBuffers.clear();
+        }
+
+        bool decode(LinkDecoder &decoder, const std::string &data)
+        {
+            return decoder.decode(data.data(), data.size(), splitter, out, sharedBuffers, failure);
+        }
+
+        /* The root of the index-th message decoded, printed */
+        std::string printed(size_t index)
+        {
+            auto it = out.begin();
+            std::advance(it, index);
+            if (!it->raw.empty())
+                return it->raw;
+            std::string xml(sprlXMLEle(it->root, 0), '\0');
+            sprXMLEle(&xml[0], it->root, 0);
+            return xml;
+        }
+};
+
+static std::string frame(int kind, const std::string &body)
+{
+    std::string bytes;
+    uint32_t length = body.size() + 1;
+    for (int i = 0; i < 4; ++i)
+        bytes.push_back(char((length >> (8 * i)) & 0xff));
+    bytes.push_back(char(kind));
+    return bytes + body;
+}
+
+/* The frame of a set*Vector, as indiserver sends it */
+static std::string encode(const char * xml)
+{
+    class NoBlobs: public INDI::BinaryFrame::BlobSource
+    {
+            std::list<std::string> buffers;
+        public:
+            bool attached(const void *&, size_t &) override
+            {
+                return false;
+            }
+            void * allocate(size_t size) override
+            {
+                buffers.emplace_back(size, '\0');
+                return &buffers.back()[0];
+            }
+    } blobs;
+
+    LilXML * lp = newLilXML();
+    char errmsg[1024];
+    XMLEle ** nodes = parseXMLChunk(lp, const_cast<char *>(xml), strlen(xml), errmsg);
+    delLilXML(lp);
+    EXPECT_NE(nodes, nullptr);
+    XMLEle * root = nodes[0];
+    free(nodes);
+
+    INDI::BinaryFrame::Encoded encoded;
+    EXPECT_TRUE(INDI::BinaryFrame::encode(root, blobs, encoded));
+    delXMLEle(root);
+
+    std::string bytes;
+    size_t pos = 0;
+    for (auto &payload : encoded.payloads)
+    {
+        bytes.append(encoded.bytes, pos, payload.offset - pos);
+        bytes.append(static_cast<const char *>(payload.data), payload.size);
+        pos = payload.offset;
+    }
+    return bytes + encoded.bytes.substr(pos);
+}
+
+TEST_F(LinkDecoderTest, StaysXmlWithoutAcknowledgement)
+{
+    LinkDecoder decoder(LinkDecoder::Frames);
+
+    ASSERT_TRUE(decode(decoder, message)) << failure;
+    EXPECT_EQ(decoder.encoding(), LinkDecoder::Xml);
+    ASSERT_EQ(out.size(), 1u);
+
+    // Later frame-like bytes are XML as well
+    EXPECT_FALSE(decode(decoder, frame(INDI_FRAME_XML, message)));
+}
+
+TEST_F(LinkDecoderTest, FallbackAfterCommonPrefix)
+{
+    // Starts like the request, then differs: what was held back is XML
+    LinkDecoder decoder(LinkDecoder::Frames);
+    const std::string other = "<enableBLOB device='dev'>Also</enableBLOB>\n";
+
+    for (char c : other + message)
+        ASSERT_TRUE(decode(decoder, std::string(1, c))) << failure;
+
+    EXPECT_EQ(decoder.encoding(), LinkDecoder::Xml);
+    ASSERT_EQ(out.size(), 2u);
+    EXPECT_EQ(std::string(tagXMLEle(out.front().root)), "enableBLOB");
+    EXPECT_EQ(std::string(tagXMLEle(out.back().root)), "message");
+}
+
+TEST_F(LinkDecoderTest, FramesAfterAcknowledgement)
+{
+    LinkDecoder decoder(LinkDecoder::Frames);
+    std::string stream = std::string(INDI_BINARY_FRAMING_REQUEST) + frame(INDI_FRAME_XML, message)
+                         + encode("<setNumberVector device='dev' name='prop' state='Ok'>"
+                                  "<oneNumber name='a'>0.1</oneNumber></setNumberVector>");
+
+    // Split anywhere, the acknowledgement included
+    for (size_t split = 1; split < stream.size(); split += 7)
+    {
+        LinkDecoder decoder(LinkDecoder::Frames);
+        ASSERT_TRUE(decode(decoder, stream.substr(0, split))) << failure;
+        ASSERT_TRUE(decode(decoder, stream.substr(split))) << failure;
+        EXPECT_EQ(decoder.encoding(), LinkDecoder::Frames);
+        EXPECT_EQ(out.size(), 2u);
+        release();
+    }
+
+    ASSERT_TRUE(decode(decoder, stream)) << failure;
+    ASSERT_EQ(out.size(), 2u);
+    EXPECT_EQ(std::string(tagXMLEle(out.front().root)), "message");
+    EXPECT_EQ(printed(1),
+              "<setNumberVector device=\"dev\" name=\"prop\" state=\"Ok\">\n"
+              "    <oneNumber name=\"a\">\n0.1\n    </oneNumber>\n"
+              "</setNumberVector>\n");
+}
+
+TEST_F(LinkDecoderTest, BlobFrame)
+{
+    LinkDecoder decoder(LinkDecoder::Frames);
+    ASSERT_TRUE(decode(decoder, INDI_BINARY_FRAMING_REQUEST));
+    ASSERT_TRUE(decode(decoder, encode("<setBLOBVector device='dev' name='prop' state='Ok'>"
+                                       "<oneBLOB name='img' size='3' format='.txt'>QUJD</oneBLOB></setBLOBVector>")))
+            << failure;
+
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_EQ(decoder.getBlobBytes(), 3u);
+    XMLEle * blob = nextXMLEle(out.front().root, 1);
+    ASSERT_NE(blob, nullptr);
+    EXPECT_STREQ(findXMLAttValu(blob, "size"), "3");
+    EXPECT_STREQ(findXMLAttValu(blob, "format"), ".txt");
+#ifdef ENABLE_INDI_SHARED_MEMORY
+    EXPECT_STREQ(findXMLAttValu(blob, "attached"), "true");
+    ASSERT_EQ(sharedBuffers.size(), 1u);
+    char content[4] = {0};
+    EXPECT_EQ(pread(sharedBuffers.front(), content, 3, 0), 3);
+    EXPECT_STREQ(content, "ABC");
+#else
+    EXPECT_STREQ(pcdataXMLEle(blob), "QUJD");
+#endif
+}
+
+TEST_F(LinkDecoderTest, BadFrame)
+{
+    LinkDecoder decoder(LinkDecoder::Frames);
+    ASSERT_TRUE(decode(decoder, INDI_BINARY_FRAMING_REQUEST));
+
+    std::string body = encode("<setBLOBVector device='dev' name='prop'>"
+                              "<oneBLOB name='img' size='3' format='.txt'>QUJD</oneBLOB></setBLOBVector>").substr(5);
+
+    // Trailing bytes, once the BLOB content was stored
+    EXPECT_FALSE(decode(decoder, frame(INDI_FRAME_SET_BLOB, body + "x")));
+    EXPECT_TRUE(out.empty());
+    EXPECT_TRUE(sharedBuffers.empty());
+
+    // The same body read as switches: a value out of range
+    LinkDecoder other(LinkDecoder::Frames);
+    ASSERT_TRUE(decode(other, INDI_BINARY_FRAMING_REQUEST));
+    EXPECT_FALSE(decode(other, frame(INDI_FRAME_SET_SWITCH, body)));
+    EXPECT_TRUE(out.empty());
+
+    LinkDecoder empty(LinkDecoder::Frames);
+    ASSERT_TRUE(decode(empty, INDI_BINARY_FRAMING_REQUEST));
+    EXPECT_FALSE(decode(empty, std::string(4, '\0')));
+}
+
+TEST_F(LinkDecoderTest, Deflate)
+{
+    std::string compressed(1024, '\0');
+    z_stream deflater;
+    memset(&deflater, 0, sizeof(deflater));
+    ASSERT_EQ(deflateInit(&deflater, Z_DEFAULT_COMPRESSION), Z_OK);
+    ASSERT_EQ(deflateSetDictionary(&deflater, reinterpret_cast<const Bytef *>(indiCompressionDictionary),
+                                   sizeof(indiCompressionDictionary) - 1), Z_OK);
+    deflater.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(message.data()));
+    deflater.avail_in = message.size();
+    deflater.next_out = reinterpret_cast<Bytef *>(&compressed[0]);
+    deflater.avail_out = compressed.size();
+    ASSERT_EQ(deflate(&deflater, Z_SYNC_FLUSH), Z_OK);
+    compressed.resize(compressed.size() - deflater.avail_out);
+    deflateEnd(&deflater);
+
+    LinkDecoder decoder(LinkDecoder::Deflate);
+    ASSERT_TRUE(decode(decoder, INDI_COMPRESSION_REQUEST + compressed)) << failure;
+    EXPECT_EQ(decoder.encoding(), LinkDecoder::Deflate);
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_EQ(std::string(tagXMLEle(out.front().root)), "message");
+}
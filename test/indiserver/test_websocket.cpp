@@ -0,0 +1,285 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "indiserver/WebSocket.hpp"
+
+static const std::string request =
+    "GET /indi HTTP/1.1\r\n"
+    "Host: localhost:7625\r\n"
+    "Upgrade: websocket\r\n"
+    "Connection: keep-alive, Upgrade\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+    "Sec-WebSocket-Version: 13\r\n";
+
+static const std::string accepted =
+    "HTTP/1.1 101 Switching Protocols\r\n"
+    "Upgrade: websocket\r\n"
+    "Connection: Upgrade\r\n"
+    "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n"
+    "\r\n";
+
+static std::string pending(WebSocket &ws)
+{
+    std::string out(ws.pendingData(), ws.pendingSize());
+    ws.consume(out.size());
+    return out;
+}
+
+/* A masked client frame */
+static std::string clientFrame(int first, const std::string &payload)
+{
+    static const unsigned char mask[4] = { 0x37, 0xfa, 0x21, 0x3d };
+
+    std::string frame;
+    frame.push_back((char)first);
+    if (payload.size() < 126)
+    {
+        frame.push_back((char)(0x80 | payload.size()));
+    }
+    else if (payload.size() <= 0xffff)
+    {
+        frame.push_back((char)(0x80 | 126));
+        frame.push_back((char)(payload.size() >> 8));
+        frame.push_back((char)payload.size());
+    }
+    else
+    {
+        frame.push_back((char)(0x80 | 127));
+        for (int i = 7; i >= 0; --i)
+            frame.push_back((char)(payload.size() >> (8 * i)));
+    }
+    frame.append((const char *)mask, 4);
+    for (size_t i = 0; i < payload.size(); ++i)
+        frame.push_back((char)(payload[i] ^ mask[i & 3]));
+    return frame;
+}
+
+/* An open connection */
+static void open(WebSocket &ws)
+{
+    std::string text, failure;
+    ASSERT_TRUE(ws.receive((request + "\r\n").data(), request.size() + 2, text, failure)) << failure;
+    ASSERT_TRUE(ws.isOpen());
+    ASSERT_EQ(pending(ws), accepted);
+}
+
+static bool receive(WebSocket &ws, const std::string &data, std::string &text, std::string &failure)
+{
+    return ws.receive(data.data(), data.size(), text, failure);
+}
+
+TEST(WebSocket, AcceptKey)
+{
+    // RFC 6455, section 1.3
+    EXPECT_EQ(WebSocket::acceptKey("dGhlIHNhbXBsZSBub25jZQ=="), "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+    EXPECT_EQ(WebSocket::acceptKey("x3JJHMbDL1EzLkh9GBhXDw=="), "HSmrc0sMlYUkAGmm5OPpG2HaGWk=");
+}
+
+TEST(WebSocket, HandshakeInPieces)
+{
+    WebSocket ws;
+    std::string full = request + "Sec-WebSocket-Protocol: chat, indi\r\n\r\n" + clientFrame(0x81, "<a/>");
+    std::string text, failure;
+
+    for (char c : full)
+        ASSERT_TRUE(ws.receive(&c, 1, text, failure)) << failure;
+
+    EXPECT_TRUE(ws.isOpen());
+    EXPECT_EQ(pending(ws), accepted.substr(0, accepted.size() - 2) + "Sec-WebSocket-Protocol: indi\r\n\r\n");
+    EXPECT_EQ(text, "<a/>");
+}
+
+TEST(WebSocket, HandshakeRejected)
+{
+    struct
+    {
+        std::string request;
+        std::string status;
+    } cases[] =
+    {
+        { "POST" + request.substr(3), "HTTP/1.1 400 Bad Request\r\n" },
+        { "GET / HTTP/1.1\r\nSec-WebSocket-Key: a\r\nSec-WebSocket-Version: 13\r\n", "HTTP/1.1 400 Bad Request\r\n" },
+        { request.substr(0, request.find("Sec-WebSocket-Version")) + "Sec-WebSocket-Version: 8\r\n", "HTTP/1.1 426 Upgrade Required\r\n" },
+    };
+
+    for (auto &c : cases)
+    {
+        WebSocket ws;
+        std::string text, failure;
+        EXPECT_TRUE(receive(ws, c.request + "\r\n", text, failure));
+        EXPECT_FALSE(ws.isOpen());
+        EXPECT_TRUE(ws.isClosing());
+        EXPECT_EQ(pending(ws).substr(0, c.status.size()), c.status);
+    }
+
+    WebSocket ws;
+    std::string text, failure;
+    EXPECT_FALSE(receive(ws, std::string(9000, 'x'), text, failure));
+}
+
+TEST(WebSocket, Origins)
+{
+    const std::string fromPage = request + "Origin: http://example.com\r\n\r\n";
+    std::string text, failure;
+
+    // A page of any site
+    WebSocket refusing;
+    EXPECT_TRUE(receive(refusing, fromPage, text, failure));
+    EXPECT_FALSE(refusing.isOpen());
+    EXPECT_EQ(pending(refusing).substr(0, 26), "HTTP/1.1 403 Forbidden\r\nCo");
+
+    WebSocket other({ "http://localhost:8080" });
+    EXPECT_TRUE(receive(other, fromPage, text, failure));
+    EXPECT_FALSE(other.isOpen());
+
+    WebSocket allowing({ "http://localhost:8080", "HTTP://Example.com" });
+    EXPECT_TRUE(receive(allowing, fromPage, text, failure));
+    EXPECT_TRUE(allowing.isOpen());
+
+    WebSocket any({ "*" });
+    EXPECT_TRUE(receive(any, fromPage, text, failure));
+    EXPECT_TRUE(any.isOpen());
+
+    // Not a browser
+    WebSocket noOrigin;
+    EXPECT_TRUE(receive(noOrigin, request + "\r\n", text, failure));
+    EXPECT_TRUE(noOrigin.isOpen());
+}
+
+TEST(WebSocket, Masking)
+{
+    WebSocket ws;
+    open(ws);
+
+    // RFC 6455, section 5.7
+    const unsigned char hello[] = { 0x81, 0x85, 0x37, 0xfa, 0x21, 0x3d, 0x7f, 0x9f, 0x4d, 0x51, 0x58 };
+    std::string text, failure;
+    EXPECT_TRUE(ws.receive((const char *)hello, sizeof(hello), text, failure)) << failure;
+    EXPECT_EQ(text, "Hello");
+
+    // Unmasked client frames are refused
+    const unsigned char unmasked[] = { 0x81, 0x05, 0x48, 0x65, 0x6c, 0x6c, 0x6f };
+    WebSocket other;
+    open(other);
+    EXPECT_FALSE(other.receive((const char *)unmasked, sizeof(unmasked), text, failure));
+}
+
+TEST(WebSocket, Fragmentation)
+{
+    WebSocket ws;
+    open(ws);
+
+    std::string text, failure;
+    EXPECT_TRUE(receive(ws, clientFrame(0x01, "<getProp"), text, failure)) << failure;
+    // Control frames may come between fragments
+    EXPECT_TRUE(receive(ws, clientFrame(0x89, "p"), text, failure)) << failure;
+    EXPECT_TRUE(receive(ws, clientFrame(0x00, "erties "), text, failure)) << failure;
+    EXPECT_TRUE(receive(ws, clientFrame(0x80, "version='1.7'/>"), text, failure)) << failure;
+    EXPECT_EQ(text, "<getProperties version='1.7'/>");
+    EXPECT_EQ(pending(ws), std::string("\x8a\x01p", 3));
+
+    // A new message may start once the previous one is complete
+    EXPECT_TRUE(receive(ws, clientFrame(0x81, "<a/>"), text, failure)) << failure;
+
+    // Not in the middle of another, nor continue a message never started
+    WebSocket interleaved;
+    open(interleaved);
+    EXPECT_FALSE(receive(interleaved, clientFrame(0x01, "a") + clientFrame(0x81, "b"), text, failure));
+
+    WebSocket orphan;
+    open(orphan);
+    EXPECT_FALSE(receive(orphan, clientFrame(0x80, "a"), text, failure));
+}
+
+TEST(WebSocket, ControlFrames)
+{
+    WebSocket ws;
+    open(ws);
+    std::string text, failure;
+
+    EXPECT_TRUE(receive(ws, clientFrame(0x89, "ping"), text, failure)) << failure;
+    EXPECT_EQ(pending(ws), std::string("\x8a\x04ping", 6));
+
+    EXPECT_TRUE(receive(ws, clientFrame(0x8a, "unsolicited"), text, failure)) << failure;
+    EXPECT_FALSE(ws.hasPending());
+
+    // Close is echoed with its status code only, then nothing more is read
+    EXPECT_TRUE(receive(ws, clientFrame(0x88, "\x03\xe8" "bye") + clientFrame(0x81, "<a/>"), text, failure));
+    EXPECT_TRUE(ws.isClosing());
+    EXPECT_EQ(pending(ws), std::string("\x88\x02\x03\xe8", 4));
+    EXPECT_EQ(text, "");
+
+    // Fragmented or longer than 125 bytes
+    WebSocket fragmented;
+    open(fragmented);
+    EXPECT_FALSE(receive(fragmented, clientFrame(0x09, "ping"), text, failure));
+
+    WebSocket large;
+    open(large);
+    EXPECT_FALSE(receive(large, clientFrame(0x89, std::string(126, 'x')), text, failure));
+
+    // Neither binary, reserved bits nor unknown opcodes
+    for (int first : { 0x82, 0xc1, 0x83, 0x8b })
+    {
+        WebSocket refused;
+        open(refused);
+        EXPECT_FALSE(receive(refused, clientFrame(first, "x"), text, failure)) << first;
+    }
+}
+
+TEST(WebSocket, HeaderLengths)
+{
+    for (size_t size : { (size_t)125, (size_t)126, (size_t)65535, (size_t)65536 })
+    {
+        WebSocket ws;
+        open(ws);
+
+        // Byte by byte: headers end up split anywhere
+        std::string payload(size, 'a');
+        std::string frame = clientFrame(0x81, payload);
+        std::string text, failure;
+        for (char c : frame.substr(0, 16))
+            ASSERT_TRUE(ws.receive(&c, 1, text, failure)) << failure;
+        ASSERT_TRUE(ws.receive(frame.data() + 16, frame.size() - 16, text, failure)) << failure;
+        EXPECT_EQ(text, payload);
+    }
+
+    // A 64 bit length must have its most significant bit clear
+    WebSocket ws;
+    open(ws);
+    const unsigned char oversized[] = { 0x81, 0xff, 0x80, 0, 0, 0, 0, 0, 0, 1, 0x37, 0xfa, 0x21, 0x3d };
+    std::string text, failure;
+    EXPECT_FALSE(ws.receive((const char *)oversized, sizeof(oversized), text, failure));
+}
+
+TEST(WebSocket, ServerFrameHeader)
+{
+    char header[WebSocket::maxHeaderSize];
+
+    EXPECT_EQ(WebSocket::frameHeader(header, WebSocket::Text, 125), 2u);
+    EXPECT_EQ(std::string(header, 2), "\x81\x7d");
+
+    EXPECT_EQ(WebSocket::frameHeader(header, WebSocket::Binary, 126), 4u);
+    EXPECT_EQ(std::string(header, 4), std::string("\x82\x7e\x00\x7e", 4));
+
+    EXPECT_EQ(WebSocket::frameHeader(header, WebSocket::Binary, 0x10000), 10u);
+    EXPECT_EQ(std::string(header, 10), std::string("\x82\x7f\x00\x00\x00\x00\x00\x01\x00\x00", 10));
+}
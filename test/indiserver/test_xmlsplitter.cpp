@@ -0,0 +1,246 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <list>
+#include <string>
+
+#include "indiserver/XmlSplitter.hpp"
+#include "indiserver/CommandLineArgs.hpp"
+
+static CommandLineArgs arguments;
+CommandLineArgs* userConfigurableArguments = &arguments;
+
+static const std::string numberUpdate =
+    "<setNumberVector device='Telescope Simulator' name='EQUATORIAL_EOD_COORD' state='Ok' timeout='60'>\n"
+    "    <oneNumber name='RA'>\n      1.5\n    </oneNumber>\n"
+    "    <oneNumber name='DEC'>\n      -2\n    </oneNumber>\n"
+    "</setNumberVector>";
+
+static const std::string blobUpdate =
+    "<setBLOBVector device='CCD Simulator' name='CCD1' state='Ok'>\n"
+    "    <oneBLOB name='CCD1' size='3' format='.fits' len='4'>\n"
+    "QUJD\n"
+    "    </oneBLOB>\n"
+    "</setBLOBVector>";
+
+static void release(std::list<ScannedXml> &out)
+{
+    for (auto &scanned : out)
+        delXMLEle(scanned.root);
+    out.clear();
+}
+
+/* feed input in chunks of chunkSize bytes */
+static bool feedChunks(XmlSplitter &splitter, const std::string &input, size_t chunkSize,
+                       std::list<ScannedXml> &out, std::string &err)
+{
+    for (size_t pos = 0; pos < input.size(); pos += chunkSize)
+    {
+        size_t len = std::min(chunkSize, input.size() - pos);
+        if (!splitter.feed(input.data() + pos, len, out, err))
+            return false;
+    }
+    return true;
+}
+
+TEST(XmlSplitterTest, ScannedElementKeepsItsBytes)
+{
+    XmlSplitter splitter;
+    std::list<ScannedXml> out;
+    std::string err;
+
+    ASSERT_TRUE(feedChunks(splitter, numberUpdate + "\n", numberUpdate.size() + 1, out, err)) << err;
+    ASSERT_EQ(out.size(), 1u);
+
+    // Only the root tag is parsed, the children stay in the raw bytes
+    XMLEle *root = out.front().root;
+    EXPECT_STREQ(tagXMLEle(root), "setNumberVector");
+    EXPECT_STREQ(findXMLAttValu(root, "name"), "EQUATORIAL_EOD_COORD");
+    EXPECT_EQ(nXMLEle(root), 0);
+    EXPECT_EQ(out.front().raw, numberUpdate + "\n");
+
+    release(out);
+}
+
+TEST(XmlSplitterTest, ChunkBoundariesAnywhere)
+{
+    std::string input = "<?xml version='1.0'?>\n" + numberUpdate + "\n<!-- a comment -->" + blobUpdate
+                        + "\n<getProperties version='1.7'/>\n" + numberUpdate;
+
+    for (size_t chunkSize = 1; chunkSize <= 17; ++chunkSize)
+    {
+        XmlSplitter splitter;
+        std::list<ScannedXml> out;
+        std::string err;
+
+        ASSERT_TRUE(feedChunks(splitter, input, chunkSize, out, err)) << "chunks of " << chunkSize << ": " << err;
+        ASSERT_EQ(out.size(), 4u) << "chunks of " << chunkSize;
+
+        auto it = out.begin();
+        EXPECT_STREQ(tagXMLEle(it->root), "setNumberVector");
+        EXPECT_EQ(it->raw, numberUpdate + "\n");
+        ++it;
+        EXPECT_STREQ(tagXMLEle(it->root), "setBLOBVector");
+        EXPECT_TRUE(it->raw.empty());
+        ++it;
+        EXPECT_STREQ(tagXMLEle(it->root), "getProperties");
+        ++it;
+        EXPECT_EQ(it->raw, numberUpdate + "\n");
+
+        release(out);
+    }
+}
+
+TEST(XmlSplitterTest, NestedElementsWithSameTag)
+{
+    XmlSplitter splitter;
+    std::list<ScannedXml> out;
+    std::string err;
+
+    std::string input = "<a x='1'><a><b/>text<a>y</a></a></a><c/>";
+    ASSERT_TRUE(feedChunks(splitter, input, 3, out, err)) << err;
+    ASSERT_EQ(out.size(), 2u);
+    EXPECT_EQ(out.front().raw, "<a x='1'><a><b/>text<a>y</a></a></a>\n");
+    EXPECT_EQ(out.back().raw, "<c/>\n");
+
+    release(out);
+}
+
+TEST(XmlSplitterTest, QuotedCharactersDoNotEndTags)
+{
+    XmlSplitter splitter;
+    std::list<ScannedXml> out;
+    std::string err;
+
+    std::string input = "<message device='D' message=\"a > b, '/>' &amp; &quot;c&quot;\"/>";
+    ASSERT_TRUE(feedChunks(splitter, input, 2, out, err)) << err;
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_STREQ(findXMLAttValu(out.front().root, "message"), "a > b, '/>' & \"c\"");
+    // forwarded as received
+    EXPECT_EQ(out.front().raw, input + "\n");
+
+    release(out);
+}
+
+TEST(XmlSplitterTest, EntitiesInScannedContent)
+{
+    XmlSplitter splitter;
+    std::list<ScannedXml> out;
+    std::string err;
+
+    std::string input = "<setTextVector device='D&amp;E' name='T'><oneText name='X'>x &lt; y &amp; z</oneText></setTextVector>";
+    ASSERT_TRUE(feedChunks(splitter, input, 5, out, err)) << err;
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_STREQ(findXMLAttValu(out.front().root, "device"), "D&E");
+    EXPECT_EQ(out.front().raw, input + "\n");
+
+    release(out);
+}
+
+TEST(XmlSplitterTest, BLOBsAreParsedCompletely)
+{
+    XmlSplitter splitter;
+    std::list<ScannedXml> out;
+    std::string err;
+
+    std::string input = blobUpdate + "<newBLOBVector device='D' name='B'><oneBLOB name='B' size='0' format='.z'/>"
+                        "</newBLOBVector><enableBLOB device='D'>Also</enableBLOB>";
+    ASSERT_TRUE(feedChunks(splitter, input, 7, out, err)) << err;
+    ASSERT_EQ(out.size(), 3u);
+
+    for (auto &scanned : out)
+        EXPECT_TRUE(scanned.raw.empty()) << tagXMLEle(scanned.root);
+
+    XMLEle *blob = findXMLEle(out.front().root, "oneBLOB");
+    ASSERT_NE(blob, nullptr);
+    EXPECT_STREQ(findXMLAttValu(blob, "format"), ".fits");
+    EXPECT_STREQ(pcdataXMLEle(out.back().root), "Also");
+
+    release(out);
+}
+
+TEST(XmlSplitterTest, EverythingParsedWhenTracing)
+{
+    arguments.verbosity = 3;
+    XmlSplitter splitter;
+    std::list<ScannedXml> out;
+    std::string err;
+
+    ASSERT_TRUE(feedChunks(splitter, numberUpdate, 11, out, err)) << err;
+    arguments.verbosity = 0;
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_TRUE(out.front().raw.empty());
+    EXPECT_EQ(nXMLEle(out.front().root), 2);
+
+    release(out);
+}
+
+TEST(XmlSplitterTest, CachedVectorsParsedAndKept)
+{
+    arguments.cacheProperties = true;
+    XmlSplitter splitter;
+    std::list<ScannedXml> out;
+    std::string err;
+
+    const std::string ping = "<pingReply uid='1'/>";
+    ASSERT_TRUE(feedChunks(splitter, numberUpdate + "\n" + ping + numberUpdate, 11, out, err)) << err;
+    arguments.cacheProperties = false;
+    ASSERT_EQ(out.size(), 3u);
+
+    // Complete for the cache, and forwarded as it came
+    for (auto &scanned : { out.front(), out.back() })
+    {
+        EXPECT_EQ(nXMLEle(scanned.root), 2);
+        EXPECT_EQ(scanned.raw, numberUpdate + "\n");
+    }
+    EXPECT_EQ(std::next(out.begin())->raw, ping + "\n");
+
+    release(out);
+}
+
+TEST(XmlSplitterTest, RejectsTextOutsideElements)
+{
+    XmlSplitter splitter;
+    std::list<ScannedXml> out;
+    std::string err;
+
+    ASSERT_TRUE(feedChunks(splitter, " \t\r\n" + numberUpdate + "\n\n", 4, out, err)) << err;
+    EXPECT_EQ(out.size(), 1u);
+    EXPECT_FALSE(splitter.feed("junk", 4, out, err));
+    EXPECT_FALSE(err.empty());
+
+    release(out);
+}
+
+TEST(XmlSplitterTest, RejectsBadNesting)
+{
+    std::list<ScannedXml> out;
+    std::string err;
+
+    XmlSplitter unexpected;
+    EXPECT_FALSE(feedChunks(unexpected, "</setNumberVector>", 4, out, err));
+
+    XmlSplitter mismatch;
+    EXPECT_FALSE(feedChunks(mismatch, "<setNumberVector><oneNumber></setNumberVector>", 4, out, err));
+
+    XmlSplitter badTag;
+    EXPECT_FALSE(feedChunks(badTag, "< setNumberVector/>", 4, out, err));
+
+    EXPECT_TRUE(out.empty());
+}
@@ -0,0 +1,244 @@
+/* parse the messages of an indiserver -C capture, or of a file of INDI XML,
+ *   with lilxml, and report the allocations and time spent per message with
+ *   and without arenas.
+ * The messages are concatenated and fed to parseXMLChunk in chunks, as read
+ *   from a connection, then each parsed message is deleted.
+ * exit status: 0 done, 2 real trouble.
+ */
+
+#include "lilxml.h"
+#include "CaptureFormat.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+#define CHUNK 32768     /* default bytes fed at once */
+#define REPEAT 10       /* default passes over the messages */
+
+static void usage(void);
+static uint64_t now(void);
+static bool loadMessages(const char *path, std::string &xml);
+static void bench(const std::string &xml, int chunk, int repeat, int arena);
+
+static char *me;                /* our name for usage() message */
+
+/* lilxml allocator counting what goes through it */
+static uint64_t nalloc;
+static uint64_t nbytes;
+
+static void *countedMalloc(size_t size)
+{
+    nalloc++;
+    nbytes += size;
+    return malloc(size);
+}
+
+static void *countedRealloc(void *ptr, size_t size)
+{
+    nalloc++;
+    nbytes += size;
+    return realloc(ptr, size);
+}
+
+int main(int ac, char *av[])
+{
+    int chunk = CHUNK;
+    int repeat = REPEAT;
+
+    /* save our name */
+    me = av[0];
+
+    /* crack args */
+    while (--ac && **++av == '-')
+    {
+        char *s = *av;
+        while (*++s)
+        {
+            switch (*s)
+            {
+                case 'c':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-c requires chunk size\n");
+                        usage();
+                    }
+                    chunk = atoi(*++av);
+                    if (chunk <= 0)
+                    {
+                        fprintf(stderr, "-c requires a positive chunk size\n");
+                        usage();
+                    }
+                    ac--;
+                    break;
+                case 'r':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-r requires repeat count\n");
+                        usage();
+                    }
+                    repeat = atoi(*++av);
+                    if (repeat <= 0)
+                    {
+                        fprintf(stderr, "-r requires a positive repeat count\n");
+                        usage();
+                    }
+                    ac--;
+                    break;
+                default:
+                    fprintf(stderr, "Unknown flag: %c\n", *s);
+                    usage();
+            }
+        }
+    }
+
+    if (ac != 1)
+        usage();
+
+    std::string xml;
+    if (!loadMessages(av[0], xml))
+        return 2;
+
+    indi_xmlMalloc(countedMalloc, countedRealloc, free);
+
+    printf("%-8s %10s %12s %12s %10s\n", "mode", "messages", "allocs/msg", "bytes/msg", "ns/msg");
+    bench(xml, chunk, repeat, 0);
+    bench(xml, chunk, repeat, 1);
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Purpose: measure the lilxml parser on recorded INDI traffic\n");
+    fprintf(stderr, "%s\n", GIT_TAG_STRING);
+    fprintf(stderr, "Usage: %s [options] file\n", me);
+    fprintf(stderr, "  file is a capture of indiserver -C, or a file of XML messages.\n");
+    fprintf(stderr, "  Allocations are those of lilxml, parsed messages included.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -c c  : bytes given to the parser at once, default is %d\n", CHUNK);
+    fprintf(stderr, "  -r r  : passes over the messages, default is %d\n", REPEAT);
+    fprintf(stderr, "Exit status:\n");
+    fprintf(stderr, "  0: measures done\n");
+    fprintf(stderr, "  2: real trouble\n");
+
+    exit(2);
+}
+
+static uint64_t now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* little endian integer at p */
+static uint64_t readInt(const char *p, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++)
+        value |= (uint64_t)(unsigned char)p[i] << (8 * i);
+    return value;
+}
+
+/* set xml to the messages of the file at path */
+static bool loadMessages(const char *path, std::string &xml)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return false;
+    }
+    std::string data;
+    char buf[65536];
+    size_t nr;
+    while ((nr = fread(buf, 1, sizeof(buf), fp)) > 0)
+        data.append(buf, nr);
+    fclose(fp);
+
+    if (data.compare(0, CAPTURE_MAGIC_SIZE, CAPTURE_MAGIC) != 0)
+    {
+        xml = std::move(data);
+        return true;
+    }
+
+    /* the messages sent by drivers and clients, in the order received */
+    size_t pos = CAPTURE_MAGIC_SIZE;
+    while (pos + CAPTURE_RECORD_HEADER_SIZE <= data.size())
+    {
+        int type = (unsigned char)data[pos];
+        pos += CAPTURE_RECORD_HEADER_SIZE;
+
+        size_t length;
+        switch (type)
+        {
+            case CaptureOpen:
+                length = pos + 3 <= data.size() ? 3 + readInt(&data[pos + 1], 2) : 3;
+                break;
+            case CaptureClose:
+                length = 0;
+                break;
+            case CaptureIn:
+                length = pos + 8 <= data.size() ? 8 + readInt(&data[pos + 4], 4) : 8;
+                if (pos + length <= data.size())
+                    xml.append(data, pos + 8, length - 8);
+                break;
+            case CaptureOut:
+                length = 4;
+                break;
+            default:
+                fprintf(stderr, "%s: unknown record %d, capture truncated there\n", path, type);
+                return true;
+        }
+        if (pos + length > data.size())
+        {
+            fprintf(stderr, "%s: last record is incomplete\n", path);
+            break;
+        }
+        pos += length;
+    }
+    return true;
+}
+
+/* parse xml repeat times, chunk bytes at a time, and report */
+static void bench(const std::string &xml, int chunk, int repeat, int arena)
+{
+    std::string copy = xml;
+    char ynot[1024];
+    uint64_t messages = 0;
+
+    LilXML *lp = newLilXML();
+    setArenaLilXML(lp, arena);
+
+    uint64_t allocs = nalloc;
+    uint64_t bytes = nbytes;
+    uint64_t start = now();
+    for (int r = 0; r < repeat; r++)
+    {
+        for (size_t off = 0; off < copy.size(); off += chunk)
+        {
+            int size = (int)std::min(copy.size() - off, (size_t)chunk);
+            XMLEle **nodes = parseXMLChunk(lp, &copy[off], size, ynot);
+            if (nodes == NULL)
+                continue;
+            for (int i = 0; nodes[i]; i++, messages++)
+                delXMLEle(nodes[i]);
+            free(nodes);
+        }
+    }
+    uint64_t ns = now() - start;
+    delLilXML(lp);
+
+    if (messages == 0)
+    {
+        printf("%-8s %10s\n", arena ? "arena" : "malloc", "none");
+        return;
+    }
+    printf("%-8s %10llu %12.2f %12.1f %10.1f\n", arena ? "arena" : "malloc", (unsigned long long)messages,
+           (double)(nalloc - allocs) / messages, (double)(nbytes - bytes) / messages, (double)ns / messages);
+}
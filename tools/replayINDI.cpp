@@ -0,0 +1,781 @@
+/* play back a traffic capture of indiserver -C through a local indiserver,
+ *   and report the throughput and latency of the messages it delivered.
+ * Each driver of the capture is replaced by this very program, started by
+ *   indiserver under the name indi_replay_driver_<n>: it sends what the driver
+ *   sent, at the recorded times. Each client is a thread connecting to the
+ *   server at the recorded time and sending what the client sent.
+ * Driver messages get a replay attribute holding their sending time: clients
+ *   use it to measure the delay of each message through the server.
+ * exit status: 0 replay done, 2 real trouble.
+ */
+
+#include "base64.h"
+#include "lilxml.h"
+#include "CaptureFormat.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define DRIVER_PREFIX "indi_replay_driver_"     /* name of the fake drivers */
+#define REPLAYPORT 17624                        /* default port */
+#define HEADSTART 500                           /* ms given to clients before drivers start at max speed */
+#define IDLE 1000                               /* ms without traffic that ends a client */
+
+typedef struct
+{
+    uint64_t ns;        /* since the capture started */
+    std::string xml;
+} Record;
+
+typedef struct
+{
+    CaptureRole role;
+    std::string name;
+    uint64_t openNs;
+    bool closed;
+    uint64_t closeNs;
+    std::vector<Record> in;     /* messages it sent */
+} Connection;
+
+typedef struct
+{
+    uint64_t messages;          /* driver messages received */
+    uint64_t bytes;
+    uint64_t lastNs;            /* time of the last data */
+    std::vector<uint64_t> latencies;
+} ClientStats;
+
+static void usage(void);
+static uint64_t now(void);
+static void sleepUntil(uint64_t ns);
+static bool loadCapture(const char *path, std::vector<Connection> &connections, uint64_t &endNs);
+static std::vector<std::string> driverNames(const std::vector<Connection> &connections);
+static std::string expandBlobs(const std::string &xml);
+static bool writeAll(int fd, const struct iovec *iov, int count);
+static int driverMain(int index);
+static void replayClient(const Connection *c, uint64_t t0, double speed, uint64_t endNs, int port,
+                         ClientStats *stats);
+
+static char *me;                /* our name for usage() message */
+static int verbose;             /* report extra info */
+
+int main(int ac, char *av[])
+{
+    const char *base = strrchr(av[0], '/');
+    base = base ? base + 1 : av[0];
+    if (strncmp(base, DRIVER_PREFIX, strlen(DRIVER_PREFIX)) == 0)
+        return driverMain(atoi(base + strlen(DRIVER_PREFIX)));
+
+    /* save our name */
+    me = av[0];
+
+    double speed = 1;
+    int port = REPLAYPORT;
+    const char *server = "indiserver";
+    std::vector<const char *> serverArgs;
+
+    /* crack args */
+    while (--ac && **++av == '-')
+    {
+        char *s = *av;
+        while (*++s)
+        {
+            switch (*s)
+            {
+                case 'a':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-a requires indiserver argument\n");
+                        usage();
+                    }
+                    serverArgs.push_back(*++av);
+                    ac--;
+                    break;
+                case 'e':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-e requires indiserver path\n");
+                        usage();
+                    }
+                    server = *++av;
+                    ac--;
+                    break;
+                case 'p':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-p requires tcp port number\n");
+                        usage();
+                    }
+                    port = atoi(*++av);
+                    ac--;
+                    break;
+                case 's':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-s requires speed factor\n");
+                        usage();
+                    }
+                    speed = atof(*++av);
+                    if (speed <= 0)
+                    {
+                        fprintf(stderr, "-s requires a positive speed factor\n");
+                        usage();
+                    }
+                    ac--;
+                    break;
+                case 'v':
+                    verbose++;
+                    break;
+                case 'x':
+                    speed = 0;
+                    break;
+                default:
+                    fprintf(stderr, "Unknown flag: %c\n", *s);
+                    usage();
+            }
+        }
+    }
+
+    if (ac != 1)
+        usage();
+
+    char capture[PATH_MAX];
+    if (realpath(av[0], capture) == NULL)
+    {
+        fprintf(stderr, "%s: %s\n", av[0], strerror(errno));
+        return 2;
+    }
+
+    std::vector<Connection> connections;
+    uint64_t endNs;
+    if (!loadCapture(capture, connections, endNs))
+        return 2;
+
+    std::vector<std::string> drivers = driverNames(connections);
+
+    /* the fake drivers are links to ourself */
+    char self[PATH_MAX];
+    ssize_t selfLen = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    char dir[] = "/tmp/indi_replay.XXXXXX";
+    if (selfLen < 0 || mkdtemp(dir) == NULL)
+    {
+        fprintf(stderr, "Can not set up fake drivers: %s\n", strerror(errno));
+        return 2;
+    }
+    self[selfLen] = '\0';
+
+    std::vector<std::string> links;
+    for (size_t i = 0; i < drivers.size(); i++)
+    {
+        links.push_back(std::string(dir) + "/" + DRIVER_PREFIX + std::to_string(i));
+        if (symlink(self, links.back().c_str()) < 0)
+        {
+            fprintf(stderr, "%s: %s\n", links.back().c_str(), strerror(errno));
+            return 2;
+        }
+        if (verbose)
+            fprintf(stderr, "Driver %s replayed by %s\n", drivers[i].c_str(), links.back().c_str());
+    }
+
+    std::string startPath = std::string(dir) + "/start";
+    std::string logPath = std::string(dir) + "/indiserver.log";
+    std::string socketPath = std::string(dir) + "/socket";
+    std::string portArg = std::to_string(port);
+
+    setenv("INDI_REPLAY_CAPTURE", capture, 1);
+    setenv("INDI_REPLAY_START", startPath.c_str(), 1);
+    setenv("INDI_REPLAY_SPEED", std::to_string(speed).c_str(), 1);
+
+    std::vector<const char *> args = { server, "-p", portArg.c_str(), "-r", "0" };
+#ifdef ENABLE_INDI_SHARED_MEMORY
+    /* do not collide with a running server */
+    args.push_back("-u");
+    args.push_back(socketPath.c_str());
+#endif
+    args.insert(args.end(), serverArgs.begin(), serverArgs.end());
+    for (auto &link : links)
+        args.push_back(link.c_str());
+    args.push_back(NULL);
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        fprintf(stderr, "fork: %s\n", strerror(errno));
+        return 2;
+    }
+    if (pid == 0)
+    {
+        if (!verbose)
+        {
+            int fd = open(logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd >= 0)
+                dup2(fd, 2);
+        }
+        execvp(server, (char * const *)args.data());
+        fprintf(stderr, "execvp %s: %s\n", server, strerror(errno));
+        _exit(1);
+    }
+
+    /* wait for the server to listen */
+    bool ready = false;
+    for (int i = 0; i < 200 && !ready; i++)
+    {
+        usleep(50000);
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ready = connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+        close(fd);
+        if (waitpid(pid, NULL, WNOHANG) == pid)
+            break;
+    }
+
+    int status = 0;
+    if (!ready)
+    {
+        fprintf(stderr, "%s did not start, see %s\n", server, logPath.c_str());
+        kill(pid, SIGTERM);
+        return 2;
+    }
+
+    /* go: clients from t0, drivers from driverT0 */
+    uint64_t t0 = now() + 100000000ull;
+    uint64_t driverT0 = speed > 0 ? t0 : t0 + HEADSTART * 1000000ull;
+    std::string tmpStart = startPath + ".tmp";
+    FILE *fp = fopen(tmpStart.c_str(), "w");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "%s: %s\n", tmpStart.c_str(), strerror(errno));
+        kill(pid, SIGTERM);
+        return 2;
+    }
+    fprintf(fp, "%llu\n", (unsigned long long)driverT0);
+    fclose(fp);
+    rename(tmpStart.c_str(), startPath.c_str());
+
+    uint64_t clientEndNs = speed > 0 ? t0 + (uint64_t)(endNs / speed) : driverT0;
+    std::vector<const Connection *> clients;
+    for (auto &c : connections)
+        if (c.role == CaptureClient)
+            clients.push_back(&c);
+    std::vector<ClientStats> stats(clients.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < clients.size(); i++)
+        threads.emplace_back(replayClient, clients[i], t0, speed, clientEndNs, port, &stats[i]);
+    for (auto &thread : threads)
+        thread.join();
+
+    kill(pid, SIGTERM);
+    waitpid(pid, &status, 0);
+
+    /* report */
+    uint64_t driverMessages = 0;
+    for (auto &c : connections)
+        if (c.role == CaptureDriver)
+            driverMessages += c.in.size();
+
+    ClientStats total = { 0, 0, 0, {} };
+    for (auto &s : stats)
+    {
+        total.messages += s.messages;
+        total.bytes += s.bytes;
+        total.lastNs = std::max(total.lastNs, s.lastNs);
+        total.latencies.insert(total.latencies.end(), s.latencies.begin(), s.latencies.end());
+    }
+    double elapsed = total.lastNs > driverT0 ? (total.lastNs - driverT0) / 1e9 : 0;
+
+    if (speed > 0)
+        printf("Replay of %s at %gx speed\n", capture, speed);
+    else
+        printf("Replay of %s at max speed\n", capture);
+    printf("  %zu drivers sent %llu messages, %zu clients\n", drivers.size(), (unsigned long long)driverMessages,
+           clients.size());
+    printf("  clients received %llu messages, %.2f MB in %.3f s\n", (unsigned long long)total.messages,
+           total.bytes / 1e6, elapsed);
+    if (elapsed > 0)
+        printf("  throughput: %.0f msg/s, %.2f MB/s\n", total.messages / elapsed, total.bytes / 1e6 / elapsed);
+    if (!total.latencies.empty())
+    {
+        std::sort(total.latencies.begin(), total.latencies.end());
+        auto percentile = [&](double p)
+        {
+            return total.latencies[std::min(total.latencies.size() - 1, (size_t)(p * total.latencies.size()))] / 1e3;
+        };
+        printf("  latency (us): p50 %.0f, p90 %.0f, p99 %.0f, max %.0f\n", percentile(0.5), percentile(0.9),
+               percentile(0.99), total.latencies.back() / 1e3);
+    }
+
+    /* clean up */
+    for (auto &link : links)
+        unlink(link.c_str());
+    unlink(startPath.c_str());
+    unlink(socketPath.c_str());
+    unlink(logPath.c_str());
+    rmdir(dir);
+
+    return 0;
+}
+
+static void usage()
+{
+    fprintf(stderr, "Purpose: replay a capture of indiserver -C and measure the server\n");
+    fprintf(stderr, "%s\n", GIT_TAG_STRING);
+    fprintf(stderr, "Usage: %s [options] capture\n", me);
+    fprintf(stderr, "  Drivers and clients of the capture are played back through a new indiserver,\n");
+    fprintf(stderr, "  then the throughput and latency seen by the clients is reported.\n");
+    fprintf(stderr, "  BLOBs are sent with the length they had, filled with the bytes kept by -B.\n");
+    fprintf(stderr, "  Requests of clients to compress or frame their traffic are not replayed.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -a a  : pass argument a to indiserver, may be repeated\n");
+    fprintf(stderr, "  -e e  : indiserver executable, default is indiserver\n");
+    fprintf(stderr, "  -p p  : port of the indiserver, default is %d\n", REPLAYPORT);
+    fprintf(stderr, "  -s s  : speed factor relative to the capture, default is 1\n");
+    fprintf(stderr, "  -v    : verbose, show the indiserver log\n");
+    fprintf(stderr, "  -x    : max speed: send everything as fast as the server takes it\n");
+    fprintf(stderr, "Exit status:\n");
+    fprintf(stderr, "  0: replay done\n");
+    fprintf(stderr, "  2: real trouble, try repeating with -v\n");
+
+    exit(2);
+}
+
+static uint64_t now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void sleepUntil(uint64_t ns)
+{
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000ull;
+    ts.tv_nsec = ns % 1000000000ull;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+/* little endian reader of the capture */
+class Reader
+{
+        const std::string &data;
+        size_t pos;
+        bool failed = false;
+
+    public:
+        Reader(const std::string &data, size_t pos): data(data), pos(pos) {}
+
+        bool done() const
+        {
+            return pos >= data.size() || failed;
+        }
+
+        bool ok() const
+        {
+            return !failed;
+        }
+
+        uint64_t read(int bytes)
+        {
+            if (pos + bytes > data.size())
+            {
+                failed = true;
+                return 0;
+            }
+            uint64_t value = 0;
+            for (int i = 0; i < bytes; i++)
+                value |= (uint64_t)(unsigned char)data[pos++] << (8 * i);
+            return value;
+        }
+
+        std::string bytes(size_t count)
+        {
+            if (pos + count > data.size())
+            {
+                failed = true;
+                return std::string();
+            }
+            pos += count;
+            return data.substr(pos - count, count);
+        }
+};
+
+static bool loadCapture(const char *path, std::vector<Connection> &connections, uint64_t &endNs)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return false;
+    }
+    std::string data;
+    char buf[65536];
+    size_t nr;
+    while ((nr = fread(buf, 1, sizeof(buf), fp)) > 0)
+        data.append(buf, nr);
+    fclose(fp);
+
+    if (data.compare(0, CAPTURE_MAGIC_SIZE, CAPTURE_MAGIC) != 0)
+    {
+        fprintf(stderr, "%s: not an indiserver capture\n", path);
+        return false;
+    }
+
+    std::map<uint32_t, size_t> open;    /* capture id to index in connections */
+    Reader reader(data, CAPTURE_MAGIC_SIZE);
+    endNs = 0;
+    while (!reader.done())
+    {
+        int type = reader.read(1);
+        uint64_t ns = reader.read(8);
+        uint32_t id = reader.read(4);
+        if (!reader.ok())
+            break;
+
+        endNs = std::max(endNs, ns);
+        auto it = open.find(id);
+        switch (type)
+        {
+            case CaptureOpen:
+            {
+                Connection c;
+                c.role = (CaptureRole)reader.read(1);
+                c.name = reader.bytes(reader.read(2));
+                c.openNs = ns;
+                c.closed = false;
+                c.closeNs = 0;
+                open[id] = connections.size();
+                connections.push_back(c);
+                break;
+            }
+            case CaptureClose:
+                if (it != open.end())
+                {
+                    connections[it->second].closed = true;
+                    connections[it->second].closeNs = ns;
+                    open.erase(it);
+                }
+                break;
+            case CaptureIn:
+            {
+                reader.read(4);
+                std::string xml = reader.bytes(reader.read(4));
+                /* messages of the server itself are not replayed */
+                if (it != open.end())
+                    connections[it->second].in.push_back({ ns, xml });
+                break;
+            }
+            case CaptureOut:
+                reader.read(4);
+                break;
+            default:
+                fprintf(stderr, "%s: unknown record %d, capture truncated there\n", path, type);
+                return true;
+        }
+    }
+    if (!reader.ok())
+        fprintf(stderr, "%s: last record is incomplete\n", path);
+
+    if (verbose)
+        fprintf(stderr, "%s: %zu connections over %.3f s\n", path, connections.size(), endNs / 1e9);
+    return true;
+}
+
+/* a fake driver stands for all the runs of a driver */
+static std::vector<std::string> driverNames(const std::vector<Connection> &connections)
+{
+    std::vector<std::string> names;
+    for (auto &c : connections)
+        if (c.role == CaptureDriver && std::find(names.begin(), names.end(), c.name) == names.end())
+            names.push_back(c.name);
+    return names;
+}
+
+/* give BLOBs their recorded length again, starting with the bytes kept */
+static std::string expandBlobs(const std::string &xml)
+{
+    if (xml.find("<oneBLOB") == std::string::npos)
+        return xml;
+
+    LilXML *lp = newLilXML();
+    char ynot[1024];
+    std::string copy = xml;
+    XMLEle **nodes = parseXMLChunk(lp, &copy[0], copy.size(), ynot);
+    delLilXML(lp);
+    if (nodes == NULL)
+        return xml;
+    XMLEle *root = nodes[0];
+    for (int i = 1; root != NULL && nodes[i] != NULL; i++)
+        delXMLEle(nodes[i]);
+    free(nodes);
+    if (root == NULL)
+        return xml;
+
+    for (XMLEle *ep = nextXMLEle(root, 1); ep != NULL; ep = nextXMLEle(root, 0))
+    {
+        if (strcmp(tagXMLEle(ep), "oneBLOB") != 0)
+            continue;
+
+        std::string content(strtoul(findXMLAttValu(ep, "len"), NULL, 10), '\0');
+        int len = pcdatalenXMLEle(ep);
+        std::vector<char> kept(3 * len / 4 + 4);
+        int keptSize = from64tobits_fast(kept.data(), pcdataXMLEle(ep), len);
+        memcpy(&content[0], kept.data(), std::min(content.size(), (size_t)std::max(keptSize, 0)));
+
+        std::string encoded(4 * content.size() / 3 + 4, '\0');
+        encoded.resize(to64frombits_s((unsigned char *)&encoded[0], (const unsigned char *)content.data(),
+                                      content.size(), encoded.size()));
+        editXMLEle(ep, encoded.c_str());
+        rmXMLAtt(ep, "len");
+        rmXMLAtt(ep, "hash");
+        addXMLAtt(ep, "enclen", std::to_string(encoded.size()).c_str());
+    }
+
+    std::string text(sprlXMLEle(root, 0) + 1, '\0');
+    text.resize(sprXMLEle(&text[0], root, 0));
+    delXMLEle(root);
+    return text;
+}
+
+static bool writeAll(int fd, const struct iovec *iov, int count)
+{
+    std::vector<struct iovec> left(iov, iov + count);
+    size_t first = 0;
+    while (first < left.size())
+    {
+        ssize_t nw = writev(fd, &left[first], left.size() - first);
+        if (nw < 0 && errno == EINTR)
+            continue;
+        if (nw <= 0)
+            return false;
+        while (first < left.size() && (size_t)nw >= left[first].iov_len)
+            nw -= left[first++].iov_len;
+        if (first < left.size())
+        {
+            left[first].iov_base = (char *)left[first].iov_base + nw;
+            left[first].iov_len -= nw;
+        }
+    }
+    return true;
+}
+
+/* replay driver number index of the capture, on stdout */
+static int driverMain(int index)
+{
+    const char *capture = getenv("INDI_REPLAY_CAPTURE");
+    const char *startPath = getenv("INDI_REPLAY_START");
+    const char *speedText = getenv("INDI_REPLAY_SPEED");
+    if (capture == NULL || startPath == NULL || speedText == NULL)
+    {
+        fprintf(stderr, "only runs under indi_replay\n");
+        return 2;
+    }
+    double speed = atof(speedText);
+
+    std::vector<Connection> connections;
+    uint64_t endNs;
+    if (!loadCapture(capture, connections, endNs))
+        return 2;
+
+    std::vector<std::string> names = driverNames(connections);
+    if (index < 0 || (size_t)index >= names.size())
+    {
+        fprintf(stderr, "no driver %d in %s\n", index, capture);
+        return 2;
+    }
+
+    std::vector<Record> records;
+    for (auto &c : connections)
+        if (c.role == CaptureDriver && c.name == names[index])
+            records.insert(records.end(), c.in.begin(), c.in.end());
+    std::stable_sort(records.begin(), records.end(), [](const Record & a, const Record & b)
+    {
+        return a.ns < b.ns;
+    });
+
+    /* what the server sends is of no interest, until it goes away */
+    std::thread([]()
+    {
+        char buf[65536];
+        while (read(0, buf, sizeof(buf)) > 0)
+            ;
+        _exit(0);
+    }).detach();
+
+    uint64_t t0 = 0;
+    FILE *fp;
+    while ((fp = fopen(startPath, "r")) == NULL)
+        usleep(10000);
+    unsigned long long start;
+    if (fscanf(fp, "%llu", &start) == 1)
+        t0 = start;
+    fclose(fp);
+
+    for (auto &record : records)
+    {
+        if (speed > 0)
+            sleepUntil(t0 + (uint64_t)(record.ns / speed));
+        else
+            sleepUntil(t0);
+
+        std::string xml = expandBlobs(record.xml);
+
+        /* the sending time goes as first attribute */
+        size_t open = xml.find('<');
+        size_t at = open == std::string::npos ? open : xml.find_first_of(" \t\r\n/>", open + 1);
+        if (at == std::string::npos)
+            continue;
+        std::string tag = " replay='" + std::to_string(now()) + "'";
+
+        struct iovec iov[3] =
+        {
+            { &xml[0], at },
+            { &tag[0], tag.size() },
+            { &xml[at], xml.size() - at }
+        };
+        if (!writeAll(1, iov, 3))
+            return 0;
+    }
+
+    /* until the server closes */
+    for (;;)
+        pause();
+}
+
+/* play the client c, collecting the replay stamps it receives */
+static void replayClient(const Connection *c, uint64_t t0, double speed, uint64_t endNs, int port,
+                         ClientStats *stats)
+{
+    /* messages parsed by the server come out with double quotes */
+    static const char stamp[] = "replay=";
+    const size_t stampLen = sizeof(stamp) - 1;
+
+    *stats = { 0, 0, 0, {} };
+
+    sleepUntil(speed > 0 ? t0 + (uint64_t)(c->openNs / speed) : t0);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        fprintf(stderr, "Client %s can not connect: %s\n", c->name.c_str(), strerror(errno));
+        close(fd);
+        return;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    size_t next = 0;            /* next record to send */
+    size_t matched = 0;         /* bytes of stamp matched so far */
+    bool inStamp = false;
+    bool quoted = false;
+    uint64_t value = 0;
+    uint64_t lastActivity = now();
+    char buf[65536];
+
+    for (;;)
+    {
+        uint64_t t = now();
+        while (next < c->in.size() && (speed == 0 || t >= t0 + (uint64_t)(c->in[next].ns / speed)))
+        {
+            const std::string &xml = c->in[next++].xml;
+            if (xml.find("<enableCompression") != std::string::npos || xml.find("<enableBinaryFraming") != std::string::npos)
+                continue;
+            std::string expanded = expandBlobs(xml);
+            struct iovec iov = { &expanded[0], expanded.size() };
+            if (!writeAll(fd, &iov, 1))
+            {
+                close(fd);
+                return;
+            }
+        }
+
+        int timeout = 100;
+        if (next < c->in.size())
+        {
+            uint64_t due = t0 + (uint64_t)(c->in[next].ns / speed);
+            timeout = std::min<uint64_t>(timeout, (due - std::min(due, t)) / 1000000 + 1);
+        }
+        else if (speed > 0 && c->closed && t >= t0 + (uint64_t)(c->closeNs / speed))
+            break;
+        else if (t >= endNs && t - lastActivity >= IDLE * 1000000ull)
+            break;
+
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, timeout) <= 0)
+            continue;
+
+        ssize_t nr = read(fd, buf, sizeof(buf));
+        if (nr <= 0)
+            break;
+        lastActivity = now();
+        stats->bytes += nr;
+        stats->lastNs = lastActivity;
+
+        for (ssize_t i = 0; i < nr; i++)
+        {
+            char ch = buf[i];
+            if (inStamp && !quoted)
+            {
+                quoted = ch == '\'' || ch == '"';
+                if (quoted)
+                    continue;
+                inStamp = false;
+                matched = 0;
+            }
+            if (inStamp)
+            {
+                if (ch >= '0' && ch <= '9')
+                {
+                    value = value * 10 + (ch - '0');
+                    continue;
+                }
+                stats->messages++;
+                stats->latencies.push_back(lastActivity - std::min(value, lastActivity));
+                inStamp = false;
+                matched = 0;
+            }
+            if (ch == stamp[matched])
+            {
+                if (++matched == stampLen)
+                {
+                    inStamp = true;
+                    quoted = false;
+                    value = 0;
+                }
+            }
+            else
+                matched = ch == stamp[0] ? 1 : 0;
+        }
+    }
+
+    close(fd);
+}